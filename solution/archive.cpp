@@ -0,0 +1,546 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the implementation of the ZipArchive and ZipMemberBuffer
+  classes. See the header file for additional comments.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <zlib.h>
+
+#include "archive.h"
+
+/*
+  The signatures of the records in a .zip file.
+*/
+const uint32_t ZIP_LOCAL_HEADER_SIGNATURE = 0x04034b50;
+const uint32_t ZIP_CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+const uint32_t ZIP_END_SIGNATURE = 0x06054b50;
+
+/*
+  The sizes of the fixed parts of the records in a .zip file.
+*/
+const size_t ZIP_LOCAL_HEADER_SIZE = 30;
+const size_t ZIP_CENTRAL_HEADER_SIZE = 46;
+const size_t ZIP_END_SIZE = 22;
+
+/*
+  The end of central directory record is followed by a comment of up to this
+  many bytes, so we search this far back from the end of the file for it.
+*/
+const size_t ZIP_MAX_COMMENT = 0xffff;
+
+/*
+  The compression methods we support.
+*/
+const uint16_t ZIP_STORED = 0;
+const uint16_t ZIP_DEFLATED = 8;
+
+/*
+  The size of the blocks a member is read (and inflated) in.
+*/
+const size_t ZIP_BLOCK_SIZE = 64 * 1024;
+
+/*
+  Read a little-endian integer from a record.
+*/
+static uint16_t readUint16(const char* data) noexcept {
+  const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+  return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+}
+
+static uint32_t readUint32(const char* data) noexcept {
+  const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+  return static_cast<uint32_t>(bytes[0]) |
+         (static_cast<uint32_t>(bytes[1]) << 8) |
+         (static_cast<uint32_t>(bytes[2]) << 16) |
+         (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+/*
+  Open a .zip file and read the list of its members from its central
+  directory, which is found from the end of central directory record at the
+  end of the file.
+
+  @param path
+    The path to the .zip file
+
+  @throws
+    std::runtime_error if the file cannot be read, is not a .zip file, or is
+    a ZIP64 archive
+
+  @example
+    ZipArchive archive("datasets.zip");
+*/
+ZipArchive::ZipArchive(const std::string& path)
+    : mPath(path), mMembers(), mIndex() {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("ZipArchive: Failed to open file " + path);
+  }
+
+  file.seekg(0, std::ios::end);
+  const uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+  if (fileSize < ZIP_END_SIZE) {
+    throw std::runtime_error("ZipArchive: Not a .zip file: " + path);
+  }
+
+  const size_t tailSize = static_cast<size_t>(
+      std::min<uint64_t>(fileSize, ZIP_END_SIZE + ZIP_MAX_COMMENT));
+  std::vector<char> tail(tailSize);
+  file.seekg(fileSize - tailSize);
+  file.read(tail.data(), tailSize);
+  if (!file) {
+    throw std::runtime_error("ZipArchive: Failed to read file " + path);
+  }
+
+  // Search backwards, as the comment could contain the signature
+  size_t end = tailSize - ZIP_END_SIZE + 1;
+  do {
+    end--;
+  } while (end > 0 && readUint32(&tail[end]) != ZIP_END_SIGNATURE);
+  if (readUint32(&tail[end]) != ZIP_END_SIGNATURE) {
+    throw std::runtime_error("ZipArchive: Not a .zip file: " + path);
+  }
+
+  const uint16_t numMembers = readUint16(&tail[end + 10]);
+  const uint32_t directorySize = readUint32(&tail[end + 12]);
+  const uint32_t directoryOffset = readUint32(&tail[end + 16]);
+  if (numMembers == 0xffff || directoryOffset == 0xffffffff) {
+    throw std::runtime_error("ZipArchive: ZIP64 archives are not supported: " +
+                             path);
+  }
+  if (static_cast<uint64_t>(directoryOffset) + directorySize > fileSize) {
+    throw std::runtime_error("ZipArchive: Corrupt central directory in " +
+                             path);
+  }
+
+  std::vector<char> directory(directorySize);
+  file.seekg(directoryOffset);
+  file.read(directory.data(), directorySize);
+  if (!file) {
+    throw std::runtime_error("ZipArchive: Failed to read file " + path);
+  }
+
+  mMembers.reserve(numMembers);
+  size_t pos = 0;
+  for (unsigned int i = 0; i < numMembers; i++) {
+    if (pos + ZIP_CENTRAL_HEADER_SIZE > directory.size() ||
+        readUint32(&directory[pos]) != ZIP_CENTRAL_HEADER_SIGNATURE) {
+      throw std::runtime_error("ZipArchive: Corrupt central directory in " +
+                               path);
+    }
+
+    const char* header = &directory[pos];
+    const uint16_t nameLength = readUint16(header + 28);
+    const uint16_t extraLength = readUint16(header + 30);
+    const uint16_t commentLength = readUint16(header + 32);
+    if (pos + ZIP_CENTRAL_HEADER_SIZE + nameLength > directory.size()) {
+      throw std::runtime_error("ZipArchive: Corrupt central directory in " +
+                               path);
+    }
+
+    ZipMember member;
+    member.flags = readUint16(header + 8);
+    member.method = readUint16(header + 10);
+    member.crc = readUint32(header + 16);
+    member.compressedSize = readUint32(header + 20);
+    member.size = readUint32(header + 24);
+    member.headerOffset = readUint32(header + 42);
+    member.name.assign(header + ZIP_CENTRAL_HEADER_SIZE, nameLength);
+
+    mIndex.emplace(member.name, mMembers.size());
+    mMembers.push_back(std::move(member));
+
+    pos += ZIP_CENTRAL_HEADER_SIZE + nameLength + extraLength + commentLength;
+  }
+}
+
+/*
+  Check whether a file is a .zip file, from the signature at its start.
+
+  @param path
+    The path to the file
+
+  @return
+    true if the file starts with the signature of a member or of an empty
+    archive
+*/
+bool ZipArchive::isArchive(const std::string& path) noexcept {
+  std::ifstream file(path, std::ios::binary);
+  char signature[4];
+  if (!file.read(signature, sizeof(signature))) {
+    return false;
+  }
+
+  const uint32_t value = readUint32(signature);
+  return value == ZIP_LOCAL_HEADER_SIGNATURE || value == ZIP_END_SIGNATURE;
+}
+
+/*
+  Split a path to a file within a .zip file, e.g. datasets.zip/areas.csv,
+  into the path of the .zip file and the name of the member within it. The
+  path may use either separator.
+
+  @param path
+    The path
+
+  @param archivePath
+    Set to the path of the .zip file, if the path is within one
+
+  @param memberName
+    Set to the name of the member, with / as the separator, if the path is
+    within a .zip file
+
+  @return
+    true if the path is within a .zip file
+
+  @example
+    std::string archivePath, memberName;
+    if (ZipArchive::splitPath("datasets.zip/areas.csv",
+                              archivePath,
+                              memberName)) {
+      ...
+    }
+*/
+bool ZipArchive::splitPath(const std::string& path,
+                           std::string& archivePath,
+                           std::string& memberName) {
+  std::string normalised = path;
+  std::replace(normalised.begin(), normalised.end(), '\\', '/');
+
+  // Find the first part of the path that is a file, rather than a directory
+  size_t end = 0;
+  while ((end = normalised.find('/', end + 1)) != std::string::npos) {
+    const std::string prefix = normalised.substr(0, end);
+
+    std::error_code ec;
+    const auto status = std::filesystem::status(prefix, ec);
+    if (ec || !std::filesystem::exists(status)) {
+      return false;
+    } else if (std::filesystem::is_directory(status)) {
+      continue;
+    } else if (!isArchive(prefix)) {
+      return false;
+    }
+
+    archivePath = path.substr(0, end);
+    memberName = normalised.substr(end + 1);
+    return !memberName.empty();
+  }
+
+  return false;
+}
+
+/*
+  Retrieve the path of the .zip file.
+
+  @return
+    The path
+*/
+const std::string& ZipArchive::getPath() const noexcept {
+  return mPath;
+}
+
+/*
+  Retrieve the members of the .zip file, in the order of its central
+  directory.
+
+  @return
+    The members
+*/
+const std::vector<ZipMember>& ZipArchive::getMembers() const noexcept {
+  return mMembers;
+}
+
+/*
+  Find a member by its name. As archives often have all of their files in a
+  directory (e.g. a bundle with a datasets/ directory in it), if there is no
+  member with exactly this name, the member with the shortest name ending
+  with / and this name is found instead.
+
+  @param name
+    The name of the member, e.g. areas.csv
+
+  @return
+    The member, or nullptr if there is no such member
+*/
+const ZipMember* ZipArchive::find(const std::string& name) const noexcept {
+  auto it = mIndex.find(name);
+  if (it != mIndex.end()) {
+    return &mMembers[it->second];
+  }
+
+  const std::string suffix = "/" + name;
+  const ZipMember* found = nullptr;
+  for (auto memberIt = mMembers.cbegin();
+       memberIt != mMembers.cend();
+       memberIt++) {
+    const std::string& memberName = memberIt->name;
+    if (memberName.size() > suffix.size() &&
+        memberName.compare(memberName.size() - suffix.size(),
+                           suffix.size(),
+                           suffix) == 0 &&
+        (found == nullptr || memberName.size() < found->name.size())) {
+      found = &*memberIt;
+    }
+  }
+
+  return found;
+}
+
+/*
+  Constructor for a stream buffer for a member of a .zip file, which opens
+  the file and finds the start of the member's data from its local header.
+
+  @param archive
+    The .zip file
+
+  @param member
+    The member of the .zip file to read
+
+  @throws
+    std::runtime_error if the member cannot be read, is encrypted, or is
+    compressed with a method other than deflate
+
+  @example
+    ZipArchive archive("datasets.zip");
+    ZipMemberBuffer buffer(archive, *archive.find("areas.csv"));
+    std::istream stream(&buffer);
+*/
+ZipMemberBuffer::ZipMemberBuffer(const ZipArchive& archive,
+                                 const ZipMember& member)
+    : mMember(member),
+      mFile(archive.getPath(), std::ios::binary),
+      mDataOffset(0),
+      mBlockStart(0),
+      mRemaining(member.compressedSize),
+      mRead(0),
+      mCrc(crc32(0L, Z_NULL, 0)),
+      mInflating(false),
+      mEnded(false),
+      mZ(),
+      mIn(),
+      mOut(ZIP_BLOCK_SIZE) {
+  const std::string source = archive.getPath() + ":" + member.name;
+
+  if (member.flags & 0x1) {
+    throw std::runtime_error("ZipMemberBuffer: Encrypted members are not "
+                             "supported: " + source);
+  }
+  if (member.method != ZIP_STORED && member.method != ZIP_DEFLATED) {
+    throw std::runtime_error("ZipMemberBuffer: Unsupported compression "
+                             "method " + std::to_string(member.method) +
+                             ": " + source);
+  }
+
+  char header[ZIP_LOCAL_HEADER_SIZE];
+  mFile.seekg(member.headerOffset);
+  if (!mFile.read(header, sizeof(header)) ||
+      readUint32(header) != ZIP_LOCAL_HEADER_SIGNATURE) {
+    throw std::runtime_error("ZipMemberBuffer: Corrupt local header for " +
+                             source);
+  }
+
+  // The local header's name and extra field may differ from the central
+  // directory's, so we skip over its own
+  mFile.seekg(readUint16(header + 26) + readUint16(header + 28),
+              std::ios::cur);
+  mDataOffset = mFile.tellg();
+
+  if (member.method == ZIP_DEFLATED) {
+    mIn.resize(ZIP_BLOCK_SIZE);
+    if (inflateInit2(&mZ, -MAX_WBITS) != Z_OK) {
+      throw std::runtime_error("ZipMemberBuffer: Failed to start inflating " +
+                               source);
+    }
+    mInflating = true;
+  }
+
+  setg(mOut.data(), mOut.data(), mOut.data());
+}
+
+ZipMemberBuffer::~ZipMemberBuffer() {
+  if (mInflating) {
+    inflateEnd(&mZ);
+  }
+}
+
+/*
+  Read (and inflate) the next block of the member into mOut.
+
+  @return
+    The number of bytes in mOut, which is 0 at the end of the member
+
+  @throws
+    std::runtime_error if the member cannot be read, is corrupt, or does not
+    match its CRC-32
+*/
+size_t ZipMemberBuffer::fill() {
+  size_t length = 0;
+
+  while (length == 0 && !mEnded) {
+    if (!mInflating) {
+      length = std::min<size_t>(mRemaining, mOut.size());
+      if (length > 0 && !mFile.read(mOut.data(), length)) {
+        throw std::runtime_error("ZipMemberBuffer: Truncated member " +
+                                 mMember.name);
+      }
+      mRemaining -= length;
+      mEnded = length == 0;
+    } else {
+      if (mZ.avail_in == 0 && mRemaining > 0) {
+        const size_t inLength = std::min<size_t>(mRemaining, mIn.size());
+        if (!mFile.read(mIn.data(), inLength)) {
+          throw std::runtime_error("ZipMemberBuffer: Truncated member " +
+                                   mMember.name);
+        }
+        mRemaining -= inLength;
+        mZ.next_in = reinterpret_cast<Bytef*>(mIn.data());
+        mZ.avail_in = static_cast<uInt>(inLength);
+      }
+
+      mZ.next_out = reinterpret_cast<Bytef*>(mOut.data());
+      mZ.avail_out = static_cast<uInt>(mOut.size());
+      const int status = inflate(&mZ, Z_NO_FLUSH);
+      length = mOut.size() - mZ.avail_out;
+
+      if (status == Z_STREAM_END) {
+        mEnded = true;
+      } else if (status != Z_OK &&
+                 !(status == Z_BUF_ERROR && mRemaining > 0)) {
+        throw std::runtime_error("ZipMemberBuffer: Corrupt member " +
+                                 mMember.name);
+      }
+    }
+
+    mRead += static_cast<uint32_t>(length);
+    mCrc = crc32(mCrc, reinterpret_cast<const Bytef*>(mOut.data()),
+                 static_cast<uInt>(length));
+  }
+
+  if (mEnded && length == 0 &&
+      (mRead != mMember.size || mCrc != mMember.crc)) {
+    throw std::runtime_error("ZipMemberBuffer: CRC mismatch for member " +
+                             mMember.name);
+  }
+
+  return length;
+}
+
+/*
+  Refill the get area with the next block of the member.
+
+  @return
+    The next character, or EOF at the end of the member
+*/
+ZipMemberBuffer::int_type ZipMemberBuffer::underflow() {
+  if (gptr() < egptr()) {
+    return traits_type::to_int_type(*gptr());
+  }
+
+  mBlockStart += egptr() - eback();
+  const size_t length = fill();
+  setg(mOut.data(), mOut.data(), mOut.data() + length);
+
+  return length == 0 ? traits_type::eof()
+                     : traits_type::to_int_type(*gptr());
+}
+
+/*
+  Go back to the start of the member, to read it again.
+
+  @throws
+    std::runtime_error if the member cannot be read
+*/
+void ZipMemberBuffer::rewind() {
+  mFile.clear();
+  mFile.seekg(mDataOffset);
+  if (!mFile) {
+    throw std::runtime_error("ZipMemberBuffer: Failed to rewind member " +
+                             mMember.name);
+  }
+
+  if (mInflating) {
+    inflateReset(&mZ);
+    mZ.avail_in = 0;
+  }
+
+  mRemaining = mMember.compressedSize;
+  mRead = 0;
+  mCrc = crc32(0L, Z_NULL, 0);
+  mEnded = false;
+  mBlockStart = 0;
+  setg(mOut.data(), mOut.data(), mOut.data());
+}
+
+/*
+  Seek to a position relative to the start, the current position, or the
+  end of the member.
+
+  @return
+    The new position, or -1 if it is outside of the member
+*/
+ZipMemberBuffer::pos_type ZipMemberBuffer::seekoff(
+    off_type off,
+    std::ios_base::seekdir dir,
+    std::ios_base::openmode which) {
+  off_type pos = off;
+  if (dir == std::ios_base::cur) {
+    pos += mBlockStart + (gptr() - eback());
+  } else if (dir == std::ios_base::end) {
+    pos += mMember.size;
+  }
+
+  return seekpos(pos_type(pos), which);
+}
+
+/*
+  Seek to a position in the member. Within the current block, this just
+  moves within it, otherwise the member is read (and inflated) up to the
+  position, from its start if the position is before the current block.
+
+  @return
+    The new position, or -1 if it is outside of the member
+*/
+ZipMemberBuffer::pos_type ZipMemberBuffer::seekpos(
+    pos_type pos,
+    std::ios_base::openmode which) {
+  const off_type target = off_type(pos);
+  if (!(which & std::ios_base::in) || target < 0 || target > mMember.size) {
+    return pos_type(off_type(-1));
+  }
+
+  if (target < mBlockStart) {
+    rewind();
+  }
+
+  while (target > mBlockStart + (egptr() - eback()) ||
+         (target == mBlockStart + (egptr() - eback()) &&
+          target < mMember.size)) {
+    mBlockStart += egptr() - eback();
+    const size_t length = fill();
+    setg(mOut.data(), mOut.data(), mOut.data() + length);
+    if (length == 0) {
+      return pos_type(off_type(-1));
+    }
+  }
+
+  setg(eback(), eback() + (target - mBlockStart), egptr());
+  return pos;
+}
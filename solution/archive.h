@@ -0,0 +1,104 @@
+#ifndef ARCHIVE_H_
+#define ARCHIVE_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the ZipArchive class, which lists the members of a .zip
+  file from its central directory, and the ZipMemberBuffer class, which reads
+  a member from the archive as a stream (see InputArchive in input.h) without
+  extracting it to disk.
+
+  Members may be stored or deflated. Deflated members are inflated with zlib
+  a block at a time as they are read, so only one block of a member is in
+  memory at once. The CRC-32 of each member is checked once it has been read
+  in full. A member can be seeked within, as the parsers do to check that a
+  stream is readable, but seeking back before the current block inflates the
+  member again from its start. Encrypted members and ZIP64 archives (i.e.
+  those of 4GB or more) are not supported.
+ */
+
+#include <cstdint>
+#include <fstream>
+#include <streambuf>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <zlib.h>
+
+/*
+  A member of a .zip file, as listed in its central directory.
+*/
+struct ZipMember {
+  std::string name;
+  uint16_t method;
+  uint16_t flags;
+  uint32_t crc;
+  uint32_t compressedSize;
+  uint32_t size;
+  uint32_t headerOffset;
+};
+
+class ZipArchive {
+protected:
+  std::string mPath;
+  std::vector<ZipMember> mMembers;
+  std::unordered_map<std::string, size_t> mIndex;
+
+public:
+  explicit ZipArchive(const std::string& path);
+  ~ZipArchive() = default;
+
+  static bool isArchive(const std::string& path) noexcept;
+  static bool splitPath(const std::string& path,
+                        std::string& archivePath,
+                        std::string& memberName);
+
+  const std::string& getPath() const noexcept;
+  const std::vector<ZipMember>& getMembers() const noexcept;
+
+  const ZipMember* find(const std::string& name) const noexcept;
+};
+
+/*
+  A stream buffer that reads one member of a ZipArchive, inflating it if it
+  is deflated.
+*/
+class ZipMemberBuffer : public std::streambuf {
+protected:
+  const ZipMember mMember;
+  std::ifstream mFile;
+  std::streamoff mDataOffset;
+  std::streamoff mBlockStart;
+  uint32_t mRemaining;
+  uint32_t mRead;
+  uint32_t mCrc;
+  bool mInflating;
+  bool mEnded;
+  z_stream mZ;
+  std::vector<char> mIn;
+  std::vector<char> mOut;
+
+  size_t fill();
+  void rewind();
+
+  virtual int_type underflow();
+  virtual pos_type seekoff(off_type off,
+                           std::ios_base::seekdir dir,
+                           std::ios_base::openmode which);
+  virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+
+public:
+  ZipMemberBuffer(const ZipArchive& archive, const ZipMember& member);
+  virtual ~ZipMemberBuffer();
+
+  ZipMemberBuffer(const ZipMemberBuffer& other) = delete;
+  ZipMemberBuffer& operator=(const ZipMemberBuffer& other) = delete;
+};
+
+#endif // ARCHIVE_H_
@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <stdexcept>
 
@@ -33,14 +34,84 @@
   @param localAuthorityCode
     The local authority code of the Area
 
+  @param alloc
+    The allocator for the Area's containers, by default using the default
+    memory resource
+
   @example
     Area("W06000023");
 */
-Area::Area(const std::string& localAuthorityCode)
+Area::Area(const std::string& localAuthorityCode, const allocator_type& alloc)
+    : mLocalAuthorityCode(
+          std::make_shared<const std::string>(localAuthorityCode)),
+      mNames(alloc),
+      mNamesList(alloc),
+      mMeasures(alloc) {
+}
+
+/*
+  Construct an Area with a local authority code interned in a SymbolTable.
+
+  @param localAuthorityCode
+    The interned local authority code of the Area
+
+  @param alloc
+    The allocator for the Area's containers
+
+  @example
+    SymbolTable symbols;
+    Area(symbols.ref(symbols.intern("W06000023")));
+*/
+Area::Area(const SymbolRef& localAuthorityCode, const allocator_type& alloc)
     : mLocalAuthorityCode(localAuthorityCode),
-      mNames(),
-      mNamesList(),
-      mMeasures() {
+      mNames(alloc),
+      mNamesList(alloc),
+      mMeasures(alloc) {
+}
+
+/*
+  Copy an Area into memory from the given allocator. This is used by std::pmr
+  containers when an Area is inserted into them, and the allocator is passed
+  down to the copied Measures.
+
+  @param other
+    The Area to copy
+
+  @param alloc
+    The allocator for the copy's containers
+*/
+Area::Area(const Area& other, const allocator_type& alloc)
+    : mLocalAuthorityCode(other.mLocalAuthorityCode),
+      mNames(other.mNames, alloc),
+      mNamesList(other.mNamesList, alloc),
+      mMeasures(other.mMeasures, alloc) {
+}
+
+/*
+  Move an Area into memory from the given allocator. If the allocators differ,
+  the containers are copied rather than moved.
+
+  @param other
+    The Area to move
+
+  @param alloc
+    The allocator for the new Area's containers
+*/
+Area::Area(Area&& other, const allocator_type& alloc)
+    : mLocalAuthorityCode(std::move(other.mLocalAuthorityCode)),
+      mNames(std::move(other.mNames), alloc),
+      mNamesList(std::move(other.mNamesList), alloc),
+      mMeasures(std::move(other.mMeasures), alloc) {
+}
+
+/*
+  Retrieve the allocator this Area's containers are allocated from.
+
+  @return
+    The allocator
+*/
+Area::allocator_type Area::get_allocator() const noexcept {
+  return mMeasures.get_allocator();
 }
 
 /*
@@ -58,6 +129,16 @@ Area::Area(const std::string& localAuthorityCode)
     auto authCode = area.getLocalAuthorityCode();
 */
 const std::string& Area::getLocalAuthorityCode() const {
+  return *mLocalAuthorityCode;
+}
+
+/*
+  Retrieve the shared storage for the Area's local authority code.
+
+  @return
+    A shared reference to the local authority code
+*/
+const SymbolRef& Area::getLocalAuthorityCodeRef() const noexcept {
   return mLocalAuthorityCode;
 }
 
@@ -105,7 +186,7 @@ const std::string& Area::getName(std::string lang) const {
     ...
     auto names = area.getNames();
 */
-const std::map<std::string, std::string>& Area::getNames() const {
+const AreaNames_c& Area::getNames() const {
   return mNames;
 }
 
@@ -192,11 +273,82 @@ void Area::setName(std::string lang, std::string&& name) {
 Measure& Area::getMeasure(std::string key) {
   std::transform(key.begin(), key.end(), key.begin(), ::tolower);
   
-  try {
-    return mMeasures.at(key);
-  } catch (const std::out_of_range& ex) {
+  auto existingIt = mMeasures.find(key);
+  if (existingIt == mMeasures.end()) {
     throw std::out_of_range("No measure found matching " + key);
   }
+
+  return existingIt->second;
+}
+
+/*
+  Find a Measure given its interned (lowercase) codename, without throwing an
+  exception if it does not exist. This is used by the parsers, which look up
+  the same measure for many rows.
+
+  @param codename
+    The interned codename for the measure
+
+  @return
+    A pointer to the Measure, or nullptr if there is no such Measure
+*/
+Measure* Area::findMeasure(const SymbolRef& codename) noexcept {
+  auto existingIt = mMeasures.find(codename);
+  if (existingIt == mMeasures.end()) {
+    return nullptr;
+  }
+
+  return &existingIt->second;
+}
+
+/*
+  Remove a Measure, given its codename, if there is one. As with getMeasure(),
+  the codename is case insensitive.
+
+  @param key
+    The codename for the measure to remove
+
+  @return
+    true if a Measure was removed
+
+  @example
+    Area area("W06000023");
+    area.setMeasure("pop", Measure("pop", "Population"));
+    area.removeMeasure("Pop"); // returns true
+*/
+bool Area::removeMeasure(std::string key) {
+  std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+
+  auto existingIt = mMeasures.find(key);
+  if (existingIt == mMeasures.end()) {
+    return false;
+  }
+
+  mMeasures.erase(existingIt);
+  return true;
+}
+
+/*
+  Produce the key for a Measure inserted with the given (lowercase) codename.
+  The Measure's own codename storage is shared where it matches, which is
+  always the case for Measures created by the parsers.
+
+  @param key
+    The lowercase codename to key the Measure with
+
+  @param measure
+    The Measure being inserted
+
+  @return
+    A SymbolRef for the key
+*/
+static SymbolRef measureKey(std::string&& key, const Measure& measure) {
+  const SymbolRef& codename = measure.getCodenameRef();
+  if (*codename == key) {
+    return codename;
+  }
+
+  return std::make_shared<const std::string>(std::move(key));
 }
 
 /*
@@ -237,14 +389,14 @@ void Area::setMeasure(std::string key, Measure& value) {
   if (existingIt != mMeasures.end()) {
     Measure& existingMeasure = existingIt->second;
 
-    existingMeasure.setLabel(value.getLabel());
+    existingMeasure.setLabel(value.getLabelRef());
     for (auto it = value.begin(); it != value.end(); it++) {
       existingMeasure.setValue(it->first, it->second);
     }    
     return;
   }
   
-  mMeasures.emplace(key, value);
+  mMeasures.emplace(measureKey(std::move(key), value), value);
 }
 
 void Area::setMeasure(std::string key, Measure&& value) {
@@ -252,16 +404,82 @@ void Area::setMeasure(std::string key, Measure&& value) {
   
   auto existingIt = mMeasures.find(key);
   if (existingIt != mMeasures.end()) {
-    Measure& existingMeasure = existingIt->second;
-
-    existingMeasure.setLabel(value.getLabel());
-    for (auto it = value.begin(); it != value.end(); it++) {
-      existingMeasure.setValue(it->first, it->second);
-    }    
+    existingIt->second.merge(std::move(value));
     return;
   }
   
-  mMeasures.emplace(key, std::move(value));
+  SymbolRef ref = measureKey(std::move(key), value);
+  mMeasures.emplace(std::move(ref), std::move(value));
+}
+
+/*
+  Merge another Area into this one, consuming it. As with setName() and
+  setMeasure(), the names, labels and values in the incoming Area take
+  precedence over those in this Area. The local authority code of this Area
+  is kept.
+
+  With MergePolicy::Import, this Area instead keeps its names (ignoring all
+  of the incoming names, as the parsers only name an Area when creating it)
+  and the labels of its Measures, as if the other Area's data had been
+  imported into this one.
+
+  Names and Measures that this Area does not have are moved across by
+  splicing the nodes of the other Area's containers into ours, which is
+  possible when both Areas allocate from the same memory resource (e.g.
+  within an Areas instance). Measures that both Areas have are merged with
+  Measure::merge().
+
+  @param other
+    The Area to merge into this one, which is left empty
+
+  @param policy
+    Whether the incoming names and labels replace ours (MergePolicy::Replace)
+    or are ignored (MergePolicy::Import)
+
+  @example
+    Area area("W06000023");
+    area.setName("eng", "Powys");
+
+    Area update("W06000023");
+    update.setName("cym", "Powys");
+    update.setMeasure("pop", Measure("pop", "Population"));
+
+    area.merge(std::move(update));
+*/
+void Area::merge(Area&& other, MergePolicy policy) {
+  if (policy == MergePolicy::Replace) {
+    if (mNames.get_allocator() == other.mNames.get_allocator()) {
+      // Names in both Areas are left behind in other.mNames
+      mNames.merge(other.mNames);
+      for (auto it = other.mNames.begin(); it != other.mNames.end(); it++) {
+        mNames[it->first] = std::move(it->second);
+      }
+    } else {
+      for (auto it = other.mNames.begin(); it != other.mNames.end(); it++) {
+        mNames.insert_or_assign(it->first, std::move(it->second));
+      }
+    }
+  }
+
+  if (mMeasures.get_allocator() == other.mMeasures.get_allocator()) {
+    // Measures in both Areas are left behind in other.mMeasures
+    mMeasures.merge(other.mMeasures);
+    for (auto it = other.mMeasures.begin(); it != other.mMeasures.end(); it++) {
+      mMeasures.find(it->first)->second.merge(std::move(it->second), policy);
+    }
+  } else {
+    for (auto it = other.mMeasures.begin(); it != other.mMeasures.end(); it++) {
+      auto existingIt = mMeasures.find(it->first);
+      if (existingIt != mMeasures.end()) {
+        existingIt->second.merge(std::move(it->second), policy);
+      } else {
+        mMeasures.emplace(it->first, std::move(it->second));
+      }
+    }
+  }
+
+  other.mNames.clear();
+  other.mMeasures.clear();
 }
 
 /*
@@ -383,7 +601,7 @@ std::ostream& operator<<(std::ostream& os, const Area& area) {
     bool eq = area1 == area2;
 */
 bool operator==(const Area& lhs, const Area& rhs) {
-  return lhs.mLocalAuthorityCode == rhs.mLocalAuthorityCode&& 
+  return *lhs.mLocalAuthorityCode == *rhs.mLocalAuthorityCode&& 
          lhs.mNames              == rhs.mNames&& 
          lhs.mNamesList          == rhs.mNamesList&& 
          lhs.mMeasures           == rhs.mMeasures;
@@ -16,57 +16,84 @@
   functions and member variables you need to declare in this class.
  */
 
+#include <cstddef>
 #include <iostream>
 #include <iterator>
 #include <map>
+#include <memory_resource>
 #include <set>
 #include <string>
 #include <tuple>
 #include <vector>
 
 #include "measure.h"
+#include "symbols.h"
 
 /*
   The Areas class stores the area-based statistics data in a map of measure
-  code to Measure object. Here we define this shortcut for the class.
+  code to Measure object. Here we define this shortcut for the class. The key
+  shares its storage with the Measure's codename, and can be searched for with
+  a std::string.
 */
-using Area_c = std::map<std::string, Measure>;
+using Area_c = std::pmr::map<SymbolRef, Measure, SymbolLess>;
+
+/*
+  The names of an Area, as a map of language code to name.
+*/
+using AreaNames_c = std::pmr::map<std::string, std::string>;
 
 /*
   An Area object consists of a unique authority code, a container for names
   for the area in any number of different languages, and a container for the
   Measures objects.
 
+  Like Measure, Area is allocator-aware, so that the containers of an Area held
+  by Areas, and of its Measures, allocate from the memory resource of Areas.
+  The strings themselves (names and interned codes) stay on the heap, as they
+  can be shared with copies that outlive the Areas instance.
+
   TODO: Based on your implementation, there may be additional constructors
   or functions you implement here, and perhaps additional operators you may wish
   to overload.
 */
 class Area {
 protected:
-  std::string mLocalAuthorityCode;
-  std::map<std::string, std::string> mNames;
-  std::vector<std::string> mNamesList;
+  SymbolRef mLocalAuthorityCode;
+  AreaNames_c mNames;
+  std::pmr::vector<std::string> mNamesList;
   Area_c mMeasures;
 
 public:
-  Area(const std::string& localAuthorityCode);
+  using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+  Area(const std::string& localAuthorityCode,
+       const allocator_type& alloc = {});
+  Area(const SymbolRef& localAuthorityCode, const allocator_type& alloc = {});
   ~Area() = default;
 
   Area(const Area& other) = default;
+  Area(const Area& other, const allocator_type& alloc);
   Area& operator=(const Area& other) = default;
   Area(Area&& other) = default;
+  Area(Area&& other, const allocator_type& alloc);
   Area& operator=(Area&& other) = default;
 
+  allocator_type get_allocator() const noexcept;
+
   const std::string& getLocalAuthorityCode() const;
+  const SymbolRef& getLocalAuthorityCodeRef() const noexcept;
 
   const std::string& getName(std::string lang) const;
-  const std::map<std::string, std::string>& getNames() const;
+  const AreaNames_c& getNames() const;
   void setName(std::string lang, const std::string& name);
   void setName(std::string lang, std::string&& name);
 
   void setMeasure(std::string ident, Measure& stat);
   void setMeasure(std::string ident, Measure&& stat);
   Measure& getMeasure(std::string ident);
+  Measure* findMeasure(const SymbolRef& codename) noexcept;
+  bool removeMeasure(std::string key);
+  void merge(Area&& other, MergePolicy policy = MergePolicy::Replace);
   size_t size() const noexcept;
 
   friend std::ostream& operator<<(std::ostream& os, const Area& area);
@@ -18,12 +18,17 @@
   must implement has a TODO block comment. 
 */
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <new>
 #include <sstream>
 #include <string>
 #include <stdexcept>
 #include <tuple>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -32,22 +37,313 @@
 #include "datasets.h"
 #include "areas.h"
 #include "area.h"
+#include "cell.h"
 #include "measure.h"
+#include "pipeline.h"
+#include "projection.h"
 
 /*
   An alias for the imported JSON parsing library.
 */
 using json = nlohmann::json;
 
+/*
+  Areas stores Area objects in a std::vector, which moves them when it grows.
+  The parsers keep pointers to Measure objects across rows, which is only safe
+  if the Area objects are moved (and their Measures not copied).
+*/
+static_assert(std::is_nothrow_move_constructible<Area>::value,
+              "Area must be nothrow move constructible");
+
+/*
+  The size of the first block of memory allocated by the arena of an Areas
+  instance. Each subsequent block is larger than the last, so a large import
+  only needs a handful of allocations from the operating system.
+*/
+const size_t AREAS_ARENA_INITIAL_SIZE = 64 * 1024;
+
 /*
   TODO: Areas::Areas()
 
   Constructor for an Areas object.
 
+  @param memory
+    Whether to allocate from an arena owned by this instance (the default), or
+    from the default memory resource
+
+  @example
+    Areas data = Areas();
+    Areas heapData = Areas(AreasMemory::Default);
+*/
+Areas::Areas(AreasMemory memory)
+    : mArena(memory == AreasMemory::Arena
+                 ? std::make_unique<std::pmr::monotonic_buffer_resource>(
+                       AREAS_ARENA_INITIAL_SIZE)
+                 : nullptr),
+      mResource(mArena ? mArena.get() : std::pmr::get_default_resource()),
+      mSymbols(mResource),
+      mIndex(mResource),
+      mAreas(mResource),
+      mAreasByName(mResource),
+      mOrder(mResource),
+      mOrderValid(true),
+      mIngestThreads(1) {}
+
+/*
+  Constructor for an Areas object that allocates from a memory resource owned
+  by the caller, which must outlive the Areas instance. Areas instances that
+  share a memory resource can be merged by splicing rather than copying.
+
+  @param resource
+    The memory resource to allocate from
+
+  @example
+    std::pmr::unsynchronized_pool_resource pool;
+    Areas data = Areas(&pool);
+    Areas update = Areas(&pool);
+*/
+Areas::Areas(std::pmr::memory_resource* resource)
+    : mArena(),
+      mResource(resource),
+      mSymbols(mResource),
+      mIndex(mResource),
+      mAreas(mResource),
+      mAreasByName(mResource),
+      mOrder(mResource),
+      mOrderValid(true),
+      mIngestThreads(1) {}
+
+/*
+  Move construct an Areas instance, taking over the other instance's arena
+  (if it has one) along with the data allocated from it. The containers are
+  moved with their memory resource, so they keep allocating from that arena.
+  The other instance is left empty and using the default memory resource,
+  so it can still be used rather than allocating from an arena it no longer
+  owns.
+
+  @param other
+    The Areas instance to move from
+
+  @example
+    Areas data = Areas();
+    Areas moved = Areas(std::move(data));
+*/
+Areas::Areas(Areas&& other) noexcept
+    : mArena(std::move(other.mArena)),
+      mResource(other.mResource),
+      mSymbols(std::move(other.mSymbols)),
+      mIndex(std::move(other.mIndex)),
+      mAreas(std::move(other.mAreas)),
+      mAreasByName(std::move(other.mAreasByName)),
+      mOrder(std::move(other.mOrder)),
+      mOrderValid(other.mOrderValid),
+      mIngestThreads(other.mIngestThreads) {
+  other.resetToDefaultResource();
+}
+
+/*
+  Move assign an Areas instance. A defaulted move assignment operator would
+  release our arena while containers allocated from it were still being
+  assigned to, or leave our containers bound to our arena while holding the
+  other instance's data (memory resources do not propagate on assignment).
+  Instead, we destroy our containers while our arena is still alive, take
+  over the other instance's arena, and move construct each container in
+  place from the other instance's, so that they keep allocating from the
+  arena that holds their data. The containers cannot throw when moved, so
+  this instance is never left without them. As with the move constructor,
+  the other instance is left empty and using the default memory resource.
+
+  @param other
+    The Areas instance to move from
+
+  @return
+    This Areas instance
+*/
+Areas& Areas::operator=(Areas&& other) {
+  static_assert(std::is_nothrow_move_constructible<SymbolTable>::value &&
+                    std::is_nothrow_move_constructible<CodeIndex>::value &&
+                    std::is_nothrow_move_constructible<AreasContainer>::value &&
+                    std::is_nothrow_move_constructible<
+                        AreasContainerNamesToAuthorityCodes>::value &&
+                    std::is_nothrow_move_constructible<
+                        std::pmr::vector<size_t>>::value,
+                "Areas must be able to move its containers without throwing");
+  using OrderContainer = std::pmr::vector<size_t>;
+
+  if (this != &other) {
+    mOrder.~OrderContainer();
+    mAreasByName.~AreasContainerNamesToAuthorityCodes();
+    mAreas.~AreasContainer();
+    mIndex.~CodeIndex();
+    mSymbols.~SymbolTable();
+
+    mArena = std::move(other.mArena);
+    mResource = other.mResource;
+
+    new (&mSymbols) SymbolTable(std::move(other.mSymbols));
+    new (&mIndex) CodeIndex(std::move(other.mIndex));
+    new (&mAreas) AreasContainer(std::move(other.mAreas));
+    new (&mAreasByName)
+        AreasContainerNamesToAuthorityCodes(std::move(other.mAreasByName));
+    new (&mOrder) OrderContainer(std::move(other.mOrder));
+    mOrderValid = other.mOrderValid;
+    mIngestThreads = other.mIngestThreads;
+
+    other.resetToDefaultResource();
+  }
+
+  return *this;
+}
+
+/*
+  Leave a moved-from Areas instance empty and allocating from the default
+  memory resource. Its containers are bound to the memory resource of the
+  instance it was moved to, which they must no longer allocate from, so
+  they are destroyed (while that resource is still alive) and constructed
+  afresh.
+*/
+void Areas::resetToDefaultResource() noexcept {
+  using OrderContainer = std::pmr::vector<size_t>;
+
+  mOrder.~OrderContainer();
+  mAreasByName.~AreasContainerNamesToAuthorityCodes();
+  mAreas.~AreasContainer();
+  mIndex.~CodeIndex();
+  mSymbols.~SymbolTable();
+
+  mArena.reset();
+  mResource = std::pmr::get_default_resource();
+
+  new (&mSymbols) SymbolTable(mResource);
+  new (&mIndex) CodeIndex(mResource);
+  new (&mAreas) AreasContainer(mResource);
+  new (&mAreasByName) AreasContainerNamesToAuthorityCodes(mResource);
+  new (&mOrder) OrderContainer(mResource);
+  mOrderValid = true;
+}
+
+/*
+  Retrieve the allocator that this Areas instance, and the Area and Measure
+  objects within it, allocate from.
+
+  @return
+    The allocator
+*/
+Areas::allocator_type Areas::get_allocator() const noexcept {
+  return allocator_type(mResource);
+}
+
+/*
+  Set the number of threads to parse each data file with. With more than
+  one, the populate functions parse with an IngestPipeline of that many
+  parsers, and otherwise on the calling thread alone.
+
+  @param threads
+    The number of threads, where 0 is taken as 1
+
   @example
     Areas data = Areas();
+    data.setIngestThreads(std::thread::hardware_concurrency());
+*/
+void Areas::setIngestThreads(unsigned int threads) noexcept {
+  mIngestThreads = std::max(threads, 1u);
+}
+
+/*
+  Retrieve the number of threads to parse each data file with.
+
+  @return
+    The number of threads, at least 1
+*/
+unsigned int Areas::getIngestThreads() const noexcept {
+  return mIngestThreads;
+}
+
+/*
+  Find the Area with a given local authority code.
+
+  @param code
+    The local authority code of the Area
+
+  @return
+    A pointer to the Area, or nullptr if there is no such Area
+*/
+Area* Areas::findArea(const AuthorityCode& code) noexcept {
+  const size_t pos = mIndex.find(code);
+  if (pos == CodeIndex::NPOS) {
+    return nullptr;
+  }
+
+  return &mAreas[pos];
+}
+
+/*
+  Find the Area with a given local authority code, without modifying it.
+
+  @param code
+    The local authority code of the Area
+
+  @return
+    A pointer to the Area, or nullptr if there is no such Area
+*/
+const Area* Areas::findArea(const AuthorityCode& code) const noexcept {
+  const size_t pos = mIndex.find(code);
+  if (pos == CodeIndex::NPOS) {
+    return nullptr;
+  }
+
+  return &mAreas[pos];
+}
+
+/*
+  Add a new Area to the container, which must not already contain an Area
+  with the same local authority code. This invalidates the cached order.
+
+  Note that adding an Area may move the existing Area objects, so any pointers
+  or references to them must be retrieved again.
+
+  @param code
+    The local authority code of the Area
+
+  @param area
+    The Area to add
+
+  @return
+    A reference to the Area in the container
+*/
+Area& Areas::insertArea(const AuthorityCode& code, Area&& area) {
+  mIndex.insert(code);
+  mAreas.push_back(std::move(area));
+  mOrderValid = false;
+
+  return mAreas.back();
+}
+
+/*
+  Retrieve the positions of the Area objects sorted by their local authority
+  codes. The order is only recomputed when an Area has been added since it was
+  last requested.
+
+  @return
+    Positions in mAreas, in the order of their local authority codes
 */
-Areas::Areas() : mAreasByCode(), mAreasByName() {}
+const std::pmr::vector<size_t>& Areas::order() const {
+  if (!mOrderValid) {
+    const std::pmr::vector<AuthorityCode>& codes = mIndex.keys();
+
+    mOrder.resize(codes.size());
+    for (size_t i = 0; i < mOrder.size(); i++) {
+      mOrder[i] = i;
+    }
+
+    std::sort(mOrder.begin(), mOrder.end(), [&codes](size_t a, size_t b) {
+      return codes[a] < codes[b];
+    });
+    mOrderValid = true;
+  }
+
+  return mOrder;
+}
 
 /*
   TODO: Areas::setArea(localAuthorityCode, area)
@@ -75,43 +371,110 @@ Areas::Areas() : mAreasByCode(), mAreasByName() {}
     data.setArea(localAuthorityCode, area);
 */
 void Areas::setArea(std::string& key, Area& value) {
-  auto existingIt = mAreasByCode.find(key);
-  if (existingIt != mAreasByCode.end()) {
-    Area& existingArea = existingIt->second;
+  const AuthorityCode code(key);
 
-    auto names = value.getNames();
-    for (auto it = names.begin(); it != names.end(); it++) {
+  Area* existingIt = findArea(code);
+  if (existingIt != nullptr) {
+    Area& existingArea = *existingIt;
+
+    const auto& names = value.getNames();
+    for (auto it = names.cbegin(); it != names.cend(); it++) {
       existingArea.setName(it->first, it->second);
     }
 
     for (auto it = value.begin(); it != value.end(); it++) {
-      existingArea.setMeasure(it->first, it->second);
+      existingArea.setMeasure(*it->first, it->second);
     }
 
     return;
   }
   
-  mAreasByCode.emplace(key, value);
+  insertArea(code, Area(value, get_allocator()));
 }
 
 void Areas::setArea(std::string& key, Area&& value) {
-  auto existingIt = mAreasByCode.find(key);
-  if (existingIt != mAreasByCode.end()) {
-    Area& existingArea = existingIt->second;
+  const AuthorityCode code(key);
 
-    auto names = value.getNames();
-    for (auto it = names.begin(); it != names.end(); it++) {
-      existingArea.setName(it->first, it->second);
-    }
+  Area* existingIt = findArea(code);
+  if (existingIt != nullptr) {
+    existingIt->merge(std::move(value));
+    return;
+  }
+  
+  insertArea(code, std::move(value));
+}
 
-    for (auto it = value.begin(); it != value.end(); it++) {
-      existingArea.setMeasure(it->first, it->second);
-    }
+/*
+  Merge another Areas instance into this one, consuming it. This has the same
+  result as calling setArea() with each of the other instance's Area objects,
+  i.e. the incoming names, labels and values take precedence, but moves the
+  data rather than copying it.
+
+  With MergePolicy::Import, the Area objects we already have keep their names
+  and the labels of their Measures, and names we already map to an authority
+  code keep that code. This gives the same result as if the data in the other
+  instance had been imported directly into this one, e.g. when the datasets
+  are imported separately (see DatasetSnapshot) and merged in order.
+
+  Area objects we do not have are moved into our container. Those we do have
+  are merged with Area::merge(), which splices the nodes of their containers
+  into ours if both instances share a memory resource (see the constructor
+  taking a std::pmr::memory_resource). Names that map to authority codes are
+  spliced in the same way.
+
+  @param other
+    The Areas instance to merge into this one, which is left empty
+
+  @param policy
+    Whether the incoming names and labels replace ours (MergePolicy::Replace)
+    or are ignored where we already have them (MergePolicy::Import)
 
+  @example
+    Areas data = Areas();
+    Areas update = Areas();
+    ...
+    data.merge(std::move(update));
+*/
+void Areas::merge(Areas&& other, MergePolicy policy) {
+  if (this == &other) {
     return;
   }
-  
-  mAreasByCode.emplace(key, std::move(value));
+
+  for (Symbol id = 0; id < other.mSymbols.size(); id++) {
+    mSymbols.intern(other.mSymbols.ref(id));
+  }
+
+  mIndex.reserve(mIndex.size() + other.mIndex.size());
+  for (size_t pos = 0; pos < other.mAreas.size(); pos++) {
+    const AuthorityCode& code = other.mIndex.key(pos);
+
+    Area* existingIt = findArea(code);
+    if (existingIt != nullptr) {
+      existingIt->merge(std::move(other.mAreas[pos]), policy);
+    } else {
+      insertArea(code, std::move(other.mAreas[pos]));
+    }
+  }
+
+  if (mAreasByName.get_allocator() == other.mAreasByName.get_allocator()) {
+    // Names in both instances are left behind in other.mAreasByName
+    mAreasByName.merge(other.mAreasByName);
+  }
+  for (auto it = other.mAreasByName.cbegin();
+       it != other.mAreasByName.cend();
+       it++) {
+    if (policy == MergePolicy::Replace) {
+      mAreasByName.insert_or_assign(it->first, it->second);
+    } else {
+      mAreasByName.emplace(it->first, it->second);
+    }
+  }
+
+  other.mIndex.clear();
+  other.mAreas.clear();
+  other.mAreasByName.clear();
+  other.mOrder.clear();
+  other.mOrderValid = true;
 }
 
 /*
@@ -138,14 +501,17 @@ void Areas::setArea(std::string& key, Area&& value) {
     Area area2 = areas.getArea("W06000023");
 */
 Area& Areas::getArea(const std::string& key) {
-  try {
-    return mAreasByCode.at(key);
-  } catch (const std::out_of_range& ex) {
+  Area* existingIt = findArea(AuthorityCode(key));
+  if (existingIt != nullptr) {
+    return *existingIt;
   }
 
-  try {
-    return mAreasByCode.at(mAreasByName.at(key));
-  } catch (const std::out_of_range& ex) {
+  auto nameIt = mAreasByName.find(key);
+  if (nameIt != mAreasByName.end()) {
+    existingIt = findArea(nameIt->second);
+    if (existingIt != nullptr) {
+      return *existingIt;
+    }
   }
 
   throw std::out_of_range("No area found matching " + key);
@@ -221,8 +587,8 @@ bool Areas::isLocalAuthorityFiltered(
       // the filter does not contain the authority code, so we will check the 
       // existing area objects' to see if we have encountered this before
 
-      auto area = mAreasByCode.find(localAuthorityCode);
-      if (area == mAreasByCode.end()) {
+      const Area* area = findArea(AuthorityCode(localAuthorityCode));
+      if (area == nullptr) {
         // We haven't encountered this authority before, so we've reached
         // a deadend. Don't import the area.
         return true;
@@ -231,7 +597,7 @@ bool Areas::isLocalAuthorityFiltered(
       // We have encountered this authority before, so lets check the names
       // of that area against the filter
       try {
-        const auto names = area->second.getNames();
+        const auto names = area->getNames();
         for (auto it = names.begin(); it != names.end(); it++) {
           auto name = it->second;
           if (wildcardCountSet(areasFilter, name) > 1) {
@@ -266,7 +632,53 @@ bool Areas::isLocalAuthorityFiltered(
     auto size = areas.size(); // returns 1
 */
 size_t Areas::size() const noexcept {
-  return mAreasByCode.size();
+  return mAreas.size();
+}
+
+/*
+  Retrieve the SymbolTable in which this Areas instance interns the codes and
+  labels of the data it imports.
+
+  @return
+    The SymbolTable
+*/
+const SymbolTable& Areas::getSymbols() const noexcept {
+  return mSymbols;
+}
+
+/*
+  Retrieve the names that getArea() accepts in place of a local authority
+  code, e.g. the English and Welsh names imported from areas.csv, mapped to
+  the code of their Area.
+
+  @return
+    The names mapped to authority codes
+*/
+const AreasContainerNamesToAuthorityCodes& Areas::getAreaNames()
+    const noexcept {
+  return mAreasByName;
+}
+
+/*
+  Let getArea() find an Area by a name. As when the parsers import a name,
+  a name that already maps to an authority code keeps that code.
+
+  @param name
+    The name of the area
+
+  @param localAuthorityCode
+    The local authority code of the Area
+
+  @example
+    Areas data = Areas();
+    std::string localAuthorityCode = "W06000023";
+    data.setArea(localAuthorityCode, Area(localAuthorityCode));
+    data.setAreaName("Powys", localAuthorityCode);
+    Area& area = data.getArea("Powys");
+*/
+void Areas::setAreaName(const std::string& name,
+                        const std::string& localAuthorityCode) {
+  mAreasByName.emplace(name, AuthorityCode(localAuthorityCode));
 }
 
 /*
@@ -331,6 +743,16 @@ void Areas::populateFromAuthorityCodeCSV(
                              "File contains no data");
   }
 
+  if (mIngestThreads > 1) {
+    populateFromPipeline(is,
+                         BethYw::AuthorityCodeCSV,
+                         cols,
+                         {},
+                         2,
+                         areasFilter);
+    return;
+  }
+
   bool areasFilterEnabled = areasFilter != nullptr && !areasFilter->empty();
 
   // Parse the data
@@ -360,14 +782,16 @@ void Areas::populateFromAuthorityCodeCSV(
         continue;
       }
 
-      Area area = Area(localAuthorityCode);
+      const SymbolRef code = mSymbols.ref(mSymbols.intern(localAuthorityCode));
+
+      Area area = Area(code, get_allocator());
       area.setName("eng", nameEnglish);
       area.setName("cym", nameWelsh);
 
       this->setArea(localAuthorityCode, std::move(area));
 
-      mAreasByName.emplace(nameEnglish, localAuthorityCode);
-      mAreasByName.emplace(nameWelsh, localAuthorityCode);
+      mAreasByName.emplace(nameEnglish, AuthorityCode(localAuthorityCode));
+      mAreasByName.emplace(nameWelsh, AuthorityCode(localAuthorityCode));
 
       lineNo++;
     }
@@ -379,6 +803,76 @@ void Areas::populateFromAuthorityCodeCSV(
   }
 }
 
+/*
+  Check whether the rows of a WelshStatsJSON file for an area match an areas
+  filter. The rows only contain the local authority code and the English name
+  of the area, so if neither match, we check the Welsh name of the existing
+  Area (e.g. imported from areas.csv), if any.
+
+  This is used by populateFromWelshStatsJSON() and, to select the rows to read
+  from a file in advance, by BethYw::loadDatasets().
+
+  @param areasFilter
+    The (non-empty) areas filter
+
+  @param localAuthorityCode
+    The local authority code in the rows
+
+  @param areaNameEnglish
+    The English name of the area in the rows
+
+  @return
+    true if the rows should be imported
+*/
+bool Areas::isWelshStatsAreaIncluded(
+    const StringFilterSet& areasFilter,
+    const std::string& localAuthorityCode,
+    const std::string& areaNameEnglish) const {
+  // Welsh names aren't in the JSON data, so we can only check local
+  // authority codes and English names by default
+  if (wildcardCountSet(areasFilter, localAuthorityCode) > 0 ||
+      wildcardCountSet(areasFilter, areaNameEnglish) > 0) {
+    return true;
+  }
+
+  // But, if the area already exists, we might have a Welsh name for
+  // it already, so we need to check that to!
+  // If there isn't an existing area, we just have to assume it doesn't
+  // match the filter and skip it.
+  const Area* existingArea = findArea(AuthorityCode(localAuthorityCode));
+  if (existingArea == nullptr) {
+    return false;
+  }
+
+  try {
+    const std::string& areaNameWelsh = existingArea->getName("cym");
+    return wildcardCountSet(areasFilter, areaNameWelsh) > 0;
+  } catch (const std::out_of_range& ex) {
+    return false;
+  }
+}
+
+/*
+  Read the next row of a WelshStatsJSON file.
+
+  @return
+    false once every row has been read
+
+  @throws
+    std::runtime_error if the file is not valid JSON
+*/
+static bool nextWelshStatsJSONRow(JSONRowReader& reader,
+                                  std::vector<json>& row) {
+  try {
+    return reader.next(row);
+  } catch (const std::invalid_argument& ex) {
+    const std::string err = "Areas::populateFromWelshStatsJSON: "
+                            "Invalid JSON: " +
+                            std::string(ex.what());
+    throw std::runtime_error(err);
+  }
+}
+
 /*
   TODO: Areas::populateFromWelshStatsJSON(is,
                                           cols,
@@ -452,6 +946,14 @@ void Areas::populateFromAuthorityCodeCSV(
     where if both values are 0, then all years should be imported, otherwise
     they should be treated as the range of years to be imported (inclusively)
 
+  @param nextLink
+    If not nullptr, set to the link to the next page of the dataset (the
+    "odata.nextLink" value), or to an empty string if this is the last page
+
+  @param valueFilter
+    An umodifiable pointer to the ValueFilter of the rows to import (see
+    valuefilter.h), or nullptr if all rows should be imported
+
   @return
     void
 
@@ -488,16 +990,36 @@ void Areas::populateFromWelshStatsJSON(
     const BethYw::SourceColumnMapping& cols,
     const StringFilterSet * const areasFilter,
     const StringFilterSet * const measuresFilter,
-    const YearFilterTuple * const yearsFilter)
+    const YearFilterTuple * const yearsFilter,
+    std::string * const nextLink,
+    const ValueFilter * const valueFilter)
     noexcept(false) {
-  json j;
-  try {
-    is >> j;
-  } catch (const json::exception& ex) {
-    const std::string err = "Areas::populateFromWelshStatsJSON: "
-                            "Invalid JSON: " +
-                            std::string(ex.what());
-    throw std::runtime_error(err);
+  // The pipeline does not look for the link to the next page, so pages are
+  // parsed on this thread
+  if (nextLink == nullptr && mIngestThreads > 1) {
+    populateFromPipeline(is,
+                         BethYw::WelshStatsJSON,
+                         cols,
+                         {},
+                         1,
+                         areasFilter,
+                         measuresFilter,
+                         yearsFilter,
+                         valueFilter);
+    return;
+  }
+
+  // The stream is read in blocks with read(), as copying its rdbuf() would
+  // swallow an error thrown while reading it (e.g. by GzipReader), rather
+  // than letting the stream rethrow it
+  std::string text;
+  char block[65536];
+  while (is.read(block, sizeof(block)) || is.gcount() > 0) {
+    text.append(block, is.gcount());
+  }
+  if (is.bad()) {
+    throw std::runtime_error("Areas::populateFromWelshStatsJSON: "
+                             "Failed to read the stream");
   }
 
   // First, we fetch the various column titles from the hardcoded data in
@@ -533,8 +1055,22 @@ void Areas::populateFromWelshStatsJSON(
     }
   }
 
-  // Determine whether the respective area, measures, and years filters
-  // are enabled or not
+  // Only these columns are read from each row, and the rest are skipped over
+  // without being decoded (see projection.h)
+  enum { JSON_CODE, JSON_NAME, JSON_YEAR, JSON_VALUE, JSON_MEASURE_CODE,
+         JSON_MEASURE_NAME };
+  std::vector<std::string> columns = {COL_AUTHORITY_CODE,
+                                      COL_AREA_NAME,
+                                      COL_YEAR,
+                                      COL_VALUE};
+  if (multipleMeasures) {
+    columns.push_back(COL_MEASURE_CODE);
+    columns.push_back(COL_MEASURE_NAME);
+  }
+  const JSONProjection projection(columns);
+
+  // Determine whether the respective area, measures, years, and value
+  // filters are enabled or not
   bool areasFilterEnabled    = areasFilter != nullptr &&
                                !areasFilter->empty();
   bool measuresFilterEnabled = measuresFilter != nullptr &&
@@ -542,131 +1078,311 @@ void Areas::populateFromWelshStatsJSON(
   bool yearsFilterEnabled    = yearsFilter != nullptr &&
                                std::get<0>(*yearsFilter) != 0 &&
                                std::get<1>(*yearsFilter) != 0;
+  bool valueFilterEnabled    = valueFilter != nullptr &&
+                               valueFilter->hasRowPredicate();
+
+  // A dataset with a single measure has the same code and label on every row,
+  // so intern them (and apply the filter) once up front
+  Symbol singleMeasureId = NO_SYMBOL;
+  SymbolRef singleMeasureLabel;
+  if (!multipleMeasures) {
+    std::string measureCode = COL_MEASURE_CODE;
+    std::transform(
+        measureCode.begin(),
+        measureCode.end(),
+        measureCode.begin(),::tolower);
+    if (!measuresFilterEnabled || measuresFilter->count(measureCode) > 0) {
+      singleMeasureId = mSymbols.intern(measureCode);
+    }
+    singleMeasureLabel = mSymbols.ref(mSymbols.intern(COL_MEASURE_NAME));
+  }
+
+  // Rows repeat the same handful of codes many times, so we cache the
+  // filtering decisions against the interned Symbols for each row's strings.
+  // areasIncluded is keyed by the authority code and English name Symbols,
+  // measureCodes maps a measure code Symbol to the Symbol for its lowercase
+  // form (or NO_SYMBOL if it is filtered out).
+  std::unordered_map<unsigned long long, bool> areasIncluded;
+  std::unordered_map<Symbol, Symbol> measureCodes;
+
+  // Consecutive rows are usually for the same area and measure, in which case
+  // we can skip looking them up again
+  Symbol lastAreaId = NO_SYMBOL;
+  Symbol lastMeasureId = NO_SYMBOL;
+  Measure* lastMeasure = nullptr;
 
   // Now loop through each row in the JSON file
-  // std::string localAuthorityCode;
-  for (auto& el : j["value"].items()) {
-    auto& data = el.value();
+  JSONRowReader reader(projection, text);
+  std::vector<json> data;
+  while (nextWelshStatsJSONRow(reader, data)) {
 
     // Fetch the local authority code and name to check whether this
     // has been added to the imported data already
-    std::string localAuthorityCode, areaNameEnglish;
+    Symbol areaId, areaNameId;
     try {
-        localAuthorityCode = data[COL_AUTHORITY_CODE];
-        areaNameEnglish = data[COL_AREA_NAME];
+      areaId = mSymbols.intern(
+          data[JSON_CODE].get_ref<const std::string&>());
+      areaNameId = mSymbols.intern(
+          data[JSON_NAME].get_ref<const std::string&>());
     } catch (const nlohmann::detail::type_error& ex) {
       throw std::out_of_range("Areas::populateFromWelshStatsJSON: "
                               "Column specification did not match file for "
                               "COL_AUTHORITY_CODE or COL_AREA_NAME!");
     }
 
-    auto existingArea = mAreasByCode.find(localAuthorityCode);
-
     if (areasFilterEnabled) {
-      // Welsh names aren't in the JSON data, so we can only check local
-      // authority codes and English names by default
-      if (wildcardCountSet(*areasFilter, localAuthorityCode) == 0 &&
-          wildcardCountSet(*areasFilter, areaNameEnglish) == 0) {
-
-        // But, if the area already exists, we might have a Welsh name for it 
-        // already, so we need to check that to!
-        // If there isn't an existing area, we just have to assume it doesn't
-        // match the filter and skip it.
-        if (existingArea != mAreasByCode.end()) {
-          try {
-            const std::string& areaNameWelsh =
-                existingArea->second.getName("cym");
-            if (wildcardCountSet(*areasFilter, areaNameWelsh) == 0) {
-              continue;
-            }
-          } catch (const std::out_of_range& ex) {
-            continue;
-          }
-        } else {
-          continue;
-        }
+      const unsigned long long areaKey =
+          (static_cast<unsigned long long>(areaId) << 32) | areaNameId;
+
+      auto includedIt = areasIncluded.find(areaKey);
+      if (includedIt == areasIncluded.end()) {
+        const bool included = isWelshStatsAreaIncluded(
+            *areasFilter,
+            mSymbols.str(areaId),
+            mSymbols.str(areaNameId));
+        includedIt = areasIncluded.emplace(areaKey, included).first;
+      }
+
+      if (!includedIt->second) {
+        continue;
       }
     }
     
     // Are there multiple measures in the data or a single measure?
     // Either way, we need to check whether this is on the filter list
-    std::string measureCode, measureName;
+    Symbol measureId = singleMeasureId;
     if (multipleMeasures) {
-      measureCode = data[COL_MEASURE_CODE];
-      measureName = data[COL_MEASURE_NAME];
-    } else {
-      measureCode = COL_MEASURE_CODE;
-      measureName = COL_MEASURE_NAME;
+      const Symbol rawId = mSymbols.intern(
+          data[JSON_MEASURE_CODE].get_ref<const std::string&>());
+
+      auto codeIt = measureCodes.find(rawId);
+      if (codeIt == measureCodes.end()) {
+        std::string measureCode = mSymbols.str(rawId);
+        std::transform(
+            measureCode.begin(),
+            measureCode.end(),
+            measureCode.begin(),::tolower);
+
+        Symbol codeId = NO_SYMBOL;
+        if (!measuresFilterEnabled || measuresFilter->count(measureCode) > 0) {
+          codeId = mSymbols.intern(measureCode);
+        }
+        codeIt = measureCodes.emplace(rawId, codeId).first;
+      }
+
+      measureId = codeIt->second;
     }
 
-    std::transform(
-        measureCode.begin(),
-        measureCode.end(),
-        measureCode.begin(),::tolower);
-    if (measuresFilterEnabled && measuresFilter->count(measureCode) == 0) {
+    if (measureId == NO_SYMBOL) {
       continue;
     }
     
-    // Now check the year to see if its within the range
+    // Now check the year to see if its within the range. A row for a year
+    // that is missing has nothing to add.
     unsigned int year = 0;
-    try {
-      year = std::stoi(data[COL_YEAR].get_ref<std::string&>());
-      if (yearsFilterEnabled && (year < std::get<0>(*yearsFilter) ||
-                                 year > std::get<1>(*yearsFilter))) {
-        continue;
-      }
-    } catch (const nlohmann::detail::type_error& ex) {
+    const CellState yearState = decodeJSONYearCell(data[JSON_YEAR], year);
+    if (yearState == CellState::Invalid) {
       throw std::out_of_range("Areas::populateFromWelshStatsJSON: "
                               "Column specification did not match file for "
                               "YEAR!");
-    } catch (const std::bad_cast& ex) {
+    }
+    if (yearState == CellState::Missing ||
+        (yearsFilterEnabled && (year < std::get<0>(*yearsFilter) ||
+                                year > std::get<1>(*yearsFilter)))) {
+      continue;
+    }
+
+    // We now fetch the value. Some datasets store numerical data as strings,
+    // and a value that is missing is left out of the measure.
+    double value(0.0);
+    const CellState valueState =
+        decodeJSONValueCell(data[JSON_VALUE], value);
+    if (valueState == CellState::Invalid) {
       throw std::out_of_range("Areas::populateFromWelshStatsJSON: "
                               "Column specification did not match file for "
-                              "YEAR!");
+                              "VALUE!");
     }
 
-    // We now fetch the value. Some datasets store numerical data as strings :(
-    double value(0.0);
-    try {
-      value = data[COL_VALUE];
-    } catch (const nlohmann::detail::type_error& ex) {
-      // dagnabbit, its problably a string!
-      value = std::stod((std::string) data[COL_VALUE]);
+    // A row the value filter does not keep is skipped, as is a row with no
+    // value to compare
+    if (valueFilterEnabled &&
+        (valueState == CellState::Missing ||
+         !valueFilter->keepRow(mSymbols.str(measureId), value))) {
+      continue;
     }
     
     // Finally, we add the value to the measure to the area to the areas
-    if (existingArea != mAreasByCode.end()) {
-      // The area exists, so we'll add to the existing instance
-      Area& area = existingArea->second;
-      
-      // Determine if a matching Measure exists within the Area
-      try {
-        // It does!
-        Measure& existingMeasure = area.getMeasure(measureCode);
-        existingMeasure.setValue(year, std::move(value));
-      } catch (const std::out_of_range& ex) {
-        // It does not, so create a new measure
-        Measure newMeasure = Measure(measureCode, measureName);
-        newMeasure.setValue(year, std::move(value));
-        area.setMeasure(measureCode, std::move(newMeasure));
+    if (areaId != lastAreaId || measureId != lastMeasureId) {
+      const AuthorityCode code(mSymbols.str(areaId));
+
+      // If the area exists, we'll add to the existing instance
+      Area* area = findArea(code);
+      if (area == nullptr) {
+        // The Area doesn't exist, so create it
+        Area newArea = Area(mSymbols.ref(areaId), get_allocator());
+        newArea.setName("eng", mSymbols.str(areaNameId));
+
+        area = &insertArea(code, std::move(newArea));
+        mAreasByName.emplace(mSymbols.str(areaNameId), code);
       }
-    } else {
-      // The Area doesn't exist, so create it and the Measure
-      Area area = Area(localAuthorityCode);
-      area.setName("eng", areaNameEnglish);
 
-      Measure newMeasure = Measure(measureCode, measureName);
-      newMeasure.setValue(year, std::move(value));
-      area.setMeasure(measureCode, std::move(newMeasure));
-      
-      this->setArea(localAuthorityCode, std::move(area));
-      
-      mAreasByName.emplace(data[COL_AREA_NAME], localAuthorityCode);
-    }
-  }
-}
+      // Determine if a matching Measure exists within the Area, and if it
+      // does not, create a new measure
+      const SymbolRef measureCode = mSymbols.ref(measureId);
+      lastMeasure = area->findMeasure(measureCode);
+      if (lastMeasure == nullptr) {
+        SymbolRef measureName = singleMeasureLabel;
+        if (multipleMeasures) {
+          measureName = mSymbols.ref(mSymbols.intern(
+              data[JSON_MEASURE_NAME].get_ref<const std::string&>()));
+        }
 
-/*
+        area->setMeasure(*measureCode,
+                         Measure(measureCode,
+                                 measureName,
+                                 area->get_allocator()));
+        lastMeasure = area->findMeasure(measureCode);
+      }
+
+      lastAreaId = areaId;
+      lastMeasureId = measureId;
+    }
+
+    if (valueState == CellState::Value) {
+      lastMeasure->setValue(year, std::move(value));
+    }
+  }
+
+  if (nextLink != nullptr) {
+    *nextLink = reader.getNextLink();
+  }
+}
+
+/*
+  Parse a WelshStatsJSON dataset served as a sequence of pages (see
+  InputPages), by following the link at the end of each page to the next.
+
+  Each page is parsed by populateFromWelshStatsJSON() in turn, which gives
+  the same result as parsing the rows of all the pages as one document, but
+  only one page is held in memory at a time.
+
+  @param pages
+    The InputPages for the dataset, which need not have been opened
+
+  @param cols
+    A map of the enum BethyYw::SourceColumnMapping (see datasets.h) to strings
+    that give the column header in the CSV file
+
+  @param areasFilter
+    An umodifiable pointer to set of umodifiable strings of areas to import,
+    or an empty set if all areas should be imported
+
+  @param measuresFilter
+    An umodifiable pointer to set of umodifiable strings of measures to import,
+    or an empty set if all measures should be imported
+
+  @param yearsFilter
+    An umodifiable pointer to an umodifiable tuple of two unsigned integers,
+    where if both values are 0, then all years should be imported, otherwise
+    they should be treated as the range of years to be imported (inclusively)
+
+  @param valueFilter
+    An umodifiable pointer to the ValueFilter of the rows to import (see
+    valuefilter.h), or nullptr if all rows should be imported
+
+  @return
+    void
+
+  @throws
+    std::runtime_error if a page cannot be read or parsed
+    std::out_of_range if there are not enough columns in cols
+
+  @example
+    InputFilePages pages("data/popu1009.json");
+
+    Areas data = Areas();
+    data.populateFromWelshStatsJSONPages(
+      pages,
+      InputFiles::POPDEN.COLS);
+*/
+void Areas::populateFromWelshStatsJSONPages(
+    InputPages& pages,
+    const BethYw::SourceColumnMapping& cols,
+    const StringFilterSet * const areasFilter,
+    const StringFilterSet * const measuresFilter,
+    const YearFilterTuple * const yearsFilter,
+    const ValueFilter * const valueFilter)
+    noexcept(false) {
+  std::string nextLink;
+  std::istream* is = &pages.open();
+
+  while (is != nullptr) {
+    populateFromWelshStatsJSON(*is,
+                               cols,
+                               areasFilter,
+                               measuresFilter,
+                               yearsFilter,
+                               &nextLink,
+                               valueFilter);
+
+    is = nextLink.empty() ? nullptr : pages.next(nextLink);
+  }
+}
+
+/*
+  Parse the header row of an AuthorityByYearCSV file, which gives the year of
+  each column, apart from the column of local authority codes.
+
+  @param is
+    The input stream, which is left at the start of the second row
+
+  @param cols
+    A map of the enum BethyYw::SourceColumnMapping (see datasets.h) to strings
+    that give the column header in the CSV file
+
+  @return
+    The year of each column, or -1 for the local authority code column
+
+  @throws
+    std::runtime_error if the file is empty or there is no AUTH_CODE column
+    in cols
+*/
+std::vector<int> Areas::parseAuthorityByYearHeader(
+    std::istream& is,
+    const BethYw::SourceColumnMapping& cols) const {
+  std::vector<int> colHeaders;
+  const unsigned int authorityCodeColIdent = (unsigned int) -1;
+
+  std::string line;
+  if (!std::getline(is, line)) {
+    throw std::runtime_error("Areas::populateFromAuthorityCodeCSV: "
+                             "File contains no data");
+  }
+
+  std::stringstream s(line);
+  s.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+  std::string cell;
+  try { // Exception is thrown at the end of the line
+    while (std::getline(s, cell, ',')) {
+      try {
+        if (cell == cols.at(BethYw::AUTH_CODE)) {
+          colHeaders.push_back(authorityCodeColIdent);
+        } else {
+          colHeaders.push_back(std::stoi(cell));
+        }
+      } catch (const std::out_of_range& ex) {
+        throw std::runtime_error("Areas::populateFromAuthorityCodeCSV: "
+                                 "Must specify valid AUTH_CODE column!");
+      }
+    }
+  } catch(const std::ios_base::failure& ex) {
+  }
+
+  return colHeaders;
+}
+
+/*
   TODO: Areas::populateFromAuthorityByYearCSV(is,
                                               cols,
                                               areasFilter,
@@ -706,6 +1422,10 @@ void Areas::populateFromWelshStatsJSON(
     where if both values are 0, then all years should be imported, otherwise
     they should be treated as a the range of years to be imported
 
+  @param valueFilter
+    An umodifiable pointer to the ValueFilter of the rows to import (see
+    valuefilter.h), or nullptr if all rows should be imported
+
   @return
     void
 
@@ -736,7 +1456,8 @@ void Areas::populateFromAuthorityByYearCSV(
     const BethYw::SourceColumnMapping& cols,
     const StringFilterSet * const areasFilter,
     const StringFilterSet * const measuresFilter,
-    const YearFilterTuple * const yearsFilter)
+    const YearFilterTuple * const yearsFilter,
+    const ValueFilter * const valueFilter)
     noexcept(false) {
 
   bool measuresFilterEnabled    = measuresFilter != nullptr && 
@@ -755,6 +1476,9 @@ void Areas::populateFromAuthorityByYearCSV(
     return;
   }
 
+  const SymbolRef measureCodeRef = mSymbols.ref(mSymbols.intern(measureCode));
+  const SymbolRef measureNameRef = mSymbols.ref(mSymbols.intern(measureName));
+
   const unsigned int authorityCodeColIdent = (unsigned int) -1;
 
   bool areasFilterEnabled = areasFilter != nullptr &&
@@ -762,39 +1486,31 @@ void Areas::populateFromAuthorityByYearCSV(
   bool yearsFilterEnabled = yearsFilter != nullptr &&
                             std::get<0>(*yearsFilter) != 0 &&
                             std::get<1>(*yearsFilter) != 0;
+  bool valueFilterEnabled = valueFilter != nullptr &&
+                            valueFilter->hasRowPredicate();
 
   // Mapping of the column ordering to the year, the authority code
   // will be given a value of -1 (we can assume no stats go back 2000+ years)
-  std::vector<int> colHeaders;
-
-  // Parse the header row
-  std::string line;
-  if (!std::getline(is, line)) {
-    throw std::runtime_error("Areas::populateFromAuthorityCodeCSV: "
-                             "File contains no data");
-  } else {
-    std::stringstream s(line);
-    s.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    
-    std::string cell;
-    try { // Exception is thrown at the end of the line
-      while (std::getline(s, cell, ',')) {
-        try {
-          if (cell == cols.at(BethYw::AUTH_CODE)) {
-            colHeaders.push_back(authorityCodeColIdent);
-          } else {
-            colHeaders.push_back(std::stoi(cell));
-          }
-        } catch (const std::out_of_range& ex) {
-          throw std::runtime_error("Areas::populateFromAuthorityCodeCSV: "
-                                   "Must specify valid AUTH_CODE column!");
-        }
-      }
-    } catch(const std::ios_base::failure& ex) {
-    }
+  const std::vector<int> colHeaders = parseAuthorityByYearHeader(is, cols);
+
+  if (mIngestThreads > 1) {
+    populateFromPipeline(is,
+                         BethYw::AuthorityByYearCSV,
+                         cols,
+                         colHeaders,
+                         2,
+                         areasFilter,
+                         measuresFilter,
+                         yearsFilter,
+                         valueFilter);
+    return;
   }
-  
+
+  // Filtering decisions are cached against the authority code's Symbol
+  std::unordered_map<Symbol, bool> areasIncluded;
+
   // Parse the remaining rows
+  std::string line;
   unsigned int lineNo = 2;
   try {
     while (std::getline(is, line)) { // row loop
@@ -807,7 +1523,7 @@ void Areas::populateFromAuthorityByYearCSV(
       // Because we don't know where the authority column will be, we
       // store all values in a temp map and then copy them into the Area
       // object at the end
-      std::string localAuthorityCode;
+      Symbol areaId = NO_SYMBOL;
       std::unordered_map<unsigned int,double> tempData;
       
       try {
@@ -820,13 +1536,22 @@ void Areas::populateFromAuthorityByYearCSV(
           // As above, if year is == -1, its the authority code
           if (columnIdent == authorityCodeColIdent) {
             // This is the local authority!
-            if (areasFilterEnabled &&
-                isLocalAuthorityFiltered(*areasFilter, cell)) {
-              break;
+            areaId = mSymbols.intern(cell);
+
+            if (areasFilterEnabled) {
+              auto includedIt = areasIncluded.find(areaId);
+              if (includedIt == areasIncluded.end()) {
+                const bool included =
+                    !isLocalAuthorityFiltered(*areasFilter, cell);
+                includedIt = areasIncluded.emplace(areaId, included).first;
+              }
+
+              if (!includedIt->second) {
+                break;
+              }
             }
 
             importArea = true;
-            localAuthorityCode = cell;
           } else {
             // It's a year value in this column
             if (yearsFilterEnabled &&
@@ -835,61 +1560,58 @@ void Areas::populateFromAuthorityByYearCSV(
               continue;
             }
             
-            if (cell.length() == 0) {
+            double value = 0.0;
+            const CellState state = decodeValueCell(cell, value);
+            if (state == CellState::Missing) {
+              continue;
+            } else if (state == CellState::Invalid) {
+              throw std::invalid_argument("Invalid value: " + cell);
+            }
+
+            if (valueFilterEnabled &&
+                !valueFilter->keepRow(measureCode, value)) {
               continue;
             }
 
             unsigned int year = columnIdent;
-            tempData.emplace(year, std::stod(cell));
+            tempData.emplace(year, value);
           }
         }
 
-        if (!importArea) {
+        // An area none of whose values the value filter keeps is not
+        // added at all
+        if (!importArea || (valueFilterEnabled && tempData.empty())) {
           continue;
         }
 
         // Finally, we add the value to the measure to the area to the areas
-        auto existingArea = mAreasByCode.find(localAuthorityCode);
-        if (existingArea != mAreasByCode.end()) {
-          // The area exists, so we'll add to the existing instance
-          Area& area = existingArea->second;
-
-          // Determine if a matching Measure exists within the Area
-          try {
-            Measure& existingMeasure = area.getMeasure(measureCode);
-            // It does!
-            for (auto it = tempData.begin(); it != tempData.end(); it++) {
-              existingMeasure.setValue(
-                static_cast<unsigned int>(it->first),
-                it->second);
-            }
-          } catch (const std::out_of_range& ex) {
-            // It does not, so create a new measure
-            Measure newMeasure = Measure(measureCode, measureName);
-
-            for (auto it = tempData.begin(); it != tempData.end(); it++) {
-              newMeasure.setValue(
-                static_cast<unsigned int>(it->first),
-                it->second);
-            }
+        const AuthorityCode code(mSymbols.str(areaId));
+
+        // If the area exists, we'll add to the existing instance
+        Area* area = findArea(code);
+        if (area == nullptr) {
+          // The Area doesn't exist, so create it
+          area = &insertArea(code,
+                             Area(mSymbols.ref(areaId), get_allocator()));
+        }
 
-            area.setMeasure(measureCode, std::move(newMeasure));
-          }
-        } else {
-          // The Area doesn't exist, so create it and the Measure
-          Area area = Area(localAuthorityCode);
-          Measure newMeasure = Measure(measureCode, measureName);
+        // Determine if a matching Measure exists within the Area, and if it
+        // does not, create a new measure
+        Measure* measure = area->findMeasure(measureCodeRef);
+        if (measure == nullptr) {
+          area->setMeasure(measureCode,
+                           Measure(measureCodeRef,
+                                   measureNameRef,
+                                   area->get_allocator()));
+          measure = area->findMeasure(measureCodeRef);
+        }
 
-          for (auto it = tempData.begin(); it != tempData.end(); it++) {
-            newMeasure.setValue(
-              static_cast<unsigned int>(it->first),
+        for (auto it = tempData.begin(); it != tempData.end(); it++) {
+          measure->setValue(
+            static_cast<unsigned int>(it->first),
             it->second);
-          }
-
-          area.setMeasure(measureCode, std::move(newMeasure));
-
-          this->setArea(localAuthorityCode, std::move(area));
         }
+
         lineNo++;
       } catch (const std::ios_base::failure& ex) {
       }
@@ -902,6 +1624,218 @@ void Areas::populateFromAuthorityByYearCSV(
   }
 }
 
+/*
+  Parse a data file with an IngestPipeline: the pipeline's threads read and
+  parse the rows (applying the measures and years filters), and this thread
+  adds them, in the order of the file, in the same way as the parser for the
+  type of file does on one thread, so the data is the same.
+
+  This is used by the populateFrom…() functions when more than one thread is
+  set with setIngestThreads().
+
+  @param is
+    The input stream, which for a CSV file has had its header row read
+
+  @param type
+    A value from the BethYw::SourceDataType enum which states the underlying
+    data file structure
+
+  @param cols
+    A map of the enum BethyYw::SourceColumnMapping (see datasets.h) to strings
+    that give the column header in the CSV file
+
+  @param colHeaders
+    The year of each column of an AuthorityByYearCSV file (see
+    parseAuthorityByYearHeader())
+
+  @param firstLine
+    The line number of the next line of the stream
+
+  @param areasFilter
+    An umodifiable pointer to set of umodifiable strings of areas to import,
+    or an empty set if all areas should be imported
+
+  @param measuresFilter
+    An umodifiable pointer to set of umodifiable strings of measures to import,
+    or an empty set if all measures should be imported
+
+  @param yearsFilter
+    An umodifiable pointer to an umodifiable tuple of two unsigned integers,
+    where if both values are 0, then all years should be imported, otherwise
+    they should be treated as the range of years to be imported (inclusively)
+
+  @param valueFilter
+    An umodifiable pointer to the ValueFilter of the rows to import (see
+    valuefilter.h), or nullptr if all rows should be imported
+
+  @throws
+    std::runtime_error if a parsing error occurs (e.g. due to a malformed file)
+    std::out_of_range if there are not enough columns in cols
+*/
+void Areas::populateFromPipeline(
+    std::istream& is,
+    const BethYw::SourceDataType type,
+    const BethYw::SourceColumnMapping& cols,
+    const std::vector<int>& colHeaders,
+    const unsigned int firstLine,
+    const StringFilterSet * const areasFilter,
+    const StringFilterSet * const measuresFilter,
+    const YearFilterTuple * const yearsFilter,
+    const ValueFilter * const valueFilter)
+    noexcept(false) {
+  IngestPipeline pipeline(is,
+                          type,
+                          cols,
+                          measuresFilter,
+                          yearsFilter,
+                          valueFilter,
+                          colHeaders,
+                          firstLine,
+                          mIngestThreads);
+
+  const bool areasFilterEnabled = areasFilter != nullptr &&
+                                  !areasFilter->empty();
+  const bool measuresFilterEnabled = measuresFilter != nullptr &&
+                                     !measuresFilter->empty();
+  const bool multipleMeasures = type == BethYw::WelshStatsJSON &&
+                                pipeline.isMultipleMeasures();
+
+  // The measure of a dataset with a single measure, as in the parsers
+  Symbol singleMeasureId = NO_SYMBOL;
+  SymbolRef singleMeasureLabel;
+  if (type != BethYw::AuthorityCodeCSV && !multipleMeasures) {
+    std::string measureCode = type == BethYw::AuthorityByYearCSV
+                                  ? cols.at(BethYw::SINGLE_MEASURE_CODE)
+                                  : pipeline.getSingleMeasureCode();
+    std::transform(
+        measureCode.begin(),
+        measureCode.end(),
+        measureCode.begin(),::tolower);
+    if (!measuresFilterEnabled || measuresFilter->count(measureCode) > 0) {
+      singleMeasureId = mSymbols.intern(measureCode);
+    }
+    singleMeasureLabel = mSymbols.ref(mSymbols.intern(
+        type == BethYw::AuthorityByYearCSV
+            ? cols.at(BethYw::SINGLE_MEASURE_NAME)
+            : pipeline.getSingleMeasureName()));
+  }
+
+  // Filtering decisions are cached against the interned Symbols, as in the
+  // parsers
+  std::unordered_map<unsigned long long, bool> areasIncluded;
+
+  Symbol lastAreaId = NO_SYMBOL;
+  Symbol lastMeasureId = NO_SYMBOL;
+  Measure* lastMeasure = nullptr;
+
+  IngestBatch batch;
+  while (pipeline.next(batch)) {
+    for (auto rowIt = batch.rows.begin(); rowIt != batch.rows.end(); rowIt++) {
+      IngestRow& row = *rowIt;
+
+      if (type == BethYw::AuthorityCodeCSV) {
+        if (areasFilterEnabled &&
+            wildcardCountSet(*areasFilter, row.code) == 0 &&
+            wildcardCountSet(*areasFilter, row.name) == 0 &&
+            wildcardCountSet(*areasFilter, row.nameWelsh) == 0) {
+          continue;
+        }
+
+        const SymbolRef code = mSymbols.ref(mSymbols.intern(row.code));
+
+        Area area = Area(code, get_allocator());
+        area.setName("eng", row.name);
+        area.setName("cym", row.nameWelsh);
+
+        this->setArea(row.code, std::move(area));
+
+        mAreasByName.emplace(row.name, AuthorityCode(row.code));
+        mAreasByName.emplace(row.nameWelsh, AuthorityCode(row.code));
+        continue;
+      }
+
+      const Symbol areaId = mSymbols.intern(row.code);
+      Symbol areaNameId = NO_SYMBOL;
+      if (type == BethYw::WelshStatsJSON) {
+        areaNameId = mSymbols.intern(row.name);
+      }
+
+      if (areasFilterEnabled) {
+        const unsigned long long areaKey =
+            (static_cast<unsigned long long>(areaId) << 32) | areaNameId;
+
+        auto includedIt = areasIncluded.find(areaKey);
+        if (includedIt == areasIncluded.end()) {
+          const bool included =
+              type == BethYw::WelshStatsJSON
+                  ? isWelshStatsAreaIncluded(*areasFilter,
+                                             row.code,
+                                             row.name)
+                  : !isLocalAuthorityFiltered(*areasFilter, row.code);
+          includedIt = areasIncluded.emplace(areaKey, included).first;
+        }
+
+        if (!includedIt->second) {
+          continue;
+        }
+      }
+
+      // The parsers have already applied the measures filter to the rows
+      const Symbol measureId = multipleMeasures
+                                   ? mSymbols.intern(row.measureCode)
+                                   : singleMeasureId;
+      if (measureId == NO_SYMBOL) {
+        continue;
+      }
+
+      if (areaId != lastAreaId || measureId != lastMeasureId) {
+        const AuthorityCode code(row.code);
+
+        Area* area = findArea(code);
+        if (area == nullptr) {
+          Area newArea = Area(mSymbols.ref(areaId), get_allocator());
+          if (type == BethYw::WelshStatsJSON) {
+            newArea.setName("eng", row.name);
+          }
+
+          area = &insertArea(code, std::move(newArea));
+          if (type == BethYw::WelshStatsJSON) {
+            mAreasByName.emplace(row.name, code);
+          }
+        }
+
+        const SymbolRef measureCode = mSymbols.ref(measureId);
+        lastMeasure = area->findMeasure(measureCode);
+        if (lastMeasure == nullptr) {
+          SymbolRef measureName = singleMeasureLabel;
+          if (multipleMeasures) {
+            measureName = mSymbols.ref(mSymbols.intern(row.measureName));
+          }
+
+          area->setMeasure(*measureCode,
+                           Measure(measureCode,
+                                   measureName,
+                                   area->get_allocator()));
+          lastMeasure = area->findMeasure(measureCode);
+        }
+
+        lastAreaId = areaId;
+        lastMeasureId = measureId;
+      }
+
+      if (type == BethYw::WelshStatsJSON) {
+        if (!row.missing) {
+          lastMeasure->setValue(row.year, std::move(row.value));
+        }
+      } else {
+        for (auto it = row.values.begin(); it != row.values.end(); it++) {
+          lastMeasure->setValue(it->first, it->second);
+        }
+      }
+    }
+  }
+}
+
 /*
   TODO: Areas::populate(is, type, cols)
 
@@ -958,12 +1892,11 @@ void Areas::populate(std::istream& is,
                      const BethYw::SourceDataType& type,
                      const BethYw::SourceColumnMapping& cols)
                      noexcept(false) {
-  // check if the stream is open and readable
-  is.seekg(1, is.beg);
-  if (is.eof() || is.fail()) {
+  // check if the stream is open and has content, by peeking rather than
+  // seeking, as a pipe (e.g. the standard input) cannot be seeked within
+  if (!is.good() || is.peek() == std::istream::traits_type::eof()) {
     throw std::runtime_error("Areas::populate: Stream not open");
   }
-  is.seekg(0, is.beg);
 
   // hand off to the specific functions
   if (type == BethYw::AuthorityCodeCSV) {
@@ -1021,6 +1954,10 @@ void Areas::populate(std::istream& is,
     where if both values are 0, then all years should be imported, otherwise
     they should be treated as a the range of years to be imported
 
+  @param valueFilter
+    An umodifiable pointer to the ValueFilter of the rows to import (see
+    valuefilter.h), or nullptr if all rows should be imported
+
   @return
     void
 
@@ -1065,15 +2002,14 @@ void Areas::populate(
     const BethYw::SourceColumnMapping& cols,
     const std::unordered_set<std::string> * const areasFilter,
     const std::unordered_set<std::string> * const measuresFilter,
-    const std::tuple<unsigned int, unsigned int> * const yearsFilter)
+    const std::tuple<unsigned int, unsigned int> * const yearsFilter,
+    const ValueFilter * const valueFilter)
     noexcept(false) {
-  // check if the stream is open and readable
-  is.seekg(1, is.beg);
-  if (is.eof() || is.fail()) {
+  // check if the stream is open and has content, without seeking
+  if (!is.good() || is.peek() == std::istream::traits_type::eof()) {
     throw std::runtime_error("Areas::populate: Stream not open");
   }
-  is.seekg(0, is.beg);
-  
+
   // hand off to the specific functions
   if (type == BethYw::AuthorityCodeCSV) {
     populateFromAuthorityCodeCSV(is, cols, areasFilter);
@@ -1082,18 +2018,148 @@ void Areas::populate(
                                cols,
                                areasFilter,
                                measuresFilter,
-                               yearsFilter);
+                               yearsFilter,
+                               nullptr,
+                               valueFilter);
   } else if (type == BethYw::AuthorityByYearCSV) {
     populateFromAuthorityByYearCSV(is,
                                    cols,
                                    areasFilter,
                                    measuresFilter,
-                                   yearsFilter);
+                                   yearsFilter,
+                                   valueFilter);
   } else {
     throw std::runtime_error("Areas::populate: Unexpected data type");
   }
 }
 
+/*
+  Remove the Measures whose whole series the series predicate of a
+  ValueFilter does not keep, e.g. those whose max is not above 500 for
+  "max(dens) > 500". This is run once every dataset is loaded, as the
+  aggregates of a series loaded from more than one dataset are not known
+  until then. The Area objects themselves are kept.
+
+  @param filter
+    The ValueFilter, which counts the series it does not keep
+
+  @return
+    The number of Measures removed
+
+  @example
+    ValueFilter filter("max(dens) > 500");
+    Areas data = Areas();
+    ...
+    data.pruneSeries(filter);
+*/
+size_t Areas::pruneSeries(const ValueFilter& filter) {
+  if (!filter.hasSeriesPredicate()) {
+    return 0;
+  }
+
+  size_t removed = 0;
+  std::vector<std::string> codes;
+  for (auto areaIt = begin(); areaIt != end(); areaIt++) {
+    codes.clear();
+    for (auto measureIt = areaIt->cbegin();
+         measureIt != areaIt->cend();
+         measureIt++) {
+      if (!filter.keepSeries(measureIt->second)) {
+        codes.push_back(measureIt->second.getCodename());
+      }
+    }
+
+    for (const auto& code : codes) {
+      if (areaIt->removeMeasure(code)) {
+        removed++;
+      }
+    }
+  }
+
+  return removed;
+}
+
+/*
+  Find the areas with a value of a measure in a range, e.g. the areas whose
+  population density has ever exceeded 500. The smallest and largest value
+  kept by each Measure rule most series in or out without looking at their
+  values (see Measure::hasValueBetween()).
+
+  @param measureCode
+    The lowercase code of the measure, or an empty string for any measure
+
+  @param low
+    The smallest value of the range (inclusive), which may be -infinity
+
+  @param high
+    The largest value of the range (inclusive), which may be infinity
+
+  @return
+    The local authority codes of the areas, in order
+
+  @example
+    Areas data = Areas();
+    ...
+    auto areas = data.findAreasWithValuesBetween(
+        "dens",
+        std::nextafter(500.0, std::numeric_limits<double>::infinity()),
+        std::numeric_limits<double>::infinity());
+*/
+std::vector<std::string> Areas::findAreasWithValuesBetween(
+    const std::string& measureCode,
+    Measure_t low,
+    Measure_t high) const {
+  std::vector<std::string> found;
+  for (auto areaIt = cbegin(); areaIt != cend(); areaIt++) {
+    for (auto measureIt = areaIt->cbegin();
+         measureIt != areaIt->cend();
+         measureIt++) {
+      const Measure& measure = measureIt->second;
+      if ((measureCode.empty() || measure.getCodename() == measureCode) &&
+          measure.hasValueBetween(low, high)) {
+        found.push_back(areaIt->getLocalAuthorityCode());
+        break;
+      }
+    }
+  }
+
+  return found;
+}
+
+/*
+  Convert an Area to the JSON object it has in toJSON(), i.e. its names and
+  its measures' values by year, which is null if it has neither.
+
+  @param area
+    The Area to convert
+
+  @return
+    The JSON object
+*/
+static json toJSONObject(const Area& area) {
+  json j;
+
+  auto names = area.getNames();
+  for (auto nameIt = names.cbegin(); nameIt != names.end(); nameIt++) {
+    j["names"][nameIt->first] = nameIt->second;
+  }
+
+  for (auto measureIt = area.cbegin();
+       measureIt != area.cend();
+       measureIt++) {
+    const Measure& measure = measureIt->second;
+    const std::string measureCodename = measure.getCodename();
+
+    for (auto yearIt = measure.cbegin(); yearIt != measure.cend(); yearIt++) {
+      const std::string year = std::to_string(yearIt->first);
+      const double value = yearIt->second;
+      j["measures"][measureCodename][year] = value;
+    }
+  }
+
+  return j;
+}
+
 /*
   TODO: Areas::toJSON()
 
@@ -1171,26 +2237,10 @@ std::string Areas::toJSON() const {
   json j;
 
   for (auto areaIt = cbegin(); areaIt != cend(); areaIt++) {
-    const Area& area = areaIt->second;
-    const std::string localAuthorityCode = area.getLocalAuthorityCode();
-
-    auto names = area.getNames();
-    for (auto nameIt = names.cbegin(); nameIt != names.end(); nameIt++) {
-      j[localAuthorityCode]["names"][nameIt->first] = nameIt->second;
-    }
-    
-    auto measures = area.getNames();
-    for (auto measureIt = area.cbegin();
-         measureIt != area.cend();
-         measureIt++) {
-      const Measure& measure = measureIt->second;
-      const std::string measureCodename = measure.getCodename();
-
-      for (auto yearIt = measure.cbegin(); yearIt != measure.cend(); yearIt++) {
-        const std::string year = std::to_string(yearIt->first);
-        const double value = yearIt->second;
-        j[localAuthorityCode]["measures"][measureCodename][year] = value;
-      }
+    const Area& area = *areaIt;
+    json areaJSON = toJSONObject(area);
+    if (!areaJSON.is_null()) {
+      j[area.getLocalAuthorityCode()] = std::move(areaJSON);
     }
   }
   
@@ -1202,6 +2252,30 @@ std::string Areas::toJSON() const {
   return result;
 }
 
+/*
+  Convert one Area to JSON, as it appears in toJSON() (under its local
+  authority code), so that the areas can be converted separately, e.g. on
+  different threads. This does not modify the state of the instance.
+
+  @param area
+    The Area to convert
+
+  @return
+    The Area as a JSON object, or an empty string if it has no names or
+    values (and so is left out of toJSON())
+
+  @example
+    Areas data = Areas();
+    ...
+    for (auto it = data.cbegin(); it != data.cend(); it++) {
+      std::cout << data.toJSON(*it) << std::endl;
+    }
+*/
+std::string Areas::toJSON(const Area& area) const {
+  const json j = toJSONObject(area);
+  return j.is_null() ? std::string() : j.dump();
+}
+
 /*
   TODO: operator<<(os, areas)
 
@@ -1310,7 +2384,7 @@ std::string Areas::toJSON() const {
 */
 std::ostream& operator<<(std::ostream& os, const Areas& areas) {
   for (auto area = areas.cbegin(); area != areas.cend(); area++) {
-    os << area->second;
+    os << *area;
   }
 
   return os;
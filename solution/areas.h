@@ -26,16 +26,25 @@
   functions and member variables you need to declare in this class.
  */
 
+#include <cstddef>
 #include <iostream>
 #include <iterator>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <set>
 #include <string>
 #include <tuple>
 #include <unordered_set>
+#include <vector>
 
 #include "datasets.h"
 #include "area.h"
+#include "authoritycode.h"
+#include "codeindex.h"
+#include "input.h"
+#include "symbols.h"
+#include "valuefilter.h"
 
 /*
   An alias for filters based on strings such as categorisations e.g. area,
@@ -55,8 +64,70 @@ using YearFilterTuple = std::tuple<unsigned int, unsigned int>;
   AreasContainer to a valid Standard Library container of your choosing.
 */
 // class Null { };
-using AreasContainer = std::map<std::string, Area>;
-using AreasContainerNamesToAuthorityCodes = std::map<std::string, std::string>;
+using AreasContainer = std::pmr::vector<Area>;
+using AreasContainerNamesToAuthorityCodes =
+    std::pmr::map<std::string, AuthorityCode>;
+
+/*
+  Where an Areas instance allocates its containers (and those of the Area and
+  Measure objects within it) from:
+
+  Arena   — A std::pmr::monotonic_buffer_resource owned by the Areas instance.
+            Allocation is a pointer bump, nothing is freed individually, and
+            the whole import is released at once when the Areas instance is
+            destroyed.
+  Default — The default memory resource (i.e. new and delete), for comparison.
+*/
+enum class AreasMemory {
+  Arena,
+  Default
+};
+
+/*
+  Areas stores its Area objects densely, in the order they were first added,
+  and finds them through a CodeIndex. Iterating over an Areas instance instead
+  visits the Area objects in the order of their local authority codes. This
+  iterator walks a (cached) list of positions sorted by authority code,
+  dereferencing to the Area at each position.
+*/
+template<typename AreaT>
+class AreasOrderedIterator {
+protected:
+  std::pmr::vector<size_t>::const_iterator mIt;
+  AreaT* mAreas;
+
+public:
+  using iterator_category = std::bidirectional_iterator_tag;
+  using value_type        = Area;
+  using difference_type   = std::ptrdiff_t;
+  using pointer           = AreaT*;
+  using reference         = AreaT&;
+
+  AreasOrderedIterator() : mIt(), mAreas(nullptr) {}
+  AreasOrderedIterator(std::pmr::vector<size_t>::const_iterator it,
+                       AreaT* areas)
+      : mIt(it), mAreas(areas) {}
+
+  reference operator*() const { return mAreas[*mIt]; }
+  pointer operator->() const { return &mAreas[*mIt]; }
+
+  AreasOrderedIterator& operator++() { ++mIt; return *this; }
+  AreasOrderedIterator operator++(int) { auto tmp = *this; ++mIt; return tmp; }
+  AreasOrderedIterator& operator--() { --mIt; return *this; }
+  AreasOrderedIterator operator--(int) { auto tmp = *this; --mIt; return tmp; }
+
+  bool operator==(const AreasOrderedIterator& other) const {
+    return mIt == other.mIt;
+  }
+  bool operator!=(const AreasOrderedIterator& other) const {
+    return mIt != other.mIt;
+  }
+};
+
+using AreasIterator             = AreasOrderedIterator<Area>;
+using AreasConstIterator        = AreasOrderedIterator<const Area>;
+using AreasReverseIterator      = std::reverse_iterator<AreasIterator>;
+using AreasConstReverseIterator = std::reverse_iterator<AreasConstIterator>;
 
 /*
   Areas is a class that stores all the data categorised by area. The 
@@ -68,23 +139,81 @@ using AreasContainerNamesToAuthorityCodes = std::map<std::string, std::string>;
   specific parsing of code to other functions, based on the value of 
   BethYw::SourceDataType.
 
+  Areas owns a SymbolTable, in which the parsers intern the local authority
+  codes, measure codes, and measure labels they encounter, so that each is
+  stored only once regardless of how many Area and Measure objects use it.
+  Areas are keyed by AuthorityCode, so lookups and the ordering of the
+  output are integer comparisons.
+
+  The Area objects are held in a std::vector and found through an
+  open-addressing hash index (CodeIndex), as the order only matters when we
+  output the data. The authority-code order is computed the first time it is
+  needed (by operator<<, toJSON(), or the iterator wrappers) and cached until
+  the next Area is added.
+
+  All of these containers, and those of the Area and Measure objects, are
+  allocated from the memory resource chosen on construction (see AreasMemory).
+  The arena is declared first, so it outlives every container using it.
+
+  The populate functions parse each data file with as many threads as are
+  set with setIngestThreads() (see pipeline.h), which is 1 by default.
+
   TODO: Based on your implementation, there may be additional constructors
   or functions you implement here, and perhaps additional operators you may wish
   to overload.
 */
 class Areas {
 protected:
-  AreasContainer mAreasByCode;
+  std::unique_ptr<std::pmr::monotonic_buffer_resource> mArena;
+  std::pmr::memory_resource* mResource;
+
+  SymbolTable mSymbols;
+  CodeIndex mIndex;
+  AreasContainer mAreas;
   AreasContainerNamesToAuthorityCodes mAreasByName;
 
+  mutable std::pmr::vector<size_t> mOrder;
+  mutable bool mOrderValid;
+
+  unsigned int mIngestThreads;
+
+  void resetToDefaultResource() noexcept;
+  Area* findArea(const AuthorityCode& code) noexcept;
+  const Area* findArea(const AuthorityCode& code) const noexcept;
+  Area& insertArea(const AuthorityCode& code, Area&& area);
+  const std::pmr::vector<size_t>& order() const;
+
+  std::vector<int> parseAuthorityByYearHeader(
+      std::istream& is,
+      const BethYw::SourceColumnMapping& cols) const;
+  void populateFromPipeline(
+      std::istream& is,
+      const BethYw::SourceDataType type,
+      const BethYw::SourceColumnMapping& cols,
+      const std::vector<int>& colHeaders,
+      const unsigned int firstLine,
+      const StringFilterSet * const areasFilter = nullptr,
+      const StringFilterSet * const measuresFilter = nullptr,
+      const YearFilterTuple * const yearsFilter = nullptr,
+      const ValueFilter * const valueFilter = nullptr)
+      noexcept(false);
+
 public:
-  Areas();
+  using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+  explicit Areas(AreasMemory memory = AreasMemory::Arena);
+  explicit Areas(std::pmr::memory_resource* resource);
   ~Areas() = default;
 
   Areas(const Areas& other) = delete;
   Areas& operator=(const Areas& other) = delete;
-  Areas(Areas&& other) = default;
-  Areas& operator=(Areas&& other) = default;
+  Areas(Areas&& other) noexcept;
+  Areas& operator=(Areas&& other);
+
+  allocator_type get_allocator() const noexcept;
+
+  void setIngestThreads(unsigned int threads) noexcept;
+  unsigned int getIngestThreads() const noexcept;
 
   size_t wildcardCountSet(
     const std::unordered_set<std::string>& needles,
@@ -93,11 +222,20 @@ public:
       const std::unordered_set<std::string>& areasFilter,
       const std::string localAuthorityCode)
       noexcept;
+  bool isWelshStatsAreaIncluded(
+      const StringFilterSet& areasFilter,
+      const std::string& localAuthorityCode,
+      const std::string& areaNameEnglish) const;
     
   void setArea(std::string& ident, Area& stat);
   void setArea(std::string& ident, Area&& stat);
+  void merge(Areas&& other, MergePolicy policy = MergePolicy::Replace);
   Area& getArea(const std::string& areaCode);
   size_t size() const noexcept;
+  const SymbolTable& getSymbols() const noexcept;
+  const AreasContainerNamesToAuthorityCodes& getAreaNames() const noexcept;
+  void setAreaName(const std::string& name,
+                   const std::string& localAuthorityCode);
   
   void populateFromAuthorityCodeCSV(
       std::istream& is,
@@ -110,7 +248,8 @@ public:
       const BethYw::SourceColumnMapping& cols,
       const StringFilterSet * const areasFilter = nullptr,
       const StringFilterSet * const measuresFilter = nullptr,
-      const YearFilterTuple * const yearsFilter = nullptr)
+      const YearFilterTuple * const yearsFilter = nullptr,
+      const ValueFilter * const valueFilter = nullptr)
       noexcept(false);
 
   void populateFromWelshStatsJSON(
@@ -118,7 +257,18 @@ public:
       const BethYw::SourceColumnMapping& cols,
       const StringFilterSet * const areasFilter = nullptr,
       const StringFilterSet * const measuresFilter = nullptr,
-      const YearFilterTuple * const yearsFilter = nullptr)
+      const YearFilterTuple * const yearsFilter = nullptr,
+      std::string * const nextLink = nullptr,
+      const ValueFilter * const valueFilter = nullptr)
+      noexcept(false);
+
+  void populateFromWelshStatsJSONPages(
+      InputPages& pages,
+      const BethYw::SourceColumnMapping& cols,
+      const StringFilterSet * const areasFilter = nullptr,
+      const StringFilterSet * const measuresFilter = nullptr,
+      const YearFilterTuple * const yearsFilter = nullptr,
+      const ValueFilter * const valueFilter = nullptr)
       noexcept(false);
 
   void populate(
@@ -132,42 +282,51 @@ public:
       const BethYw::SourceColumnMapping& cols,
       const StringFilterSet * const areasFilter = nullptr,
       const StringFilterSet * const measuresFilter = nullptr,
-      const YearFilterTuple * const yearsFilter = nullptr)
+      const YearFilterTuple * const yearsFilter = nullptr,
+      const ValueFilter * const valueFilter = nullptr)
       noexcept(false);
 
+  size_t pruneSeries(const ValueFilter& filter);
+  std::vector<std::string> findAreasWithValuesBetween(
+      const std::string& measureCode,
+      Measure_t low,
+      Measure_t high) const;
+
   std::string toJSON() const;
+  std::string toJSON(const Area& area) const;
 
   friend std::ostream& operator<<(std::ostream& os, const Areas& areas);
   
   /*
-    Wrapper around underlying iterator functions for ease.
+    Wrapper around underlying iterator functions for ease. These visit the
+    Area objects in the order of their local authority codes.
   */
-  inline AreasContainer::iterator begin() {
-    return mAreasByCode.begin();
+  inline AreasIterator begin() {
+    return AreasIterator(order().cbegin(), mAreas.data());
   }
-  inline AreasContainer::const_iterator cbegin() const {
-    return mAreasByCode.cbegin();
+  inline AreasConstIterator cbegin() const {
+    return AreasConstIterator(order().cbegin(), mAreas.data());
   }
 
-  inline AreasContainer::iterator end() {
-    return mAreasByCode.end();
+  inline AreasIterator end() {
+    return AreasIterator(order().cend(), mAreas.data());
   }
-  inline AreasContainer::const_iterator cend() const {
-    return mAreasByCode.cend();
+  inline AreasConstIterator cend() const {
+    return AreasConstIterator(order().cend(), mAreas.data());
   }
 
-  inline AreasContainer::reverse_iterator rbegin() {
-    return mAreasByCode.rbegin();
+  inline AreasReverseIterator rbegin() {
+    return AreasReverseIterator(end());
   }
-  inline AreasContainer::const_reverse_iterator crbegin() const {
-    return mAreasByCode.crbegin();
+  inline AreasConstReverseIterator crbegin() const {
+    return AreasConstReverseIterator(cend());
   }
 
-  inline AreasContainer::reverse_iterator rend() {
-    return mAreasByCode.rend();
+  inline AreasReverseIterator rend() {
+    return AreasReverseIterator(begin());
   }
-  inline AreasContainer::const_reverse_iterator crend() const {
-    return mAreasByCode.crend();
+  inline AreasConstReverseIterator crend() const {
+    return AreasConstReverseIterator(cbegin());
   }
 };
 
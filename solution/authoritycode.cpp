@@ -0,0 +1,163 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the implementation of the AuthorityCode class. See the
+  header file for additional comments.
+*/
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "authoritycode.h"
+
+constexpr uint64_t AuthorityCode::FALLBACK_BIT;
+constexpr size_t AuthorityCode::MAX_PACKED_LENGTH;
+
+/*
+  Construct an empty AuthorityCode, which compares less than every other code.
+*/
+AuthorityCode::AuthorityCode() noexcept : mPacked(0), mFallback() {}
+
+/*
+  Construct an AuthorityCode from a string, packing it into an integer if
+  possible.
+
+  @param code
+    The local authority code
+
+  @example
+    AuthorityCode code("W06000023");
+*/
+AuthorityCode::AuthorityCode(const std::string& code)
+    : mPacked(0), mFallback() {
+  if (code.length() <= MAX_PACKED_LENGTH) {
+    unsigned int shift = 56;
+    for (const unsigned char c : code) {
+      if (c == 0 || c > 0x7F) {
+        mPacked = FALLBACK_BIT;
+        break;
+      }
+
+      mPacked |= static_cast<uint64_t>(c) << shift;
+      shift -= 7;
+    }
+  } else {
+    mPacked = FALLBACK_BIT;
+  }
+
+  if (mPacked == FALLBACK_BIT) {
+    mFallback = std::make_shared<const std::string>(code);
+  }
+}
+
+/*
+  Whether this code is packed into an integer or held as a string.
+
+  @return
+    true if the code is packed
+*/
+bool AuthorityCode::isPacked() const noexcept {
+  return (mPacked & FALLBACK_BIT) == 0;
+}
+
+/*
+  Retrieve the packed integer for this code.
+
+  @return
+    The packed code, which is only meaningful if isPacked() is true
+*/
+uint64_t AuthorityCode::getPacked() const noexcept {
+  return mPacked;
+}
+
+/*
+  Materialise the code as a string.
+
+  @return
+    The local authority code
+
+  @example
+    AuthorityCode code("W06000023");
+    std::string str = code.str(); // returns "W06000023"
+*/
+std::string AuthorityCode::str() const {
+  if (!isPacked()) {
+    return *mFallback;
+  }
+
+  std::string code;
+  code.reserve(MAX_PACKED_LENGTH);
+  for (int shift = 56; shift >= 0; shift -= 7) {
+    const char c = static_cast<char>((mPacked >> shift) & 0x7F);
+    if (c == 0) {
+      break;
+    }
+    code.push_back(c);
+  }
+
+  return code;
+}
+
+/*
+  Two AuthorityCodes are equal if they represent the same string. A string
+  that fits is always packed, so a packed code never equals a fallback code.
+*/
+bool operator==(const AuthorityCode& lhs, const AuthorityCode& rhs) {
+  if (lhs.mPacked != rhs.mPacked) {
+    return false;
+  }
+
+  return lhs.isPacked() || *lhs.mFallback == *rhs.mFallback;
+}
+
+bool operator!=(const AuthorityCode& lhs, const AuthorityCode& rhs) {
+  return !(lhs == rhs);
+}
+
+/*
+  Order AuthorityCodes in the same way as their strings. Two packed codes are
+  compared as integers, otherwise we fall back to comparing the strings.
+*/
+bool operator<(const AuthorityCode& lhs, const AuthorityCode& rhs) {
+  if (lhs.isPacked() && rhs.isPacked()) {
+    return lhs.mPacked < rhs.mPacked;
+  }
+
+  return lhs.str() < rhs.str();
+}
+
+/*
+  Write the code to an output stream as a string.
+*/
+std::ostream& operator<<(std::ostream& os, const AuthorityCode& code) {
+  return os << code.str();
+}
+
+/*
+  Hash a packed code by mixing its bits (so that codes differing only in their
+  final characters do not collide in the low bits), or a fallback code by its
+  string.
+*/
+size_t std::hash<AuthorityCode>::operator()(
+    const AuthorityCode& code) const noexcept {
+  if (!code.isPacked()) {
+    return std::hash<std::string>()(code.str());
+  }
+
+  uint64_t h = code.getPacked();
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+
+  return static_cast<size_t>(h);
+}
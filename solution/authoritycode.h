@@ -0,0 +1,75 @@
+#ifndef AUTHORITYCODE_H_
+#define AUTHORITYCODE_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the AuthorityCode class, a small value type for local
+  authority codes such as W06000001 or W92000004.
+
+  All StatsWales authority codes are nine ASCII characters long. As ASCII only
+  needs seven bits per character, nine characters fit into a single 64-bit
+  integer. The characters are packed left-aligned (i.e. the first character in
+  the most significant bits), so comparing two packed codes as integers gives
+  the same ordering as comparing the strings. This makes AuthorityCode cheap
+  to use as the key of a container.
+
+  Codes that do not fit (longer than nine characters, or containing non-ASCII
+  characters) fall back to holding the string on the heap, and are compared
+  as strings.
+ */
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+
+class AuthorityCode {
+protected:
+  /*
+    If the top bit is clear, mPacked contains up to nine 7-bit characters. If
+    the top bit is set, the code is held in mFallback instead.
+  */
+  uint64_t mPacked;
+  std::shared_ptr<const std::string> mFallback;
+
+  static constexpr uint64_t FALLBACK_BIT = static_cast<uint64_t>(1) << 63;
+
+public:
+  static constexpr size_t MAX_PACKED_LENGTH = 9;
+
+  AuthorityCode() noexcept;
+  AuthorityCode(const std::string& code);
+  ~AuthorityCode() = default;
+
+  AuthorityCode(const AuthorityCode& other) = default;
+  AuthorityCode& operator=(const AuthorityCode& other) = default;
+  AuthorityCode(AuthorityCode&& other) = default;
+  AuthorityCode& operator=(AuthorityCode&& other) = default;
+
+  bool isPacked() const noexcept;
+  uint64_t getPacked() const noexcept;
+  std::string str() const;
+
+  friend bool operator==(const AuthorityCode& lhs, const AuthorityCode& rhs);
+  friend bool operator!=(const AuthorityCode& lhs, const AuthorityCode& rhs);
+  friend bool operator<(const AuthorityCode& lhs, const AuthorityCode& rhs);
+  friend std::ostream& operator<<(std::ostream& os, const AuthorityCode& code);
+};
+
+/*
+  Allow AuthorityCode to be used as the key of unordered containers.
+*/
+namespace std {
+template<>
+struct hash<AuthorityCode> {
+  size_t operator()(const AuthorityCode& code) const noexcept;
+};
+} // namespace std
+
+#endif // AUTHORITYCODE_H_
@@ -0,0 +1,506 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the implementation of the FileBatch class. See the header
+  file for additional comments.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define BATCH_IO_URING 1
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include "batch.h"
+
+/*
+  The most reads in flight at once, i.e. the size of the submission queue.
+*/
+const unsigned int BATCH_QUEUE_DEPTH = 64;
+
+/*
+  The most read in one request, as the length of a read is 32 bits.
+*/
+const size_t BATCH_MAX_READ = 1u << 30;
+
+/*
+  The most buffers that can be registered with the kernel.
+*/
+const size_t BATCH_MAX_BUFFERS = 1024;
+
+#ifdef BATCH_IO_URING
+
+/*
+  The queues shared with the kernel, mapped into our memory.
+*/
+struct FileBatch::Ring {
+  int fd = -1;
+  unsigned int entries = 0;
+
+  void* sqRing = MAP_FAILED;
+  size_t sqRingSize = 0;
+  void* cqRing = MAP_FAILED;
+  size_t cqRingSize = 0;
+  io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+  size_t sqesSize = 0;
+
+  unsigned* sqHead = nullptr;
+  unsigned* sqTail = nullptr;
+  unsigned* sqMask = nullptr;
+  unsigned* sqArray = nullptr;
+  unsigned* cqHead = nullptr;
+  unsigned* cqTail = nullptr;
+  unsigned* cqMask = nullptr;
+  io_uring_cqe* cqes = nullptr;
+
+  ~Ring() {
+    if (sqes != MAP_FAILED) {
+      munmap(sqes, sqesSize);
+    }
+    if (cqRing != MAP_FAILED && cqRing != sqRing) {
+      munmap(cqRing, cqRingSize);
+    }
+    if (sqRing != MAP_FAILED) {
+      munmap(sqRing, sqRingSize);
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+
+  int enter(unsigned int toSubmit, unsigned int minComplete) {
+    int ret;
+    do {
+      ret = static_cast<int>(syscall(__NR_io_uring_enter,
+                                     fd,
+                                     toSubmit,
+                                     minComplete,
+                                     minComplete > 0 ? IORING_ENTER_GETEVENTS
+                                                     : 0,
+                                     nullptr,
+                                     0));
+    } while (ret < 0 && errno == EINTR);
+    return ret;
+  }
+};
+
+#else
+
+struct FileBatch::Ring {};
+
+#endif
+
+/*
+  Constructor for a batch of files, which submits the reads of all of them.
+
+  @param paths
+    The paths to the files
+
+  @param useUring
+    false to not use io_uring, i.e. so that the files are read with the
+    blocking path
+
+  @example
+    FileBatch batch({"datasets/popu1009.json", "datasets/envi0201.csv"});
+    std::string contents;
+    if (batch.take("datasets/popu1009.json", contents)) {
+      ...
+    }
+*/
+FileBatch::FileBatch(const std::vector<std::string>& paths, bool useUring)
+    : mFiles(), mIndex(), mPending(), mRing(), mInFlight(0), mMutex() {
+#ifdef BATCH_IO_URING
+  if (!useUring || paths.empty() || !setupRing(BATCH_QUEUE_DEPTH)) {
+    return;
+  }
+
+  mFiles.reserve(paths.size());
+  for (auto it = paths.cbegin(); it != paths.cend(); it++) {
+    if (mIndex.count(*it) > 0) {
+      continue;
+    }
+
+    // A file we cannot size is left to the blocking path to report, and it
+    // is not opened until its read is submitted
+    struct stat info;
+    if (stat(it->c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+      continue;
+    }
+
+    File file{*it, -1, std::string(), 0, -1, false, false, false};
+    file.data.resize(static_cast<size_t>(info.st_size));
+    mIndex[*it] = mFiles.size();
+    mFiles.push_back(std::move(file));
+  }
+
+  registerBuffers();
+
+  for (size_t i = 0; i < mFiles.size(); i++) {
+    if (mFiles[i].data.empty()) {
+      finish(mFiles[i], false);
+    } else {
+      mPending.push_back(i);
+    }
+  }
+
+  submitPending();
+#else
+  (void) paths;
+  (void) useUring;
+#endif
+}
+
+/*
+  Wait for any reads still in flight, as they read into our buffers, and
+  close the files.
+*/
+FileBatch::~FileBatch() {
+#ifdef BATCH_IO_URING
+  mPending.clear();
+  while (mInFlight > 0) {
+    reapCompletions(true);
+  }
+
+  for (auto it = mFiles.begin(); it != mFiles.end(); it++) {
+    if (it->fd >= 0) {
+      close(it->fd);
+    }
+  }
+#endif
+}
+
+/*
+  Set up an io_uring and map its queues into our memory.
+
+  @param entries
+    The size of the submission queue
+
+  @return
+    true if io_uring is available
+*/
+bool FileBatch::setupRing(unsigned int entries) {
+#ifdef BATCH_IO_URING
+  auto ring = std::make_unique<Ring>();
+
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  ring->fd = static_cast<int>(
+      syscall(__NR_io_uring_setup, entries, &params));
+  if (ring->fd < 0) {
+    return false;
+  }
+  ring->entries = params.sq_entries;
+
+  ring->sqRingSize = params.sq_off.array +
+                     params.sq_entries * sizeof(unsigned);
+  ring->cqRingSize = params.cq_off.cqes +
+                     params.cq_entries * sizeof(io_uring_cqe);
+
+  // Newer kernels map both queues in one go
+  const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (singleMap) {
+    ring->sqRingSize = ring->cqRingSize =
+        std::max(ring->sqRingSize, ring->cqRingSize);
+  }
+
+  ring->sqRing = mmap(nullptr,
+                      ring->sqRingSize,
+                      PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE,
+                      ring->fd,
+                      IORING_OFF_SQ_RING);
+  if (ring->sqRing == MAP_FAILED) {
+    return false;
+  }
+
+  if (singleMap) {
+    ring->cqRing = ring->sqRing;
+  } else {
+    ring->cqRing = mmap(nullptr,
+                        ring->cqRingSize,
+                        PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE,
+                        ring->fd,
+                        IORING_OFF_CQ_RING);
+    if (ring->cqRing == MAP_FAILED) {
+      return false;
+    }
+  }
+
+  ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+  ring->sqes = static_cast<io_uring_sqe*>(mmap(nullptr,
+                                              ring->sqesSize,
+                                              PROT_READ | PROT_WRITE,
+                                              MAP_SHARED | MAP_POPULATE,
+                                              ring->fd,
+                                              IORING_OFF_SQES));
+  if (ring->sqes == MAP_FAILED) {
+    return false;
+  }
+
+  char* sq = static_cast<char*>(ring->sqRing);
+  ring->sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  ring->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  ring->sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  ring->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+  char* cq = static_cast<char*>(ring->cqRing);
+  ring->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  ring->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  ring->cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+  mRing = std::move(ring);
+  return true;
+#else
+  (void) entries;
+  return false;
+#endif
+}
+
+/*
+  Register the buffers of the files with the kernel, so that it need not map
+  them for every read. This may be refused (e.g. beyond the limit on locked
+  memory), in which case the files are read into the buffers unregistered.
+*/
+void FileBatch::registerBuffers() {
+#ifdef BATCH_IO_URING
+  std::vector<iovec> buffers;
+  for (auto it = mFiles.begin(); it != mFiles.end(); it++) {
+    if (!it->data.empty() && it->data.size() <= BATCH_MAX_READ) {
+      buffers.push_back(iovec{&it->data[0], it->data.size()});
+    }
+  }
+
+  if (buffers.empty() || buffers.size() > BATCH_MAX_BUFFERS) {
+    return;
+  }
+
+  if (syscall(__NR_io_uring_register,
+              mRing->fd,
+              IORING_REGISTER_BUFFERS,
+              buffers.data(),
+              static_cast<unsigned int>(buffers.size())) != 0) {
+    return;
+  }
+
+  int bufIndex = 0;
+  for (auto it = mFiles.begin(); it != mFiles.end(); it++) {
+    if (!it->data.empty() && it->data.size() <= BATCH_MAX_READ) {
+      it->bufIndex = bufIndex++;
+    }
+  }
+#endif
+}
+
+/*
+  Submit the next read of each file waiting for one, as far as the queue
+  allows, opening each file as its first read is submitted. A file that
+  cannot be opened is left to the blocking path.
+*/
+void FileBatch::submitPending() {
+#ifdef BATCH_IO_URING
+  unsigned int submitted = 0;
+  unsigned int tail = *mRing->sqTail;
+
+  while (!mPending.empty() && mInFlight < mRing->entries) {
+    const size_t index = mPending.front();
+    mPending.pop_front();
+    File& file = mFiles[index];
+
+    if (file.fd < 0) {
+      file.fd = open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+      if (file.fd < 0) {
+        finish(file, true);
+        continue;
+      }
+    }
+
+    const unsigned int slot = tail & *mRing->sqMask;
+    io_uring_sqe* sqe = &mRing->sqes[slot];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = file.bufIndex >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = file.fd;
+    sqe->off = file.done;
+    sqe->addr = reinterpret_cast<unsigned long long>(&file.data[file.done]);
+    sqe->len = static_cast<unsigned int>(
+        std::min(file.data.size() - file.done, BATCH_MAX_READ));
+    sqe->buf_index = static_cast<unsigned short>(std::max(file.bufIndex, 0));
+    sqe->user_data = index;
+    mRing->sqArray[slot] = slot;
+
+    tail++;
+    submitted++;
+    mInFlight++;
+  }
+
+  if (submitted == 0) {
+    return;
+  }
+
+  __atomic_store_n(mRing->sqTail, tail, __ATOMIC_RELEASE);
+  if (mRing->enter(submitted, 0) < 0) {
+    // The kernel took none of them, so the files go to the blocking path
+    for (unsigned int i = 0; i < submitted; i++) {
+      const unsigned int slot = (tail - submitted + i) & *mRing->sqMask;
+      finish(mFiles[mRing->sqes[slot].user_data], true);
+    }
+    __atomic_store_n(mRing->sqTail, tail - submitted, __ATOMIC_RELEASE);
+    mInFlight -= submitted;
+  }
+#endif
+}
+
+/*
+  Process the reads that have completed, resubmitting the rest of any file
+  that was only partly read.
+
+  @param wait
+    true to wait for at least one read to complete
+*/
+void FileBatch::reapCompletions(bool wait) {
+#ifdef BATCH_IO_URING
+  if (wait && mInFlight > 0 && mRing->enter(0, 1) < 0) {
+    // We cannot wait for the reads, so nor can we use their buffers
+    for (auto it = mFiles.begin(); it != mFiles.end(); it++) {
+      if (!it->complete) {
+        it->failed = true;
+      }
+    }
+    mPending.clear();
+    mInFlight = 0;
+    return;
+  }
+
+  unsigned int head = *mRing->cqHead;
+  const unsigned int tail = __atomic_load_n(mRing->cqTail, __ATOMIC_ACQUIRE);
+
+  while (head != tail) {
+    const io_uring_cqe& cqe = mRing->cqes[head & *mRing->cqMask];
+    File& file = mFiles[cqe.user_data];
+    mInFlight--;
+
+    if (cqe.res == -EAGAIN || cqe.res == -EINTR) {
+      mPending.push_back(cqe.user_data);
+    } else if (cqe.res < 0) {
+      finish(file, true);
+    } else if (cqe.res == 0) {
+      // The file was truncated since we sized it
+      file.data.resize(file.done);
+      finish(file, false);
+    } else {
+      file.done += static_cast<size_t>(cqe.res);
+      if (file.done == file.data.size()) {
+        finish(file, false);
+      } else {
+        mPending.push_back(cqe.user_data);
+      }
+    }
+
+    head++;
+  }
+
+  __atomic_store_n(mRing->cqHead, head, __ATOMIC_RELEASE);
+#else
+  (void) wait;
+#endif
+}
+
+/*
+  Mark a file as read, or as failed to be read, and close it.
+
+  @param file
+    The file
+
+  @param failed
+    true if the file could not be read
+*/
+void FileBatch::finish(File& file, bool failed) {
+  file.complete = !failed;
+  file.failed = failed;
+#ifdef BATCH_IO_URING
+  if (file.fd >= 0) {
+    close(file.fd);
+    file.fd = -1;
+  }
+#endif
+}
+
+/*
+  Check whether the files are read with io_uring.
+
+  @return
+    true if io_uring is available, or false if every file is left to the
+    blocking path
+*/
+bool FileBatch::isUsingUring() const noexcept {
+  return mRing != nullptr;
+}
+
+/*
+  Take the contents of a file in the batch, waiting for its read to complete
+  if need be. The contents can be taken only once.
+
+  @param path
+    The path to the file, as given to the constructor
+
+  @param contents
+    Set to the contents of the file
+
+  @return
+    true if the contents were taken, or false if the file is not in the batch
+    (or could not be read, or was taken already), and should be read with the
+    blocking path
+
+  @example
+    std::string contents;
+    if (batch.take("datasets/popu1009.json", contents)) {
+      std::istringstream stream(std::move(contents));
+      ...
+    }
+*/
+bool FileBatch::take(const std::string& path, std::string& contents) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  auto it = mIndex.find(path);
+  if (it == mIndex.end()) {
+    return false;
+  }
+
+  File& file = mFiles[it->second];
+  while (!file.complete && !file.failed) {
+    submitPending();
+    reapCompletions(true);
+  }
+
+  if (file.failed || file.taken) {
+    return false;
+  }
+
+  // Keep the reads of the rest of the files going while this one is parsed
+  submitPending();
+
+  contents = std::move(file.data);
+  file.data = std::string();
+  file.taken = true;
+  return true;
+}
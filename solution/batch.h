@@ -0,0 +1,81 @@
+#ifndef BATCH_H_
+#define BATCH_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the FileBatch class, which reads a set of files in full
+  at once, before they are parsed, so that the reads of every file are in
+  flight together rather than each file being read only once the one before
+  it has been parsed.
+
+  On Linux, the reads are submitted up front to an io_uring (without
+  liburing, with the system calls themselves), straight into buffers that are
+  registered with the kernel where it allows. The buffer for a file is handed
+  over (see take()) as soon as its read completes, while the reads of the
+  files after it carry on. Each file is only opened when its read is
+  submitted, so a batch of thousands of files (e.g. the pages of a dataset)
+  holds no more of them open than there are reads in flight.
+
+  A FileBatch never fails: where io_uring is unavailable (e.g. on another
+  OS, an older kernel, or where it is blocked by a sandbox), or a file
+  cannot be read with it, the file is simply not in the batch, and the caller
+  reads it with the existing blocking path (see InputOptions::batch).
+ */
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class FileBatch {
+protected:
+  /*
+    A file in the batch, and how much of it has been read.
+  */
+  struct File {
+    std::string path;
+    int fd;
+    std::string data;
+    size_t done;
+    int bufIndex;
+    bool complete;
+    bool failed;
+    bool taken;
+  };
+
+  struct Ring;
+
+  std::vector<File> mFiles;
+  std::unordered_map<std::string, size_t> mIndex;
+  std::deque<size_t> mPending;
+  std::unique_ptr<Ring> mRing;
+  unsigned int mInFlight;
+  std::mutex mMutex;
+
+  bool setupRing(unsigned int entries);
+  void registerBuffers();
+  void submitPending();
+  void reapCompletions(bool wait);
+  void finish(File& file, bool failed);
+
+public:
+  explicit FileBatch(const std::vector<std::string>& paths,
+                     bool useUring = true);
+  ~FileBatch();
+
+  FileBatch(const FileBatch& other) = delete;
+  FileBatch& operator=(const FileBatch& other) = delete;
+
+  bool isUsingUring() const noexcept;
+  bool take(const std::string& path, std::string& contents);
+};
+
+#endif // BATCH_H_
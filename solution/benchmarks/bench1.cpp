@@ -0,0 +1,120 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 benchmark script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+
+  Compares the flat hash index in Areas with the std::map<AuthorityCode, Area>
+  it replaced, for 22 (i.e. Wales), 1,000 and 100,000 areas. Each row of a
+  simulated import looks up (or creates) the Area for a code, with codes
+  arriving in a shuffled order, and the import finishes by iterating over the
+  areas in authority code order as the output does.
+
+  Build and run with:
+    ./build.sh bench1 && ./bin/bethyw-bench
+ */
+
+#include "../lib_catch.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../areas.h"
+#include "../authoritycode.h"
+
+/*
+  Generate the rows of a simulated import: rowsPerArea rows for each of
+  numAreas synthetic authority codes, in a shuffled order.
+*/
+static std::vector<std::string> generateRows(size_t numAreas,
+                                             size_t rowsPerArea) {
+  std::vector<std::string> rows;
+  rows.reserve(numAreas * rowsPerArea);
+
+  char code[16];
+  for (size_t i = 0; i < numAreas; i++) {
+    std::snprintf(code, sizeof(code), "W%08zu", i * 7919 % 100000000);
+    for (size_t j = 0; j < rowsPerArea; j++) {
+      rows.push_back(code);
+    }
+  }
+
+  std::mt19937 rng(371);
+  std::shuffle(rows.begin(), rows.end(), rng);
+  return rows;
+}
+
+/*
+  The previous implementation of the Areas container, following the lookup
+  pattern of the previous Areas::getArea() and Areas::setArea().
+*/
+static size_t importIntoMap(const std::vector<std::string>& rows) {
+  std::map<AuthorityCode, Area> areas;
+  for (const auto& row : rows) {
+    const AuthorityCode code(row);
+    try {
+      areas.at(code);
+    } catch (const std::out_of_range& ex) {
+      areas.emplace(code, Area(row));
+    }
+  }
+
+  size_t checksum = 0;
+  for (auto it = areas.cbegin(); it != areas.cend(); it++) {
+    checksum += it->second.getLocalAuthorityCode().back();
+  }
+  return checksum;
+}
+
+/*
+  The current implementation, through the public Areas API.
+*/
+static size_t importIntoAreas(const std::vector<std::string>& rows) {
+  Areas areas;
+  for (auto row : rows) {
+    try {
+      areas.getArea(row);
+    } catch (const std::out_of_range& ex) {
+      areas.setArea(row, Area(row));
+    }
+  }
+
+  size_t checksum = 0;
+  for (auto it = areas.cbegin(); it != areas.cend(); it++) {
+    checksum += it->getLocalAuthorityCode().back();
+  }
+  return checksum;
+}
+
+TEST_CASE( "Areas container lookup and ordered output", "[benchmark][Areas]" ) {
+
+  const size_t rowsPerArea = 30;
+
+  for (const size_t numAreas : {22, 1000, 100000}) {
+    const auto rows = generateRows(numAreas, rowsPerArea);
+    REQUIRE( importIntoMap(rows) == importIntoAreas(rows) );
+
+    const std::string suffix = " (" + std::to_string(numAreas) + " areas)";
+
+    BENCHMARK( "std::map<AuthorityCode, Area>" + suffix ) {
+      return importIntoMap(rows);
+    };
+
+    BENCHMARK( "Areas flat hash index" + suffix ) {
+      return importIntoAreas(rows);
+    };
+  }
+
+} // TEST_CASE
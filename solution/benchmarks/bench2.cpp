@@ -0,0 +1,87 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 benchmark script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+
+  Compares importing into (and destroying) an Areas instance that allocates
+  from its own arena with one that uses the default memory resource, for a
+  synthetic AuthorityByYearCSV file of 1,000 and 50,000 areas over 30 years.
+
+  Build and run with:
+    ./build.sh bench2 && ./bin/bethyw-bench
+ */
+
+#include "../lib_catch.hpp"
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+#include "../areas.h"
+#include "../datasets.h"
+
+/*
+  Generate a synthetic AuthorityByYearCSV file with numAreas rows, each with
+  a value for numYears years.
+*/
+static std::string generateCSV(size_t numAreas, size_t numYears) {
+  std::ostringstream csv;
+
+  csv << "AuthorityCode";
+  for (size_t year = 0; year < numYears; year++) {
+    csv << ',' << 1990 + year;
+  }
+  csv << '\n';
+
+  char code[16];
+  for (size_t i = 0; i < numAreas; i++) {
+    std::snprintf(code, sizeof(code), "W%08zu", i);
+    csv << code;
+    for (size_t year = 0; year < numYears; year++) {
+      csv << ',' << (i * 31 + year * 17) % 100000;
+    }
+    csv << '\n';
+  }
+
+  return csv.str();
+}
+
+/*
+  Import the file into an Areas instance, which is destroyed on return.
+*/
+static size_t import(const std::string& csv, AreasMemory memory) {
+  Areas areas = Areas(memory);
+  std::istringstream stream(csv);
+  areas.populateFromAuthorityByYearCSV(stream,
+                                       BethYw::InputFiles::COMPLETE_POP.COLS);
+  return areas.size();
+}
+
+TEST_CASE( "Areas arena and default allocation", "[benchmark][AreasMemory]" ) {
+
+  const size_t numYears = 30;
+
+  for (const size_t numAreas : {1000, 50000}) {
+    const std::string csv = generateCSV(numAreas, numYears);
+    REQUIRE( import(csv, AreasMemory::Arena) == numAreas );
+
+    const std::string suffix = " (" + std::to_string(numAreas) + " areas)";
+
+    BENCHMARK( "Default memory resource" + suffix ) {
+      return import(csv, AreasMemory::Default);
+    };
+
+    BENCHMARK( "Arena" + suffix ) {
+      return import(csv, AreasMemory::Arena);
+    };
+  }
+
+} // TEST_CASE
@@ -0,0 +1,137 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 benchmark script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+
+  Compares finding the structural characters of a WelshStatsJSON and an
+  AuthorityByYearCSV file of around 16MB one byte at a time with the
+  StructuralScanner, with each kernel the CPU supports. The throughput is
+  the size of the file divided by the mean time.
+
+  Build and run with:
+    ./build.sh bench3 && ./bin/bethyw-bench
+ */
+
+#include "../lib_catch.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../structural.h"
+
+/*
+  Repeat the contents of a dataset file until it is at least size bytes.
+*/
+static std::string repeatDataset(const std::string& path, size_t size) {
+  std::ifstream file(path, std::ios::binary);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  const std::string once = contents.str();
+
+  std::string text;
+  text.reserve(size + once.size());
+  while (!once.empty() && text.size() < size) {
+    text += once;
+  }
+  return text;
+}
+
+/*
+  Find the structural characters one byte at a time, as the parsers did
+  before the StructuralScanner.
+*/
+static size_t scanEachByte(const std::string& text,
+                           ScanFormat format,
+                           std::vector<size_t>& positions) {
+  positions.clear();
+  bool inString = false;
+  bool escaped = false;
+
+  for (size_t i = 0; i < text.size(); i++) {
+    const char c = text[i];
+    if (format == ScanFormat::CSV) {
+      if (c == ',' || c == '\n') {
+        positions.push_back(i);
+      }
+    } else if (inString) {
+      if (escaped) {
+        escaped = false;
+      } else if (c == '\\') {
+        escaped = true;
+      } else if (c == '"') {
+        positions.push_back(i);
+        inString = false;
+      }
+    } else if (c == '"') {
+      positions.push_back(i);
+      inString = true;
+    } else if (c == '{' || c == '}' || c == '[' || c == ']' || c == ':' ||
+               c == ',') {
+      positions.push_back(i);
+    }
+  }
+
+  return positions.size();
+}
+
+/*
+  Find the structural characters with a kernel.
+*/
+static size_t scanWithKernel(const std::string& text,
+                             ScanFormat format,
+                             ScanKernel kernel,
+                             std::vector<size_t>& positions) {
+  positions.clear();
+  StructuralScanner scanner(format, kernel);
+  scanner.scan(text.data(), text.size(), 0, positions);
+  return positions.size();
+}
+
+TEST_CASE( "StructuralScanner kernels", "[benchmark][StructuralScanner]" ) {
+
+  const size_t size = 16 * 1024 * 1024;
+
+  for (const auto format : {ScanFormat::JSON, ScanFormat::CSV}) {
+    const std::string path = format == ScanFormat::JSON
+                                 ? "datasets/popu1009.json"
+                                 : "datasets/complete-popu1009-pop.csv";
+    const std::string text = repeatDataset(path, size);
+    const std::string suffix = format == ScanFormat::JSON
+                                   ? " (JSON, "
+                                   : " (CSV, ";
+    const std::string mb = std::to_string(text.size() / (1024 * 1024)) + "MB)";
+
+    std::vector<size_t> positions;
+    positions.reserve(text.size() / 4);
+    const size_t expected = scanEachByte(text, format, positions);
+    REQUIRE( expected > 0 );
+
+    BENCHMARK( "Each byte" + suffix + mb ) {
+      return scanEachByte(text, format, positions);
+    };
+
+    for (const auto kernel : {ScanKernel::Scalar,
+                              ScanKernel::SSE2,
+                              ScanKernel::AVX2}) {
+      if (!StructuralScanner::isSupported(kernel)) {
+        continue;
+      }
+      REQUIRE( scanWithKernel(text, format, kernel, positions) == expected );
+
+      BENCHMARK( StructuralScanner::kernelName(kernel) + suffix + mb ) {
+        return scanWithKernel(text, format, kernel, positions);
+      };
+    }
+  }
+
+} // TEST_CASE
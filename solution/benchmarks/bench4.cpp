@@ -0,0 +1,130 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 benchmark script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+
+  Compares finding the areas with a value of a measure in a range by looking
+  at every value of every series, as before Measure kept the bounds of its
+  values, with Areas::findAreasWithValuesBetween(), which rules most series
+  in or out by their bounds. The data is 20,000 synthetic areas with 8
+  measures of 40 years each (6.4 million values).
+
+  Build and run with:
+    ./build.sh bench4 && ./bin/bethyw-bench
+ */
+
+#include "../lib_catch.hpp"
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../areas.h"
+
+/*
+  Build an Areas instance of synthetic areas, each with a number of measures
+  whose values wander from a level of their own.
+*/
+static void buildSyntheticAreas(Areas& areas,
+                                unsigned int count,
+                                unsigned int measures,
+                                unsigned int years) {
+  std::mt19937 rng(48);
+  std::uniform_real_distribution<double> levels(0, 1000);
+  std::normal_distribution<double> steps(0, 5);
+
+  for (unsigned int i = 0; i < count; i++) {
+    std::string code = "W" + std::to_string(10000000 + i);
+    Area area(code, areas.get_allocator());
+
+    for (unsigned int m = 0; m < measures; m++) {
+      const std::string measureCode = "m" + std::to_string(m);
+      Measure measure(measureCode, "Measure " + std::to_string(m));
+      double value = levels(rng);
+      for (unsigned int year = 0; year < years; year++) {
+        value += steps(rng);
+        measure.setValue(1980 + year, value);
+      }
+      area.setMeasure(measureCode, std::move(measure));
+    }
+
+    areas.setArea(code, std::move(area));
+  }
+}
+
+/*
+  Find the areas with a value of a measure in a range by looking at every
+  value.
+*/
+static std::vector<std::string> scanAreasWithValuesBetween(
+    const Areas& areas,
+    const std::string& measureCode,
+    double low,
+    double high) {
+  std::vector<std::string> found;
+  for (auto areaIt = areas.cbegin(); areaIt != areas.cend(); areaIt++) {
+    bool match = false;
+    for (auto measureIt = areaIt->cbegin();
+         !match && measureIt != areaIt->cend();
+         measureIt++) {
+      if (measureIt->second.getCodename() != measureCode) {
+        continue;
+      }
+      for (auto it = measureIt->second.cbegin();
+           it != measureIt->second.cend();
+           it++) {
+        if (it->second >= low && it->second <= high) {
+          match = true;
+          break;
+        }
+      }
+    }
+    if (match) {
+      found.push_back(areaIt->getLocalAuthorityCode());
+    }
+  }
+  return found;
+}
+
+TEST_CASE( "Range queries with zone maps", "[benchmark][zonemap]" ) {
+
+  Areas areas = Areas();
+  buildSyntheticAreas(areas, 20000, 8, 40);
+
+  const double inf = std::numeric_limits<double>::infinity();
+  struct Query {
+    std::string label;
+    double low;
+    double high;
+  };
+  const std::vector<Query> queries = {
+      {"ever exceeded 950", std::nextafter(950.0, inf), inf},
+      {"ever below 20", -inf, std::nextafter(20.0, -inf)},
+      {"between 500 and 501", 500, 501}};
+
+  for (const auto& query : queries) {
+    const auto expected =
+        scanAreasWithValuesBetween(areas, "m3", query.low, query.high);
+    REQUIRE( areas.findAreasWithValuesBetween("m3", query.low, query.high) ==
+             expected );
+
+    BENCHMARK( "Scan every value, " + query.label ) {
+      return scanAreasWithValuesBetween(areas, "m3", query.low, query.high);
+    };
+
+    BENCHMARK( "Zone maps, " + query.label ) {
+      return areas.findAreasWithValuesBetween("m3", query.low, query.high);
+    };
+  }
+
+} // TEST_CASE
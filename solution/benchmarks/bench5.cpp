@@ -0,0 +1,114 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 benchmark script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+
+  Compares importing datasets into Areas instances of their own and merging
+  them into one, as BethYw::loadAreasAndDatasets() does with more than one
+  thread, where each import has an arena of its own (so it is copied when it
+  is merged), with where they all share a thread safe pool or the heap, as
+  with AreasMemory::Default (so they are merged by splicing). The data is 8 synthetic datasets of 2,000
+  areas, each with 4 measures of 40 years (2.56 million values).
+
+  Build and run with:
+    ./build.sh bench5 && ./bin/bethyw-bench
+ */
+
+#include "../lib_catch.hpp"
+
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../areas.h"
+
+/*
+  Import a synthetic dataset into an Areas instance, with measures of its
+  own, as each dataset file has.
+*/
+static void importSyntheticDataset(Areas& areas,
+                                   unsigned int dataset,
+                                   unsigned int count,
+                                   unsigned int measures,
+                                   unsigned int years) {
+  std::mt19937 rng(dataset);
+  std::uniform_real_distribution<double> values(0, 1000);
+
+  for (unsigned int i = 0; i < count; i++) {
+    std::string code = "W" + std::to_string(10000000 + i);
+    Area area(code, areas.get_allocator());
+
+    for (unsigned int m = 0; m < measures; m++) {
+      const std::string measureCode =
+          "d" + std::to_string(dataset) + "m" + std::to_string(m);
+      Measure measure(measureCode, "Measure", areas.get_allocator());
+      for (unsigned int year = 0; year < years; year++) {
+        measure.setValue(1980 + year, values(rng));
+      }
+      area.setMeasure(measureCode, std::move(measure));
+    }
+
+    areas.setArea(code, std::move(area));
+  }
+}
+
+/*
+  Import the datasets each into an Areas instance of its own, allocating as
+  areas does, and merge them into areas in turn.
+*/
+static size_t importAndMerge(AreasMemory memory) {
+  Areas areas(memory);
+  for (unsigned int dataset = 0; dataset < 8; dataset++) {
+    auto imported = std::make_unique<Areas>(memory);
+    importSyntheticDataset(*imported, dataset, 2000, 4, 40);
+    areas.merge(std::move(*imported), MergePolicy::Import);
+  }
+
+  return areas.size();
+}
+
+/*
+  As above, but with areas and the imports all allocating from one thread
+  safe pool.
+*/
+static size_t importAndMergeShared() {
+  std::pmr::synchronized_pool_resource pool;
+  Areas areas(&pool);
+  for (unsigned int dataset = 0; dataset < 8; dataset++) {
+    auto imported = std::make_unique<Areas>(&pool);
+    importSyntheticDataset(*imported, dataset, 2000, 4, 40);
+    areas.merge(std::move(*imported), MergePolicy::Import);
+  }
+
+  return areas.size();
+}
+
+TEST_CASE( "Merging imported datasets", "[benchmark][merge]" ) {
+
+  REQUIRE( importAndMerge(AreasMemory::Arena) == 2000 );
+  REQUIRE( importAndMergeShared() == 2000 );
+  REQUIRE( importAndMerge(AreasMemory::Default) == 2000 );
+
+  BENCHMARK( "An arena for each import, copied when merged" ) {
+    return importAndMerge(AreasMemory::Arena);
+  };
+
+  BENCHMARK( "A shared pool, spliced when merged" ) {
+    return importAndMergeShared();
+  };
+
+  BENCHMARK( "The heap, spliced when merged" ) {
+    return importAndMerge(AreasMemory::Default);
+  };
+
+} // TEST_CASE
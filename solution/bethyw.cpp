@@ -23,8 +23,15 @@
 */
 
 #include <algorithm>
+#include <chrono>
 #include <exception>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
 #include <string>
 #include <stdexcept>
 #include <tuple>
@@ -32,10 +39,43 @@
 #include <vector>
 
 #include "lib_cxxopts.hpp"
+#include "lib_json.hpp"
 
 #include "datasets.h"
+#include "batch.h"
 #include "bethyw.h"
+#include "catalog.h"
+#include "compressed.h"
 #include "input.h"
+#include "pipeline.h"
+#include "readahead.h"
+#include "rowindex.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include "watch.h"
+
+/*
+  In batch mode, the reads of the dataset files are all submitted before the
+  first is parsed (see BethYw::batchDatasetFiles()), and the batch is given
+  to the sources in the InputOptions returned, so it is only kept for the
+  import they are used for.
+*/
+static InputOptions batchInputOptions(
+    const InputOptions& input,
+    const std::string& dir,
+    const std::vector<BethYw::InputFileSource>& datasetsToImport,
+    const std::unordered_set<std::string>& areasFilter,
+    const std::unordered_set<std::string>& measuresFilter) {
+  InputOptions batched = input;
+  if (input.batchReads && input.batch == nullptr) {
+    batched.batch = BethYw::batchDatasetFiles(dir,
+                                              datasetsToImport,
+                                              areasFilter,
+                                              measuresFilter);
+  }
+
+  return batched;
+}
 
 /*
   Run Beth Yw?, parsing the command line arguments, importing the data,
@@ -72,30 +112,77 @@ int BethYw::run(int argc, char *argv[]) {
     auto areasFilter      = BethYw::parseAreasArg(args);
     auto measuresFilter   = BethYw::parseMeasuresArg(args);
     auto yearsFilter      = BethYw::parseYearsArg(args);
+    auto valueFilter      = BethYw::parseWhereArg(args);
+    auto threads          = BethYw::parseThreadsArg(args);
+
+    // All of the imported data is allocated from an arena owned by data, and
+    // released in one go when it goes out of scope, unless --no-arena is
+    // given (as are the datasets imported on each thread)
+    const AreasMemory memory = args.count("no-arena") ? AreasMemory::Default
+                                                      : AreasMemory::Arena;
+    Areas data(memory);
+
+    // The files can be read ahead of the parsers, on threads of their own, or
+    // they can all be read at once before they are parsed
+    InputOptions input;
+    input.readAhead = args.count("read-ahead") > 0;
+    input.batchReads = args.count("io-uring") > 0;
+
+    // And each file can be parsed on several threads, while the datasets are
+    // loaded and the areas rendered as tasks on as many
+    data.setIngestThreads(threads);
+    TaskScheduler scheduler(threads);
+
+    if (args.count("watch")) {
+      BethYw::loadAreas(data, dir, areasFilter, input);
+      return BethYw::watchDatasets(data,
+                                   dir,
+                                   datasetsToImport,
+                                   areasFilter,
+                                   measuresFilter,
+                                   yearsFilter,
+                                   memory,
+                                   args.count("json") > 0,
+                                   &valueFilter,
+                                   input);
+    }
 
-    Areas data = Areas();
-
-    BethYw::loadAreas(data, dir, areasFilter);
+    BethYw::loadAreasAndDatasets(scheduler,
+                                 data,
+                                 dir,
+                                 datasetsToImport,
+                                 areasFilter,
+                                 measuresFilter,
+                                 yearsFilter,
+                                 memory,
+                                 &valueFilter,
+                                 input);
+
+    // The aggregates of each series are only known once every dataset has
+    // been loaded
+    data.pruneSeries(valueFilter);
+
+    BethYw::printAreas(scheduler, data, args.count("json") > 0);
+
+    if (!valueFilter.empty()) {
+      BethYw::printWhereStats(valueFilter);
+    }
 
-    BethYw::loadDatasets(data,
-                         dir,
-                         datasetsToImport,
-                         areasFilter,
-                         measuresFilter,
-                         yearsFilter);
+    if (input.readAhead) {
+      BethYw::printReadAheadStats();
+    }
 
-    if (args.count("json")) {
-      // The output as JSON
-      std::cout << data.toJSON() << std::endl;
-    } else {
-      // The output as tables
-      std::cout << data << std::endl;
+    if (threads > 1) {
+      BethYw::printIngestStats();
     }
 
     return 0;
   } catch (const cxxopts::missing_argument_exception& ex) {
     std::cerr << "Missing value for argument:" << ex.what() << std::endl;
     return 1;
+  } catch (const cxxopts::OptionException& ex) {
+    std::cerr << ex.what() << std::endl;
+    return 1;
   } catch (const std::invalid_argument& ex) {
     std::cerr << ex.what() << std::endl;
     return 1;
@@ -118,14 +205,20 @@ cxxopts::Options BethYw::cxxoptsSetup() {
     
   cxxopts.add_options()(
       "dir",
-      "Directory for input data passed in as files",
+      "Directory for input data passed in as files, or a .zip file of them",
       cxxopts::value<std::string>()->default_value("datasets"))(
 
       "d,datasets",
       "The dataset(s) to import and analyse as a comma-separated list of codes "
-      "(omit or set to 'all' to import and analyse all datasets)",
+      "(omit or set to 'all' to import and analyse all datasets), where '-' "
+      "is a dataset piped in on the standard input",
       cxxopts::value<std::vector<std::string>>())(
 
+      "format",
+      "The code of the dataset whose format (i.e. parser and columns) the "
+      "dataset piped in on the standard input has, e.g. popden",
+      cxxopts::value<std::string>())(
+
       "a,areas",
       "The areas(s) to import and analyse as a comma-separated list of "
       "authority codes (omit or set to 'all' to import and analyse all areas)",
@@ -141,9 +234,38 @@ cxxopts::Options BethYw::cxxoptsSetup() {
       "inclusive range of years (YYYY-ZZZZ)",
       cxxopts::value<std::string>()->default_value("0"))(
 
+      "where",
+      "Keep only the values (and series) matching an expression, e.g. "
+      "\"pop > 100000 and max(dens) > 500\", reporting the number of rows "
+      "and series left out to the standard error",
+      cxxopts::value<std::string>())(
+
       "j,json",
       "Print the output as JSON instead of tables.")(
 
+      "no-arena",
+      "Allocate the imported data with the default allocator instead of an "
+      "arena (for comparison).")(
+
+      "read-ahead",
+      "Read each data file on a thread of its own, a block ahead of parsing "
+      "it, and print the time spent waiting for it to the standard error.")(
+
+      "io-uring",
+      "Read the dataset files all at once before parsing them, with io_uring "
+      "where the system supports it (and one at a time otherwise).")(
+
+      "threads",
+      "The number of threads to load the datasets and print the areas on, "
+      "and to parse each data file with, in a pipeline of a reader, parsers, "
+      "and a thread adding the data (printing the throughput of each stage to "
+      "the standard error). Must be at least 1.",
+      cxxopts::value<unsigned int>()->default_value("1"))(
+
+      "watch",
+      "Keep running, and reload and print the data whenever the dataset "
+      "files in the directory change.")(
+
       "h,help",
       "Print usage.");
 
@@ -175,6 +297,9 @@ cxxopts::Options BethYw::cxxoptsSetup() {
   @throws
     std::invalid_argument if the argument contains an invalid dataset with
     message: No dataset matches key <input code>
+    or if the format argument is given without the dataset '-' (which it
+    gives the format of), with the message:
+    --format can only be given with the dataset - (the standard input)
 
   @example
     auto cxxopts = BethYw::cxxoptsSetup();
@@ -189,6 +314,7 @@ std::vector<BethYw::InputFileSource> BethYw::parseDatasetsArg(
   std::vector<InputFileSource> datasetsToImport;
 
   bool importAllValues = false;
+  bool importStdin = false;
 
   std::vector<std::string> inputDatasets;
   try {
@@ -211,6 +337,12 @@ std::vector<BethYw::InputFileSource> BethYw::parseDatasetsArg(
         break;
       }
 
+      if (code == STDIN_PATH) {
+        datasetsToImport.push_back(parseFormatArg(args));
+        importStdin = true;
+        continue;
+      }
+
       bool match = false;
       for (unsigned int i = 0; i < numDatasets; i++) {
         const InputFileSource& ifs = allDatasets[i];
@@ -232,11 +364,62 @@ std::vector<BethYw::InputFileSource> BethYw::parseDatasetsArg(
     for (size_t i = 0; i < numDatasets; i++) {
       datasetsToImport.push_back(allDatasets[i]);
     }
+    importStdin = false;
+  }
+
+  if (!importStdin && args.count("format") > 0) {
+    throw std::invalid_argument("--format can only be given with the "
+                                "dataset - (the standard input)");
   }
   
   return datasetsToImport;
 }
 
+/*
+  Parse the format argument, which gives the format of a dataset piped in on
+  the standard input as the code of a dataset in that format, as the datasets
+  differ in their columns as well as their parsers.
+
+  @param args
+    Parsed program arguments
+
+  @return
+    An InputFileSource for the standard input, which has the code, name,
+    parser and columns of the dataset given, and STDIN_PATH as its file
+
+  @throws
+    std::invalid_argument if the argument is missing, with the message:
+    The format of the standard input must be given with --format
+    or if it is not the code of a dataset, with the message:
+    No dataset matches key: <input code>
+
+  @example
+    auto cxxopts = BethYw::cxxoptsSetup();
+    auto args = cxxopts.parse(argc, argv);
+
+    // e.g. curl ... | zcat | bethyw -d - --format popden
+    auto dataset = BethYw::parseFormatArg(args);
+*/
+BethYw::InputFileSource BethYw::parseFormatArg(cxxopts::ParseResult& args) {
+  if (args.count("format") == 0) {
+    throw std::invalid_argument("The format of the standard input must be "
+                                "given with --format");
+  }
+
+  std::string code = args["format"].as<std::string>();
+  std::transform(code.begin(), code.end(), code.begin(), ::tolower);
+
+  for (size_t i = 0; i < InputFiles::NUM_DATASETS; i++) {
+    const InputFileSource& ifs = InputFiles::DATASETS[i];
+    if (ifs.CODE == code) {
+      return InputFileSource{ifs.CODE, ifs.NAME, STDIN_PATH, ifs.PARSER,
+                             ifs.COLS};
+    }
+  }
+
+  throw std::invalid_argument("No dataset matches key: " + code);
+}
+
 /*
   TODO: BethYw::parseAreasArg(args)
   
@@ -402,6 +585,122 @@ std::tuple<unsigned int, unsigned int>BethYw::parseYearsArg(
   return years;
 }
 
+/*
+  Parse the where command line argument, an expression of the values and
+  series to keep (see valuefilter.h), into a ValueFilter. If no where
+  argument is given, the ValueFilter is empty and keeps everything.
+
+  @param args
+    Parsed program arguments
+
+  @return
+    The ValueFilter
+
+  @throws
+    std::invalid_argument if the expression is not valid, with a message
+    giving the character at which it is not
+
+  @example
+    auto cxxopts = BethYw::cxxoptsSetup();
+    auto args = cxxopts.parse(argc, argv);
+    auto valueFilter = BethYw::parseWhereArg(args);
+*/
+ValueFilter BethYw::parseWhereArg(cxxopts::ParseResult& args) {
+  if (args.count("where") == 0) {
+    return ValueFilter();
+  }
+
+  return ValueFilter(args["where"].as<std::string>());
+}
+
+/*
+  Parse the threads command line argument, the number of threads to load the
+  datasets and print the areas on, which must be at least 1 (and is 1 if no
+  threads argument is given). A value that is not a number, or is negative,
+  is rejected by cxxopts when the arguments are parsed.
+
+  @param args
+    Parsed program arguments
+
+  @return
+    The number of threads
+
+  @throws
+    std::invalid_argument if the number of threads is 0, with the message:
+    Invalid input for threads argument
+
+  @example
+    auto cxxopts = BethYw::cxxoptsSetup();
+    auto args = cxxopts.parse(argc, argv);
+    TaskScheduler scheduler(BethYw::parseThreadsArg(args));
+*/
+unsigned int BethYw::parseThreadsArg(cxxopts::ParseResult& args) {
+  const unsigned int threads = args["threads"].as<unsigned int>();
+  if (threads == 0) {
+    throw std::invalid_argument("Invalid input for threads argument");
+  }
+
+  return threads;
+}
+
+/*
+  Open a file in the data directory as an InputSource. If the data directory
+  is a .zip file (or a directory within one), e.g. --dir datasets.zip, the
+  file is read from the archive without extracting it (see InputArchive),
+  otherwise it is read from disk. STDIN_PATH opens the standard input.
+
+  The caches kept alongside dataset files (e.g. the RowIndex) cannot be kept
+  within an archive, so they are not used for the files within one.
+
+  @param path
+    The path to the file, e.g. datasets/areas.csv or datasets.zip/areas.csv
+
+  @param input
+    How a file on disk is read (see InputOptions)
+
+  @return
+    An InputSource for the file
+
+  @example
+    auto source = BethYw::openDataFile("datasets.zip/areas.csv");
+    areas.populate(source->open(), ...);
+*/
+std::unique_ptr<InputSource> BethYw::openDataFile(const std::string& path,
+                                                  const InputOptions& input) {
+  if (path == STDIN_PATH) {
+    return std::make_unique<InputStdin>();
+  } else if (InputArchive::isArchivePath(path)) {
+    return std::make_unique<InputArchive>(path);
+  }
+
+  return std::make_unique<InputFile>(path, input);
+}
+
+/*
+  Find a file in the data directory, which may have been compressed with
+  gzip and given a .gz extension, e.g. popu1009.json.gz in place of
+  popu1009.json (see InputFile).
+
+  @param path
+    The path to the file, e.g. datasets/popu1009.json
+
+  @return
+    The path, or the path with .gz added if only that file exists
+
+  @example
+    std::string path = BethYw::findDataFile("datasets/popu1009.json");
+*/
+std::string BethYw::findDataFile(const std::string& path) {
+  std::ifstream file(path);
+  if (file.is_open()) {
+    return path;
+  }
+
+  const std::string compressed = path + ".gz";
+  std::ifstream compressedFile(compressed);
+  return compressedFile.is_open() ? compressed : path;
+}
+
 /*
   TODO: BethYw::loadAreas(areas, dir, areasFilter)
 
@@ -429,6 +728,9 @@ std::tuple<unsigned int, unsigned int>BethYw::parseYearsArg(
   @param areasFilter
     An unordered set of areas to filter, or empty to import all areas
 
+  @param input
+    How the file is read (see InputOptions)
+
   @return
     void
 
@@ -439,11 +741,12 @@ std::tuple<unsigned int, unsigned int>BethYw::parseYearsArg(
 */
 void BethYw::loadAreas(Areas& areas,
                        const std::string& dir,
-                       std::unordered_set<std::string>& areasFilter) {
-  const std::string fileAreas = dir + InputFiles::AREAS.FILE;
+                       std::unordered_set<std::string>& areasFilter,
+                       const InputOptions& input) {
+  const std::string fileAreas = findDataFile(dir + InputFiles::AREAS.FILE);
 
   try {
-    auto source = std::make_unique<InputFile>(fileAreas);
+    auto source = openDataFile(fileAreas, input);
     areas.populate(source->open(),
                    InputFiles::AREAS.PARSER,
                    InputFiles::AREAS.COLS,
@@ -494,6 +797,12 @@ void BethYw::loadAreas(Areas& areas,
     An two-pair tuple of unsigned ints corresponding to the range of years 
     to import, which should both be 0 to import all years.
 
+  @param valueFilter
+    The ValueFilter of the rows to import, or nullptr to import every row
+
+  @param input
+    How the files are read (see InputOptions)
+
   @return
     void
 
@@ -514,21 +823,1346 @@ void BethYw::loadDatasets(
     std::vector<InputFileSource>& datasetsToImport,
     std::unordered_set<std::string>& areasFilter,
     std::unordered_set<std::string>& measuresFilter,
-    std::tuple<unsigned int,unsigned int>& yearsFilter) noexcept {
+    std::tuple<unsigned int,unsigned int>& yearsFilter,
+    const ValueFilter* valueFilter,
+    const InputOptions& input) noexcept {
+  try {
+    loadDatasets(areas,
+                 dir,
+                 datasetsToImport,
+                 areasFilter,
+                 measuresFilter,
+                 yearsFilter,
+                 nullptr,
+                 valueFilter,
+                 input);
+  } catch (const std::runtime_error& ex) {
+    std::cerr << "Error importing dataset:\n" << ex.what() << std::endl;
+    std::exit(1);
+  }
+}
+
+/*
+  Import datasets from `datasetsToImport` as files in `dir` into areas, as
+  above, but throwing an exception rather than exiting if a dataset cannot be
+  imported. If snapshots is given, the DatasetSnapshot of each dataset is
+  kept in it, and a dataset that has a snapshot for the same import in it is
+  restored from there rather than from its file.
+
+  @param areas
+    An Areas instance that should be modified (i.e. datasets loaded into it)
+
+  @param dir
+    The directory where the datasets are
+
+  @param datasetsToImport
+    A vector of InputFileSource objects
+
+  @param areasFilter
+    An unordered set of areas to filter, or empty to import all areas
+
+  @param measuresFilter
+    An unordered set of measures to filter, or empty to import all measures
+
+  @param yearsFilter
+    The range of years to import, which should both be 0 to import all years
+
+  @param snapshots
+    The DatasetSnapshots of the datasets, by dataset code, to restore from and
+    update, or nullptr
+
+  @param valueFilter
+    The ValueFilter of the rows to import, or nullptr to import every row
+
+  @param input
+    How the files are read (see InputOptions)
+
+  @throws
+    std::runtime_error if a dataset cannot be imported
+*/
+void BethYw::loadDatasets(
+    Areas& areas,
+    const std::string& dir,
+    std::vector<InputFileSource>& datasetsToImport,
+    std::unordered_set<std::string>& areasFilter,
+    std::unordered_set<std::string>& measuresFilter,
+    std::tuple<unsigned int,unsigned int>& yearsFilter,
+    DatasetSnapshots* snapshots,
+    const ValueFilter* valueFilter,
+    const InputOptions& input) {
+  const InputOptions batched = batchInputOptions(input,
+                                                 dir,
+                                                 datasetsToImport,
+                                                 areasFilter,
+                                                 measuresFilter);
+
   for (auto dataset = datasetsToImport.begin();
        dataset != datasetsToImport.end();
        dataset++) {
-    try {
-      auto source = std::make_unique<InputFile>(dir + dataset->FILE);
+    // Each dataset is imported into an Areas instance of its own, sharing
+    // our memory resource so that merging it in moves rather than copies
+    // the data, and parsing with as many threads
+    Areas imported(areas.get_allocator().resource());
+    imported.setIngestThreads(areas.getIngestThreads());
+    if (loadDataset(imported,
+                    areas,
+                    dir,
+                    *dataset,
+                    areasFilter,
+                    measuresFilter,
+                    yearsFilter,
+                    snapshots,
+                    valueFilter,
+                    batched)) {
+      areas.merge(std::move(imported), MergePolicy::Import);
+    }
+  }
+}
+
+/*
+  Import a dataset from its file in `dir` into an Areas instance of its own,
+  ready to be merged into the Areas instance the datasets before it were
+  imported into, restoring it from its snapshot if it is unchanged.
+
+  The existing Areas instance is only read when the areas are filtered (as
+  the filter is matched against the names of the areas imported so far).
+
+  @param imported
+    An empty Areas instance to import the dataset into
+
+  @param areas
+    The Areas instance the dataset will be merged into
+
+  @param dir
+    The directory where the datasets are
+
+  @param dataset
+    The InputFileSource for the dataset
+
+  @param areasFilter
+    An unordered set of areas to filter, or empty to import all areas
+
+  @param measuresFilter
+    An unordered set of measures to filter, or empty to import all measures
+
+  @param yearsFilter
+    The range of years to import, which should both be 0 to import all years
+
+  @param snapshots
+    The DatasetSnapshots of the datasets, by dataset code, to restore from and
+    update, or nullptr
+
+  @param valueFilter
+    The ValueFilter of the rows to import, or nullptr to import every row
+
+  @param input
+    How the files are read (see InputOptions)
+
+  @return
+    false if the dataset has nothing to import given the filters, in which
+    case nothing is imported
+
+  @throws
+    std::runtime_error if the dataset cannot be imported
+*/
+bool BethYw::loadDataset(
+    Areas& imported,
+    Areas& areas,
+    const std::string& dir,
+    const InputFileSource& dataset,
+    std::unordered_set<std::string>& areasFilter,
+    std::unordered_set<std::string>& measuresFilter,
+    std::tuple<unsigned int,unsigned int>& yearsFilter,
+    DatasetSnapshots* snapshots,
+    const ValueFilter* valueFilter,
+    const InputOptions& input) {
+  // A dataset piped in on the standard input is read as it arrives, so it
+  // cannot be checked against its caches beforehand
+  const bool piped = dataset.FILE == STDIN_PATH;
+  const std::string path = piped ? STDIN_PATH
+                                 : findDataFile(dir + dataset.FILE);
+  const bool filtered = !areasFilter.empty() ||
+                        !measuresFilter.empty() ||
+                        (std::get<0>(yearsFilter) != 0 &&
+                         std::get<1>(yearsFilter) != 0) ||
+                        (valueFilter != nullptr &&
+                         !valueFilter->getRowMeasures().empty());
+
+  // When filtering, a file may have nothing we want to import
+  if (filtered &&
+      !piped &&
+      !datasetMayContribute(areas,
+                            path,
+                            dataset,
+                            areasFilter,
+                            measuresFilter,
+                            yearsFilter,
+                            valueFilter)) {
+    if (snapshots != nullptr) {
+      snapshots->erase(dataset.CODE);
+    }
+    return false;
+  }
+
+  const std::vector<std::string> import = DatasetSnapshot::describeImport(
+      dataset,
+      areasFilter,
+      measuresFilter,
+      yearsFilter,
+      areas,
+      valueFilter);
+
+  const DatasetSnapshot* kept = nullptr;
+  if (snapshots != nullptr) {
+    auto keptIt = snapshots->find(dataset.CODE);
+    if (keptIt != snapshots->end() && keptIt->second.getImport() == import) {
+      kept = &keptIt->second;
+    }
+  }
+
+  if (kept != nullptr) {
+    kept->restore(imported);
+  } else {
+    DatasetSnapshot snapshot;
+    if (piped || !restoreDataset(imported, path, import, &snapshot)) {
+      snapshot = importDataset(imported,
+                               areas,
+                               path,
+                               dataset,
+                               import,
+                               areasFilter,
+                               measuresFilter,
+                               yearsFilter,
+                               valueFilter,
+                               input);
+    }
+
+    if (snapshots != nullptr) {
+      snapshots->insert_or_assign(dataset.CODE, std::move(snapshot));
+    }
+  }
+
+  return true;
+}
+
+/*
+  Load the areas.csv file and then the datasets in datasetsToImport from
+  `dir` into areas, as loadAreas() and then loadDatasets() do, but as tasks on
+  a TaskScheduler, so that the datasets are imported in parallel.
+
+  Each dataset is imported into an Areas instance of its own by one task,
+  and merged into areas by another, once areas.csv and the datasets before
+  it have been merged, so the data is the same as when they are loaded one
+  at a time. Each import allocates as areas does (see AreasMemory): with
+  AreasMemory::Default, from the heap, so it is merged by splicing its nodes
+  into areas. An arena is not thread safe, so with AreasMemory::Arena each
+  import has an arena of its own, and its data is copied into areas when it
+  is merged. Sharing a thread safe pool between them would let the merges
+  splice, but locking the pool costs more than the copy saves (see
+  benchmarks/bench5.cpp).
+
+  Without an areas filter, the imports do not depend on areas, so they all
+  run at once. With one, each dataset's rows are matched against the names
+  of the areas imported before it (e.g. the Welsh names in areas.csv, which
+  the AuthorityByYearCSV and WelshStatsJSON files do not have), so each
+  import waits for the datasets before it to be merged.
+
+  With one thread, this simply calls loadAreas() and loadDatasets().
+
+  As with those, if a dataset cannot be imported, the error is printed and
+  the program exits.
+
+  @param scheduler
+    The TaskScheduler to run the tasks on
+
+  @param areas
+    An Areas instance that should be modified (i.e. datasets loaded into it)
+
+  @param dir
+    The directory where the datasets are
+
+  @param datasetsToImport
+    A vector of InputFileSource objects
+
+  @param areasFilter
+    An unordered set of areas to filter, or empty to import all areas
+
+  @param measuresFilter
+    An unordered set of measures to filter, or empty to import all measures
+
+  @param yearsFilter
+    The range of years to import, which should both be 0 to import all years
+
+  @param memory
+    Where areas allocates its data from, as given to its constructor
+
+  @param valueFilter
+    The ValueFilter of the rows to import, or nullptr to import every row
+
+  @param input
+    How the files are read (see InputOptions)
+
+  @example
+    TaskScheduler scheduler(4);
+    Areas areas(AreasMemory::Arena);
+
+    BethYw::loadAreasAndDatasets(
+      scheduler,
+      areas,
+      "data",
+      BethYw::parseDatasetsArgument(args),
+      BethYw::parseAreasArg(args),
+      BethYw::parseMeasuresArg(args),
+      BethYw::parseYearsArg(args),
+      AreasMemory::Arena);
+*/
+void BethYw::loadAreasAndDatasets(
+    TaskScheduler& scheduler,
+    Areas& areas,
+    const std::string& dir,
+    std::vector<InputFileSource>& datasetsToImport,
+    std::unordered_set<std::string>& areasFilter,
+    std::unordered_set<std::string>& measuresFilter,
+    std::tuple<unsigned int,unsigned int>& yearsFilter,
+    AreasMemory memory,
+    const ValueFilter* valueFilter,
+    const InputOptions& input) noexcept {
+  if (scheduler.getThreads() == 1) {
+    loadAreas(areas, dir, areasFilter, input);
+    loadDatasets(areas,
+                 dir,
+                 datasetsToImport,
+                 areasFilter,
+                 measuresFilter,
+                 yearsFilter,
+                 valueFilter,
+                 input);
+    return;
+  }
+
+  const InputOptions batched = batchInputOptions(input,
+                                                 dir,
+                                                 datasetsToImport,
+                                                 areasFilter,
+                                                 measuresFilter);
+
+  std::vector<std::unique_ptr<Areas>> imported;
+  std::vector<char> contributes(datasetsToImport.size(), false);
+
+  try {
+    TaskScheduler::TaskId merged = scheduler.submit([&]() {
+      auto source = openDataFile(findDataFile(dir + InputFiles::AREAS.FILE),
+                                 input);
       areas.populate(source->open(),
-                     dataset->PARSER,
-                     dataset->COLS,
-                     &areasFilter,
-                     &measuresFilter,
-                     &yearsFilter);
-    } catch (const std::runtime_error& ex) {
-      std::cerr << "Error importing dataset:\n" << ex.what() << std::endl;
-      std::exit(1);
+                     InputFiles::AREAS.PARSER,
+                     InputFiles::AREAS.COLS,
+                     &areasFilter);
+    });
+
+    for (size_t i = 0; i < datasetsToImport.size(); i++) {
+      imported.push_back(std::make_unique<Areas>(memory));
+      imported.back()->setIngestThreads(areas.getIngestThreads());
+    }
+
+    for (size_t i = 0; i < datasetsToImport.size(); i++) {
+      std::vector<TaskScheduler::TaskId> after;
+      if (!areasFilter.empty()) {
+        after.push_back(merged);
+      }
+
+      const TaskScheduler::TaskId load = scheduler.submit([&, i]() {
+        contributes[i] = loadDataset(*imported[i],
+                                     areas,
+                                     dir,
+                                     datasetsToImport[i],
+                                     areasFilter,
+                                     measuresFilter,
+                                     yearsFilter,
+                                     nullptr,
+                                     valueFilter,
+                                     batched);
+      }, after);
+
+      merged = scheduler.submit([&, i]() {
+        if (contributes[i]) {
+          areas.merge(std::move(*imported[i]), MergePolicy::Import);
+        }
+        imported[i].reset();
+      }, {load, merged});
     }
+
+    scheduler.wait();
+  } catch (const std::runtime_error& ex) {
+    std::cerr << "Error importing dataset:\n" << ex.what() << std::endl;
+    std::exit(1);
+  }
+}
+
+/*
+  Submit the reads of the dataset files that will be parsed in full to a
+  FileBatch, so that they are read all at once, with io_uring where it is
+  available (see batch.h), and InputFile takes each file's contents from the
+  batch when it is parsed (see InputOptions).
+
+  Each page of a paged dataset (see InputFilePages) is submitted, as the
+  pages are always parsed in full, so a dataset saved as thousands of pages
+  is read with as many reads in flight as the batch allows. Files within a
+  .zip file and compressed files are read as they are parsed, as are
+  unpaged JSON datasets that are filtered by area or measure, which may be
+  imported using their RowIndex without reading them in full.
+
+  @param dir
+    The directory where the datasets are
+
+  @param datasetsToImport
+    A vector of InputFileSource objects
+
+  @param areasFilter
+    An unordered set of areas to filter, or empty to import all areas
+
+  @param measuresFilter
+    An unordered set of measures to filter, or empty to import all measures
+
+  @return
+    The FileBatch of the files
+
+  @example
+    InputOptions input;
+    input.batch = BethYw::batchDatasetFiles(dir,
+                                            datasetsToImport,
+                                            areasFilter,
+                                            measuresFilter);
+    InputFile file(dir + datasetsToImport[0].FILE, input);
+*/
+std::shared_ptr<FileBatch> BethYw::batchDatasetFiles(
+    const std::string& dir,
+    const std::vector<InputFileSource>& datasetsToImport,
+    const std::unordered_set<std::string>& areasFilter,
+    const std::unordered_set<std::string>& measuresFilter) {
+  std::vector<std::string> paths;
+  for (auto dataset = datasetsToImport.cbegin();
+       dataset != datasetsToImport.cend();
+       dataset++) {
+    if (dataset->FILE == STDIN_PATH) {
+      continue;
+    }
+
+    const std::string path = findDataFile(dir + dataset->FILE);
+    const bool isJSON =
+        dataset->PARSER == BethYw::SourceDataType::WelshStatsJSON;
+
+    if (InputArchive::isArchivePath(path) ||
+        detectCompression(path) != Compression::None) {
+      continue;
+    }
+
+    if (isJSON && InputFilePages::isPaged(path)) {
+      paths.push_back(path);
+      for (unsigned int page = 2; ; page++) {
+        const std::string pagePath = InputFilePages::pagePath(path, page);
+        std::ifstream file(pagePath);
+        if (!file.is_open()) {
+          break;
+        }
+        paths.push_back(pagePath);
+      }
+      continue;
+    }
+
+    if (isJSON && (!areasFilter.empty() || !measuresFilter.empty())) {
+      continue;
+    }
+
+    paths.push_back(path);
+  }
+
+  return std::make_shared<FileBatch>(paths);
+}
+
+/*
+  Restore what a dataset file contributed to the Areas when it was last
+  imported, from the DatasetSnapshot saved alongside it (see snapshot.h), if
+  the file and the import are unchanged.
+
+  @param areas
+    An empty Areas instance to restore the dataset into
+
+  @param path
+    The path to the dataset file
+
+  @param import
+    The description of the import from DatasetSnapshot::describeImport()
+
+  @param restored
+    Set to the restored snapshot, if not nullptr
+
+  @return
+    true if the dataset was restored, or false (having restored nothing) if
+    there is no usable snapshot
+*/
+bool BethYw::restoreDataset(Areas& areas,
+                            const std::string& path,
+                            const std::vector<std::string>& import,
+                            DatasetSnapshot* restored) {
+  // The snapshot only covers the dataset file, not any pages after it
+  if (InputFilePages::isPaged(path)) {
+    return false;
+  }
+
+  DatasetSnapshot snapshot;
+  try {
+    snapshot = DatasetSnapshot::forFile(path);
+  } catch (const std::runtime_error& ex) {
+    // There is no snapshot, or it is corrupt, so we parse the file
+    return false;
+  }
+
+  if (!snapshot.isFor(path, import)) {
+    return false;
+  }
+
+  snapshot.restore(areas);
+  if (restored != nullptr) {
+    *restored = std::move(snapshot);
+  }
+
+  return true;
+}
+
+/*
+  Import a dataset file into an Areas instance of its own, and save a
+  DatasetSnapshot of it alongside the file for next time.
+
+  The parsers match the areas filter against the names of the Area objects
+  imported beforehand, so if the areas are filtered, the Areas instance is
+  first given an empty copy (i.e. with names but no Measures) of each of
+  them, which the snapshot leaves out.
+
+  A JSON dataset with more pages saved after the dataset file (see
+  InputFilePages) is imported page by page, and not saved in a snapshot.
+
+  @param imported
+    An empty Areas instance to import the dataset into
+
+  @param existing
+    The Areas instance the dataset will be merged into
+
+  @param path
+    The path to the dataset file
+
+  @param dataset
+    The InputFileSource for the dataset
+
+  @param import
+    The description of the import from DatasetSnapshot::describeImport()
+
+  @param areasFilter
+    An unordered set of areas to filter, or empty to import all areas
+
+  @param measuresFilter
+    An unordered set of measures to filter, or empty to import all measures
+
+  @param yearsFilter
+    The range of years to import, which should both be 0 to import all years
+
+  @param valueFilter
+    The ValueFilter of the rows to import, or nullptr to import every row
+
+  @param input
+    How the files are read (see InputOptions)
+
+  @return
+    The DatasetSnapshot of the import
+
+  @throws
+    std::runtime_error if the dataset cannot be imported
+*/
+DatasetSnapshot BethYw::importDataset(
+    Areas& imported,
+    const Areas& existing,
+    const std::string& path,
+    const InputFileSource& dataset,
+    const std::vector<std::string>& import,
+    std::unordered_set<std::string>& areasFilter,
+    std::unordered_set<std::string>& measuresFilter,
+    std::tuple<unsigned int,unsigned int>& yearsFilter,
+    const ValueFilter* valueFilter,
+    const InputOptions& input) {
+  if (!areasFilter.empty()) {
+    for (auto it = existing.cbegin(); it != existing.cend(); it++) {
+      std::string code = it->getLocalAuthorityCode();
+      Area area(code, imported.get_allocator());
+
+      const auto& names = it->getNames();
+      for (auto nameIt = names.cbegin(); nameIt != names.cend(); nameIt++) {
+        area.setName(nameIt->first, nameIt->second);
+      }
+
+      imported.setArea(code, std::move(area));
+    }
+  }
+
+  // A JSON dataset may continue in page files after the dataset file (see
+  // InputFilePages), which the caches alongside the file do not cover, and
+  // the standard input has no caches as it is not a file at all
+  const bool isJSON = dataset.PARSER == BethYw::SourceDataType::WelshStatsJSON;
+  const bool piped = path == STDIN_PATH;
+  const bool paged = isJSON && !piped && InputFilePages::isPaged(path);
+
+  // The fingerprint is taken first, so that if the file changes while we
+  // import it, the snapshot will not match the changed file. If the file
+  // cannot be fingerprinted, the parser will report why.
+  FileFingerprint fingerprint;
+  bool fingerprinted = !paged && !piped;
+  if (fingerprinted) {
+    try {
+      fingerprint = FileFingerprint::of(path);
+    } catch (const std::runtime_error& ex) {
+      fingerprinted = false;
+    }
+  }
+
+  // We may only need to parse some of the rows of a JSON file, although the
+  // rows of a compressed file (or the standard input) cannot be seeked to
+  const bool indexed =
+      isJSON &&
+      !paged &&
+      !piped &&
+      detectCompression(path) == Compression::None &&
+      (!areasFilter.empty() ||
+       !measuresFilter.empty() ||
+       (valueFilter != nullptr && !valueFilter->getRowMeasures().empty())) &&
+      loadIndexedDataset(imported,
+                         path,
+                         dataset,
+                         areasFilter,
+                         measuresFilter,
+                         yearsFilter,
+                         valueFilter);
+
+  if (paged) {
+    InputFilePages pages(path, input);
+    imported.populateFromWelshStatsJSONPages(pages,
+                                             dataset.COLS,
+                                             &areasFilter,
+                                             &measuresFilter,
+                                             &yearsFilter,
+                                             valueFilter);
+  } else if (!indexed) {
+    auto source = openDataFile(path, input);
+    imported.populate(source->open(),
+                      dataset.PARSER,
+                      dataset.COLS,
+                      &areasFilter,
+                      &measuresFilter,
+                      &yearsFilter,
+                      valueFilter);
+  }
+
+  DatasetSnapshot snapshot(imported, fingerprint, import);
+  if (fingerprinted) {
+    snapshot.save(path);
+  }
+
+  return snapshot;
+}
+
+/*
+  Check whether importing a dataset file could add anything to an Areas
+  instance, given the filters. The file's DatasetCatalog (see catalog.h)
+  lists its areas, measures and years, which we check against the filters in
+  the same way as the dataset's parser would check each row.
+
+  @param areas
+    The Areas instance the dataset would be imported into
+
+  @param path
+    The path to the dataset file
+
+  @param dataset
+    The InputFileSource for the dataset
+
+  @param areasFilter
+    An unordered set of areas to filter, or empty to import all areas
+
+  @param measuresFilter
+    An unordered set of measures to filter, or empty to import all measures
+
+  @param yearsFilter
+    The range of years to import, which should both be 0 to import all years
+
+  @param valueFilter
+    The ValueFilter of the rows to import, or nullptr to import every row
+
+  @return
+    false if the file definitely has nothing to import, or true if it may do
+    (or cannot be catalogued)
+*/
+bool BethYw::datasetMayContribute(
+    Areas& areas,
+    const std::string& path,
+    const InputFileSource& dataset,
+    std::unordered_set<std::string>& areasFilter,
+    std::unordered_set<std::string>& measuresFilter,
+    std::tuple<unsigned int,unsigned int>& yearsFilter,
+    const ValueFilter* valueFilter) {
+  const bool isJSON = dataset.PARSER == BethYw::SourceDataType::WelshStatsJSON;
+
+  // The catalog only covers the dataset file, not any pages after it, and is
+  // built from the raw contents of the file, so not for a compressed file
+  if ((isJSON && InputFilePages::isPaged(path)) ||
+      detectCompression(path) != Compression::None) {
+    return true;
+  }
+
+  DatasetCatalog catalog;
+  try {
+    catalog = DatasetCatalog::forFile(path, dataset);
+  } catch (const std::runtime_error& ex) {
+    // Leave it to the parser to report any problems with the file
+    return true;
+  }
+
+  if (!measuresFilter.empty() && !catalog.mayContainMeasures(measuresFilter)) {
+    return false;
+  }
+
+  // Both parsers skip the rows the value filter does not keep before
+  // creating the Area and Measure, and it can only keep rows of some measures
+  if (valueFilter != nullptr) {
+    const auto rowMeasures = valueFilter->getRowMeasures();
+    if (!rowMeasures.empty() && !catalog.mayContainMeasures(rowMeasures)) {
+      return false;
+    }
+  }
+
+  // Only the JSON parser skips the rows outside of the years filter before
+  // creating the Area and Measure, the CSV parser creates them regardless
+  if (isJSON &&
+      std::get<0>(yearsFilter) != 0 &&
+      std::get<1>(yearsFilter) != 0 &&
+      !catalog.mayContainYears(std::get<0>(yearsFilter),
+                               std::get<1>(yearsFilter))) {
+    return false;
+  }
+
+  if (areasFilter.empty()) {
+    return true;
+  }
+
+  // If every area is listed, we can apply the parser's own check to each
+  if (catalog.hasAreaList()) {
+    const auto& catalogAreas = catalog.getAreas();
+    for (auto it = catalogAreas.cbegin(); it != catalogAreas.cend(); it++) {
+      if (isJSON ? areas.isWelshStatsAreaIncluded(areasFilter,
+                                                  it->first,
+                                                  it->second)
+                 : !areas.isLocalAuthorityFiltered(areasFilter, it->first)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  if (catalog.mayMatchAreas(areasFilter)) {
+    return true;
+  }
+
+  // The parsers also match the filter against the names of existing Areas
+  for (auto it = areas.cbegin(); it != areas.cend(); it++) {
+    const auto& names = it->getNames();
+    for (auto nameIt = names.cbegin(); nameIt != names.cend(); nameIt++) {
+      if (areas.wildcardCountSet(areasFilter, nameIt->second) > 0 &&
+          catalog.mayContainArea(it->getLocalAuthorityCode())) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+/*
+  Load only the rows of a WelshStatsJSON dataset that may be imported given
+  the areas and measures filters. The file's RowIndex (see rowindex.h) groups
+  its rows by authority code, English area name, and measure code, so we
+  apply the same checks as Areas::populateFromWelshStatsJSON() to each group,
+  and read and parse only the rows of the groups that pass. The groups of
+  measures the value filter cannot keep are left out too, and the years and
+  value filters are applied as normal while parsing the rows.
+
+  @param areas
+    An Areas instance that should be modified (i.e. the dataset loaded into it)
+
+  @param path
+    The path to the dataset file
+
+  @param dataset
+    The InputFileSource for the dataset
+
+  @param areasFilter
+    An unordered set of areas to filter, or empty to import all areas
+
+  @param measuresFilter
+    An unordered set of measures to filter, or empty to import all measures
+
+  @param yearsFilter
+    The range of years to import, which should both be 0 to import all years
+
+  @param valueFilter
+    The ValueFilter of the rows to import, or nullptr to import every row
+
+  @return
+    true if the dataset was imported, or false (having imported nothing) if
+    the file could not be indexed
+
+  @throws
+    std::runtime_error if the selected rows cannot be imported
+*/
+bool BethYw::loadIndexedDataset(
+    Areas& areas,
+    const std::string& path,
+    const InputFileSource& dataset,
+    std::unordered_set<std::string>& areasFilter,
+    std::unordered_set<std::string>& measuresFilter,
+    std::tuple<unsigned int,unsigned int>& yearsFilter,
+    const ValueFilter* valueFilter) {
+  RowIndex index;
+  try {
+    index = RowIndex::forFile(path, dataset.COLS);
+  } catch (const std::runtime_error& ex) {
+    // Leave it to the full parse to report any problems with the file
+    return false;
+  }
+
+  const std::unordered_set<std::string> rowMeasures =
+      valueFilter != nullptr ? valueFilter->getRowMeasures()
+                             : std::unordered_set<std::string>();
+
+  const std::vector<RowRange> ranges = index.select(
+      [&](const RowGroup& group) {
+        if ((!measuresFilter.empty() || !rowMeasures.empty()) &&
+            !group.measure.empty()) {
+          std::string measureCode = group.measure;
+          std::transform(measureCode.begin(),
+                         measureCode.end(),
+                         measureCode.begin(),
+                         ::tolower);
+          if ((!measuresFilter.empty() &&
+               measuresFilter.count(measureCode) == 0) ||
+              (!rowMeasures.empty() && rowMeasures.count(measureCode) == 0)) {
+            return false;
+          }
+        }
+
+        return areasFilter.empty() ||
+               areas.isWelshStatsAreaIncluded(areasFilter,
+                                              group.code,
+                                              group.name);
+      });
+
+  // The ranges are byte offsets, so the file must be read in binary mode
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("InputFile::open: Failed to open file " + path);
+  }
+
+  std::istringstream rows(RowIndex::extract(file, ranges));
+  areas.populate(rows,
+                 dataset.PARSER,
+                 dataset.COLS,
+                 &areasFilter,
+                 &measuresFilter,
+                 &yearsFilter,
+                 valueFilter);
+
+  return true;
+}
+
+/*
+  Print the data to the standard output.
+
+  @param areas
+    The Areas instance to print
+
+  @param json
+    Whether to print the data as JSON instead of tables
+*/
+void BethYw::printAreas(const Areas& areas, bool json) {
+  if (json) {
+    // The output as JSON
+    std::cout << areas.toJSON() << std::endl;
+  } else {
+    // The output as tables
+    std::cout << areas << std::endl;
+  }
+}
+
+/*
+  Print the data to the standard output, as printAreas() does, but rendering
+  the areas as tasks on a TaskScheduler, a run of areas per task, and then
+  printing them in order, so the output is the same.
+
+  With one thread, this simply calls printAreas().
+
+  @param scheduler
+    The TaskScheduler to run the tasks on
+
+  @param areas
+    The Areas instance to print
+
+  @param json
+    Whether to print the data as JSON instead of tables
+*/
+void BethYw::printAreas(TaskScheduler& scheduler,
+                        const Areas& areas,
+                        bool json) {
+  if (scheduler.getThreads() == 1) {
+    printAreas(areas, json);
+    return;
+  }
+
+  // The order of the areas is found (and cached) before any task runs
+  std::vector<const Area*> ordered;
+  for (auto it = areas.cbegin(); it != areas.cend(); it++) {
+    ordered.push_back(&*it);
+  }
+
+  // A few runs per thread, so that the threads are kept busy even if some
+  // areas have much more data than others
+  const size_t tasks = std::min(ordered.size(),
+                                size_t(scheduler.getThreads()) *
+                                    PRINT_TASKS_PER_THREAD);
+  std::vector<std::string> rendered(ordered.size());
+  for (size_t task = 0; task < tasks; task++) {
+    const size_t begin = ordered.size() * task / tasks;
+    const size_t end = ordered.size() * (task + 1) / tasks;
+
+    scheduler.submit([&, begin, end]() {
+      for (size_t i = begin; i < end; i++) {
+        if (json) {
+          rendered[i] = areas.toJSON(*ordered[i]);
+        } else {
+          std::ostringstream os;
+          os << *ordered[i];
+          rendered[i] = os.str();
+        }
+      }
+    });
+  }
+  scheduler.wait();
+
+  if (json) {
+    std::string output = "{";
+    for (size_t i = 0; i < ordered.size(); i++) {
+      if (rendered[i].empty()) {
+        continue;
+      }
+
+      if (output.size() > 1) {
+        output += ",";
+      }
+      output += nlohmann::json(ordered[i]->getLocalAuthorityCode()).dump() +
+                ":" + rendered[i];
+    }
+    output += "}";
+
+    std::cout << output << std::endl;
+  } else {
+    for (auto it = rendered.cbegin(); it != rendered.cend(); it++) {
+      std::cout << *it;
+    }
+    std::cout << std::endl;
+  }
+}
+
+/*
+  Print how long the parsers spent waiting for the data files to be read
+  (see getReadAheadStats()) to the standard error, e.g.
+    I/O wait: 1.234ms (waited for 2 of 9 blocks)
+
+  The standard output is left for the data.
+*/
+void BethYw::printReadAheadStats() {
+  const ReadAheadStats stats = getReadAheadStats();
+  const double waitMs = std::chrono::duration<double, std::milli>(
+      stats.waitTime).count();
+
+  std::cerr << "I/O wait: " << std::fixed << std::setprecision(3) << waitMs
+            << "ms (waited for " << stats.waits << " of " << stats.blocks
+            << " blocks)" << std::endl;
+}
+
+/*
+  Print the throughput of each stage of the pipelines that parsed the data
+  files (see getIngestStats()) to the standard error, e.g.
+    Read:   12 blocks, 2.910MB in 1.234ms (2358.190MB/s), 3 stalls
+    Parse:  12 blocks, 48105 rows in 20.011ms (2403928 rows/s), 0 stalls
+    Insert: 12 blocks, 48105 rows in 9.870ms (4873860 rows/s), 7 stalls
+
+  A stall is a wait for the next stage to make room in its queue (or, for the
+  inserter, for the next batch to be parsed), so the stage with the fewest
+  stalls is the one holding up the others.
+*/
+void BethYw::printIngestStats() {
+  const IngestStats stats = getIngestStats();
+
+  const auto printStage = [](const std::string& label,
+                             const IngestStageStats& stage,
+                             bool bytes) {
+    const double ms = std::chrono::duration<double, std::milli>(
+        stage.busy).count();
+    const double amount = bytes ? stage.amount / (1024.0 * 1024.0)
+                                : static_cast<double>(stage.amount);
+    const double rate = ms > 0 ? amount / (ms / 1000.0) : 0;
+
+    std::cerr << std::left << std::setw(8) << label << std::right
+              << stage.blocks << " blocks, " << std::fixed;
+    if (bytes) {
+      std::cerr << std::setprecision(3) << amount << "MB in " << ms
+                << "ms (" << rate << "MB/s)";
+    } else {
+      std::cerr << stage.amount << " rows in " << std::setprecision(3) << ms
+                << "ms (" << std::setprecision(0) << rate << " rows/s)";
+    }
+    std::cerr << ", " << stage.stalls << " stalls" << std::endl;
+  };
+
+  std::cerr << "Ingest pipelines: " << stats.pipelines << std::endl;
+  printStage("Read:", stats.read, true);
+  printStage("Parse:", stats.parse, false);
+  printStage("Insert:", stats.insert, false);
+}
+
+/*
+  Print the number of rows the parsers left out, and the number of series
+  removed after loading, because the value filter (--where) did not keep
+  them, to the standard error. The rows of a dataset restored from its
+  snapshot are not parsed, so are not counted.
+
+  @param valueFilter
+    The ValueFilter that filtered the data
+*/
+void BethYw::printWhereStats(const ValueFilter& valueFilter) {
+  std::cerr << "Where " << valueFilter.getExpression() << ": "
+            << valueFilter.getRowsPruned() << " rows and "
+            << valueFilter.getSeriesPruned() << " series left out"
+            << std::endl;
+}
+
+/*
+  Find the names of the files in `dir` that a dataset may be read from, so
+  that a change to any of them can be noticed: its file, the copy of it
+  compressed with gzip that findDataFile() falls back to, and, for a
+  WelshStatsJSON dataset, the pages saved after the first (see
+  InputFilePages). As pages may be added, the name of the page after the
+  last is included too.
+
+  @param dir
+    The directory where the datasets are
+
+  @param source
+    The InputFileSource of the dataset
+
+  @return
+    The names of the files, within dir
+
+  @example
+    auto names = BethYw::dataFileNames("datasets/",
+                                       InputFiles::POPDEN);
+    // popu1009.json, popu1009.json.gz, popu1009.2.json, ...
+*/
+std::set<std::string> BethYw::dataFileNames(const std::string& dir,
+                                            const InputFileSource& source) {
+  std::set<std::string> names = {source.FILE, source.FILE + ".gz"};
+  if (source.PARSER != BethYw::SourceDataType::WelshStatsJSON) {
+    return names;
+  }
+
+  for (unsigned int page = 2; ; page++) {
+    const std::string name = InputFilePages::pagePath(source.FILE, page);
+    names.insert(name);
+
+    std::ifstream file(dir + name);
+    if (!file.is_open()) {
+      break;
+    }
+  }
+
+  return names;
+}
+
+/*
+  Reload the data after some of the files in `dir` have changed, replacing
+  the contents of areas.
+
+  The data is rebuilt in a new Areas instance: areas.csv is imported again,
+  and each dataset is restored from its snapshot in snapshots unless its file
+  has changed, in which case it is parsed again (or restored from the snapshot
+  saved alongside the file, if that matches). A dataset whose import depends
+  on the datasets before it (see DatasetSnapshot::describeImport()) is parsed
+  again if they have changed. The new data replaces areas once every dataset
+  has been imported, so if an exception is thrown, areas is left unchanged.
+
+  @param areas
+    The Areas instance to replace with the reloaded data
+
+  @param dir
+    The directory where the datasets are
+
+  @param datasetsToImport
+    A vector of InputFileSource objects
+
+  @param changedFiles
+    The names of the files in dir that have changed, which may be any of
+    those dataFileNames() gives for a dataset
+
+  @param snapshots
+    The DatasetSnapshots of the datasets, by dataset code, from the previous
+    load, which are updated
+
+  @param areasFilter
+    An unordered set of areas to filter, or empty to import all areas
+
+  @param measuresFilter
+    An unordered set of measures to filter, or empty to import all measures
+
+  @param yearsFilter
+    The range of years to import, which should both be 0 to import all years
+
+  @param memory
+    Where the new Areas instance allocates its data from
+
+  @param valueFilter
+    The ValueFilter of the rows and series to keep, or nullptr to keep them all
+
+  @param input
+    How the files are read (see InputOptions)
+
+  @return
+    The number of values added, changed or removed for each dataset whose
+    file changed, by dataset code
+
+  @throws
+    std::runtime_error if areas.csv or a dataset cannot be imported
+*/
+std::map<std::string, size_t> BethYw::reloadDatasets(
+    Areas& areas,
+    const std::string& dir,
+    std::vector<InputFileSource>& datasetsToImport,
+    const std::set<std::string>& changedFiles,
+    DatasetSnapshots& snapshots,
+    std::unordered_set<std::string>& areasFilter,
+    std::unordered_set<std::string>& measuresFilter,
+    std::tuple<unsigned int,unsigned int>& yearsFilter,
+    AreasMemory memory,
+    const ValueFilter* valueFilter,
+    const InputOptions& input) {
+  // Forget the snapshots of the changed datasets, keeping them to compare
+  DatasetSnapshots previous;
+  for (auto dataset = datasetsToImport.cbegin();
+       dataset != datasetsToImport.cend();
+       dataset++) {
+    const std::set<std::string> names = dataFileNames(dir, *dataset);
+    if (std::none_of(names.cbegin(),
+                     names.cend(),
+                     [&](const std::string& name) {
+                       return changedFiles.count(name) > 0;
+                     })) {
+      continue;
+    }
+
+    auto snapshotIt = snapshots.find(dataset->CODE);
+    if (snapshotIt != snapshots.end()) {
+      previous.insert_or_assign(dataset->CODE, std::move(snapshotIt->second));
+      snapshots.erase(snapshotIt);
+    } else {
+      previous.emplace(dataset->CODE, DatasetSnapshot());
+    }
+  }
+
+  Areas reloaded(memory);
+  reloaded.setIngestThreads(areas.getIngestThreads());
+
+  auto source = openDataFile(findDataFile(dir + InputFiles::AREAS.FILE),
+                             input);
+  reloaded.populate(source->open(),
+                    InputFiles::AREAS.PARSER,
+                    InputFiles::AREAS.COLS,
+                    &areasFilter);
+
+  loadDatasets(reloaded,
+               dir,
+               datasetsToImport,
+               areasFilter,
+               measuresFilter,
+               yearsFilter,
+               &snapshots,
+               valueFilter,
+               input);
+
+  if (valueFilter != nullptr) {
+    reloaded.pruneSeries(*valueFilter);
+  }
+
+  areas = std::move(reloaded);
+
+  std::map<std::string, size_t> changes;
+  for (auto it = previous.cbegin(); it != previous.cend(); it++) {
+    auto snapshotIt = snapshots.find(it->first);
+    changes[it->first] = snapshotIt == snapshots.end()
+        ? it->second.countChangedValues(DatasetSnapshot())
+        : it->second.countChangedValues(snapshotIt->second);
+  }
+
+  return changes;
+}
+
+/*
+  Import the datasets and print the data, and then keep running, watching
+  `dir` for changes to areas.csv or the files of the datasets, reloading the
+  data (see reloadDatasets()) and printing it again whenever they change.
+
+  Writes to the files are debounced by WATCH_DEBOUNCE_MS, and the time taken
+  to reload the data and the number of values changed in each dataset are
+  reported on the standard error. If the data cannot be reloaded, e.g.
+  because a file is only partly written, the error is reported and the
+  previous data is kept until the next change.
+
+  @param areas
+    An Areas instance with areas.csv imported into it
+
+  @param dir
+    The directory where the datasets are
+
+  @param datasetsToImport
+    A vector of InputFileSource objects
+
+  @param areasFilter
+    An unordered set of areas to filter, or empty to import all areas
+
+  @param measuresFilter
+    An unordered set of measures to filter, or empty to import all measures
+
+  @param yearsFilter
+    The range of years to import, which should both be 0 to import all years
+
+  @param memory
+    Where the Areas instances for reloaded data allocate their data from
+
+  @param json
+    Whether to print the data as JSON instead of tables
+
+  @param valueFilter
+    The ValueFilter of the rows and series to keep, or nullptr to keep them all
+
+  @param input
+    How the files are read (see InputOptions)
+
+  @return
+    Exit code, if the directory cannot be watched
+*/
+int BethYw::watchDatasets(
+    Areas& areas,
+    const std::string& dir,
+    std::vector<InputFileSource>& datasetsToImport,
+    std::unordered_set<std::string>& areasFilter,
+    std::unordered_set<std::string>& measuresFilter,
+    std::tuple<unsigned int,unsigned int>& yearsFilter,
+    AreasMemory memory,
+    bool json,
+    const ValueFilter* valueFilter,
+    const InputOptions& input) {
+  // inotify cannot see into a .zip file, so it would never report a change
+  if (InputArchive::isArchivePath(dir + InputFiles::AREAS.FILE)) {
+    std::cerr << "Cannot watch datasets within a .zip file: " << dir
+              << std::endl;
+    return 1;
+  }
+
+  // We start watching before the first import, so no change is missed
+  std::unique_ptr<DirectoryWatcher> watcher;
+  try {
+    watcher = std::make_unique<DirectoryWatcher>(dir);
+  } catch (const std::runtime_error& ex) {
+    std::cerr << ex.what() << std::endl;
+    return 1;
+  }
+
+  DatasetSnapshots snapshots;
+  try {
+    loadDatasets(areas,
+                 dir,
+                 datasetsToImport,
+                 areasFilter,
+                 measuresFilter,
+                 yearsFilter,
+                 &snapshots,
+                 valueFilter,
+                 input);
+  } catch (const std::runtime_error& ex) {
+    std::cerr << "Error importing dataset:\n" << ex.what() << std::endl;
+    return 1;
+  }
+
+  if (valueFilter != nullptr) {
+    areas.pruneSeries(*valueFilter);
+  }
+
+  printAreas(areas, json);
+
+  while (true) {
+    // The names are found again each time, as pages may have been added
+    std::set<std::string> files = dataFileNames(dir, InputFiles::AREAS);
+    for (auto dataset = datasetsToImport.cbegin();
+         dataset != datasetsToImport.cend();
+         dataset++) {
+      // A dataset piped in on the standard input is kept as it was first read
+      if (dataset->FILE != STDIN_PATH) {
+        const std::set<std::string> names = dataFileNames(dir, *dataset);
+        files.insert(names.cbegin(), names.cend());
+      }
+    }
+
+    std::set<std::string> changed;
+    try {
+      changed = watcher->wait(files, WATCH_DEBOUNCE_MS);
+    } catch (const std::runtime_error& ex) {
+      std::cerr << ex.what() << std::endl;
+      return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    std::map<std::string, size_t> changes;
+    try {
+      changes = reloadDatasets(areas,
+                               dir,
+                               datasetsToImport,
+                               changed,
+                               snapshots,
+                               areasFilter,
+                               measuresFilter,
+                               yearsFilter,
+                               memory,
+                               valueFilter,
+                               input);
+    } catch (const std::runtime_error& ex) {
+      std::cerr << "Error importing dataset:\n" << ex.what() << std::endl;
+      continue;
+    }
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+
+    std::cerr << "Reloaded";
+    for (const auto& file : changed) {
+      std::cerr << " " << file;
+    }
+    std::cerr << " in " << elapsed.count() << " ms" << std::endl;
+    for (auto it = changes.cbegin(); it != changes.cend(); it++) {
+      std::cerr << "  " << it->first << ": " << it->second
+                << " values changed" << std::endl;
+    }
+
+    printAreas(areas, json);
   }
 }
@@ -15,6 +15,9 @@
   functions you need to declare in this file.
  */
 
+#include <map>
+#include <memory>
+#include <set>
 #include <string>
 #include <tuple>
 #include <unordered_set>
@@ -24,6 +27,10 @@
 
 #include "datasets.h"
 #include "areas.h"
+#include "input.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include "valuefilter.h"
 
 /*
   OS-specific directory separator
@@ -42,6 +49,18 @@ namespace BethYw {
 */
 const std::string STUDENT_NUMBER = "987654";
 
+/*
+  How long, in milliseconds, the dataset files must be left unchanged in
+  watch mode before the data is reloaded.
+*/
+const unsigned int WATCH_DEBOUNCE_MS = 250;
+
+/*
+  How many tasks per thread the areas are split between when they are
+  rendered on a TaskScheduler.
+*/
+const unsigned int PRINT_TASKS_PER_THREAD = 4;
+
 /*
   Run Beth Yw?, parsing the command line arguments and acting upon them.
 */
@@ -58,6 +77,13 @@ cxxopts::Options cxxoptsSetup();
 */
 std::vector<InputFileSource> parseDatasetsArg(cxxopts::ParseResult& args);
 
+/*
+  Parse the format argument, which is the code of the dataset whose format a
+  dataset piped in on the standard input (given as the dataset '-') has, and
+  return an InputFileSource for the standard input in that format.
+*/
+InputFileSource parseFormatArg(cxxopts::ParseResult& args);
+
 /*
   Parse the areas argument and return a std::unordered_set of all the
   areas to import, or an empty set if all areas should be imported.
@@ -77,6 +103,33 @@ std::unordered_set<std::string> parseMeasuresArg(cxxopts::ParseResult& args);
 std::tuple<unsigned int, unsigned int> parseYearsArg(
     cxxopts::ParseResult& args);
 
+/*
+  Parse the where argument and return the ValueFilter it gives, which is
+  empty if no expression is given.
+*/
+ValueFilter parseWhereArg(cxxopts::ParseResult& args);
+
+/*
+  Parse the threads argument and return the number of threads to run on,
+  which must be at least 1.
+*/
+unsigned int parseThreadsArg(cxxopts::ParseResult& args);
+
+/*
+  Find a file in the data directory, or a gzip compressed copy of it with .gz
+  added to its name if only that exists.
+*/
+std::string findDataFile(const std::string& path);
+
+/*
+  Open a file in the data directory as an InputSource, which reads it from
+  within a .zip file if the data directory is one (see InputArchive), and
+  reads a file on disk as input gives.
+*/
+std::unique_ptr<InputSource> openDataFile(
+    const std::string& path,
+    const InputOptions& input = InputOptions());
+
 /*
   Load the areas.csv file from the directory `dir`. Parse the file and
   create the appropriate Area objects inside an Areas object.
@@ -84,7 +137,8 @@ std::tuple<unsigned int, unsigned int> parseYearsArg(
 void loadAreas(
     Areas& areas,
     const std::string& dir,
-    std::unordered_set<std::string>& filter);
+    std::unordered_set<std::string>& filter,
+    const InputOptions& input = InputOptions());
 
 /*
   Load the datasets in datasetsToImport into the Areas object from files
@@ -96,6 +150,10 @@ void loadAreas(
   yearsFilter should be two unsigned ints; if both 0 then import all years.
   Otherwise import only years within the range (inclusive) specified in the
   tuple.
+
+  If valueFilter is not nullptr, only import the rows its row predicate keeps.
+  The files are read as input gives, and parsed with as many threads as cat
+  is set to (see Areas::setIngestThreads()).
 */
 void loadDatasets(
     Areas& cat,
@@ -103,7 +161,201 @@ void loadDatasets(
     std::vector<InputFileSource>& datasetsToImport,
     std::unordered_set<std::string>& areasFilter,
     std::unordered_set<std::string>& measuresFilter,
-    std::tuple<unsigned int,unsigned int>& yearsFilter) noexcept;
+    std::tuple<unsigned int,unsigned int>& yearsFilter,
+    const ValueFilter* valueFilter = nullptr,
+    const InputOptions& input = InputOptions()) noexcept;
+
+/*
+  As above, but throwing a std::runtime_error if a dataset cannot be imported,
+  and restoring datasets from (and keeping their DatasetSnapshots in)
+  snapshots if it is not nullptr.
+*/
+void loadDatasets(
+    Areas& areas,
+    const std::string& dir,
+    std::vector<InputFileSource>& datasetsToImport,
+    std::unordered_set<std::string>& areasFilter,
+    std::unordered_set<std::string>& measuresFilter,
+    std::tuple<unsigned int,unsigned int>& yearsFilter,
+    DatasetSnapshots* snapshots,
+    const ValueFilter* valueFilter = nullptr,
+    const InputOptions& input = InputOptions());
+
+/*
+  Import one dataset into an Areas instance of its own (imported), to be
+  merged into areas. Returns false, having imported nothing, if the dataset
+  has nothing to import given the filters.
+*/
+bool loadDataset(
+    Areas& imported,
+    Areas& areas,
+    const std::string& dir,
+    const InputFileSource& dataset,
+    std::unordered_set<std::string>& areasFilter,
+    std::unordered_set<std::string>& measuresFilter,
+    std::tuple<unsigned int,unsigned int>& yearsFilter,
+    DatasetSnapshots* snapshots,
+    const ValueFilter* valueFilter = nullptr,
+    const InputOptions& input = InputOptions());
+
+/*
+  Load areas.csv and then the datasets into areas, as loadAreas() and
+  loadDatasets() do, as tasks on the scheduler, giving the same data. The
+  datasets are imported on other threads into Areas instances that allocate
+  as areas does (memory).
+*/
+void loadAreasAndDatasets(
+    TaskScheduler& scheduler,
+    Areas& areas,
+    const std::string& dir,
+    std::vector<InputFileSource>& datasetsToImport,
+    std::unordered_set<std::string>& areasFilter,
+    std::unordered_set<std::string>& measuresFilter,
+    std::tuple<unsigned int,unsigned int>& yearsFilter,
+    AreasMemory memory = AreasMemory::Arena,
+    const ValueFilter* valueFilter = nullptr,
+    const InputOptions& input = InputOptions()) noexcept;
+
+/*
+  Submit the reads of the dataset files that will be parsed in full to a
+  FileBatch (see batch.h), which reads them all at once with io_uring where it
+  is available.
+*/
+std::shared_ptr<FileBatch> batchDatasetFiles(
+    const std::string& dir,
+    const std::vector<InputFileSource>& datasetsToImport,
+    const std::unordered_set<std::string>& areasFilter,
+    const std::unordered_set<std::string>& measuresFilter);
+
+/*
+  Restore the data a dataset file contributed when it was last imported from
+  the DatasetSnapshot saved alongside it, if neither the file nor the import
+  (see DatasetSnapshot::describeImport()) have changed. Returns false, having
+  restored nothing, otherwise.
+*/
+bool restoreDataset(
+    Areas& areas,
+    const std::string& path,
+    const std::vector<std::string>& import,
+    DatasetSnapshot* restored = nullptr);
+
+/*
+  Import a dataset file into an Areas instance of its own (imported), to be
+  merged into existing, and save a DatasetSnapshot of it for next time,
+  which is returned.
+*/
+DatasetSnapshot importDataset(
+    Areas& imported,
+    const Areas& existing,
+    const std::string& path,
+    const InputFileSource& dataset,
+    const std::vector<std::string>& import,
+    std::unordered_set<std::string>& areasFilter,
+    std::unordered_set<std::string>& measuresFilter,
+    std::tuple<unsigned int,unsigned int>& yearsFilter,
+    const ValueFilter* valueFilter = nullptr,
+    const InputOptions& input = InputOptions());
+
+/*
+  Check, using the DatasetCatalog of a dataset file (which is built and cached
+  alongside the file if needed), whether importing the file could add anything
+  to areas given the filters. Returns true if the file cannot be catalogued.
+*/
+bool datasetMayContribute(
+    Areas& areas,
+    const std::string& path,
+    const InputFileSource& dataset,
+    std::unordered_set<std::string>& areasFilter,
+    std::unordered_set<std::string>& measuresFilter,
+    std::tuple<unsigned int,unsigned int>& yearsFilter,
+    const ValueFilter* valueFilter = nullptr);
+
+/*
+  Load only the rows of a WelshStatsJSON dataset that may match areasFilter
+  and measuresFilter, finding them with the file's RowIndex (which is built
+  and cached alongside the file if needed). Returns false, having imported
+  nothing, if the file cannot be indexed.
+*/
+bool loadIndexedDataset(
+    Areas& areas,
+    const std::string& path,
+    const InputFileSource& dataset,
+    std::unordered_set<std::string>& areasFilter,
+    std::unordered_set<std::string>& measuresFilter,
+    std::tuple<unsigned int,unsigned int>& yearsFilter,
+    const ValueFilter* valueFilter = nullptr);
+
+/*
+  Print the data to the standard output, as tables or as JSON.
+*/
+void printAreas(const Areas& areas, bool json);
+
+/*
+  As above, but rendering the areas as tasks on the scheduler.
+*/
+void printAreas(TaskScheduler& scheduler, const Areas& areas, bool json);
+
+/*
+  Print the time spent waiting for data files to be read ahead of the
+  parsers to the standard error.
+*/
+void printReadAheadStats();
+
+/*
+  Print the throughput of, and stalls in, each stage of the pipelines that
+  parsed the data files to the standard error.
+*/
+void printIngestStats();
+
+/*
+  Print the number of rows and series the value filter did not keep to the
+  standard error.
+*/
+void printWhereStats(const ValueFilter& valueFilter);
+
+/*
+  The names of the files in dir that a dataset may be read from: its file,
+  a gzip compressed copy of it, and (for a WelshStatsJSON dataset) its pages
+  after the first, up to the name the next page would be given.
+*/
+std::set<std::string> dataFileNames(const std::string& dir,
+                                    const InputFileSource& source);
+
+/*
+  Replace areas with the data reloaded after changedFiles (in dir) have
+  changed, parsing only the datasets whose files (or imports) have changed
+  and restoring the rest from snapshots. Returns the number of values changed
+  in each changed dataset.
+*/
+std::map<std::string, size_t> reloadDatasets(
+    Areas& areas,
+    const std::string& dir,
+    std::vector<InputFileSource>& datasetsToImport,
+    const std::set<std::string>& changedFiles,
+    DatasetSnapshots& snapshots,
+    std::unordered_set<std::string>& areasFilter,
+    std::unordered_set<std::string>& measuresFilter,
+    std::tuple<unsigned int,unsigned int>& yearsFilter,
+    AreasMemory memory,
+    const ValueFilter* valueFilter = nullptr,
+    const InputOptions& input = InputOptions());
+
+/*
+  Import the datasets into areas and print them, then watch dir and reload
+  and print the data whenever areas.csv or the dataset files change. Only
+  returns if the directory cannot be watched, e.g. because it is a .zip file.
+*/
+int watchDatasets(
+    Areas& areas,
+    const std::string& dir,
+    std::vector<InputFileSource>& datasetsToImport,
+    std::unordered_set<std::string>& areasFilter,
+    std::unordered_set<std::string>& measuresFilter,
+    std::tuple<unsigned int,unsigned int>& yearsFilter,
+    AreasMemory memory,
+    bool json,
+    const ValueFilter* valueFilter = nullptr,
+    const InputOptions& input = InputOptions());
 
 } // namespace BethYw
 
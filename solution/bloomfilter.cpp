@@ -0,0 +1,183 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the implementation of the BloomFilter class. See the
+  header file for additional comments.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bloomfilter.h"
+#include "fingerprint.h"
+
+/*
+  Derive the two base hashes for a string. The positions of its bits are
+  then h1 + i * h2 for each of the hash functions i (double hashing).
+*/
+static void baseHashes(const char* data,
+                       size_t length,
+                       uint64_t& h1,
+                       uint64_t& h2) noexcept {
+  h1 = FileFingerprint::hash(data, length);
+
+  h2 = h1;
+  h2 ^= h2 >> 33;
+  h2 *= 0xff51afd7ed558ccdULL;
+  h2 ^= h2 >> 33;
+  h2 |= 1;
+}
+
+/*
+  Construct an empty BloomFilter, which contains nothing.
+*/
+BloomFilter::BloomFilter() : mBits(), mHashes(0) {}
+
+/*
+  Construct a BloomFilter sized for a number of strings.
+
+  @param expectedItems
+    The number of strings that will be inserted
+
+  @param falsePositiveRate
+    The chance that mayContain() returns true for a string that was not
+    inserted, once expectedItems strings have been inserted
+*/
+BloomFilter::BloomFilter(size_t expectedItems, double falsePositiveRate)
+    : mBits(), mHashes(0) {
+  if (falsePositiveRate <= 0 || falsePositiveRate >= 1) {
+    throw std::invalid_argument("BloomFilter: False positive rate must be "
+                                "between 0 and 1");
+  }
+
+  const double ln2 = std::log(2.0);
+  const double items = std::max<size_t>(expectedItems, 1);
+  const double bits = std::ceil(-items * std::log(falsePositiveRate) /
+                                (ln2 * ln2));
+
+  mBits.assign(static_cast<size_t>(std::ceil(bits / 64)), 0);
+  mHashes = std::max(1u, static_cast<unsigned int>(
+      std::round(mBits.size() * 64 / items * ln2)));
+}
+
+/*
+  Construct a BloomFilter from its bits, e.g. when reading it back from a
+  cache.
+
+  @param bits
+    The bits of the filter
+
+  @param hashes
+    The number of hash functions
+*/
+BloomFilter::BloomFilter(std::vector<uint64_t> bits, unsigned int hashes)
+    : mBits(std::move(bits)), mHashes(hashes) {
+  if (mBits.empty() != (mHashes == 0)) {
+    throw std::invalid_argument("BloomFilter: Invalid bits or hashes");
+  }
+}
+
+/*
+  Insert a string into the filter.
+
+  @param data
+    The string
+
+  @param length
+    The length of the string
+*/
+void BloomFilter::insert(const char* data, size_t length) {
+  if (mBits.empty()) {
+    throw std::logic_error("BloomFilter::insert: Filter has no capacity");
+  }
+
+  uint64_t h1, h2;
+  baseHashes(data, length, h1, h2);
+
+  const uint64_t numBits = mBits.size() * 64;
+  for (unsigned int i = 0; i < mHashes; i++) {
+    const uint64_t bit = (h1 + i * h2) % numBits;
+    mBits[bit / 64] |= uint64_t(1) << (bit % 64);
+  }
+}
+
+void BloomFilter::insert(const std::string& str) {
+  insert(str.data(), str.size());
+}
+
+/*
+  Check whether a string may have been inserted into the filter.
+
+  @param data
+    The string
+
+  @param length
+    The length of the string
+
+  @return
+    false if the string was definitely not inserted
+*/
+bool BloomFilter::mayContain(const char* data, size_t length) const noexcept {
+  if (mBits.empty()) {
+    return false;
+  }
+
+  uint64_t h1, h2;
+  baseHashes(data, length, h1, h2);
+
+  const uint64_t numBits = mBits.size() * 64;
+  for (unsigned int i = 0; i < mHashes; i++) {
+    const uint64_t bit = (h1 + i * h2) % numBits;
+    if ((mBits[bit / 64] & (uint64_t(1) << (bit % 64))) == 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool BloomFilter::mayContain(const std::string& str) const noexcept {
+  return mayContain(str.data(), str.size());
+}
+
+/*
+  Whether this filter has no capacity (i.e. was default constructed).
+
+  @return
+    true if the filter has no bits
+*/
+bool BloomFilter::empty() const noexcept {
+  return mBits.empty();
+}
+
+/*
+  Retrieve the bits of the filter, e.g. to cache it.
+
+  @return
+    The bits
+*/
+const std::vector<uint64_t>& BloomFilter::getBits() const noexcept {
+  return mBits;
+}
+
+/*
+  Retrieve the number of hash functions of the filter.
+
+  @return
+    The number of hash functions
+*/
+unsigned int BloomFilter::getHashes() const noexcept {
+  return mHashes;
+}
@@ -0,0 +1,49 @@
+#ifndef BLOOMFILTER_H_
+#define BLOOMFILTER_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the BloomFilter class, a compact probabilistic set of
+  strings. A BloomFilter can tell us that a string is definitely not in the
+  set, or that it may be (with a small chance of a false positive).
+
+  A DatasetCatalog uses these to summarise the authority codes in a file
+  when there are too many to list.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class BloomFilter {
+protected:
+  std::vector<uint64_t> mBits;
+  unsigned int mHashes;
+
+public:
+  BloomFilter();
+  BloomFilter(size_t expectedItems, double falsePositiveRate = 0.01);
+  BloomFilter(std::vector<uint64_t> bits, unsigned int hashes);
+  ~BloomFilter() = default;
+
+  BloomFilter(const BloomFilter& other) = default;
+  BloomFilter& operator=(const BloomFilter& other) = default;
+  BloomFilter(BloomFilter&& other) = default;
+  BloomFilter& operator=(BloomFilter&& other) = default;
+
+  void insert(const char* data, size_t length);
+  void insert(const std::string& str);
+  bool mayContain(const char* data, size_t length) const noexcept;
+  bool mayContain(const std::string& str) const noexcept;
+
+  bool empty() const noexcept;
+  const std::vector<uint64_t>& getBits() const noexcept;
+  unsigned int getHashes() const noexcept;
+};
+
+#endif // BLOOMFILTER_H_
@@ -2,15 +2,17 @@
 
 BIN_DIR="bin"
 TESTS_DIR="tests"
-SOURCE_FILES="bethyw.cpp input.cpp areas.cpp area.cpp measure.cpp"
+BENCH_DIR="benchmarks"
+SOURCE_FILES="bethyw.cpp input.cpp areas.cpp area.cpp measure.cpp symbols.cpp authoritycode.cpp codeindex.cpp fingerprint.cpp rowindex.cpp bloomfilter.cpp catalog.cpp snapshot.cpp watch.cpp http.cpp archive.cpp readahead.cpp compressed.cpp batch.cpp pipeline.cpp scheduler.cpp cell.cpp projection.cpp structural.cpp valuefilter.cpp"
 MAIN_FILE="main.cpp"
 EXECUTABLE="./${BIN_DIR}/bethyw"
+CXXFLAGS=""
 
 set -x
 cd "${0%/*}"
 
 if [ $# -gt 1 ]; then
-  echo "Unknown arguments!" "Only one argument accepted, and must begin with test"
+  echo "Unknown arguments!" "Only one argument accepted, and must begin with test or bench"
   exit
 elif [ $# -eq 1 ]; then
   if [[ $1 == test* ]]; then
@@ -22,9 +24,19 @@ elif [ $# -eq 1 ]; then
     if [ ! -f ./${BIN_DIR}/catch.o ]; then
       g++ --std=c++11 -c ./lib_catch_main.cpp -o ./${BIN_DIR}/catch.o
     fi
+  elif [[ $1 == bench* ]]; then
+    SOURCE_FILES="${SOURCE_FILES} ./${BENCH_DIR}/$1.cpp"
+    MAIN_FILE="./${BIN_DIR}/catch-bench.o"
+    EXECUTABLE="./${BIN_DIR}/bethyw-bench"
+    CXXFLAGS="-O2 -DCATCH_CONFIG_ENABLE_BENCHMARKING"
+
+    # Benchmarks need a Catch2 built with benchmarking enabled
+    if [ ! -f ./${BIN_DIR}/catch-bench.o ]; then
+      g++ --std=c++11 ${CXXFLAGS} -c ./lib_catch_main.cpp -o ./${BIN_DIR}/catch-bench.o
+    fi
   fi
 fi
 
 mkdir -p ${BIN_DIR}
 rm ${EXECUTABLE} 2> /dev/null
-g++ --std=c++14 -pedantic -Wall  ${SOURCE_FILES} ${MAIN_FILE} -o ${EXECUTABLE}
\ No newline at end of file
+g++ --std=c++17 -pedantic -Wall ${CXXFLAGS} ${SOURCE_FILES} ${MAIN_FILE} -o ${EXECUTABLE} -lz
\ No newline at end of file
@@ -0,0 +1,587 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the implementation of the DatasetCatalog class. See the
+  header file for additional comments.
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lib_json.hpp"
+
+#include "areas.h"
+#include "bloomfilter.h"
+#include "cell.h"
+#include "catalog.h"
+#include "datasets.h"
+#include "fingerprint.h"
+
+/*
+  An alias for the imported JSON parsing library.
+*/
+using json = nlohmann::json;
+
+const unsigned int DatasetCatalog::VERSION;
+const size_t DatasetCatalog::MAX_LISTED_AREAS;
+const size_t DatasetCatalog::GRAM_LENGTH;
+
+/*
+  Retrieve a column name from a column mapping, or an empty string if the
+  dataset does not have the column.
+*/
+static std::string column(const BethYw::SourceColumnMapping& cols,
+                          BethYw::SourceColumn col) {
+  auto it = cols.find(col);
+  return it == cols.end() ? "" : it->second;
+}
+
+/*
+  Convert a string to lowercase, as the parsers do with measure codes.
+*/
+static std::string lowercase(std::string str) {
+  std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+  return str;
+}
+
+/*
+  Convert a string to uppercase, as Areas::wildcardCountSet() does when
+  matching the areas filter.
+*/
+static std::string uppercase(std::string str) {
+  std::transform(str.begin(), str.end(), str.begin(),
+                 [](unsigned char c) { return std::toupper(c); });
+  return str;
+}
+
+/*
+  Construct an empty DatasetCatalog, for a file with no rows.
+*/
+DatasetCatalog::DatasetCatalog()
+    : mFingerprint(),
+      mSource(),
+      mAreas(),
+      mNumAreas(0),
+      mCodes(),
+      mGrams(),
+      mMeasures(),
+      mMinYear(UINT_MAX),
+      mMaxYear(0) {}
+
+/*
+  Build a DatasetCatalog for the contents of a dataset file, reading the file
+  in the same way as the dataset's parser in Areas.
+
+  @param contents
+    The contents of the file
+
+  @param fingerprint
+    The fingerprint of the file
+
+  @param source
+    The InputFileSource for the dataset
+
+  @throws
+    std::runtime_error if the contents cannot be catalogued, e.g. they are
+    not valid, or the dataset's parser is not supported
+*/
+DatasetCatalog::DatasetCatalog(const std::string& contents,
+                               const FileFingerprint& fingerprint,
+                               const BethYw::InputFileSource& source)
+    : DatasetCatalog() {
+  mFingerprint = fingerprint;
+  mSource = describeSource(source);
+
+  const BethYw::SourceColumnMapping& cols = source.COLS;
+  std::set<std::string> measures;
+
+  try {
+    if (source.PARSER == BethYw::SourceDataType::WelshStatsJSON) {
+      const std::string codeCol = column(cols, BethYw::AUTH_CODE);
+      const std::string nameCol = column(cols, BethYw::AUTH_NAME_ENG);
+      const std::string measureCol = column(cols, BethYw::MEASURE_CODE);
+      const std::string yearCol = column(cols, BethYw::YEAR);
+      if (measureCol.empty()) {
+        measures.insert(lowercase(cols.at(BethYw::SINGLE_MEASURE_CODE)));
+      }
+
+      const json j = json::parse(contents);
+      for (const auto& row : j.at("value")) {
+        addArea(row.at(codeCol).get<std::string>(),
+                row.at(nameCol).get<std::string>());
+        if (!measureCol.empty()) {
+          measures.insert(lowercase(row.at(measureCol).get<std::string>()));
+        }
+
+        unsigned int year = 0;
+        const CellState state = decodeJSONYearCell(row.at(yearCol), year);
+        if (state == CellState::Invalid) {
+          throw std::runtime_error("Invalid year: " + row.at(yearCol).dump());
+        } else if (state == CellState::Value) {
+          mMinYear = std::min(mMinYear, year);
+          mMaxYear = std::max(mMaxYear, year);
+        }
+      }
+    } else if (source.PARSER == BethYw::SourceDataType::AuthorityByYearCSV) {
+      measures.insert(lowercase(cols.at(BethYw::SINGLE_MEASURE_CODE)));
+
+      std::istringstream is(contents);
+      std::string line, cell;
+      if (!std::getline(is, line)) {
+        throw std::runtime_error("File contains no data");
+      }
+
+      // Find the authority code column, and the years of the others
+      size_t codeIdx = std::string::npos;
+      std::istringstream header(line);
+      for (size_t i = 0; std::getline(header, cell, ','); i++) {
+        if (cell == cols.at(BethYw::AUTH_CODE)) {
+          codeIdx = i;
+        } else {
+          const unsigned int year = std::stoi(cell);
+          mMinYear = std::min(mMinYear, year);
+          mMaxYear = std::max(mMaxYear, year);
+        }
+      }
+
+      while (std::getline(is, line)) {
+        std::istringstream row(line);
+        for (size_t i = 0; std::getline(row, cell, ','); i++) {
+          if (i == codeIdx) {
+            addArea(cell, "");
+            break;
+          }
+        }
+      }
+    } else {
+      throw std::runtime_error("Unsupported parser");
+    }
+  } catch (const std::exception& ex) {
+    throw std::runtime_error("DatasetCatalog: Failed to catalog file: " +
+                             std::string(ex.what()));
+  }
+
+  mMeasures.assign(measures.begin(), measures.end());
+  summariseAreas();
+}
+
+/*
+  Add an area found in the file, which is listed until summariseAreas() is
+  called.
+
+  @param code
+    The local authority code of the area
+
+  @param name
+    The English name of the area, or an empty string if the file has none
+*/
+void DatasetCatalog::addArea(const std::string& code,
+                             const std::string& name) {
+  if (mAreas.empty() || mAreas.back().first != code ||
+      mAreas.back().second != name) {
+    mAreas.emplace_back(code, name);
+  }
+}
+
+/*
+  Sort and deduplicate the areas found in the file, and if there are too many
+  to list, replace them with BloomFilters.
+*/
+void DatasetCatalog::summariseAreas() {
+  std::sort(mAreas.begin(), mAreas.end());
+  mAreas.erase(std::unique(mAreas.begin(), mAreas.end()), mAreas.end());
+  mNumAreas = mAreas.size();
+
+  if (mNumAreas <= MAX_LISTED_AREAS) {
+    return;
+  }
+
+  std::vector<std::string> grams;
+  mCodes = BloomFilter(mNumAreas);
+  for (auto it = mAreas.cbegin(); it != mAreas.cend(); it++) {
+    mCodes.insert(it->first);
+
+    for (const std::string& str : {uppercase(it->first),
+                                   uppercase(it->second)}) {
+      for (size_t i = 0; i + GRAM_LENGTH <= str.size(); i++) {
+        grams.push_back(str.substr(i, GRAM_LENGTH));
+      }
+    }
+  }
+
+  std::sort(grams.begin(), grams.end());
+  grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+  mGrams = BloomFilter(grams.size());
+  for (auto it = grams.cbegin(); it != grams.cend(); it++) {
+    mGrams.insert(*it);
+  }
+
+  mAreas.clear();
+  mAreas.shrink_to_fit();
+}
+
+/*
+  Retrieve the DatasetCatalog for a dataset file. If there is a cached
+  catalog alongside the file for the same version of the file (and the same
+  dataset definition), it is used. Otherwise, the catalog is built and we try
+  to cache it; failing to write the cache is not an error.
+
+  @param path
+    The path to the dataset file
+
+  @param source
+    The InputFileSource for the dataset
+
+  @return
+    The DatasetCatalog for the file
+
+  @throws
+    std::runtime_error if the file cannot be read or catalogued
+
+  @example
+    DatasetCatalog catalog = DatasetCatalog::forFile(
+        "datasets/popu1009.json",
+        BethYw::InputFiles::DATASETS[0]);
+*/
+DatasetCatalog DatasetCatalog::forFile(const std::string& path,
+                                       const BethYw::InputFileSource& source) {
+  const std::string sidecar = sidecarPath(path);
+
+  std::string cached;
+  if (readFileContents(sidecar, cached)) {
+    try {
+      DatasetCatalog catalog = fromJSON(cached);
+      if (catalog.mSource == describeSource(source) &&
+          catalog.mFingerprint.matches(path, false)) {
+        return catalog;
+      }
+    } catch (const std::runtime_error& ex) {
+      // The cached catalog is corrupt, so we rebuild it
+    }
+  }
+
+  const FileFingerprint fingerprint = FileFingerprint::of(path);
+  std::string contents;
+  if (!readFileContents(path, contents)) {
+    throw std::runtime_error("DatasetCatalog::forFile: Failed to read " +
+                             path);
+  }
+
+  DatasetCatalog catalog(contents, fingerprint, source);
+  writeFileAtomically(sidecar, catalog.toJSON());
+
+  return catalog;
+}
+
+/*
+  Retrieve the path of the cached catalog for a dataset file.
+
+  @param path
+    The path to the dataset file
+
+  @return
+    The path of the cached catalog
+*/
+std::string DatasetCatalog::sidecarPath(const std::string& path) {
+  return path + ".cat";
+}
+
+/*
+  Describe the parts of a dataset definition that a catalog depends upon, so
+  that a cached catalog is rebuilt if they change.
+
+  @param source
+    The InputFileSource for the dataset
+
+  @return
+    The parser and the names of the relevant columns
+*/
+std::vector<std::string> DatasetCatalog::describeSource(
+    const BethYw::InputFileSource& source) {
+  return {std::to_string(static_cast<int>(source.PARSER)),
+          column(source.COLS, BethYw::AUTH_CODE),
+          column(source.COLS, BethYw::AUTH_NAME_ENG),
+          column(source.COLS, BethYw::MEASURE_CODE),
+          column(source.COLS, BethYw::SINGLE_MEASURE_CODE),
+          column(source.COLS, BethYw::YEAR)};
+}
+
+/*
+  Retrieve the fingerprint of the file this catalog was built from.
+
+  @return
+    The fingerprint
+*/
+const FileFingerprint& DatasetCatalog::getFingerprint() const noexcept {
+  return mFingerprint;
+}
+
+/*
+  Whether the areas in the file are listed, rather than summarised by
+  BloomFilters.
+
+  @return
+    true if getAreas() lists every area in the file
+*/
+bool DatasetCatalog::hasAreaList() const noexcept {
+  return mCodes.empty();
+}
+
+/*
+  Retrieve the distinct areas in the file, if hasAreaList() is true.
+
+  @return
+    Pairs of local authority code and English name (which is empty if the
+    file has no names), sorted
+*/
+const std::vector<std::pair<std::string, std::string>>&
+DatasetCatalog::getAreas() const noexcept {
+  return mAreas;
+}
+
+/*
+  Retrieve the number of distinct areas (pairs of local authority code and
+  English name) in the file.
+
+  @return
+    The number of areas
+*/
+size_t DatasetCatalog::getNumAreas() const noexcept {
+  return mNumAreas;
+}
+
+/*
+  Retrieve the distinct measure codes in the file.
+
+  @return
+    The lowercase measure codes, sorted
+*/
+const std::vector<std::string>& DatasetCatalog::getMeasures() const noexcept {
+  return mMeasures;
+}
+
+/*
+  Retrieve the earliest year in the file.
+
+  @return
+    The earliest year, or UINT_MAX if the file has no years
+*/
+unsigned int DatasetCatalog::getMinYear() const noexcept {
+  return mMinYear;
+}
+
+/*
+  Retrieve the latest year in the file.
+
+  @return
+    The latest year, or 0 if the file has no years
+*/
+unsigned int DatasetCatalog::getMaxYear() const noexcept {
+  return mMaxYear;
+}
+
+/*
+  Check whether the file may contain a local authority code.
+
+  @param code
+    The local authority code
+
+  @return
+    false if the file definitely does not contain the code
+*/
+bool DatasetCatalog::mayContainArea(const std::string& code) const noexcept {
+  if (!hasAreaList()) {
+    return mCodes.mayContain(code);
+  }
+
+  auto it = std::lower_bound(
+      mAreas.cbegin(), mAreas.cend(), code,
+      [](const std::pair<std::string, std::string>& area,
+         const std::string& code) {
+        return area.first < code;
+      });
+  return it != mAreas.cend() && it->first == code;
+}
+
+/*
+  Check whether the areas filter may match the local authority code or
+  English name of an area in the file. As with Areas::wildcardCountSet(),
+  a filter term matches if it is a (case-insensitive) substring.
+
+  This does not consider the Welsh names of existing Area objects, which the
+  parsers also match the areas filter against.
+
+  @param areasFilter
+    The areas filter
+
+  @return
+    false if no term in the filter matches an area in the file
+*/
+bool DatasetCatalog::mayMatchAreas(const StringFilterSet& areasFilter) const {
+  for (auto it = areasFilter.cbegin(); it != areasFilter.cend(); it++) {
+    const std::string term = uppercase(*it);
+
+    if (hasAreaList()) {
+      for (auto areaIt = mAreas.cbegin(); areaIt != mAreas.cend(); areaIt++) {
+        if (uppercase(areaIt->first).find(term) != std::string::npos ||
+            uppercase(areaIt->second).find(term) != std::string::npos) {
+          return true;
+        }
+      }
+      continue;
+    }
+
+    // A term shorter than a trigram could match anything
+    if (term.size() < GRAM_LENGTH) {
+      return true;
+    }
+
+    bool mayMatch = true;
+    for (size_t i = 0; mayMatch && i + GRAM_LENGTH <= term.size(); i++) {
+      mayMatch = mGrams.mayContain(term.data() + i, GRAM_LENGTH);
+    }
+    if (mayMatch) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*
+  Check whether the file contains any of the measures in a measures filter.
+
+  @param measuresFilter
+    The (lowercase) measure codes to import
+
+  @return
+    false if the file contains none of the measures
+*/
+bool DatasetCatalog::mayContainMeasures(
+    const StringFilterSet& measuresFilter) const {
+  for (auto it = mMeasures.cbegin(); it != mMeasures.cend(); it++) {
+    if (measuresFilter.count(*it) > 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*
+  Check whether the file has values in a range of years.
+
+  @param from
+    The first year of the range
+
+  @param to
+    The last year of the range (inclusive)
+
+  @return
+    false if the file has no years in the range
+*/
+bool DatasetCatalog::mayContainYears(unsigned int from,
+                                     unsigned int to) const noexcept {
+  return mMinYear <= to && from <= mMaxYear;
+}
+
+/*
+  Serialise the catalog, e.g. to cache it.
+
+  @return
+    The catalog as a JSON document
+*/
+std::string DatasetCatalog::toJSON() const {
+  json j = {
+    {"version", VERSION},
+    {"size", mFingerprint.getSize()},
+    {"modified", mFingerprint.getModified()},
+    {"hash", mFingerprint.getHash()},
+    {"source", mSource},
+    {"numAreas", mNumAreas},
+    {"measures", mMeasures},
+    {"minYear", mMinYear},
+    {"maxYear", mMaxYear}
+  };
+
+  if (hasAreaList()) {
+    j["areas"] = mAreas;
+  } else {
+    j["codes"] = {{"bits", mCodes.getBits()}, {"hashes", mCodes.getHashes()}};
+    j["grams"] = {{"bits", mGrams.getBits()}, {"hashes", mGrams.getHashes()}};
+  }
+
+  return j.dump();
+}
+
+/*
+  Deserialise a catalog written by toJSON().
+
+  @param str
+    The catalog as a JSON document
+
+  @return
+    The catalog
+
+  @throws
+    std::runtime_error if the document is not a valid catalog
+*/
+DatasetCatalog DatasetCatalog::fromJSON(const std::string& str) {
+  DatasetCatalog catalog;
+  try {
+    const json j = json::parse(str);
+    if (j.at("version").get<unsigned int>() != VERSION) {
+      throw std::runtime_error("DatasetCatalog::fromJSON: "
+                               "Unsupported version");
+    }
+
+    catalog.mFingerprint = FileFingerprint(j.at("size").get<uint64_t>(),
+                                           j.at("modified").get<int64_t>(),
+                                           j.at("hash").get<uint64_t>());
+    catalog.mSource = j.at("source").get<std::vector<std::string>>();
+    catalog.mNumAreas = j.at("numAreas").get<size_t>();
+    catalog.mMeasures = j.at("measures").get<std::vector<std::string>>();
+    catalog.mMinYear = j.at("minYear").get<unsigned int>();
+    catalog.mMaxYear = j.at("maxYear").get<unsigned int>();
+
+    if (j.contains("areas")) {
+      catalog.mAreas = j.at("areas")
+          .get<std::vector<std::pair<std::string, std::string>>>();
+      if (catalog.mAreas.size() != catalog.mNumAreas) {
+        throw std::runtime_error("DatasetCatalog::fromJSON: Invalid areas");
+      }
+    } else {
+      catalog.mCodes = BloomFilter(
+          j.at("codes").at("bits").get<std::vector<uint64_t>>(),
+          j.at("codes").at("hashes").get<unsigned int>());
+      catalog.mGrams = BloomFilter(
+          j.at("grams").at("bits").get<std::vector<uint64_t>>(),
+          j.at("grams").at("hashes").get<unsigned int>());
+      if (catalog.mCodes.empty()) {
+        throw std::runtime_error("DatasetCatalog::fromJSON: Invalid codes");
+      }
+    }
+  } catch (const json::exception& ex) {
+    throw std::runtime_error("DatasetCatalog::fromJSON: Invalid catalog: " +
+                             std::string(ex.what()));
+  } catch (const std::invalid_argument& ex) {
+    throw std::runtime_error("DatasetCatalog::fromJSON: Invalid catalog: " +
+                             std::string(ex.what()));
+  }
+
+  return catalog;
+}
@@ -0,0 +1,96 @@
+#ifndef CATALOG_H_
+#define CATALOG_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the DatasetCatalog class, a summary of the contents of a
+  dataset file: its distinct local authority codes (with their English names,
+  where the file has them), its distinct measure codes, and the range of years
+  it has values for.
+
+  BethYw::loadDatasets() consults the catalog of each file before opening it,
+  and skips files that cannot contribute anything given the areas, measures,
+  and years filters. Building a catalog requires parsing the file, so like a
+  RowIndex it is cached alongside the file with the file's FileFingerprint.
+  Only the size and modification time of the file are checked before using
+  a cached catalog, so that skipping a file does not require opening it.
+
+  A file with more than MAX_LISTED_AREAS areas is summarised by two
+  BloomFilters instead: one of the authority codes, and one of the
+  (uppercase) trigrams of the authority codes and English names. As the
+  areas filter matches substrings, a filter term can only match an area in
+  the file if all of its trigrams may be in the file.
+ */
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "areas.h"
+#include "bloomfilter.h"
+#include "datasets.h"
+#include "fingerprint.h"
+
+class DatasetCatalog {
+protected:
+  FileFingerprint mFingerprint;
+  std::vector<std::string> mSource;
+
+  std::vector<std::pair<std::string, std::string>> mAreas;
+  size_t mNumAreas;
+  BloomFilter mCodes;
+  BloomFilter mGrams;
+
+  std::vector<std::string> mMeasures;
+  unsigned int mMinYear;
+  unsigned int mMaxYear;
+
+  void addArea(const std::string& code, const std::string& name);
+  void summariseAreas();
+
+public:
+  static const unsigned int VERSION = 1;
+  static const size_t MAX_LISTED_AREAS = 256;
+  static const size_t GRAM_LENGTH = 3;
+
+  DatasetCatalog();
+  DatasetCatalog(const std::string& contents,
+                 const FileFingerprint& fingerprint,
+                 const BethYw::InputFileSource& source);
+  ~DatasetCatalog() = default;
+
+  DatasetCatalog(const DatasetCatalog& other) = default;
+  DatasetCatalog& operator=(const DatasetCatalog& other) = default;
+  DatasetCatalog(DatasetCatalog&& other) = default;
+  DatasetCatalog& operator=(DatasetCatalog&& other) = default;
+
+  static DatasetCatalog forFile(const std::string& path,
+                                const BethYw::InputFileSource& source);
+  static std::string sidecarPath(const std::string& path);
+  static std::vector<std::string> describeSource(
+      const BethYw::InputFileSource& source);
+
+  const FileFingerprint& getFingerprint() const noexcept;
+  bool hasAreaList() const noexcept;
+  const std::vector<std::pair<std::string, std::string>>& getAreas()
+      const noexcept;
+  size_t getNumAreas() const noexcept;
+  const std::vector<std::string>& getMeasures() const noexcept;
+  unsigned int getMinYear() const noexcept;
+  unsigned int getMaxYear() const noexcept;
+
+  bool mayContainArea(const std::string& code) const noexcept;
+  bool mayMatchAreas(const StringFilterSet& areasFilter) const;
+  bool mayContainMeasures(const StringFilterSet& measuresFilter) const;
+  bool mayContainYears(unsigned int from, unsigned int to) const noexcept;
+
+  std::string toJSON() const;
+  static DatasetCatalog fromJSON(const std::string& str);
+};
+
+#endif // CATALOG_H_
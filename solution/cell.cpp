@@ -0,0 +1,220 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the implementation of the functions that decode the
+  cells of a data file. See the header file for additional comments.
+*/
+
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "lib_json.hpp"
+
+#include "cell.h"
+
+/*
+  Remove any spaces around the text of a cell.
+*/
+static std::string_view trimCell(std::string_view text) noexcept {
+  const char* whitespace = " \t\r\n";
+  const size_t first = text.find_first_not_of(whitespace);
+  if (first == std::string_view::npos) {
+    return std::string_view();
+  }
+
+  const size_t last = text.find_last_not_of(whitespace);
+  return text.substr(first, last - first + 1);
+}
+
+/*
+  @return
+    true if the (trimmed) text of a cell says that its data is missing
+*/
+static bool isMissingCell(std::string_view text) noexcept {
+  return text.empty() || text == "." || text == "..";
+}
+
+/*
+  Decode the text of a cell as a number, e.g. a value in a data file. The
+  whole cell must be the number, other than spaces around it.
+
+  @param text
+    The text of the cell
+
+  @param value
+    Set to the number, if the cell is one
+
+  @return
+    CellState::Value if the cell is a number, CellState::Missing if it is
+    empty or a placeholder (. or ..), or otherwise CellState::Invalid
+
+  @example
+    double value;
+    if (decodeValueCell("12.5", value) == CellState::Value) { ... }
+*/
+CellState decodeValueCell(std::string_view text, double& value) noexcept {
+  text = trimCell(text);
+  if (isMissingCell(text)) {
+    return CellState::Missing;
+  }
+
+  // std::from_chars, unlike std::stod, does not accept a leading plus
+  if (text.front() == '+' && text.size() > 1 && text[1] != '-') {
+    text.remove_prefix(1);
+  }
+
+  const char* last = text.data() + text.size();
+  const auto result = std::from_chars(text.data(), last, value);
+  if (result.ec != std::errc() || result.ptr != last) {
+    return CellState::Invalid;
+  }
+
+  return CellState::Value;
+}
+
+/*
+  Decode the text of a cell as a year. The whole cell must be the year, other
+  than spaces around it.
+
+  @param text
+    The text of the cell
+
+  @param year
+    Set to the year, if the cell is one
+
+  @return
+    CellState::Value if the cell is a year, CellState::Missing if it is
+    empty or a placeholder (. or ..), or otherwise CellState::Invalid
+
+  @example
+    unsigned int year;
+    if (decodeYearCell("1991", year) == CellState::Value) { ... }
+*/
+CellState decodeYearCell(std::string_view text, unsigned int& year) noexcept {
+  text = trimCell(text);
+  if (isMissingCell(text)) {
+    return CellState::Missing;
+  }
+
+  const char* last = text.data() + text.size();
+  const auto result = std::from_chars(text.data(), last, year);
+  if (result.ec != std::errc() || result.ptr != last) {
+    return CellState::Invalid;
+  }
+
+  return CellState::Value;
+}
+
+/*
+  Decode a cell of a JSON data file as a number, whether it is a JSON number
+  or a number quoted as a string.
+
+  @param cell
+    The cell
+
+  @param value
+    Set to the number, if the cell is one
+
+  @return
+    CellState::Value if the cell is a number, CellState::Missing if it is
+    null, empty, or a placeholder (. or ..), or otherwise CellState::Invalid
+
+  @example
+    double value;
+    if (decodeJSONValueCell(row["Data"], value) == CellState::Value) { ... }
+*/
+CellState decodeJSONValueCell(const nlohmann::json& cell,
+                              double& value) noexcept {
+  switch (cell.type()) {
+    case nlohmann::json::value_t::number_float:
+      value = *cell.get_ptr<const nlohmann::json::number_float_t*>();
+      return CellState::Value;
+
+    case nlohmann::json::value_t::number_integer:
+      value = static_cast<double>(
+          *cell.get_ptr<const nlohmann::json::number_integer_t*>());
+      return CellState::Value;
+
+    case nlohmann::json::value_t::number_unsigned:
+      value = static_cast<double>(
+          *cell.get_ptr<const nlohmann::json::number_unsigned_t*>());
+      return CellState::Value;
+
+    case nlohmann::json::value_t::string:
+      return decodeValueCell(
+          std::string_view(*cell.get_ptr<const nlohmann::json::string_t*>()),
+          value);
+
+    case nlohmann::json::value_t::null:
+      return CellState::Missing;
+
+    default:
+      return CellState::Invalid;
+  }
+}
+
+/*
+  Decode a cell of a JSON data file as a year, whether it is a JSON number or
+  a number quoted as a string.
+
+  Unlike a value, a year that is null (e.g. because the row has no such key)
+  is invalid, as it means the file does not have the columns expected of it.
+
+  @param cell
+    The cell
+
+  @param year
+    Set to the year, if the cell is one
+
+  @return
+    CellState::Value if the cell is a year, CellState::Missing if it is an
+    empty string or a placeholder (. or ..), or otherwise CellState::Invalid
+
+  @example
+    unsigned int year;
+    if (decodeJSONYearCell(row["Year_Code"], year) == CellState::Value) {
+      ...
+    }
+*/
+CellState decodeJSONYearCell(const nlohmann::json& cell,
+                             unsigned int& year) noexcept {
+  switch (cell.type()) {
+    case nlohmann::json::value_t::number_unsigned: {
+      const auto number =
+          *cell.get_ptr<const nlohmann::json::number_unsigned_t*>();
+      if (number > UINT32_MAX) {
+        return CellState::Invalid;
+      }
+      year = static_cast<unsigned int>(number);
+      return CellState::Value;
+    }
+
+    case nlohmann::json::value_t::number_integer: {
+      const auto number =
+          *cell.get_ptr<const nlohmann::json::number_integer_t*>();
+      if (number < 0 || number > UINT32_MAX) {
+        return CellState::Invalid;
+      }
+      year = static_cast<unsigned int>(number);
+      return CellState::Value;
+    }
+
+    case nlohmann::json::value_t::string:
+      return decodeYearCell(
+          std::string_view(*cell.get_ptr<const nlohmann::json::string_t*>()),
+          year);
+
+    default:
+      return CellState::Invalid;
+  }
+}
@@ -0,0 +1,48 @@
+#ifndef CELL_H_
+#define CELL_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the functions that decode the cells of a data file (a
+  value or a year) as numbers, without throwing exceptions.
+
+  StatsWales mixes JSON numbers with numbers quoted as strings (one dataset
+  quotes every value), and marks data that is missing with "." (not
+  applicable) or ".." (not available). Each is decoded directly with
+  std::from_chars, rather than by catching the nlohmann::json type_error of
+  the wrong type and retrying with std::stod, and a missing cell is reported
+  as such so the parsers can leave it out rather than fail.
+ */
+
+#include <string_view>
+
+#include "lib_json.hpp"
+
+/*
+  What a cell was decoded as.
+*/
+enum class CellState {
+  // A number, which has been decoded
+  Value,
+
+  // Empty, null, or a placeholder for data that is missing
+  Missing,
+
+  // Anything else
+  Invalid
+};
+
+CellState decodeValueCell(std::string_view text, double& value) noexcept;
+CellState decodeYearCell(std::string_view text, unsigned int& year) noexcept;
+
+CellState decodeJSONValueCell(const nlohmann::json& cell,
+                              double& value) noexcept;
+CellState decodeJSONYearCell(const nlohmann::json& cell,
+                             unsigned int& year) noexcept;
+
+#endif // CELL_H_
@@ -0,0 +1,189 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the implementation of the CodeIndex class. See the
+  header file for additional comments.
+*/
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+#include "authoritycode.h"
+#include "codeindex.h"
+
+constexpr uint32_t CodeIndex::EMPTY;
+constexpr size_t CodeIndex::MIN_CAPACITY;
+constexpr size_t CodeIndex::NPOS;
+
+/*
+  Construct an empty CodeIndex. No memory is allocated until the first insert.
+
+  @param resource
+    The memory resource to allocate the keys and slots from
+*/
+CodeIndex::CodeIndex(std::pmr::memory_resource* resource)
+    : mKeys(resource), mSlots(resource), mMask(0) {}
+
+/*
+  Find the position of a code.
+
+  @param code
+    The AuthorityCode to find
+
+  @return
+    The position given to code when it was inserted, or CodeIndex::NPOS
+*/
+size_t CodeIndex::find(const AuthorityCode& code) const noexcept {
+  if (mSlots.empty()) {
+    return NPOS;
+  }
+
+  const size_t hash = std::hash<AuthorityCode>()(code);
+  for (size_t i = hash & mMask; ; i = (i + 1) & mMask) {
+    const Slot& slot = mSlots[i];
+    if (slot.pos == EMPTY) {
+      return NPOS;
+    } else if (slot.hash == hash && mKeys[slot.pos] == code) {
+      return slot.pos;
+    }
+  }
+}
+
+/*
+  Insert a code, giving it the next position if it is not already indexed.
+
+  @param code
+    The AuthorityCode to insert
+
+  @return
+    A pair of the position of code, and whether it was newly inserted
+*/
+std::pair<size_t, bool> CodeIndex::insert(const AuthorityCode& code) {
+  // Keep the load factor at or below a half so probe sequences stay short
+  if ((mKeys.size() + 1) * 2 > mSlots.size()) {
+    rehash(std::max(MIN_CAPACITY, mSlots.size() * 2));
+  }
+
+  const size_t hash = std::hash<AuthorityCode>()(code);
+  size_t i = hash & mMask;
+  for (; mSlots[i].pos != EMPTY; i = (i + 1) & mMask) {
+    const Slot& slot = mSlots[i];
+    if (slot.hash == hash && mKeys[slot.pos] == code) {
+      return std::make_pair(static_cast<size_t>(slot.pos), false);
+    }
+  }
+
+  const size_t pos = mKeys.size();
+  mKeys.push_back(code);
+  mSlots[i] = Slot{hash, static_cast<uint32_t>(pos)};
+
+  return std::make_pair(pos, true);
+}
+
+/*
+  Retrieve the code given a position.
+
+  @param pos
+    The position of the code
+
+  @return
+    The AuthorityCode at pos
+
+  @throws
+    std::out_of_range if there is no code with the given position
+*/
+const AuthorityCode& CodeIndex::key(size_t pos) const {
+  return mKeys.at(pos);
+}
+
+/*
+  Retrieve all the indexed codes, in the order of their positions.
+
+  @return
+    The indexed codes
+*/
+const std::pmr::vector<AuthorityCode>& CodeIndex::keys() const noexcept {
+  return mKeys;
+}
+
+/*
+  Retrieve the number of indexed codes.
+
+  @return
+    The number of codes
+*/
+size_t CodeIndex::size() const noexcept {
+  return mKeys.size();
+}
+
+/*
+  Make room for at least size codes without further rehashing.
+
+  @param size
+    The number of codes to make room for
+*/
+void CodeIndex::reserve(size_t size) {
+  mKeys.reserve(size);
+
+  size_t capacity = MIN_CAPACITY;
+  while (capacity < size * 2) {
+    capacity *= 2;
+  }
+
+  if (capacity > mSlots.size()) {
+    rehash(capacity);
+  }
+}
+
+/*
+  Remove all the codes from the index.
+*/
+void CodeIndex::clear() noexcept {
+  mKeys.clear();
+  mSlots.clear();
+  mMask = 0;
+}
+
+/*
+  Rebuild the slots with a new capacity, which must be a power of two larger
+  than twice the number of keys.
+
+  @param capacity
+    The new number of slots
+*/
+void CodeIndex::rehash(size_t capacity) {
+  if (capacity > static_cast<size_t>(EMPTY)) {
+    throw std::length_error("CodeIndex::rehash: Too many codes to index");
+  }
+
+  std::pmr::vector<Slot> slots(capacity,
+                               Slot{0, EMPTY},
+                               mSlots.get_allocator());
+  const size_t mask = capacity - 1;
+
+  for (const Slot& slot : mSlots) {
+    if (slot.pos == EMPTY) {
+      continue;
+    }
+
+    size_t i = slot.hash & mask;
+    while (slots[i].pos != EMPTY) {
+      i = (i + 1) & mask;
+    }
+    slots[i] = slot;
+  }
+
+  mSlots = std::move(slots);
+  mMask = mask;
+}
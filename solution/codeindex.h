@@ -0,0 +1,72 @@
+#ifndef CODEINDEX_H_
+#define CODEINDEX_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the CodeIndex class, a flat (open-addressing) hash index
+  from AuthorityCode to a position in a dense container.
+
+  Areas uses this to find the position of an Area in its std::vector of Area
+  objects. Keys are given positions in the order they are inserted, so the
+  index never has to move the Area objects themselves, and a lookup is a hash
+  and (usually) a single integer comparison in a contiguous array.
+
+  The keys and slots are allocated from the memory resource given on
+  construction.
+ */
+
+#include <cstdint>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+#include "authoritycode.h"
+
+class CodeIndex {
+protected:
+  /*
+    Each slot stores the hash of its key, so that most mismatches can be
+    rejected without comparing the keys themselves.
+  */
+  struct Slot {
+    size_t hash;
+    uint32_t pos;
+  };
+
+  static constexpr uint32_t EMPTY = static_cast<uint32_t>(-1);
+  static constexpr size_t MIN_CAPACITY = 32;
+
+  std::pmr::vector<AuthorityCode> mKeys;
+  std::pmr::vector<Slot> mSlots;
+  size_t mMask;
+
+  void rehash(size_t capacity);
+
+public:
+  static constexpr size_t NPOS = static_cast<size_t>(-1);
+
+  explicit CodeIndex(
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+  ~CodeIndex() = default;
+
+  CodeIndex(const CodeIndex& other) = default;
+  CodeIndex& operator=(const CodeIndex& other) = default;
+  CodeIndex(CodeIndex&& other) = default;
+  CodeIndex& operator=(CodeIndex&& other) = default;
+
+  size_t find(const AuthorityCode& code) const noexcept;
+  std::pair<size_t, bool> insert(const AuthorityCode& code);
+  const AuthorityCode& key(size_t pos) const;
+  const std::pmr::vector<AuthorityCode>& keys() const noexcept;
+
+  size_t size() const noexcept;
+  void reserve(size_t size);
+  void clear() noexcept;
+};
+
+#endif // CODEINDEX_H_
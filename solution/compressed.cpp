@@ -0,0 +1,160 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the implementation of detectCompression() and the
+  GzipReader class. See the header file for additional comments.
+*/
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include <zlib.h>
+
+#include "compressed.h"
+
+/*
+  The size of the blocks of compressed data read from a file.
+*/
+const size_t COMPRESSED_BLOCK_SIZE = 64 * 1024;
+
+/*
+  Detect the compression of a file from the magic number at its start.
+
+  @param path
+    The path to the file
+
+  @return
+    The compression, or Compression::None if the file is not compressed (or
+    cannot be read, which is left to the caller to report)
+
+  @example
+    if (detectCompression("datasets/popu1009.json.gz") == Compression::Gzip) {
+      ...
+    }
+*/
+Compression detectCompression(const std::string& path) noexcept {
+  std::ifstream file(path, std::ios::binary);
+  unsigned char magic[4] = {0, 0, 0, 0};
+  file.read(reinterpret_cast<char*>(magic), sizeof(magic));
+
+  if (file.gcount() >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+    return Compression::Gzip;
+  } else if (file.gcount() == 4 && magic[0] == 0x28 && magic[1] == 0xb5 &&
+             magic[2] == 0x2f && magic[3] == 0xfd) {
+    return Compression::Zstd;
+  }
+
+  return Compression::None;
+}
+
+/*
+  Constructor for a reader of a gzip file.
+
+  @param path
+    The path to the file
+
+  @throws
+    std::runtime_error if the file cannot be opened
+
+  @example
+    ReadAheadBuffer buffer(std::make_unique<GzipReader>("popu1009.json.gz"),
+                           64 * 1024,
+                           4);
+*/
+GzipReader::GzipReader(const std::string& path)
+    : mPath(path),
+      mFile(path, std::ios::binary),
+      mZ(),
+      mIn(COMPRESSED_BLOCK_SIZE),
+      mEnded(false) {
+  if (!mFile.is_open()) {
+    throw std::runtime_error("GzipReader: Failed to open file " + path);
+  }
+
+  // 16 added to the window bits means a gzip header and trailer
+  if (inflateInit2(&mZ, MAX_WBITS + 16) != Z_OK) {
+    throw std::runtime_error("GzipReader: Failed to start inflating " + path);
+  }
+}
+
+GzipReader::~GzipReader() {
+  inflateEnd(&mZ);
+}
+
+/*
+  Inflate the next block of the file. zlib checks the CRC-32 and length in
+  the trailer of each gzip member.
+
+  @param data
+    The buffer to inflate into
+
+  @param size
+    The size of the buffer
+
+  @return
+    The number of bytes inflated, which is 0 only at the end of the file
+
+  @throws
+    std::runtime_error if the file cannot be read, or is corrupt or truncated
+*/
+size_t GzipReader::read(char* data, size_t size) {
+  mZ.next_out = reinterpret_cast<Bytef*>(data);
+  mZ.avail_out = static_cast<uInt>(size);
+
+  while (mZ.avail_out > 0 && !mEnded) {
+    if (mZ.avail_in == 0) {
+      mFile.read(mIn.data(), mIn.size());
+      if (mFile.bad()) {
+        throw std::runtime_error("GzipReader: Failed to read " + mPath);
+      }
+      mZ.next_in = reinterpret_cast<Bytef*>(mIn.data());
+      mZ.avail_in = static_cast<uInt>(mFile.gcount());
+    }
+
+    if (mZ.avail_in == 0) {
+      // The file ended part way through a member
+      throw std::runtime_error("GzipReader: Truncated file " + mPath);
+    }
+
+    const int status = inflate(&mZ, Z_NO_FLUSH);
+    if (status == Z_STREAM_END) {
+      // Another member may follow this one
+      if (mZ.avail_in == 0 &&
+          mFile.peek() == std::ifstream::traits_type::eof()) {
+        mEnded = true;
+      } else {
+        inflateReset(&mZ);
+      }
+    } else if (status != Z_OK) {
+      throw std::runtime_error("GzipReader: Corrupt file " + mPath);
+    }
+  }
+
+  return size - mZ.avail_out;
+}
+
+/*
+  Go back to the start of the file.
+
+  @throws
+    std::runtime_error if the file cannot be read
+*/
+void GzipReader::rewind() {
+  mFile.clear();
+  mFile.seekg(0);
+  if (!mFile) {
+    throw std::runtime_error("GzipReader: Failed to rewind " + mPath);
+  }
+
+  inflateReset(&mZ);
+  mZ.avail_in = 0;
+  mEnded = false;
+}
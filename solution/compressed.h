@@ -0,0 +1,63 @@
+#ifndef COMPRESSED_H_
+#define COMPRESSED_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains support for reading compressed dataset files, which
+  InputFile detects from their first few bytes (so a compressed file need
+  not be named .gz) and decompresses as they are parsed.
+
+  gzip files are inflated with zlib by a GzipReader, on the thread of a
+  ReadAheadBuffer (see readahead.h), so that decompressing the next blocks
+  overlaps parsing the current one. Files of several gzip members one after
+  another (e.g. made with cat a.gz b.gz) are read as one.
+
+  zstd files are detected, but we do not link against libzstd, so they are
+  reported as unsupported rather than parsed as garbage.
+ */
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "readahead.h"
+
+/*
+  The compression of a file, as detected from its first few bytes.
+*/
+enum class Compression {
+  None,
+  Gzip,
+  Zstd
+};
+
+Compression detectCompression(const std::string& path) noexcept;
+
+class GzipReader : public BlockReader {
+protected:
+  const std::string mPath;
+  std::ifstream mFile;
+  z_stream mZ;
+  std::vector<char> mIn;
+  bool mEnded;
+
+public:
+  explicit GzipReader(const std::string& path);
+  virtual ~GzipReader();
+
+  GzipReader(const GzipReader& other) = delete;
+  GzipReader& operator=(const GzipReader& other) = delete;
+
+  virtual size_t read(char* data, size_t size);
+  virtual void rewind();
+};
+
+#endif // COMPRESSED_H_
@@ -0,0 +1,303 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the implementation of the FileFingerprint class. See the
+  header file for additional comments.
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "fingerprint.h"
+
+/*
+  The size of the chunks a file is read in to hash it.
+*/
+const size_t FINGERPRINT_CHUNK_SIZE = 64 * 1024;
+
+/*
+  Retrieve the size and modification time of a file.
+
+  @return
+    false if the file cannot be found
+*/
+static bool statFile(const std::string& path,
+                     uint64_t& size,
+                     int64_t& modified) noexcept {
+  std::error_code ec;
+  size = std::filesystem::file_size(path, ec);
+  if (ec) {
+    return false;
+  }
+
+  const auto time = std::filesystem::last_write_time(path, ec);
+  if (ec) {
+    return false;
+  }
+  modified = static_cast<int64_t>(time.time_since_epoch().count());
+
+  return true;
+}
+
+/*
+  Hash the contents of a file.
+
+  @return
+    false if the file cannot be read
+*/
+static bool hashFile(const std::string& path, uint64_t& hash) noexcept {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  std::vector<char> buffer(FINGERPRINT_CHUNK_SIZE);
+  hash = FileFingerprint::hash(nullptr, 0);
+  while (file) {
+    file.read(buffer.data(), buffer.size());
+    hash = FileFingerprint::hash(buffer.data(), file.gcount(), hash);
+  }
+
+  return file.eof();
+}
+
+/*
+  Construct an empty FileFingerprint, which does not match any file.
+*/
+FileFingerprint::FileFingerprint() noexcept
+    : mSize(0), mModified(0), mHash(0) {}
+
+/*
+  Construct a FileFingerprint from its parts, e.g. when reading it back from
+  a cache.
+
+  @param size
+    The size of the file in bytes
+
+  @param modified
+    The modification time of the file, in the units of the file system clock
+
+  @param hash
+    The hash of the file's contents
+*/
+FileFingerprint::FileFingerprint(uint64_t size,
+                                 int64_t modified,
+                                 uint64_t hash) noexcept
+    : mSize(size), mModified(modified), mHash(hash) {}
+
+/*
+  Fingerprint a file.
+
+  @param path
+    The path to the file
+
+  @return
+    The fingerprint of the file
+
+  @throws
+    std::runtime_error if the file cannot be read
+
+  @example
+    FileFingerprint fingerprint = FileFingerprint::of("datasets/popu1009.json");
+*/
+FileFingerprint FileFingerprint::of(const std::string& path) {
+  uint64_t size, hash;
+  int64_t modified;
+  if (!statFile(path, size, modified) || !hashFile(path, hash)) {
+    throw std::runtime_error("FileFingerprint::of: Failed to read " + path);
+  }
+
+  return FileFingerprint(size, modified, hash);
+}
+
+/*
+  Hash a block of data with 64-bit FNV-1a. The hash of a large block can be
+  computed in chunks by passing the hash of the previous chunk as the seed.
+
+  @param data
+    The data to hash
+
+  @param length
+    The number of bytes of data
+
+  @param seed
+    The hash of the preceding data, if any
+
+  @return
+    The hash
+*/
+uint64_t FileFingerprint::hash(const char* data,
+                               size_t length,
+                               uint64_t seed) noexcept {
+  uint64_t hash = seed;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 0x100000001b3ULL;
+  }
+
+  return hash;
+}
+
+/*
+  Retrieve the size of the file in bytes.
+
+  @return
+    The size
+*/
+uint64_t FileFingerprint::getSize() const noexcept {
+  return mSize;
+}
+
+/*
+  Retrieve the modification time of the file.
+
+  @return
+    The modification time, in the units of the file system clock
+*/
+int64_t FileFingerprint::getModified() const noexcept {
+  return mModified;
+}
+
+/*
+  Retrieve the hash of the file's contents.
+
+  @return
+    The hash
+*/
+uint64_t FileFingerprint::getHash() const noexcept {
+  return mHash;
+}
+
+/*
+  Check whether a file still has this fingerprint. The file is only read
+  (to hash it) if its size and modification time are unchanged.
+
+  @param path
+    The path to the file
+
+  @param checkHash
+    Whether to also check the hash of the file's contents, or trust the size
+    and modification time alone, which does not require opening the file
+
+  @return
+    true if the file has this fingerprint
+*/
+bool FileFingerprint::matches(const std::string& path,
+                              bool checkHash) const noexcept {
+  uint64_t size, hash;
+  int64_t modified;
+  if (!statFile(path, size, modified) ||
+      size != mSize ||
+      modified != mModified) {
+    return false;
+  }
+
+  return !checkHash || (hashFile(path, hash) && hash == mHash);
+}
+
+bool operator==(const FileFingerprint& lhs, const FileFingerprint& rhs) {
+  return lhs.mSize     == rhs.mSize &&
+         lhs.mModified == rhs.mModified &&
+         lhs.mHash     == rhs.mHash;
+}
+
+bool operator!=(const FileFingerprint& lhs, const FileFingerprint& rhs) {
+  return !(lhs == rhs);
+}
+
+/*
+  Read a whole file into a string.
+
+  @param path
+    The path to the file
+
+  @param contents
+    Set to the contents of the file
+
+  @return
+    false if the file cannot be read
+*/
+bool readFileContents(const std::string& path, std::string& contents) noexcept {
+  try {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+      return false;
+    }
+
+    std::stringstream ss;
+    ss << file.rdbuf();
+    contents = ss.str();
+    return !file.bad();
+  } catch (const std::exception& ex) {
+    return false;
+  }
+}
+
+/*
+  Write a file, first to a temporary file which then replaces it. The
+  temporary file is named after this process and a counter, so that two
+  processes (or threads) writing the same file never write into each other's
+  temporary file; whichever rename comes last wins with a complete file.
+
+  @param path
+    The path to the file
+
+  @param contents
+    The contents to write
+
+  @return
+    false if the file could not be written
+*/
+bool writeFileAtomically(const std::string& path,
+                         const std::string& contents) noexcept {
+  static std::atomic<unsigned long> counter(0);
+#ifdef _WIN32
+  const long pid = _getpid();
+#else
+  const long pid = getpid();
+#endif
+
+  std::string temp;
+  try {
+    temp = path + "." + std::to_string(pid) + "." +
+           std::to_string(counter++) + ".tmp";
+    std::ofstream out(temp, std::ios::binary);
+    if (!out.is_open()) {
+      return false;
+    }
+
+    out << contents;
+    out.close();
+    if (out && std::rename(temp.c_str(), path.c_str()) == 0) {
+      return true;
+    }
+  } catch (const std::exception& ex) {
+  }
+
+  if (!temp.empty()) {
+    std::remove(temp.c_str());
+  }
+  return false;
+}
@@ -0,0 +1,70 @@
+#ifndef FINGERPRINT_H_
+#define FINGERPRINT_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the FileFingerprint class, which identifies a particular
+  version of a file by its size, modification time, and a hash of its
+  contents.
+
+  Data cached alongside a dataset file (e.g. a RowIndex) stores the
+  fingerprint of the file it was built from, and is only used if the file
+  still has the same fingerprint. The size and modification time are checked
+  first, so a changed file is usually detected without reading it. Caches
+  that only need to be conservative can skip hashing the file entirely.
+ */
+
+#include <cstdint>
+#include <string>
+
+class FileFingerprint {
+protected:
+  uint64_t mSize;
+  int64_t mModified;
+  uint64_t mHash;
+
+public:
+  FileFingerprint() noexcept;
+  FileFingerprint(uint64_t size, int64_t modified, uint64_t hash) noexcept;
+  ~FileFingerprint() = default;
+
+  FileFingerprint(const FileFingerprint& other) = default;
+  FileFingerprint& operator=(const FileFingerprint& other) = default;
+
+  static FileFingerprint of(const std::string& path);
+  static uint64_t hash(const char* data, size_t length,
+                       uint64_t seed = 0xcbf29ce484222325ULL) noexcept;
+
+  uint64_t getSize() const noexcept;
+  int64_t getModified() const noexcept;
+  uint64_t getHash() const noexcept;
+
+  bool matches(const std::string& path, bool checkHash = true) const noexcept;
+
+  friend bool operator==(const FileFingerprint& lhs,
+                         const FileFingerprint& rhs);
+  friend bool operator!=(const FileFingerprint& lhs,
+                         const FileFingerprint& rhs);
+};
+
+/*
+  Read a whole file (e.g. a dataset, or a RowIndex cached alongside it) into
+  a string, returning false if it cannot be read.
+*/
+bool readFileContents(const std::string& path, std::string& contents) noexcept;
+
+/*
+  Write a file (e.g. a cache), replacing it atomically so that a reader never
+  sees a partially written file. The temporary file is unique to the writer,
+  so concurrent writers of the same file do not interfere. Failing to write a
+  cache is not an error, so this returns false rather than throwing.
+*/
+bool writeFileAtomically(const std::string& path,
+                         const std::string& contents) noexcept;
+
+#endif // FINGERPRINT_H_
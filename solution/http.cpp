@@ -0,0 +1,670 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the implementation of the minimal HTTP/1.1 client and
+  the HttpCache. See the header file for additional comments.
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#ifndef _WIN32
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#include "lib_json.hpp"
+
+#include "fingerprint.h"
+#include "http.h"
+
+using json = nlohmann::json;
+
+/*
+  How long, in milliseconds, a connection waits for a server to accept or
+  send data before the request fails.
+*/
+const unsigned int HTTP_DEFAULT_TIMEOUT_MS = 30000;
+
+/*
+  Split an http:// URL into the host, port and request target.
+
+  @param url
+    The URL, e.g. http://localhost:8080/popu1009?page=2
+
+  @return
+    The parts of the URL, with the port defaulting to 80 and the target to /
+
+  @throws
+    std::runtime_error if the URL is not an http:// URL
+
+  @example
+    HttpUrl url = HttpUrl::parse("http://localhost:8080/popu1009");
+*/
+HttpUrl HttpUrl::parse(const std::string& url) {
+  const std::string scheme = "http://";
+  if (url.compare(0, scheme.size(), scheme) != 0) {
+    throw std::runtime_error("HttpUrl::parse: Only http:// URLs are "
+                             "supported: " + url);
+  }
+
+  const size_t authorityStart = scheme.size();
+  size_t targetStart = url.find('/', authorityStart);
+  if (targetStart == std::string::npos) {
+    targetStart = url.size();
+  }
+
+  const std::string authority =
+      url.substr(authorityStart, targetStart - authorityStart);
+  if (authority.empty()) {
+    throw std::runtime_error("HttpUrl::parse: No host in URL: " + url);
+  }
+
+  HttpUrl parsed;
+  const size_t colon = authority.rfind(':');
+  if (colon == std::string::npos) {
+    parsed.host = authority;
+    parsed.port = "80";
+  } else {
+    parsed.host = authority.substr(0, colon);
+    parsed.port = authority.substr(colon + 1);
+  }
+  parsed.target = targetStart < url.size() ? url.substr(targetStart) : "/";
+
+  return parsed;
+}
+
+/*
+  Constructor for a connection, which is not opened until the first request.
+*/
+HttpConnection::HttpConnection() noexcept
+    : mHost(),
+      mPort(),
+      mFd(-1),
+      mBuffer(),
+      mConnects(0),
+      mTimeoutMs(HTTP_DEFAULT_TIMEOUT_MS) {}
+
+HttpConnection::~HttpConnection() {
+  disconnect();
+}
+
+/*
+  Retrieve the number of times a connection has been opened, which is less
+  than the number of requests if the connection has been kept alive.
+
+  @return
+    The number of connections opened
+*/
+unsigned int HttpConnection::getConnectCount() const noexcept {
+  return mConnects;
+}
+
+/*
+  Set how long the connection waits for the server to accept or send data
+  before a request fails, which takes effect from the next connection.
+
+  @param timeoutMs
+    The timeout, in milliseconds, or 0 to wait forever
+
+  @example
+    HttpConnection connection;
+    connection.setTimeout(5000);
+*/
+void HttpConnection::setTimeout(unsigned int timeoutMs) noexcept {
+  mTimeoutMs = timeoutMs;
+}
+
+/*
+  Open a connection to the server of a URL.
+
+  @param url
+    The URL
+
+  @throws
+    std::runtime_error if the server cannot be reached
+*/
+void HttpConnection::connect(const HttpUrl& url) {
+#ifndef _WIN32
+  struct addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  struct addrinfo* addresses = nullptr;
+  if (getaddrinfo(url.host.c_str(),
+                  url.port.c_str(),
+                  &hints,
+                  &addresses) != 0) {
+    throw std::runtime_error("HttpConnection: Failed to resolve " + url.host);
+  }
+
+  for (auto* address = addresses; address != nullptr;
+       address = address->ai_next) {
+    mFd = socket(address->ai_family, address->ai_socktype,
+                 address->ai_protocol);
+    if (mFd < 0) {
+      continue;
+    }
+
+    struct timeval timeout = {};
+    timeout.tv_sec = mTimeoutMs / 1000;
+    timeout.tv_usec = (mTimeoutMs % 1000) * 1000;
+    setsockopt(mFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(mFd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    if (::connect(mFd, address->ai_addr, address->ai_addrlen) == 0) {
+      break;
+    }
+    close(mFd);
+    mFd = -1;
+  }
+  freeaddrinfo(addresses);
+
+  if (mFd < 0) {
+    throw std::runtime_error("HttpConnection: Failed to connect to " +
+                             url.host + ":" + url.port);
+  }
+
+  mHost = url.host;
+  mPort = url.port;
+  mBuffer.clear();
+  mConnects++;
+#else
+  throw std::runtime_error("HttpConnection: HTTP is not supported on this "
+                           "platform");
+#endif
+}
+
+/*
+  Close the connection, if it is open.
+*/
+void HttpConnection::disconnect() noexcept {
+#ifndef _WIN32
+  if (mFd >= 0) {
+    close(mFd);
+  }
+#endif
+  mFd = -1;
+  mBuffer.clear();
+}
+
+/*
+  Read from the connection into mBuffer.
+
+  @return
+    false if the connection was closed
+
+  @throws
+    std::runtime_error if the connection fails, or nothing is received
+    before the timeout
+*/
+bool HttpConnection::readSome() {
+#ifndef _WIN32
+  char chunk[8192];
+  while (true) {
+    const ssize_t length = recv(mFd, chunk, sizeof(chunk), 0);
+    if (length < 0 && errno == EINTR) {
+      continue;
+    } else if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      throw std::runtime_error("HttpConnection: Timed out reading response");
+    } else if (length < 0) {
+      throw std::runtime_error("HttpConnection: Failed to read response");
+    }
+
+    mBuffer.append(chunk, static_cast<size_t>(length));
+    return length > 0;
+  }
+#else
+  return false;
+#endif
+}
+
+/*
+  Decode a body sent with chunked transfer encoding from the start of
+  mBuffer, leaving anything after it in mBuffer.
+
+  @return
+    The decoded body
+
+  @throws
+    std::runtime_error if the connection closes before the end of the body
+*/
+std::string HttpConnection::readChunkedBody() {
+  std::string body;
+  size_t pos = 0;
+
+  while (true) {
+    size_t lineEnd;
+    while ((lineEnd = mBuffer.find("\r\n", pos)) == std::string::npos) {
+      if (!readSome()) {
+        throw std::runtime_error("HttpConnection: Truncated chunked response");
+      }
+    }
+
+    const size_t length = std::strtoul(mBuffer.c_str() + pos, nullptr, 16);
+    pos = lineEnd + 2;
+    if (length == 0) {
+      break;
+    }
+
+    while (mBuffer.size() < pos + length + 2) {
+      if (!readSome()) {
+        throw std::runtime_error("HttpConnection: Truncated chunked response");
+      }
+    }
+
+    body.append(mBuffer, pos, length);
+    pos += length + 2;
+  }
+
+  // The last chunk is followed by any trailers, and then an empty line
+  while (true) {
+    size_t lineEnd;
+    while ((lineEnd = mBuffer.find("\r\n", pos)) == std::string::npos) {
+      if (!readSome()) {
+        throw std::runtime_error("HttpConnection: Truncated chunked response");
+      }
+    }
+
+    const bool empty = lineEnd == pos;
+    pos = lineEnd + 2;
+    if (empty) {
+      break;
+    }
+  }
+
+  mBuffer.erase(0, pos);
+  return body;
+}
+
+/*
+  Make a GET request on the open connection and read the response.
+
+  @param url
+    The URL to fetch, which is on the connected server
+
+  @param headers
+    Additional request headers
+
+  @param reusable
+    Set to whether the connection can be used for another request
+
+  @return
+    The response
+
+  @throws
+    std::runtime_error if the request fails or the response is malformed
+*/
+HttpResponse HttpConnection::request(
+    const HttpUrl& url,
+    const std::map<std::string, std::string>& headers,
+    bool& reusable) {
+#ifndef _WIN32
+  // The port is part of the Host header unless it is the default
+  const std::string host =
+      url.port == "80" ? url.host : url.host + ":" + url.port;
+  std::string request = "GET " + url.target + " HTTP/1.1\r\n"
+                        "Host: " + host + "\r\n"
+                        "Accept: application/json\r\n"
+                        "Connection: keep-alive\r\n";
+  for (auto it = headers.cbegin(); it != headers.cend(); it++) {
+    request += it->first + ": " + it->second + "\r\n";
+  }
+  request += "\r\n";
+
+  for (size_t sent = 0; sent < request.size(); ) {
+    const ssize_t length = send(mFd,
+                                request.data() + sent,
+                                request.size() - sent,
+                                MSG_NOSIGNAL);
+    if (length < 0 && errno == EINTR) {
+      continue;
+    } else if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      throw std::runtime_error("HttpConnection: Timed out sending request");
+    } else if (length < 0) {
+      throw std::runtime_error("HttpConnection: Failed to send request");
+    }
+    sent += static_cast<size_t>(length);
+  }
+
+  size_t headersEnd;
+  while ((headersEnd = mBuffer.find("\r\n\r\n")) == std::string::npos) {
+    if (!readSome()) {
+      throw std::runtime_error("HttpConnection: Truncated response");
+    }
+  }
+
+  // The status line, e.g. HTTP/1.1 200 OK
+  HttpResponse response;
+  size_t lineEnd = mBuffer.find("\r\n");
+  const size_t space = mBuffer.find(' ');
+  if (mBuffer.compare(0, 5, "HTTP/") != 0 || space > lineEnd) {
+    throw std::runtime_error("HttpConnection: Malformed response");
+  }
+  response.status = std::atoi(mBuffer.c_str() + space + 1);
+  reusable = mBuffer.compare(0, 9, "HTTP/1.1 ") == 0;
+
+  for (size_t pos = lineEnd + 2; pos < headersEnd; pos = lineEnd + 2) {
+    lineEnd = mBuffer.find("\r\n", pos);
+    const size_t colon = mBuffer.find(':', pos);
+    if (colon == std::string::npos || colon > lineEnd) {
+      continue;
+    }
+
+    std::string name = mBuffer.substr(pos, colon - pos);
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+    size_t valueStart = colon + 1;
+    while (valueStart < lineEnd && mBuffer[valueStart] == ' ') {
+      valueStart++;
+    }
+    response.headers[name] = mBuffer.substr(valueStart, lineEnd - valueStart);
+  }
+
+  mBuffer.erase(0, headersEnd + 4);
+
+  auto connection = response.headers.find("connection");
+  if (connection != response.headers.end() &&
+      connection->second.find("close") != std::string::npos) {
+    reusable = false;
+  }
+
+  auto encoding = response.headers.find("transfer-encoding");
+  auto length = response.headers.find("content-length");
+  if (response.status == 204 || response.status == 304) {
+    // These never have a body
+  } else if (encoding != response.headers.end() &&
+             encoding->second.find("chunked") != std::string::npos) {
+    response.body = readChunkedBody();
+  } else if (length != response.headers.end()) {
+    const size_t contentLength = std::strtoul(length->second.c_str(),
+                                              nullptr,
+                                              10);
+    while (mBuffer.size() < contentLength) {
+      if (!readSome()) {
+        throw std::runtime_error("HttpConnection: Truncated response");
+      }
+    }
+    response.body = mBuffer.substr(0, contentLength);
+    mBuffer.erase(0, contentLength);
+  } else {
+    // The body ends when the server closes the connection
+    while (readSome()) {}
+    response.body = std::move(mBuffer);
+    reusable = false;
+  }
+
+  return response;
+#else
+  throw std::runtime_error("HttpConnection: HTTP is not supported on this "
+                           "platform");
+#endif
+}
+
+/*
+  Make a GET request, reusing the connection if it is open to the same
+  server. If a connection that was kept open fails, e.g. because the server
+  closed it while it was idle, the request is made again on a new one.
+
+  @param url
+    The http:// URL to fetch
+
+  @param headers
+    Additional request headers, e.g. If-None-Match
+
+  @return
+    The response, whatever its status
+
+  @throws
+    std::runtime_error if the URL is invalid, the server cannot be reached,
+    or the response is malformed
+
+  @example
+    HttpConnection connection;
+    HttpResponse first = connection.get("http://localhost:8080/popu1009");
+    HttpResponse second = connection.get("http://localhost:8080/econ0080");
+*/
+HttpResponse HttpConnection::get(
+    const std::string& url,
+    const std::map<std::string, std::string>& headers) {
+  const HttpUrl parsed = HttpUrl::parse(url);
+  if (mFd >= 0 && (parsed.host != mHost || parsed.port != mPort)) {
+    disconnect();
+  }
+
+  while (true) {
+    const bool reused = mFd >= 0;
+    if (!reused) {
+      connect(parsed);
+    }
+
+    try {
+      bool reusable = false;
+      HttpResponse response = request(parsed, headers, reusable);
+      if (!reusable) {
+        disconnect();
+      }
+      return response;
+    } catch (const std::runtime_error& ex) {
+      disconnect();
+      if (!reused) {
+        throw std::runtime_error(std::string(ex.what()) + " from " + url);
+      }
+    }
+  }
+}
+
+/*
+  Make a GET request on a new connection, which is closed afterwards.
+
+  @param url
+    The http:// URL to fetch
+
+  @return
+    The response, whatever its status
+
+  @throws
+    std::runtime_error if the URL is invalid, the server cannot be reached,
+    or the response is malformed
+
+  @example
+    HttpResponse response = httpGet("http://localhost:8080/popu1009");
+*/
+HttpResponse httpGet(const std::string& url) {
+  HttpConnection connection;
+  return connection.get(url);
+}
+
+/*
+  Constructor for a cache kept in a directory, which is created when the
+  first response is stored.
+
+  @param dir
+    The directory
+
+  @example
+    HttpCache cache("cache");
+*/
+HttpCache::HttpCache(const std::string& dir) : mDir(dir) {}
+
+/*
+  Retrieve the directory of the cache.
+
+  @return
+    The directory
+*/
+const std::string& HttpCache::getDir() const noexcept {
+  return mDir;
+}
+
+/*
+  Get the path of the file the response for a URL is kept in, which is named
+  after a hash of the URL.
+
+  @param url
+    The URL
+
+  @return
+    The path of the file
+*/
+std::string HttpCache::entryPath(const std::string& url) const {
+  char name[32];
+  std::snprintf(name,
+                sizeof(name),
+                "%016llx.http",
+                static_cast<unsigned long long>(
+                    FileFingerprint::hash(url.data(), url.size())));
+
+  return (std::filesystem::path(mDir) / name).string();
+}
+
+/*
+  Find the response kept for a URL. The file starts with a line of JSON with
+  the URL and the validators, followed by the body.
+
+  @param url
+    The URL
+
+  @param response
+    Set to the response kept for the URL, with its ETag and Last-Modified
+    headers, if any
+
+  @return
+    true if a response was found
+*/
+bool HttpCache::find(const std::string& url,
+                     HttpResponse& response) const noexcept {
+  std::string contents;
+  if (!readFileContents(entryPath(url), contents)) {
+    return false;
+  }
+
+  try {
+    const size_t lineEnd = contents.find('\n');
+    if (lineEnd == std::string::npos) {
+      return false;
+    }
+
+    const json meta = json::parse(contents.cbegin(),
+                                  contents.cbegin() + lineEnd);
+    if (meta.at("url").get<std::string>() != url) {
+      return false;
+    }
+
+    response.status = 200;
+    response.headers.clear();
+    for (const auto& name : {"etag", "last-modified"}) {
+      if (meta.contains(name)) {
+        response.headers[name] = meta.at(name).get<std::string>();
+      }
+    }
+    response.body = contents.substr(lineEnd + 1);
+    return true;
+  } catch (const std::exception& ex) {
+    return false;
+  }
+}
+
+/*
+  Keep a successful response for a URL, if it has an ETag or Last-Modified
+  header to make a conditional request with next time.
+
+  @param url
+    The URL
+
+  @param response
+    The response
+
+  @return
+    true if the response was kept
+*/
+bool HttpCache::store(const std::string& url,
+                      const HttpResponse& response) const noexcept {
+  try {
+    json meta;
+    meta["url"] = url;
+    for (const auto& name : {"etag", "last-modified"}) {
+      auto it = response.headers.find(name);
+      if (it != response.headers.end()) {
+        meta[name] = it->second;
+      }
+    }
+
+    if (response.status != 200 || meta.size() == 1) {
+      return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(mDir, ec);
+
+    return writeFileAtomically(entryPath(url),
+                               meta.dump() + "\n" + response.body);
+  } catch (const std::exception& ex) {
+    return false;
+  }
+}
+
+/*
+  Fetch a URL, on the condition that it has changed since the response kept
+  for it in the cache. If the server responds that it has not changed, the
+  kept response is returned, otherwise the new response is kept.
+
+  @param connection
+    The connection to make the request on
+
+  @param url
+    The http:// URL to fetch
+
+  @return
+    The response, whatever its status
+
+  @throws
+    std::runtime_error if the URL cannot be fetched
+
+  @example
+    HttpConnection connection;
+    HttpCache cache("cache");
+    HttpResponse response = cache.get(connection, "http://localhost/popu1009");
+*/
+HttpResponse HttpCache::get(HttpConnection& connection,
+                            const std::string& url) const {
+  HttpResponse cached;
+  std::map<std::string, std::string> conditions;
+  if (find(url, cached)) {
+    auto etag = cached.headers.find("etag");
+    if (etag != cached.headers.end()) {
+      conditions["If-None-Match"] = etag->second;
+    }
+
+    auto modified = cached.headers.find("last-modified");
+    if (modified != cached.headers.end()) {
+      conditions["If-Modified-Since"] = modified->second;
+    }
+  }
+
+  HttpResponse response = connection.get(url, conditions);
+  if (response.status == 304 && !conditions.empty()) {
+    return cached;
+  }
+
+  store(url, response);
+  return response;
+}
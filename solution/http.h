@@ -0,0 +1,106 @@
+#ifndef HTTP_H_
+#define HTTP_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains a minimal HTTP/1.1 client, which InputHttp uses to fetch
+  the pages of a dataset (see input.h).
+
+  Only plain http:// URLs are supported, i.e. there is no TLS, so this is
+  meant for a local mirror or proxy of StatsWales (or a stand-in server in
+  the tests). An HttpConnection keeps its connection open between requests
+  to the same server, unless the server closes it, so fetching a series of
+  pages does not pay for a new connection each time. A server that stops
+  sending (or receiving) for longer than the connection's timeout fails the
+  request, rather than leaving it waiting forever. The whole body of a
+  response is read into memory, which is fine for a single page of a
+  dataset. Response bodies may be sent with a Content-Length, with chunked
+  transfer encoding, or by closing the connection.
+
+  An HttpCache keeps the last response for each URL on disk, along with its
+  ETag and Last-Modified headers, so that a page can be requested on the
+  condition that it has changed, and taken from the cache if it has not.
+
+  As with InputHttp, the command line tool does not use these yet.
+ */
+
+#include <map>
+#include <string>
+
+/*
+  The parts of an http:// URL that we need to make a request.
+*/
+struct HttpUrl {
+  std::string host;
+  std::string port;
+  std::string target;
+
+  static HttpUrl parse(const std::string& url);
+};
+
+/*
+  A response from a server. The names of the headers are in lowercase.
+*/
+struct HttpResponse {
+  int status;
+  std::map<std::string, std::string> headers;
+  std::string body;
+};
+
+class HttpConnection {
+protected:
+  std::string mHost;
+  std::string mPort;
+  int mFd;
+  std::string mBuffer;
+  unsigned int mConnects;
+  unsigned int mTimeoutMs;
+
+  void connect(const HttpUrl& url);
+  void disconnect() noexcept;
+  bool readSome();
+  std::string readChunkedBody();
+  HttpResponse request(const HttpUrl& url,
+                       const std::map<std::string, std::string>& headers,
+                       bool& reusable);
+
+public:
+  HttpConnection() noexcept;
+  ~HttpConnection();
+
+  HttpConnection(const HttpConnection& other) = delete;
+  HttpConnection& operator=(const HttpConnection& other) = delete;
+
+  unsigned int getConnectCount() const noexcept;
+  void setTimeout(unsigned int timeoutMs) noexcept;
+
+  HttpResponse get(const std::string& url,
+                   const std::map<std::string, std::string>& headers = {});
+};
+
+HttpResponse httpGet(const std::string& url);
+
+class HttpCache {
+protected:
+  std::string mDir;
+
+  std::string entryPath(const std::string& url) const;
+
+public:
+  explicit HttpCache(const std::string& dir);
+
+  const std::string& getDir() const noexcept;
+
+  bool find(const std::string& url, HttpResponse& response) const noexcept;
+  bool store(const std::string& url,
+             const HttpResponse& response) const noexcept;
+
+  HttpResponse get(HttpConnection& connection, const std::string& url) const;
+};
+
+#endif // HTTP_H_
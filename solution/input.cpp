@@ -17,11 +17,48 @@
   functions not specified.
  */
 
+#include <cctype>
+#include <cstdio>
 #include <exception>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
 #include <stdexcept>
+#include <string>
+#include <thread>
 
+#include "lib_json.hpp"
+
+#include "archive.h"
+#include "batch.h"
+#include "compressed.h"
+#include "http.h"
 #include "input.h"
+#include "readahead.h"
+
+using json = nlohmann::json;
+
+/*
+  The size and number of the blocks a compressed file is decompressed into
+  ahead of being parsed.
+*/
+const size_t INPUT_DECOMPRESS_BLOCK_SIZE = 64 * 1024;
+const size_t INPUT_DECOMPRESS_BLOCKS = 4;
+
+/*
+  The size and number of the blocks the standard input is read into ahead of
+  being parsed.
+*/
+const size_t INPUT_STDIN_BLOCK_SIZE = 64 * 1024;
+const size_t INPUT_STDIN_BLOCKS = 4;
+
+/*
+  The size and number of the blocks a plain file is read into ahead of being
+  parsed in read-ahead mode, i.e. it is double buffered in large blocks.
+*/
+const size_t INPUT_READ_AHEAD_BLOCK_SIZE = 1024 * 1024;
+const size_t INPUT_READ_AHEAD_BLOCKS = 2;
 
 /*
   TODO: InputSource::InputSource(source)
@@ -49,11 +86,20 @@ const std::string& InputSource::getSource() const { return mSource; }
   @param path
     The complete path for a file to import.
 
+  @param options
+    How the file is read, i.e. whether it is read ahead of the parser, or
+    taken from a FileBatch
+
   @example
     InputFile input("data/areas.csv");
 */
-InputFile::InputFile(const std::string& path)
-    : InputSource(path), mFileStream() {}
+InputFile::InputFile(const std::string& path, const InputOptions& options)
+    : InputSource(path),
+      mOptions(options),
+      mFileStream(),
+      mReadAhead(),
+      mReadAheadStream(nullptr),
+      mBatchStream() {}
 
 /*
   Close the file stream.
@@ -82,6 +128,50 @@ InputFile::~InputFile() {
     input.open();
 */
 std::istream& InputFile::open() {
+  // A compressed file is decompressed ahead of being parsed, as is a plain
+  // file read in read-ahead mode, and an error reading it is thrown from the
+  // stream (see ReadAheadBuffer)
+  const Compression compression = detectCompression(mSource);
+  if (compression == Compression::Zstd) {
+    throw std::runtime_error("InputFile::open: zstd compressed files are not "
+                             "supported, decompress or gzip " + mSource);
+  }
+
+  // A plain file may have been read already, along with the other files in
+  // the batch, and otherwise we read it ourselves
+  std::string contents;
+  if (compression == Compression::None &&
+      mOptions.batch != nullptr &&
+      mOptions.batch->take(mSource, contents)) {
+    mBatchStream.str(std::move(contents));
+    mBatchStream.clear();
+    return mBatchStream;
+  }
+
+  if (compression == Compression::Gzip || mOptions.readAhead) {
+    try {
+      if (compression == Compression::Gzip) {
+        mReadAhead = std::make_unique<ReadAheadBuffer>(
+            std::make_unique<GzipReader>(mSource),
+            INPUT_DECOMPRESS_BLOCK_SIZE,
+            INPUT_DECOMPRESS_BLOCKS);
+      } else {
+        mReadAhead = std::make_unique<ReadAheadBuffer>(
+            std::make_unique<FileBlockReader>(mSource),
+            INPUT_READ_AHEAD_BLOCK_SIZE,
+            INPUT_READ_AHEAD_BLOCKS);
+      }
+    } catch (const std::runtime_error& ex) {
+      throw std::runtime_error("InputFile::open: Failed to open file " +
+                               mSource);
+    }
+
+    mReadAheadStream.rdbuf(mReadAhead.get());
+    mReadAheadStream.clear();
+    mReadAheadStream.exceptions(std::ios::badbit);
+    return mReadAheadStream;
+  }
+
   try {
     mFileStream.open(mSource, std::ifstream::in);
   } catch(const std::runtime_error& ex) {
@@ -93,4 +183,571 @@ std::istream& InputFile::open() {
   }
 
   return mFileStream;
-}
\ No newline at end of file
+}
+
+/*
+  Constructor for the standard input as a source.
+
+  @example
+    InputStdin input;
+    areas.populate(input.open(), ...);
+*/
+InputStdin::InputStdin()
+    : InputSource(STDIN_PATH), mBuffer(), mStream(nullptr) {}
+
+/*
+  Start reading the standard input, a block ahead of the parser, and return
+  a reference to the stream. An error reading it is thrown from the stream.
+  Once it has been read, it is empty.
+
+  @return
+    A standard input stream reference
+*/
+std::istream& InputStdin::open() {
+  mBuffer = std::make_unique<ReadAheadBuffer>(
+      std::make_unique<PipeBlockReader>(stdin, "the standard input"),
+      INPUT_STDIN_BLOCK_SIZE,
+      INPUT_STDIN_BLOCKS);
+
+  mStream.rdbuf(mBuffer.get());
+  mStream.clear();
+  mStream.exceptions(std::ios::badbit);
+  return mStream;
+}
+
+/*
+  Constructor for a member of a .zip file, given as a path within the .zip
+  file.
+
+  @param path
+    The path, e.g. datasets.zip/areas.csv
+
+  @throws
+    std::runtime_error if the path is not within a .zip file
+
+  @example
+    InputArchive input("datasets.zip/areas.csv");
+*/
+InputArchive::InputArchive(const std::string& path)
+    : InputSource(path),
+      mArchivePath(),
+      mMemberName(),
+      mBuffer(),
+      mStream(nullptr) {
+  if (!ZipArchive::splitPath(path, mArchivePath, mMemberName)) {
+    throw std::runtime_error("InputArchive: Not a path within a .zip file: " +
+                             path);
+  }
+}
+
+/*
+  Constructor for a member of a .zip file.
+
+  @param archivePath
+    The path to the .zip file
+
+  @param memberName
+    The name of the member (see ZipArchive::find())
+
+  @example
+    InputArchive input("datasets.zip", "areas.csv");
+*/
+InputArchive::InputArchive(const std::string& archivePath,
+                           const std::string& memberName)
+    : InputSource(archivePath + "/" + memberName),
+      mArchivePath(archivePath),
+      mMemberName(memberName),
+      mBuffer(),
+      mStream(nullptr) {}
+
+/*
+  Check whether a path is to a file within a .zip file.
+
+  @param path
+    The path
+
+  @return
+    true if the path is within a .zip file
+*/
+bool InputArchive::isArchivePath(const std::string& path) {
+  std::string archivePath, memberName;
+  return ZipArchive::splitPath(path, archivePath, memberName);
+}
+
+/*
+  Open the member of the .zip file, which is read (and inflated) as the
+  stream is read. An error reading the member, e.g. a CRC mismatch, is
+  thrown from the stream, rather than just failing it, so that a corrupt
+  member is not mistaken for a short one.
+
+  @return
+    A standard input stream reference
+
+  @throws
+    std::runtime_error if the .zip file cannot be read, or it has no such
+    member, with the message:
+    InputArchive::open: Failed to open <member name> in <.zip file>
+*/
+std::istream& InputArchive::open() {
+  std::unique_ptr<ZipMemberBuffer> buffer;
+  try {
+    ZipArchive archive(mArchivePath);
+    const ZipMember* member = archive.find(mMemberName);
+    if (member == nullptr) {
+      throw std::runtime_error("no such member");
+    }
+    buffer = std::make_unique<ZipMemberBuffer>(archive, *member);
+  } catch (const std::runtime_error& ex) {
+    throw std::runtime_error("InputArchive::open: Failed to open " +
+                             mMemberName + " in " + mArchivePath + " (" +
+                             ex.what() + ")");
+  }
+
+  mStream.rdbuf(buffer.get());
+  mStream.clear();
+  mStream.exceptions(std::ios::badbit);
+  mBuffer = std::move(buffer);
+
+  return mStream;
+}
+
+/*
+  Constructor for a source of pages.
+
+  @param source
+    A unique identifier for the source (i.e. the location of the first page)
+*/
+InputPages::InputPages(const std::string& source)
+    : InputSource(source), mPages(0) {}
+
+/*
+  Retrieve the number of pages opened so far.
+
+  @return
+    The number of pages
+*/
+unsigned int InputPages::getPageCount() const noexcept {
+  return mPages;
+}
+
+/*
+  Constructor for the pages of a dataset saved as files.
+
+  @param path
+    The path of the first page, i.e. the dataset file
+
+  @param options
+    How the pages are read, i.e. whether they are taken from a FileBatch
+
+  @example
+    InputFilePages input("data/popu1009.json");
+*/
+InputFilePages::InputFilePages(const std::string& path,
+                               const InputOptions& options)
+    : InputPages(path), mOptions(options), mFileStream(), mBatchStream() {}
+
+/*
+  Get the path of a page, which is the path of the first page numbered before
+  its extension, if it has one.
+
+  @param path
+    The path of the first page
+
+  @param page
+    The page number, from 1
+
+  @return
+    The path of the page
+
+  @example
+    InputFilePages::pagePath("data/popu1009.json", 2); // data/popu1009.2.json
+*/
+std::string InputFilePages::pagePath(const std::string& path,
+                                     unsigned int page) {
+  if (page <= 1) {
+    return path;
+  }
+
+  const size_t sep = path.find_last_of("/\\");
+  const size_t dot = path.rfind('.');
+  if (dot == std::string::npos || (sep != std::string::npos && dot < sep)) {
+    return path + "." + std::to_string(page);
+  }
+
+  return path.substr(0, dot) + "." + std::to_string(page) + path.substr(dot);
+}
+
+/*
+  Check whether a dataset file has a second page saved alongside it.
+
+  @param path
+    The path of the dataset file
+
+  @return
+    true if there is a file for the second page
+*/
+bool InputFilePages::isPaged(const std::string& path) {
+  std::ifstream file(pagePath(path, 2));
+  return file.is_open();
+}
+
+/*
+  Open the file of a page, taking its contents from the FileBatch of the
+  InputOptions if it was read in the batch.
+
+  @param path
+    The path of the page
+
+  @return
+    A pointer to the stream for the page, or nullptr if it cannot be opened
+*/
+std::istream* InputFilePages::openPage(const std::string& path) {
+  mFileStream.close();
+  mFileStream.clear();
+
+  std::string contents;
+  if (mOptions.batch != nullptr && mOptions.batch->take(path, contents)) {
+    mBatchStream.str(std::move(contents));
+    mBatchStream.clear();
+    return &mBatchStream;
+  }
+
+  mFileStream.open(path, std::ifstream::in);
+  return mFileStream.is_open() ? &mFileStream : nullptr;
+}
+
+/*
+  Open the first page.
+
+  @return
+    A standard input stream reference
+
+  @throws
+    std::runtime_error if there is an issue opening the file, with the message:
+    InputFilePages::open: Failed to open file <file name>
+*/
+std::istream& InputFilePages::open() {
+  std::istream* stream = openPage(mSource);
+  if (stream == nullptr) {
+    throw std::runtime_error("InputFilePages::open: Failed to open file " +
+                             mSource);
+  }
+
+  mPages = 1;
+  return *stream;
+}
+
+/*
+  Open the next page, if its file exists.
+
+  @param nextLink
+    The link to the next page from the current page (which is not used)
+
+  @return
+    A pointer to the stream for the next page, or nullptr if there is no file
+    for the next page
+*/
+std::istream* InputFilePages::next(const std::string& /* nextLink */) {
+  std::istream* stream = openPage(pagePath(mSource, mPages + 1));
+  if (stream == nullptr) {
+    return nullptr;
+  }
+
+  mPages++;
+  return stream;
+}
+
+/*
+  Constructor for a dataset fetched with HTTP.
+
+  @param url
+    The http:// URL of the first page
+
+  @param cacheDir
+    The directory of an HttpCache to make conditional requests with, or an
+    empty string to fetch every page in full
+
+  @param prefetch
+    The number of pages to fetch ahead of the page being parsed, or 0 to
+    fetch each page when it is opened
+
+  @example
+    InputHttp input("http://localhost:8080/popu1009", "cache");
+*/
+InputHttp::InputHttp(const std::string& url,
+                     const std::string& cacheDir,
+                     unsigned int prefetch)
+    : InputPages(url),
+      mCacheDir(cacheDir),
+      mPrefetch(prefetch),
+      mUrl(),
+      mPageStream(),
+      mConnection(),
+      mFetcher(),
+      mMutex(),
+      mChanged(),
+      mFetched(),
+      mExpected(),
+      mStopping(false),
+      mFetching(false) {}
+
+/*
+  Stop fetching pages ahead, waiting for the page being fetched (if any).
+*/
+InputHttp::~InputHttp() {
+  stopFetching();
+}
+
+/*
+  Find the link to the next page at the end of a page, without parsing the
+  whole page. StatsWales puts the "odata.nextLink" after the rows, so we
+  search for it from the end.
+
+  @param page
+    The contents of the page
+
+  @return
+    The link, or an empty string if the page has no link (or it cannot be
+    found)
+
+  @example
+    std::string link = InputHttp::findNextLink(
+        "{\"value\":[],\"odata.nextLink\":\"http://localhost/p?page=2\"}");
+*/
+std::string InputHttp::findNextLink(const std::string& page) {
+  const std::string key = "\"odata.nextLink\"";
+  const size_t keyPos = page.rfind(key);
+  if (keyPos == std::string::npos) {
+    return "";
+  }
+
+  size_t pos = keyPos + key.size();
+  while (pos < page.size() && std::isspace(page[pos])) {
+    pos++;
+  }
+  if (pos >= page.size() || page[pos] != ':') {
+    return "";
+  }
+  pos++;
+  while (pos < page.size() && std::isspace(page[pos])) {
+    pos++;
+  }
+  if (pos >= page.size() || page[pos] != '"') {
+    return "";
+  }
+
+  // Find the closing quote, skipping escaped characters
+  size_t end = pos + 1;
+  while (end < page.size() && page[end] != '"') {
+    end += page[end] == '\\' ? 2 : 1;
+  }
+  if (end >= page.size()) {
+    return "";
+  }
+
+  try {
+    return json::parse(page.substr(pos, end - pos + 1)).get<std::string>();
+  } catch (const json::exception& ex) {
+    return "";
+  }
+}
+
+/*
+  Fetch a page, through the cache if there is one.
+
+  @param connection
+    The connection to fetch the page on
+
+  @param url
+    The URL of the page
+
+  @return
+    The page, or the error fetching it
+*/
+InputHttp::Page InputHttp::fetch(HttpConnection& connection,
+                                 const std::string& url) const {
+  Page page;
+  page.url = url;
+
+  try {
+    HttpResponse response = mCacheDir.empty()
+                                ? connection.get(url)
+                                : HttpCache(mCacheDir).get(connection, url);
+    if (response.status != 200) {
+      throw std::runtime_error("InputHttp: Failed to fetch " + url +
+                               " (HTTP " + std::to_string(response.status) +
+                               ")");
+    }
+
+    page.body = std::move(response.body);
+  } catch (...) {
+    page.error = std::current_exception();
+  }
+
+  return page;
+}
+
+/*
+  Fetch pages ahead of them being parsed, starting from a URL and following
+  the links in each page, until there are no more pages, a page cannot be
+  fetched, or we are stopped. This runs on mFetcher, and waits whenever
+  mPrefetch pages are waiting to be parsed.
+
+  @param url
+    The URL of the first page to fetch
+*/
+void InputHttp::fetchPages(std::string url) {
+  HttpConnection connection;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mChanged.wait(lock, [this]() {
+        return mStopping || mFetched.size() < mPrefetch;
+      });
+      if (mStopping) {
+        break;
+      }
+    }
+
+    Page page = fetch(connection, url);
+    std::string nextLink = page.error ? "" : findNextLink(page.body);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mStopping) {
+      break;
+    }
+
+    // A page linking to itself is reported when it is opened
+    mFetched.push_back(std::move(page));
+    mExpected = nextLink == url ? "" : nextLink;
+    mChanged.notify_all();
+
+    if (mExpected.empty()) {
+      break;
+    }
+    url = mExpected;
+  }
+
+  std::lock_guard<std::mutex> lock(mMutex);
+  mFetching = false;
+  mChanged.notify_all();
+}
+
+/*
+  Start fetching pages ahead from a URL.
+
+  @param url
+    The URL of the first page to fetch
+*/
+void InputHttp::startFetching(const std::string& url) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  mFetching = true;
+  mExpected = url;
+  mFetcher = std::thread(&InputHttp::fetchPages, this, url);
+}
+
+/*
+  Stop fetching pages ahead, and forget any pages that have been fetched.
+*/
+void InputHttp::stopFetching() {
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStopping = true;
+    mChanged.notify_all();
+  }
+
+  if (mFetcher.joinable()) {
+    mFetcher.join();
+  }
+
+  std::lock_guard<std::mutex> lock(mMutex);
+  mStopping = false;
+  mFetching = false;
+  mFetched.clear();
+  mExpected.clear();
+}
+
+/*
+  Open a page, taking it from the pages fetched ahead if it is the next of
+  them, or else fetching ahead from it instead.
+
+  @param url
+    The URL of the page
+
+  @return
+    A standard input stream reference
+
+  @throws
+    std::runtime_error if the page cannot be fetched
+*/
+std::istream& InputHttp::openPage(const std::string& url) {
+  Page page;
+
+  if (mPrefetch == 0) {
+    page = fetch(mConnection, url);
+  } else {
+    std::unique_lock<std::mutex> lock(mMutex);
+    const bool fetchingUrl = mFetched.empty()
+                                 ? mFetching && mExpected == url
+                                 : mFetched.front().url == url;
+    if (!fetchingUrl) {
+      lock.unlock();
+      stopFetching();
+      startFetching(url);
+      lock.lock();
+    }
+
+    mChanged.wait(lock, [this]() { return !mFetched.empty(); });
+    page = std::move(mFetched.front());
+    mFetched.pop_front();
+    mChanged.notify_all();
+  }
+
+  if (page.error) {
+    std::rethrow_exception(page.error);
+  }
+
+  mUrl = page.url;
+  mPageStream.str(std::move(page.body));
+  mPageStream.clear();
+  mPages++;
+
+  return mPageStream;
+}
+
+/*
+  Fetch the first page, and start fetching the pages after it.
+
+  @return
+    A standard input stream reference
+
+  @throws
+    std::runtime_error if the page cannot be fetched
+*/
+std::istream& InputHttp::open() {
+  stopFetching();
+  mPages = 0;
+  return openPage(mSource);
+}
+
+/*
+  Open the page a link refers to, which has usually been fetched already.
+
+  @param nextLink
+    The link to the next page from the current page
+
+  @return
+    A pointer to the stream for the next page
+
+  @throws
+    std::runtime_error if the page cannot be fetched, or the link refers to
+    the current page (which would never end)
+*/
+std::istream* InputHttp::next(const std::string& nextLink) {
+  if (nextLink == mUrl) {
+    throw std::runtime_error("InputHttp: Page links to itself: " + nextLink);
+  }
+
+  return &openPage(nextLink);
+}
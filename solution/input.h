@@ -17,12 +17,79 @@
   code this way to support future expansion of input from different sources
   (e.g. the web).
 
+  StatsWales serves its datasets in pages of 1000 rows, each ending with an
+  "odata.nextLink" to the next page. InputPages is an InputSource for such a
+  sequence of pages, which are read one at a time (see
+  Areas::populateFromWelshStatsJSONPages()) so that only one page is in
+  memory at once. InputFilePages reads pages saved as numbered files
+  (popu1009.json, popu1009.2.json, popu1009.3.json...) and InputHttp follows
+  the links to fetch the pages from a server.
+
+  InputFile decompresses gzip files as it reads them (see compressed.h), so a
+  dataset may be kept compressed, e.g. as popu1009.json.gz.
+
+  In read-ahead mode (see InputOptions), InputFile reads plain files on a
+  thread of their own too, a large block ahead of the parser, so that waiting
+  for the disk overlaps parsing.
+
+  In batch mode (see InputOptions), the dataset files are all read at once
+  before they are parsed, with io_uring where it is available (see batch.h),
+  and InputFile takes the contents of a file from the FileBatch rather than
+  reading it itself.
+
+  InputStdin reads a dataset piped in on the standard input, which is given
+  as the path "-" (see STDIN_PATH), on a thread of its own as it arrives. It
+  can only be read once, so the parsers read their streams from start to
+  end, without seeking.
+
+  InputArchive reads a file from within a .zip file (e.g. a bundle of the
+  datasets), inflating it as it is read rather than extracting it to disk
+  first.
+
   TODO: Read the block comments with TODO in input.cpp to know which 
   functions and member variables you need to declare in these classes.
  */
 
-#include <string>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "archive.h"
+#include "batch.h"
+#include "compressed.h"
+#include "http.h"
+#include "readahead.h"
+
+/*
+  The path that stands for the standard input, e.g. in place of a dataset
+  file when it is piped in.
+*/
+const std::string STDIN_PATH = "-";
+
+/*
+  How the data files are read, which is given to each InputSource that reads
+  files (and to the BethYw functions that load the datasets). By default,
+  each file is read by its parser as it goes.
+*/
+struct InputOptions {
+  // Whether a plain file is read on a thread of its own, a large block ahead
+  // of its parser (a compressed file always is, as it is decompressed)
+  bool readAhead = false;
+
+  // Whether the dataset files are all read in a FileBatch before they are
+  // parsed (see BethYw::batchDatasetFiles()), which is then given as batch
+  bool batchReads = false;
+
+  // The FileBatch a file's contents are taken from, if it is in it, or
+  // nullptr to read every file
+  std::shared_ptr<FileBatch> batch;
+};
 
 /*
   InputSource is an abstract/purely virtual base class for all input source 
@@ -49,6 +116,10 @@ public:
 /*
   Source data that is contained within a file. For now, our application will
   only work with files (and in particular, the files in the data directory).
+  A gzip file is decompressed on a thread of its own as it is read, and in
+  read-ahead mode, a plain file is also read on a thread of its own. A plain
+  file in the FileBatch of the InputOptions is parsed from the contents read
+  by it.
 
   TODO: You should read the various block comments in the corresponding 
   implementation file to know what to declare.
@@ -56,13 +127,169 @@ public:
 
 class InputFile : public InputSource {
 protected:
+  const InputOptions mOptions;
   std::ifstream mFileStream;
+  std::unique_ptr<ReadAheadBuffer> mReadAhead;
+  std::istream mReadAheadStream;
+  std::istringstream mBatchStream;
 
 public:
-  InputFile(const std::string& path);
+  InputFile(const std::string& path,
+            const InputOptions& options = InputOptions());
   virtual ~InputFile();
 
   virtual std::istream& open();
 };
 
+/*
+  Source data that is piped in on the standard input, which is read a block
+  ahead of the parser, and can only be read once.
+*/
+class InputStdin : public InputSource {
+protected:
+  std::unique_ptr<ReadAheadBuffer> mBuffer;
+  std::istream mStream;
+
+public:
+  InputStdin();
+  virtual ~InputStdin() = default;
+
+  InputStdin(const InputStdin& other) = delete;
+  InputStdin& operator=(const InputStdin& other) = delete;
+
+  virtual std::istream& open();
+};
+
+/*
+  Source data that is a member of a .zip file, given as a path within the
+  .zip file, e.g. datasets.zip/areas.csv (see ZipArchive::splitPath() and
+  ZipArchive::find()).
+*/
+class InputArchive : public InputSource {
+protected:
+  std::string mArchivePath;
+  std::string mMemberName;
+  std::unique_ptr<ZipMemberBuffer> mBuffer;
+  std::istream mStream;
+
+public:
+  InputArchive(const std::string& path);
+  InputArchive(const std::string& archivePath, const std::string& memberName);
+  virtual ~InputArchive() = default;
+
+  InputArchive(const InputArchive& other) = delete;
+  InputArchive& operator=(const InputArchive& other) = delete;
+
+  static bool isArchivePath(const std::string& path);
+
+  virtual std::istream& open();
+};
+
+/*
+  A dataset served as a sequence of pages, each a separate document ending
+  with a link to the next (or with no link, on the last page). open() opens
+  the first page, and next() the page a link refers to. The stream for the
+  previous page is no longer valid once the next page is opened.
+*/
+class InputPages : public InputSource {
+protected:
+  unsigned int mPages;
+  InputPages(const std::string& source);
+
+public:
+  virtual ~InputPages() = default;
+
+  unsigned int getPageCount() const noexcept;
+  virtual std::istream* next(const std::string& nextLink) = 0;
+};
+
+/*
+  The pages of a dataset saved as files, where the first page is the dataset
+  file, e.g. popu1009.json, and the following pages are numbered from 2,
+  e.g. popu1009.2.json. The links themselves are not used, so the pages end
+  at the first missing file. A page in the FileBatch of the InputOptions is
+  parsed from the contents read by it, as with InputFile.
+*/
+class InputFilePages : public InputPages {
+protected:
+  const InputOptions mOptions;
+  std::ifstream mFileStream;
+  std::istringstream mBatchStream;
+
+  std::istream* openPage(const std::string& path);
+
+public:
+  InputFilePages(const std::string& path,
+                 const InputOptions& options = InputOptions());
+  virtual ~InputFilePages() = default;
+
+  static std::string pagePath(const std::string& path, unsigned int page);
+  static bool isPaged(const std::string& path);
+
+  virtual std::istream& open();
+  virtual std::istream* next(const std::string& nextLink);
+};
+
+/*
+  A dataset fetched from the StatsWales OData API (or a mirror of it) with
+  HTTP, starting from a URL and following the links to each page after it.
+
+  The pages are fetched over a connection that is kept alive, by a thread
+  that fetches up to a given number of pages ahead of the page being parsed,
+  so that fetching the pages overlaps with parsing them. The link to the next
+  page is found at the end of each page without parsing it. At most
+  prefetch + 1 pages are held in memory at once. If a cache directory is
+  given, the pages are requested on the condition that they have changed
+  since they were kept in the cache (see HttpCache).
+
+  For now, InputHttp is only available to code using this library: the
+  datasets given to the command line tool are always read from files in the
+  data directory, as there is no option to give the URL of a dataset.
+*/
+class InputHttp : public InputPages {
+protected:
+  /*
+    A page fetched ahead of being parsed, or the error fetching it.
+  */
+  struct Page {
+    std::string url;
+    std::string body;
+    std::exception_ptr error;
+  };
+
+  const std::string mCacheDir;
+  const unsigned int mPrefetch;
+  std::string mUrl;
+  std::istringstream mPageStream;
+  HttpConnection mConnection;
+
+  std::thread mFetcher;
+  std::mutex mMutex;
+  std::condition_variable mChanged;
+  std::deque<Page> mFetched;
+  std::string mExpected;
+  bool mStopping;
+  bool mFetching;
+
+  void startFetching(const std::string& url);
+  void stopFetching();
+  void fetchPages(std::string url);
+  Page fetch(HttpConnection& connection, const std::string& url) const;
+  std::istream& openPage(const std::string& url);
+
+public:
+  InputHttp(const std::string& url,
+            const std::string& cacheDir = "",
+            unsigned int prefetch = 2);
+  virtual ~InputHttp();
+
+  InputHttp(const InputHttp& other) = delete;
+  InputHttp& operator=(const InputHttp& other) = delete;
+
+  static std::string findNextLink(const std::string& page);
+
+  virtual std::istream& open();
+  virtual std::istream* next(const std::string& nextLink);
+};
+
 #endif // INPUT_H_
\ No newline at end of file
@@ -19,8 +19,11 @@
 */
 
 #include <algorithm>
+#include <cmath>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <stdexcept>
@@ -41,18 +44,129 @@
   @param label
     Human-readable (i.e. nice/explanatory) label for the measure
 
+  @param alloc
+    The allocator for the measure's data, by default using the default memory
+    resource
+
   @example
     std::string codename = "Pop";
     std::string label = "Population";
     Measure measure(codename, label);
 */
-Measure::Measure(std::string codename, const std::string& label)
-    : mLabel(label), mData(), mSum(0) {
+Measure::Measure(std::string codename,
+                 const std::string& label,
+                 const allocator_type& alloc)
+    : mCodename(),
+      mLabel(std::make_shared<const std::string>(label)),
+      mData(alloc),
+      mSum(0),
+      mMin(std::numeric_limits<Measure_t>::infinity()),
+      mMax(-std::numeric_limits<Measure_t>::infinity()),
+      mMean(0),
+      mSquares(0),
+      mPrefixSums(alloc),
+      mPrefixCounts(alloc),
+      mPrefixFirstYear(0),
+      mPrefixValid(false) {
   std::transform(codename.begin(),
                  codename.end(),
                  codename.begin(),
                  ::tolower);
-   mCodename = std::move(codename);
+  mCodename = std::make_shared<const std::string>(std::move(codename));
+}
+
+/*
+  Construct a Measure from strings interned in a SymbolTable. Unlike the
+  constructor above, the codename is not converted to lowercase, so the
+  caller must intern the lowercase codename.
+
+  @param codename
+    The interned (lowercase) codename for the measure
+
+  @param label
+    The interned human-readable label for the measure
+
+  @param alloc
+    The allocator for the measure's data
+
+  @example
+    SymbolTable symbols;
+    Symbol code = symbols.intern("pop");
+    Symbol label = symbols.intern("Population");
+    Measure measure(symbols.ref(code), symbols.ref(label));
+*/
+Measure::Measure(const SymbolRef& codename,
+                 const SymbolRef& label,
+                 const allocator_type& alloc)
+    : mCodename(codename),
+      mLabel(label),
+      mData(alloc),
+      mSum(0),
+      mMin(std::numeric_limits<Measure_t>::infinity()),
+      mMax(-std::numeric_limits<Measure_t>::infinity()),
+      mMean(0),
+      mSquares(0),
+      mPrefixSums(alloc),
+      mPrefixCounts(alloc),
+      mPrefixFirstYear(0),
+      mPrefixValid(false) {}
+
+/*
+  Copy a Measure into memory from the given allocator. This is used by
+  std::pmr containers when a Measure is inserted into them.
+
+  @param other
+    The Measure to copy
+
+  @param alloc
+    The allocator for the copy's data
+*/
+Measure::Measure(const Measure& other, const allocator_type& alloc)
+    : mCodename(other.mCodename),
+      mLabel(other.mLabel),
+      mData(other.mData, alloc),
+      mSum(other.mSum),
+      mMin(other.mMin),
+      mMax(other.mMax),
+      mMean(other.mMean),
+      mSquares(other.mSquares),
+      mPrefixSums(alloc),
+      mPrefixCounts(alloc),
+      mPrefixFirstYear(0),
+      mPrefixValid(false) {}
+
+/*
+  Move a Measure into memory from the given allocator. If the allocators
+  differ, the data is copied rather than moved.
+
+  @param other
+    The Measure to move
+
+  @param alloc
+    The allocator for the new Measure's data
+*/
+Measure::Measure(Measure&& other, const allocator_type& alloc)
+    : mCodename(std::move(other.mCodename)),
+      mLabel(std::move(other.mLabel)),
+      mData(std::move(other.mData), alloc),
+      mSum(other.mSum),
+      mMin(other.mMin),
+      mMax(other.mMax),
+      mMean(other.mMean),
+      mSquares(other.mSquares),
+      mPrefixSums(alloc),
+      mPrefixCounts(alloc),
+      mPrefixFirstYear(0),
+      mPrefixValid(false) {}
+
+/*
+  Retrieve the allocator this Measure's data is allocated from.
+
+  @return
+    The allocator
+*/
+Measure::allocator_type Measure::get_allocator() const noexcept {
+  return mData.get_allocator();
 }
 
 /*
@@ -74,7 +188,9 @@ Measure::Measure(std::string codename, const std::string& label)
     ...
     auto code = measure.getCodename();
 */
-const std::string& Measure::getCodename() const noexcept { return mCodename; }
+const std::string& Measure::getCodename() const noexcept {
+  return *mCodename;
+}
 
 /*
   TODO: Measure::getLabel()
@@ -95,7 +211,24 @@ const std::string& Measure::getCodename() const noexcept { return mCodename; }
     ...
     auto label = measure.getLabel();
 */
-const std::string& Measure::getLabel() const noexcept { return mLabel; }
+const std::string& Measure::getLabel() const noexcept { return *mLabel; }
+
+/*
+  Retrieve the shared storage for the Measure's codename, e.g. so that an
+  Area can key its container with it without copying the string.
+
+  @return
+    A shared reference to the codename
+*/
+const SymbolRef& Measure::getCodenameRef() const noexcept { return mCodename; }
+
+/*
+  Retrieve the shared storage for the Measure's label.
+
+  @return
+    A shared reference to the label
+*/
+const SymbolRef& Measure::getLabelRef() const noexcept { return mLabel; }
 
 /*
   TODO: Measure::setLabel(label)
@@ -111,12 +244,24 @@ const std::string& Measure::getLabel() const noexcept { return mLabel; }
     ...
     measure.setLabel("New Population");
 */
-void Measure::setLabel(const std::string& label) { mLabel = label; }
+void Measure::setLabel(const std::string& label) {
+  if (*mLabel != label) {
+    mLabel = std::make_shared<const std::string>(label);
+  }
+}
+
+void Measure::setLabel(const SymbolRef& label) {
+  if (label) {
+    mLabel = label;
+  }
+}
 
 /*
   TODO: Measure::getValue(key)
 
-  Retrieve a Measure's value for a given year.
+  Retrieve a Measure's value for a given year. The value is read-only, so
+  that it is only changed with setValue(), which keeps the bounds, moments,
+  and sums of the Measure up to date.
 
   @param key
     The year to find the value for
@@ -140,7 +285,7 @@ void Measure::setLabel(const std::string& label) { mLabel = label; }
     ...
     auto value = measure.getValue(1999); // returns 12345678.9
 */
-Measure_t& Measure::getValue(const int& key) {
+const Measure_t& Measure::getValue(const int& key) const {
   try {
     return mData.at(key);
   } catch (const std::out_of_range& ex) {
@@ -171,25 +316,107 @@ Measure_t& Measure::getValue(const int& key) {
     measure.setValue(1999, 12345678.9);
 */
 void Measure::setValue(const int& key, const Measure_t& value) {
+  // Replacing the smallest or largest value may narrow the bounds, which
+  // only a look at every value can tell
+  bool narrowed = false;
   auto existingIt = mData.find(key);
   if (existingIt != mData.end()) {
     mSum -= existingIt->second;
+    removeFromMoments(existingIt->second, mData.size());
+    narrowed = existingIt->second != value &&
+               (existingIt->second == mMin || existingIt->second == mMax);
     mData.erase(key);
   }
   
   mSum += value;
   mData.emplace(key, value);
+  addToMoments(value, mData.size());
+  mPrefixValid = false;
+
+  if (narrowed) {
+    recomputeBounds();
+  } else {
+    widenBounds(value);
+  }
 }
 
 void Measure::setValue(const int& key, const Measure_t&& value) {
-  auto existingIt = mData.find(key);
-  if (existingIt != mData.end()) {
-    mSum -= existingIt->second;
-    mData.erase(key);
+  setValue(key, value);
+}
+
+/*
+  Merge another Measure into this one, consuming it. As with setValue(), the
+  incoming values take precedence over those in this Measure, as does the
+  incoming label unless policy is MergePolicy::Import.
+
+  Values for years we do not have are moved across by splicing the nodes of
+  the other Measure's container into ours, which is possible when both
+  Measures allocate from the same memory resource (e.g. within an Areas
+  instance). Otherwise, they are copied as with setValue().
+
+  @param other
+    The Measure to merge into this one, which is left empty
+
+  @param policy
+    Whether to take the incoming label (MergePolicy::Replace) or keep ours
+    (MergePolicy::Import)
+
+  @example
+    Measure measure("pop", "Population");
+    measure.setValue(1999, 12345678.9);
+
+    Measure update("pop", "Population");
+    update.setValue(1999, 12345679.9);
+    update.setValue(2000, 12345680.9);
+
+    measure.merge(std::move(update)); // 1999 is now 12345679.9
+*/
+void Measure::merge(Measure&& other, MergePolicy policy) {
+  if (policy == MergePolicy::Replace) {
+    setLabel(other.mLabel);
   }
 
-  mSum += value;
-  mData.emplace(key, std::move(value));
+  // Update the years we already have, and keep the sum in the same order as
+  // setValue() would, so merging gives exactly the same result
+  bool narrowed = false;
+  size_t count = mData.size();
+  for (auto it = other.mData.cbegin(); it != other.mData.cend(); it++) {
+    auto existingIt = mData.find(it->first);
+    if (existingIt != mData.end()) {
+      mSum -= existingIt->second;
+      removeFromMoments(existingIt->second, count--);
+      narrowed = narrowed ||
+                 (existingIt->second != it->second &&
+                  (existingIt->second == mMin || existingIt->second == mMax));
+      existingIt->second = it->second;
+    }
+    mSum += it->second;
+    addToMoments(it->second, ++count);
+  }
+
+  if (mData.get_allocator() == other.mData.get_allocator()) {
+    // Only the years not already in mData are spliced
+    mData.merge(other.mData);
+  } else {
+    mData.insert(other.mData.cbegin(), other.mData.cend());
+  }
+
+  if (narrowed) {
+    recomputeBounds();
+  } else {
+    widenBounds(other.mMin);
+    widenBounds(other.mMax);
+  }
+
+  other.mData.clear();
+  other.mSum = 0;
+  other.mMin = std::numeric_limits<Measure_t>::infinity();
+  other.mMax = -std::numeric_limits<Measure_t>::infinity();
+  other.mMean = 0;
+  other.mSquares = 0;
+
+  mPrefixValid = false;
+  other.mPrefixValid = false;
 }
 
 /*
@@ -214,6 +441,39 @@ size_t Measure::size() const noexcept {
   return mData.size();
 }
 
+/*
+  Retrieve the running sum of the values, as kept by setValue() for
+  getAverage().
+
+  @return
+    The sum of the values
+*/
+double Measure::getSum() const noexcept {
+  return mSum;
+}
+
+/*
+  Restore the running sum of the values. The sum depends (in its last bits)
+  on the order the values were set in, so a Measure rebuilt in a different
+  order (e.g. from a DatasetSnapshot, in year order) restores the sum it had
+  when it was saved to give exactly the same averages. This is private, as
+  setting any other sum would make the Measure inconsistent, and is only
+  called by DatasetSnapshot::restore().
+
+  @param sum
+    The sum returned by getSum() when the values were saved
+
+  @example
+    Measure copy("pop", "Population");
+    for (auto it = measure.cbegin(); it != measure.cend(); it++) {
+      copy.setValue(it->first, it->second);
+    }
+    copy.restoreSum(measure.getSum());
+*/
+void Measure::restoreSum(double sum) noexcept {
+  mSum = sum;
+}
+
 /*
   TODO: Measure::getDifference()
 
@@ -232,11 +492,7 @@ size_t Measure::size() const noexcept {
     auto diff = measure.getDifference(); // returns 1.0
 */
 Measure_t Measure::getDifference() const noexcept {
-  if (size() == 0) {
-    return 0;
-  }
-
-  return crbegin()->second - cbegin()->second;
+  return getLast() - getFirst();
 }
 
 /*
@@ -288,6 +544,426 @@ double Measure::getAverage() const noexcept {
   return mSum/size();
 }
 
+/*
+  Widen the bounds of the values to include a value.
+
+  @param value
+    The value
+*/
+void Measure::widenBounds(Measure_t value) noexcept {
+  if (value < mMin) {
+    mMin = value;
+  }
+  if (value > mMax) {
+    mMax = value;
+  }
+}
+
+/*
+  Find the bounds of the values again, after the smallest or largest value
+  has been replaced.
+*/
+void Measure::recomputeBounds() noexcept {
+  mMin = std::numeric_limits<Measure_t>::infinity();
+  mMax = -std::numeric_limits<Measure_t>::infinity();
+  for (auto it = mData.cbegin(); it != mData.cend(); it++) {
+    widenBounds(it->second);
+  }
+}
+
+/*
+  Add a value to the running mean and sum of squared differences from the
+  mean (Welford's algorithm).
+
+  @param value
+    The value added
+
+  @param count
+    The number of values, including the one added
+*/
+void Measure::addToMoments(Measure_t value, size_t count) noexcept {
+  const double delta = value - mMean;
+  mMean += delta / count;
+  mSquares += delta * (value - mMean);
+}
+
+/*
+  Remove a value from the running mean and sum of squared differences, by
+  undoing the step of Welford's algorithm that added it, e.g. when
+  setValue() replaces the value of a year.
+
+  @param value
+    The value removed
+
+  @param count
+    The number of values, including the one removed
+*/
+void Measure::removeFromMoments(Measure_t value, size_t count) noexcept {
+  if (count <= 1) {
+    mMean = 0;
+    mSquares = 0;
+    return;
+  }
+
+  const double mean = mMean - (value - mMean) / (count - 1);
+  mSquares -= (value - mMean) * (value - mean);
+  mMean = mean;
+
+  // Rounding may leave the sum a little below 0
+  if (mSquares < 0) {
+    mSquares = 0;
+  }
+}
+
+/*
+  Retrieve the smallest value, as kept by setValue(). This function
+  should be callable from a constant context and must promise to not change
+  the state of the instance or throw an exception.
+
+  @return
+    The smallest value, or 0 if there are none
+
+  @example
+    Measure measure("pop", "Population");
+    measure.setValue(1999, 12345678.9);
+    measure.setValue(2000, 12345679.9);
+    auto min = measure.getMin(); // returns 12345678.9
+*/
+Measure_t Measure::getMin() const noexcept {
+  if (size() == 0) {
+    return 0;
+  }
+
+  return mMin;
+}
+
+/*
+  Retrieve the largest value, as kept by setValue(). This function
+  should be callable from a constant context and must promise to not change
+  the state of the instance or throw an exception.
+
+  @return
+    The largest value, or 0 if there are none
+
+  @example
+    Measure measure("pop", "Population");
+    measure.setValue(1999, 12345678.9);
+    measure.setValue(2000, 12345679.9);
+    auto max = measure.getMax(); // returns 12345679.9
+*/
+Measure_t Measure::getMax() const noexcept {
+  if (size() == 0) {
+    return 0;
+  }
+
+  return mMax;
+}
+
+/*
+  Retrieve the value of the first year. This function should be callable
+  from a constant context and must promise to not change the state of the
+  instance or throw an exception.
+
+  @return
+    The value of the first year, or 0 if there are none
+
+  @example
+    Measure measure("pop", "Population");
+    measure.setValue(2000, 12345679.9);
+    measure.setValue(1999, 12345678.9);
+    auto first = measure.getFirst(); // returns 12345678.9
+*/
+Measure_t Measure::getFirst() const noexcept {
+  if (size() == 0) {
+    return 0;
+  }
+
+  return cbegin()->second;
+}
+
+/*
+  Retrieve the value of the last year. This function should be callable
+  from a constant context and must promise to not change the state of the
+  instance or throw an exception.
+
+  @return
+    The value of the last year, or 0 if there are none
+
+  @example
+    Measure measure("pop", "Population");
+    measure.setValue(2000, 12345679.9);
+    measure.setValue(1999, 12345678.9);
+    auto last = measure.getLast(); // returns 12345679.9
+*/
+Measure_t Measure::getLast() const noexcept {
+  if (size() == 0) {
+    return 0;
+  }
+
+  return crbegin()->second;
+}
+
+/*
+  Retrieve the (population) variance of the values, as kept by setValue().
+  This function should be callable from a constant context and must promise
+  to not change the state of the instance or throw an exception.
+
+  @return
+    The variance of the values, or 0 if there are none
+
+  @example
+    Measure measure("pop", "Population");
+    measure.setValue(1999, 2);
+    measure.setValue(2000, 4);
+    auto variance = measure.getVariance(); // returns 1
+*/
+double Measure::getVariance() const noexcept {
+  if (size() == 0) {
+    return 0;
+  }
+
+  return mSquares / size();
+}
+
+/*
+  Retrieve the (population) standard deviation of the values. This function
+  should be callable from a constant context and must promise to not change
+  the state of the instance or throw an exception.
+
+  @return
+    The standard deviation of the values, or 0 if there are none
+
+  @example
+    Measure measure("pop", "Population");
+    measure.setValue(1999, 2);
+    measure.setValue(2000, 4);
+    auto sd = measure.getStandardDeviation(); // returns 1
+*/
+double Measure::getStandardDeviation() const noexcept {
+  return std::sqrt(getVariance());
+}
+
+/*
+  Build the running totals by year for the sums and counts of ranges of
+  years, if they are not already built. The totals are kept for each year
+  from the first to the last, so a range is found from two of them.
+
+  @return
+    false if the years span more than MEASURE_PREFIX_MAX_SPAN years, so the
+    totals are not kept
+*/
+bool Measure::buildPrefixIndex() const {
+  if (mPrefixValid) {
+    return true;
+  }
+
+  if (size() == 0) {
+    mPrefixSums.assign(1, 0.0);
+    mPrefixCounts.assign(1, 0);
+    mPrefixFirstYear = 0;
+    mPrefixValid = true;
+    return true;
+  }
+
+  const int first = cbegin()->first;
+  const long long span = static_cast<long long>(crbegin()->first) - first + 1;
+  if (span > MEASURE_PREFIX_MAX_SPAN) {
+    return false;
+  }
+
+  mPrefixSums.assign(span + 1, 0.0);
+  mPrefixCounts.assign(span + 1, 0);
+  auto it = cbegin();
+  for (long long i = 0; i < span; i++) {
+    mPrefixSums[i + 1] = mPrefixSums[i];
+    mPrefixCounts[i + 1] = mPrefixCounts[i];
+    if (it != cend() && it->first == first + i) {
+      mPrefixSums[i + 1] += it->second;
+      mPrefixCounts[i + 1]++;
+      it++;
+    }
+  }
+
+  mPrefixFirstYear = first;
+  mPrefixValid = true;
+  return true;
+}
+
+/*
+  Retrieve the number of years with a value in a range of years. The first
+  query of a range builds running totals by year, after which each query
+  takes the same time however many years it covers, until a value is set.
+
+  @param from
+    The first year of the range
+
+  @param to
+    The last year of the range (inclusive)
+
+  @return
+    The number of years with a value in the range
+
+  @example
+    Measure measure("pop", "Population");
+    measure.setValue(2010, 1);
+    measure.setValue(2012, 2);
+    auto count = measure.getCount(2011, 2015); // returns 1
+*/
+size_t Measure::getCount(int from, int to) const {
+  if (from > to || size() == 0) {
+    return 0;
+  }
+
+  if (!buildPrefixIndex()) {
+    return std::distance(mData.lower_bound(from), mData.upper_bound(to));
+  }
+
+  const long long last = mPrefixFirstYear +
+                         static_cast<long long>(mPrefixCounts.size()) - 2;
+  const long long begin = std::max<long long>(from, mPrefixFirstYear);
+  const long long end = std::min<long long>(to, last);
+  if (begin > end) {
+    return 0;
+  }
+
+  return mPrefixCounts[end - mPrefixFirstYear + 1] -
+         mPrefixCounts[begin - mPrefixFirstYear];
+}
+
+/*
+  Retrieve the sum of the values in a range of years, from the running
+  totals by year as with getCount().
+
+  @param from
+    The first year of the range
+
+  @param to
+    The last year of the range (inclusive)
+
+  @return
+    The sum of the values in the range, or 0 if there are none
+
+  @example
+    Measure measure("pop", "Population");
+    measure.setValue(2010, 1);
+    measure.setValue(2012, 2);
+    measure.setValue(2013, 3);
+    auto sum = measure.getSum(2011, 2015); // returns 5
+*/
+double Measure::getSum(int from, int to) const {
+  if (from > to || size() == 0) {
+    return 0;
+  }
+
+  if (!buildPrefixIndex()) {
+    double sum = 0;
+    for (auto it = mData.lower_bound(from);
+         it != mData.end() && it->first <= to;
+         it++) {
+      sum += it->second;
+    }
+    return sum;
+  }
+
+  const long long last = mPrefixFirstYear +
+                         static_cast<long long>(mPrefixSums.size()) - 2;
+  const long long begin = std::max<long long>(from, mPrefixFirstYear);
+  const long long end = std::min<long long>(to, last);
+  if (begin > end) {
+    return 0;
+  }
+
+  return mPrefixSums[end - mPrefixFirstYear + 1] -
+         mPrefixSums[begin - mPrefixFirstYear];
+}
+
+/*
+  Calculate the average/mean of the values in a range of years, from the
+  running totals by year as with getCount().
+
+  @param from
+    The first year of the range
+
+  @param to
+    The last year of the range (inclusive)
+
+  @return
+    The average of the values in the range, or 0 if there are none
+
+  @example
+    Measure measure("pop", "Population");
+    measure.setValue(2010, 1);
+    measure.setValue(2012, 2);
+    measure.setValue(2013, 3);
+    auto average = measure.getAverage(2011, 2015); // returns 2.5
+*/
+double Measure::getAverage(int from, int to) const {
+  const size_t count = getCount(from, to);
+  if (count == 0) {
+    return 0;
+  }
+
+  return getSum(from, to) / count;
+}
+
+/*
+  Check, from the bounds of the values alone, whether any value may be in a
+  range. If not, the values need not be looked at.
+
+  @param low
+    The smallest value of the range (inclusive), which may be -infinity
+
+  @param high
+    The largest value of the range (inclusive), which may be infinity
+
+  @return
+    false if no value is in the range, or true if one may be
+*/
+bool Measure::mayHaveValueBetween(Measure_t low, Measure_t high) const
+    noexcept {
+  return size() > 0 && low <= high && mMax >= low && mMin <= high;
+}
+
+/*
+  Check whether any value is in a range. The bounds of the values decide
+  this without looking at them unless the range lies strictly between the
+  smallest and largest value, e.g. whether the population has ever exceeded
+  100,000 is whether the largest value does.
+
+  @param low
+    The smallest value of the range (inclusive), which may be -infinity
+
+  @param high
+    The largest value of the range (inclusive), which may be infinity
+
+  @return
+    true if a value is in the range
+
+  @example
+    Measure measure("dens", "Population density");
+    ...
+    bool exceeded = measure.hasValueBetween(
+        std::nextafter(500.0, std::numeric_limits<double>::infinity()),
+        std::numeric_limits<double>::infinity());
+*/
+bool Measure::hasValueBetween(Measure_t low, Measure_t high) const noexcept {
+  if (!mayHaveValueBetween(low, high)) {
+    return false;
+  }
+
+  if (mMin >= low || mMax <= high) {
+    return true;
+  }
+
+  for (auto it = mData.cbegin(); it != mData.cend(); it++) {
+    if (it->second >= low && it->second <= high) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 /*
   TODO: operator<<(os, measure)
 
@@ -401,8 +1077,8 @@ std::ostream& operator<<(std::ostream& os, const Measure& measure) {
     otherwise
 */
 bool operator==(const Measure& lhs, const Measure& rhs) {
-  return lhs.mCodename == rhs.mCodename &&
-         lhs.mLabel    == rhs.mLabel &&
+  return *lhs.mCodename == *rhs.mCodename &&
+         *lhs.mLabel    == *rhs.mLabel &&
          lhs.mData     == rhs.mData &&
          lhs.mSum      == rhs.mSum;
 }
\ No newline at end of file
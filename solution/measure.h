@@ -14,9 +14,14 @@
   functions and member variables you need to declare in this class.
  */
 
+#include <cstddef>
 #include <iterator>
 #include <map>
+#include <memory_resource>
 #include <string>
+#include <vector>
+
+#include "symbols.h"
 
 /*
   For each set of data, we have a value for each individual measure over
@@ -33,13 +38,57 @@ using Measure_t = double;
 
 /*
   We declare Measure_c as the container for the year:value mappings (i.e. 
-  the Measure data container) as a shortcut.
+  the Measure data container) as a shortcut. The container takes its memory
+  from a std::pmr::memory_resource, so that Measures held by Areas can all be
+  allocated from (and released with) a single arena.
 */
-using Measure_c = std::map<int, Measure_t>;
+using Measure_c = std::pmr::map<int, Measure_t>;
+
+/*
+  How merging one Measure, Area or Areas instance into another treats the
+  labels and names that both already have. Values always take the incoming
+  value.
+
+  Replace — The incoming labels and names take precedence, as with setLabel(),
+            Area::setName(), and Areas::setArea().
+  Import  — The existing labels and names are kept, as happens when a dataset
+            is populated into an Areas instance that already has the Area or
+            Measure (i.e. the first dataset to name something wins).
+*/
+enum class MergePolicy {
+  Replace,
+  Import
+};
+
+/*
+  The widest range of years, from the first to the last, for which a Measure
+  keeps running totals by year. A Measure spanning more years finds the sums
+  of a range of years by iterating over its values.
+*/
+const int MEASURE_PREFIX_MAX_SPAN = 10000;
 
 /*
   The Measure class contains a measure code, label, and a container for readings
-  from across a number of years.
+  from across a number of years. The code and label are held as SymbolRefs, so
+  Measures created by Areas share the interned strings rather than each
+  holding a copy.
+
+  Measure is allocator-aware: a std::pmr container of Measures passes its
+  memory resource down to the Measures it holds. A copy made outside of such
+  a container uses the default memory resource.
+
+  Alongside the running sum, a Measure keeps the smallest and largest of its
+  values (a "zone map"), so a query for the series with a value in a range
+  can rule most of them out, or in, without looking at their values. It
+  also keeps their running mean and sum of squared differences from it
+  (with Welford's algorithm), so every summary of the values is found
+  without iterating over them.
+
+  The sums and counts of the values of a range of years (e.g. the average
+  population for 2011–2015) are found from running totals by year, which
+  are built by the first such query and thrown away when a value is set. As
+  that query builds them, a Measure must not be queried for a range of years
+  on two threads at once.
 
   TODO: Based on your implementation, there may be additional constructors
   or functions you implement here, and perhaps additional operators you may wish
@@ -47,61 +96,110 @@ using Measure_c = std::map<int, Measure_t>;
 */
 class Measure {
 private:
-  std::string mCodename;
-  std::string mLabel;
+  SymbolRef mCodename;
+  SymbolRef mLabel;
   Measure_c mData;
   double mSum;
+  Measure_t mMin;
+  Measure_t mMax;
+  double mMean;
+  double mSquares;
+
+  // The sums and counts of the values of the years before each year from
+  // mPrefixFirstYear, when mPrefixValid
+  mutable std::pmr::vector<double> mPrefixSums;
+  mutable std::pmr::vector<size_t> mPrefixCounts;
+  mutable int mPrefixFirstYear;
+  mutable bool mPrefixValid;
+
+  void widenBounds(Measure_t value) noexcept;
+  void recomputeBounds() noexcept;
+  void addToMoments(Measure_t value, size_t count) noexcept;
+  void removeFromMoments(Measure_t value, size_t count) noexcept;
+  bool buildPrefixIndex() const;
+
+  // Only a DatasetSnapshot, rebuilding a Measure it saved, restores its sum
+  void restoreSum(double sum) noexcept;
+  friend class DatasetSnapshot;
 
 public:
-  Measure(std::string code, const std::string& label);
+  using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+  Measure(std::string code,
+          const std::string& label,
+          const allocator_type& alloc = {});
+  Measure(const SymbolRef& codename,
+          const SymbolRef& label,
+          const allocator_type& alloc = {});
   ~Measure() = default;
 
   Measure(const Measure& other) = default;
+  Measure(const Measure& other, const allocator_type& alloc);
   Measure& operator=(const Measure& other) = default;
   Measure(Measure&& other) = default;
+  Measure(Measure&& other, const allocator_type& alloc);
   Measure& operator=(Measure&& other) = default;
 
+  allocator_type get_allocator() const noexcept;
+
   const std::string& getCodename() const noexcept;
   const std::string& getLabel() const noexcept;
+  const SymbolRef& getCodenameRef() const noexcept;
+  const SymbolRef& getLabelRef() const noexcept;
   void setLabel(const std::string& label);
+  void setLabel(const SymbolRef& label);
 
-  Measure_t& getValue(const int& key);
+  const Measure_t& getValue(const int& key) const;
   void setValue(const int& key, const Measure_t& value);
   void setValue(const int& key, const Measure_t&& value);
+  void merge(Measure&& other, MergePolicy policy = MergePolicy::Replace);
   size_t size() const noexcept;
+  double getSum() const noexcept;
 
   Measure_t getDifference() const noexcept;
   double getDifferenceAsPercentage() const noexcept;
   double getAverage() const noexcept;
+  Measure_t getMin() const noexcept;
+  Measure_t getMax() const noexcept;
+  Measure_t getFirst() const noexcept;
+  Measure_t getLast() const noexcept;
+  double getVariance() const noexcept;
+  double getStandardDeviation() const noexcept;
+  size_t getCount(int from, int to) const;
+  double getSum(int from, int to) const;
+  double getAverage(int from, int to) const;
+  bool mayHaveValueBetween(Measure_t low, Measure_t high) const noexcept;
+  bool hasValueBetween(Measure_t low, Measure_t high) const noexcept;
 
   friend std::ostream& operator<<(std::ostream& os, const Measure& measure);
   friend bool operator==(const Measure& lhs, const Measure& rhs);
 
   /*
-    Wrapper around underlying iterator functions for ease.
+    Wrapper around underlying iterator functions for ease. The values are
+    read-only, as with getValue().
   */
-  inline Measure_c::iterator begin() {
+  inline Measure_c::const_iterator begin() const {
     return mData.begin();
   }
   inline Measure_c::const_iterator cbegin() const {
     return mData.cbegin();
   }
 
-  inline Measure_c::iterator end() {
+  inline Measure_c::const_iterator end() const {
     return mData.end();
   }
   inline Measure_c::const_iterator cend() const {
     return mData.cend();
   }
 
-  inline Measure_c::reverse_iterator rbegin() {
+  inline Measure_c::const_reverse_iterator rbegin() const {
     return mData.rbegin();
   }
   inline Measure_c::const_reverse_iterator crbegin() const {
     return mData.crbegin();
   }
 
-  inline Measure_c::reverse_iterator rend() {
+  inline Measure_c::const_reverse_iterator rend() const {
     return mData.rend();
   }
   inline Measure_c::const_reverse_iterator crend() const {
@@ -0,0 +1,981 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the implementation of the IngestPipeline class. See the
+  header file for additional comments.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <exception>
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "lib_json.hpp"
+
+#include "cell.h"
+#include "pipeline.h"
+#include "projection.h"
+#include "structural.h"
+
+using json = nlohmann::json;
+
+/*
+  The size of the blocks the reader reads, which are cut at the end of the
+  last whole row in them.
+*/
+const size_t INGEST_BLOCK_SIZE = 256 * 1024;
+
+/*
+  How many blocks the reader may read ahead of the inserter, per parser.
+*/
+const size_t INGEST_WINDOW_PER_PARSER = 4;
+
+/*
+  How many times a stage retries a full (or empty) queue straight away
+  before it starts to sleep between tries.
+*/
+const unsigned int INGEST_SPINS = 64;
+
+/*
+  The totals reported by getIngestStats(), which each IngestPipeline adds to
+  as it finishes.
+*/
+static std::atomic<unsigned int> ingestPipelines(0);
+static std::atomic<uint64_t> ingestStats[3][4];
+
+/*
+  Add the work of a stage to the totals.
+*/
+static void addIngestStats(unsigned int stage, const IngestStageStats& stats) {
+  ingestStats[stage][0] += stats.blocks;
+  ingestStats[stage][1] += stats.amount;
+  ingestStats[stage][2] += stats.busy.count();
+  ingestStats[stage][3] += stats.stalls;
+}
+
+/*
+  Retrieve the totals of a stage.
+*/
+static IngestStageStats getIngestStageStats(unsigned int stage) noexcept {
+  return IngestStageStats{
+      ingestStats[stage][0],
+      ingestStats[stage][1],
+      std::chrono::nanoseconds(ingestStats[stage][2]),
+      ingestStats[stage][3]};
+}
+
+/*
+  Wait a little before trying a queue again: at first by yielding, and then,
+  if the other stages are taking a while (e.g. the reader waiting for the
+  disk), by sleeping so as not to keep a core busy.
+*/
+static void backOff(unsigned int& spins) {
+  if (spins < INGEST_SPINS) {
+    spins++;
+    std::this_thread::yield();
+  } else {
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+}
+
+/*
+  Retrieve the work done by each stage of every IngestPipeline so far.
+
+  @return
+    The totals
+
+  @example
+    IngestStats stats = getIngestStats();
+    std::cerr << stats.parse.amount << " rows parsed";
+*/
+IngestStats getIngestStats() noexcept {
+  return IngestStats{ingestPipelines,
+                     getIngestStageStats(0),
+                     getIngestStageStats(1),
+                     getIngestStageStats(2)};
+}
+
+/*
+  Constructor for a pipeline that parses a stream, starting the reader and
+  the parsers.
+
+  @param is
+    The stream, which for a CSV file has had its header row read already, and
+    which is only read by the reader until the pipeline is destroyed
+
+  @param type
+    The type of the data in the stream
+
+  @param cols
+    The column mapping for the data
+
+  @param measuresFilter
+    The measures to import, or nullptr or an empty set for all
+
+  @param yearsFilter
+    The years to import, or nullptr or <0,0> for all
+
+  @param valueFilter
+    The ValueFilter of the rows to import, or nullptr for all
+
+  @param colHeaders
+    The year of each column of an AuthorityByYearCSV file, or -1 for the
+    authority code column (see Areas::parseAuthorityByYearHeader())
+
+  @param firstLine
+    The line number of the first line to be read from the stream
+
+  @param parsers
+    The number of parser threads
+
+  @throws
+    std::out_of_range if cols is missing a column the parsers need
+
+  @example
+    IngestPipeline pipeline(is, BethYw::WelshStatsJSON, cols, nullptr,
+                            nullptr, nullptr, {}, 1, 4);
+    IngestBatch batch;
+    while (pipeline.next(batch)) {
+      ...
+    }
+*/
+IngestPipeline::IngestPipeline(
+    std::istream& is,
+    BethYw::SourceDataType type,
+    const BethYw::SourceColumnMapping& cols,
+    const std::unordered_set<std::string>* measuresFilter,
+    const std::tuple<unsigned int, unsigned int>* yearsFilter,
+    const ValueFilter* valueFilter,
+    const std::vector<int>& colHeaders,
+    unsigned int firstLine,
+    unsigned int parsers)
+    : mStream(is),
+      mType(type),
+      mMeasuresFilter(measuresFilter != nullptr && !measuresFilter->empty()
+                          ? measuresFilter
+                          : nullptr),
+      mYearsFilter(yearsFilter != nullptr &&
+                           std::get<0>(*yearsFilter) != 0 &&
+                           std::get<1>(*yearsFilter) != 0
+                       ? yearsFilter
+                       : nullptr),
+      mValueFilter(valueFilter != nullptr && valueFilter->hasRowPredicate()
+                       ? valueFilter
+                       : nullptr),
+      mColHeaders(colHeaders),
+      mFirstLine(firstLine),
+      mColCode(),
+      mColName(),
+      mColMeasureCode(),
+      mColMeasureName(),
+      mColYear(),
+      mColValue(),
+      mMultipleMeasures(true),
+      mValueMeasureCode(),
+      mProjection({}),
+      mWindow(INGEST_WINDOW_PER_PARSER * std::max(parsers, 1u)),
+      mBlocks(mWindow),
+      mBatches(mWindow),
+      mPending(),
+      mStopping(false),
+      mReadEnded(false),
+      mReadCount(0),
+      mApplied(0),
+      mNextSeq(0),
+      mReader(),
+      mParsers(),
+      mLastReturn(),
+      mInsertStats{0, 0, std::chrono::nanoseconds(0), 0} {
+  if (mType == BethYw::WelshStatsJSON) {
+    try {
+      mColCode = cols.at(BethYw::AUTH_CODE);
+      mColName = cols.at(BethYw::AUTH_NAME_ENG);
+      mColYear = cols.at(BethYw::YEAR);
+      mColValue = cols.at(BethYw::VALUE);
+    } catch (const std::out_of_range& ex) {
+      throw std::out_of_range("Areas::populateFromWelshStatsJSON: "
+                              "Incomplete column specification!");
+    }
+
+    try {
+      mColMeasureCode = cols.at(BethYw::MEASURE_CODE);
+      mColMeasureName = cols.at(BethYw::MEASURE_NAME);
+    } catch (const std::out_of_range& ex) {
+      try {
+        mColMeasureCode = cols.at(BethYw::SINGLE_MEASURE_CODE);
+        mColMeasureName = cols.at(BethYw::SINGLE_MEASURE_NAME);
+        mMultipleMeasures = false;
+      } catch (const std::out_of_range& ex2) {
+        throw std::out_of_range("Areas::populateFromWelshStatsJSON: "
+                                "Incomplete column specification, "
+                                "no measure details specified!");
+      }
+    }
+
+    std::vector<std::string> columns = {mColCode,
+                                        mColName,
+                                        mColYear,
+                                        mColValue};
+    if (mMultipleMeasures) {
+      columns.push_back(mColMeasureCode);
+      columns.push_back(mColMeasureName);
+    }
+    mProjection = JSONProjection(columns);
+  }
+
+  // The rows of a dataset with a single measure are compared by the value
+  // filter as rows of that measure, whose code is lowercased as in the Areas
+  if (mType == BethYw::AuthorityByYearCSV) {
+    auto it = cols.find(BethYw::SINGLE_MEASURE_CODE);
+    if (it != cols.end()) {
+      mValueMeasureCode = it->second;
+    }
+  } else if (!mMultipleMeasures) {
+    mValueMeasureCode = mColMeasureCode;
+  }
+  std::transform(mValueMeasureCode.begin(),
+                 mValueMeasureCode.end(),
+                 mValueMeasureCode.begin(),
+                 ::tolower);
+
+  mReader = std::thread(&IngestPipeline::readBlocks, this);
+  for (unsigned int i = 0; i < std::max(parsers, 1u); i++) {
+    mParsers.emplace_back(&IngestPipeline::parseBlocks, this);
+  }
+
+  mLastReturn = std::chrono::steady_clock::now();
+}
+
+/*
+  Stop the stages, e.g. if the inserter stopped part way through because of
+  an error, and add their work to the totals.
+*/
+IngestPipeline::~IngestPipeline() {
+  stop();
+
+  mInsertStats.busy += std::chrono::steady_clock::now() - mLastReturn;
+  addIngestStats(2, mInsertStats);
+  ingestPipelines++;
+}
+
+/*
+  Stop the reader and the parsers, waiting for them to finish.
+*/
+void IngestPipeline::stop() {
+  mStopping = true;
+  if (mReader.joinable()) {
+    mReader.join();
+  }
+  for (auto it = mParsers.begin(); it != mParsers.end(); it++) {
+    if (it->joinable()) {
+      it->join();
+    }
+  }
+}
+
+/*
+  Check whether the WelshStatsJSON rows have a measure code column, or the
+  dataset has a single measure, given by getSingleMeasureCode() and
+  getSingleMeasureName().
+
+  @return
+    true if the rows have a measure code column
+*/
+bool IngestPipeline::isMultipleMeasures() const noexcept {
+  return mMultipleMeasures;
+}
+
+/*
+  @return
+    The code of the single measure of a WelshStatsJSON dataset, as in cols
+*/
+const std::string& IngestPipeline::getSingleMeasureCode() const noexcept {
+  return mColMeasureCode;
+}
+
+/*
+  @return
+    The name of the single measure of a WelshStatsJSON dataset
+*/
+const std::string& IngestPipeline::getSingleMeasureName() const noexcept {
+  return mColMeasureName;
+}
+
+/*
+  Pass a block to the parsers, waiting while the reader is as far ahead of
+  the inserter as it may be, or the queue is full.
+
+  @param block
+    The block
+
+  @param stats
+    The reader's work, to count any stall in (and take the time stalled
+    from)
+
+  @return
+    false if the pipeline is stopping
+*/
+bool IngestPipeline::pushBlock(IngestBlock&& block, IngestStageStats& stats) {
+  unsigned int spins = 0;
+  std::chrono::steady_clock::time_point stalled;
+  while (block.seq >= mApplied.load(std::memory_order_acquire) + mWindow ||
+         !mBlocks.tryPush(std::move(block))) {
+    if (mStopping) {
+      return false;
+    }
+    if (spins == 0) {
+      stalled = std::chrono::steady_clock::now();
+      stats.stalls++;
+    }
+    backOff(spins);
+  }
+
+  if (spins > 0) {
+    stats.busy -= std::chrono::steady_clock::now() - stalled;
+  }
+  return true;
+}
+
+/*
+  The reader: read the stream in blocks of whole rows and pass them to the
+  parsers. An error reading the stream is passed on in place of the next
+  block, for the inserter to throw.
+*/
+void IngestPipeline::readBlocks() {
+  IngestStageStats stats{0, 0, std::chrono::nanoseconds(0), 0};
+  const auto start = std::chrono::steady_clock::now();
+  uint64_t seq = 0;
+
+  try {
+    if (mType == BethYw::WelshStatsJSON) {
+      readJSONBlocks(seq, stats);
+    } else {
+      readCSVBlocks(seq, stats);
+    }
+  } catch (...) {
+    IngestBlock error{seq, 0, std::string(), {}, std::current_exception()};
+    if (pushBlock(std::move(error), stats)) {
+      seq++;
+    }
+  }
+
+  mReadCount.store(seq, std::memory_order_release);
+  mReadEnded.store(true, std::memory_order_release);
+
+  stats.blocks = seq;
+  stats.busy += std::chrono::steady_clock::now() - start;
+  addIngestStats(0, stats);
+}
+
+/*
+  Read the lines of a CSV file in blocks, each cut after its last newline.
+
+  @param seq
+    The sequence number of the next block, which is updated
+
+  @param stats
+    The reader's work
+*/
+void IngestPipeline::readCSVBlocks(uint64_t& seq, IngestStageStats& stats) {
+  IngestBlock block{0, 0, std::string(), {}, nullptr};
+  unsigned int line = mFirstLine;
+  std::string carry;
+
+  for (;;) {
+    block.text = std::move(carry);
+    carry = std::string();
+
+    const size_t kept = block.text.size();
+    block.text.resize(kept + INGEST_BLOCK_SIZE);
+    mStream.read(&block.text[kept], INGEST_BLOCK_SIZE);
+    const size_t length = static_cast<size_t>(mStream.gcount());
+    block.text.resize(kept + length);
+    stats.amount += length;
+
+    const bool ended = length < INGEST_BLOCK_SIZE;
+    if (!ended) {
+      const size_t cut = block.text.rfind('\n');
+      if (cut == std::string::npos) {
+        // The line is longer than a block, so keep reading it
+        carry = std::move(block.text);
+        continue;
+      }
+      carry.assign(block.text, cut + 1, std::string::npos);
+      block.text.resize(cut + 1);
+    }
+
+    if (!block.text.empty()) {
+      const unsigned int lines = static_cast<unsigned int>(
+          std::count(block.text.cbegin(), block.text.cend(), '\n'));
+      block.seq = seq;
+      block.firstLine = line;
+      line += lines;
+
+      if (!pushBlock(std::move(block), stats)) {
+        return;
+      }
+      seq++;
+      block = IngestBlock{0, 0, std::string(), {}, nullptr};
+    }
+
+    if (ended) {
+      break;
+    }
+  }
+}
+
+/*
+  Read the rows of a WelshStatsJSON file in blocks. The rows are the objects
+  in the top-level "value" array, which are found by tracking the nesting of
+  objects and arrays at the structural characters found by a
+  StructuralScanner, as RowIndex does, without parsing them.
+
+  @param seq
+    The sequence number of the next block, which is updated
+
+  @param stats
+    The reader's work
+
+  @throws
+    std::runtime_error if the stream is not a complete JSON document
+*/
+void IngestPipeline::readJSONBlocks(uint64_t& seq, IngestStageStats& stats) {
+  IngestBlock block{0, 0, std::string(), {}, nullptr};
+  std::string chunk(INGEST_BLOCK_SIZE, '\0');
+
+  size_t depth = 0;
+  bool inString = false;
+  bool inValue = false;
+  bool inRow = false;
+  bool started = false;
+  std::string key;
+  size_t keyBegin = 0;
+  size_t rowBegin = 0;
+
+  StructuralScanner scanner(ScanFormat::JSON);
+  std::vector<size_t> positions;
+
+  for (;;) {
+    mStream.read(&chunk[0], INGEST_BLOCK_SIZE);
+    const size_t length = static_cast<size_t>(mStream.gcount());
+    stats.amount += length;
+
+    for (size_t i = 0; !started && i < length; i++) {
+      if (!std::isspace(static_cast<unsigned char>(chunk[i]))) {
+        if (chunk[i] != '{') {
+          throw std::runtime_error("Areas::populateFromWelshStatsJSON: "
+                                   "Invalid JSON: not an object");
+        }
+        started = true;
+      }
+    }
+
+    positions.clear();
+    scanner.scan(chunk.data(), length, 0, positions);
+
+    // The part of the chunk in the current row, appended to the block when
+    // the row ends or the chunk does
+    size_t spanBegin = 0;
+
+    for (auto it = positions.cbegin(); it != positions.cend(); it++) {
+      const size_t i = *it;
+      const char c = chunk[i];
+      if (c == '"') {
+        // Keep the top-level keys, to find the "value" array
+        if (!inString && depth == 1) {
+          key.clear();
+          keyBegin = i + 1;
+        } else if (inString && depth == 1) {
+          key.append(chunk, keyBegin, i - keyBegin);
+        }
+        inString = !inString;
+      } else if (c == '{' || c == '[') {
+        depth++;
+        if (depth == 2 && c == '[' && key == "value") {
+          inValue = true;
+        } else if (depth == 3 && inValue) {
+          inRow = true;
+          spanBegin = i;
+          rowBegin = block.text.size();
+        }
+      } else if (c == '}' || c == ']') {
+        if (depth == 0) {
+          throw std::runtime_error("Areas::populateFromWelshStatsJSON: "
+                                   "Invalid JSON: unbalanced brackets");
+        } else if (depth == 3 && inValue) {
+          block.text.append(chunk, spanBegin, i + 1 - spanBegin);
+          block.rows.emplace_back(rowBegin, block.text.size() - rowBegin);
+          inRow = false;
+
+          if (block.text.size() >= INGEST_BLOCK_SIZE) {
+            block.seq = seq;
+            if (!pushBlock(std::move(block), stats)) {
+              return;
+            }
+            seq++;
+            block = IngestBlock{0, 0, std::string(), {}, nullptr};
+          }
+        } else if (depth == 2) {
+          inValue = false;
+        }
+        depth--;
+      }
+    }
+
+    if (inString && depth == 1) {
+      key.append(chunk, keyBegin, length - keyBegin);
+      keyBegin = 0;
+    }
+    if (inRow) {
+      block.text.append(chunk, spanBegin, length - spanBegin);
+    }
+
+    if (length < INGEST_BLOCK_SIZE) {
+      break;
+    }
+  }
+
+  if (depth != 0 || inString || !started) {
+    throw std::runtime_error("Areas::populateFromWelshStatsJSON: "
+                             "Invalid JSON: the document is incomplete");
+  }
+
+  if (!block.rows.empty()) {
+    block.seq = seq;
+    if (pushBlock(std::move(block), stats)) {
+      seq++;
+    }
+  }
+}
+
+/*
+  A parser: parse the blocks from the reader into batches of rows for the
+  inserter, until the reader has finished and every block is parsed.
+*/
+void IngestPipeline::parseBlocks() {
+  IngestStageStats stats{0, 0, std::chrono::nanoseconds(0), 0};
+
+  for (;;) {
+    IngestBlock block;
+    unsigned int spins = 0;
+    bool popped = false;
+    while (!(popped = mBlocks.tryPop(block))) {
+      if (mStopping) {
+        break;
+      }
+      if (mReadEnded.load(std::memory_order_acquire)) {
+        popped = mBlocks.tryPop(block);
+        break;
+      }
+      backOff(spins);
+    }
+    if (!popped) {
+      break;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    IngestBatch batch{block.seq, {}, block.error};
+    if (batch.error == nullptr) {
+      try {
+        if (mType == BethYw::AuthorityCodeCSV) {
+          parseAuthorityCodeCSV(block, batch.rows);
+        } else if (mType == BethYw::AuthorityByYearCSV) {
+          parseAuthorityByYearCSV(block, batch.rows);
+        } else {
+          parseWelshStatsJSON(block, batch.rows);
+        }
+      } catch (...) {
+        batch.error = std::current_exception();
+      }
+    }
+    stats.blocks++;
+    stats.amount += batch.rows.size();
+    stats.busy += std::chrono::steady_clock::now() - start;
+
+    // There is room for every block in the window, but the inserter may be
+    // yet to pop a batch it has been told about
+    spins = 0;
+    bool stalled = false;
+    while (!mBatches.tryPush(std::move(batch))) {
+      if (mStopping) {
+        break;
+      }
+      if (!stalled) {
+        stalled = true;
+        stats.stalls++;
+      }
+      backOff(spins);
+    }
+  }
+
+  addIngestStats(1, stats);
+}
+
+/*
+  Split the next line of a block of a CSV file at its commas, in the same way
+  as std::getline() with ',' (i.e. a trailing comma does not give an empty
+  last cell), using the commas and newlines found by a StructuralScanner.
+
+  @param text
+    The text of the block
+
+  @param begin
+    The position of the start of the line
+
+  @param delimiters
+    The positions of the commas and newlines in text
+
+  @param next
+    The index in delimiters of the first at or after begin, which is set to
+    the first after the line
+
+  @param cells
+    Set to the cells of the line
+
+  @return
+    The position of the end of the line (its newline, or the end of text)
+*/
+static size_t splitCSVLine(const std::string& text,
+                           size_t begin,
+                           const std::vector<size_t>& delimiters,
+                           size_t& next,
+                           std::vector<std::string>& cells) {
+  cells.clear();
+  for (; next < delimiters.size(); next++) {
+    const size_t delimiter = delimiters[next];
+    if (text[delimiter] == '\n') {
+      break;
+    }
+    cells.emplace_back(text, begin, delimiter - begin);
+    begin = delimiter + 1;
+  }
+
+  size_t end = text.size();
+  if (next < delimiters.size()) {
+    end = delimiters[next++];
+  }
+  if (begin < end) {
+    cells.emplace_back(text, begin, end - begin);
+  }
+
+  return end;
+}
+
+/*
+  Parse the lines of an AuthorityCodeCSV file, i.e. areas.csv, into rows of
+  the local authority code and English and Welsh names of the areas.
+
+  @throws
+    std::runtime_error if a line does not have the three columns
+*/
+void IngestPipeline::parseAuthorityCodeCSV(
+    const IngestBlock& block,
+    std::vector<IngestRow>& rows) const {
+  std::vector<std::string> cells;
+  unsigned int lineNo = block.firstLine;
+  size_t begin = 0;
+
+  while (begin < block.text.size()) {
+    size_t end = block.text.find('\n', begin);
+    if (end == std::string::npos) {
+      end = block.text.size();
+    }
+
+    // As with std::getline() on one thread, the third column must not be
+    // empty, and any columns after it are ignored
+    const size_t first = block.text.find(',', begin);
+    const size_t second = first == std::string::npos || first >= end
+                              ? std::string::npos
+                              : block.text.find(',', first + 1);
+    if (second == std::string::npos || second + 1 >= end) {
+      throw std::runtime_error("AreaCSVParser::parse: "
+                               "Error on or near line " +
+                               std::to_string(lineNo));
+    }
+
+    IngestRow row{};
+    row.code.assign(block.text, begin, first - begin);
+    row.name.assign(block.text, first + 1, second - first - 1);
+    const size_t third = block.text.find(',', second + 1);
+    row.nameWelsh.assign(block.text,
+                         second + 1,
+                         std::min(third, end) - second - 1);
+    rows.push_back(std::move(row));
+
+    begin = end + 1;
+    lineNo++;
+  }
+}
+
+/*
+  Parse the lines of an AuthorityByYearCSV file into rows of a local
+  authority code and its values by year, leaving out the years not in the
+  years filter and the values the value filter does not keep.
+
+  @throws
+    std::runtime_error if a line has more columns than the header, or a value
+    is not a number
+*/
+void IngestPipeline::parseAuthorityByYearCSV(
+    const IngestBlock& block,
+    std::vector<IngestRow>& rows) const {
+  const int authorityCodeCol = -1;
+  std::vector<std::string> cells;
+  unsigned int lineNo = block.firstLine;
+  size_t begin = 0;
+
+  std::vector<size_t> delimiters;
+  StructuralScanner scanner(ScanFormat::CSV);
+  scanner.scan(block.text.data(), block.text.size(), 0, delimiters);
+  size_t next = 0;
+
+  while (begin < block.text.size()) {
+    const size_t end = splitCSVLine(block.text, begin, delimiters, next, cells);
+
+    try {
+      IngestRow row{};
+      bool hasCode = false;
+      for (size_t col = 0; col < cells.size(); col++) {
+        const int columnIdent = mColHeaders.at(col);
+        if (columnIdent == authorityCodeCol) {
+          row.code = std::move(cells[col]);
+          hasCode = true;
+          continue;
+        }
+
+        const unsigned int year = static_cast<unsigned int>(columnIdent);
+        if ((mYearsFilter != nullptr &&
+             (year < std::get<0>(*mYearsFilter) ||
+              year > std::get<1>(*mYearsFilter))) ||
+            cells[col].empty()) {
+          continue;
+        }
+
+        double value = 0.0;
+        const CellState state = decodeValueCell(cells[col], value);
+        if (state == CellState::Missing) {
+          continue;
+        } else if (state == CellState::Invalid) {
+          throw std::invalid_argument("Invalid value: " + cells[col]);
+        }
+
+        if (mValueFilter != nullptr &&
+            !mValueFilter->keepRow(mValueMeasureCode, value)) {
+          continue;
+        }
+
+        // As with the std::unordered_map::emplace() of the parser on one
+        // thread, the first value in the row for a year is kept
+        auto it = std::find_if(row.values.cbegin(),
+                               row.values.cend(),
+                               [year](const std::pair<unsigned int,
+                                                      double>& v) {
+                                 return v.first == year;
+                               });
+        if (it == row.values.cend()) {
+          row.values.emplace_back(year, value);
+        }
+      }
+
+      // As on one thread, a row none of whose values the value filter
+      // keeps does not add its area
+      if (hasCode && (mValueFilter == nullptr || !row.values.empty())) {
+        rows.push_back(std::move(row));
+      }
+    } catch (const std::exception& ex) {
+      throw std::runtime_error("Areas::populateFromAuthorityByYearCSV: "
+                               "Error on or near line " +
+                               std::to_string(lineNo));
+    }
+
+    begin = end + 1;
+    lineNo++;
+  }
+}
+
+/*
+  The columns of a WelshStatsJSON row kept by the JSONProjection of the
+  pipeline, in the order they are given to it.
+*/
+enum IngestJSONColumn {
+  JSON_CODE,
+  JSON_NAME,
+  JSON_YEAR,
+  JSON_VALUE,
+  JSON_MEASURE_CODE,
+  JSON_MEASURE_NAME
+};
+
+/*
+  Parse the rows of a WelshStatsJSON file, leaving out those not in the
+  measures or years filters, or not kept by the value filter (the areas
+  filter needs the Areas, so is left to the inserter).
+
+  @throws
+    std::runtime_error if a row is not valid JSON
+    std::out_of_range if a row does not have the columns in cols
+*/
+void IngestPipeline::parseWelshStatsJSON(const IngestBlock& block,
+                                         std::vector<IngestRow>& rows) const {
+  rows.reserve(block.rows.size());
+
+  // The strings of the row are reused from one row to the next
+  std::vector<json> data;
+  for (auto it = block.rows.cbegin(); it != block.rows.cend(); it++) {
+    try {
+      const std::string_view text(block.text.data() + it->first, it->second);
+      size_t pos = 0;
+      mProjection.readRow(text, pos, data);
+      JSONProjection::skipWhitespace(text, pos);
+      if (pos != text.size()) {
+        throw std::invalid_argument("Expected the end of the row at byte " +
+                                    std::to_string(pos));
+      }
+    } catch (const std::invalid_argument& ex) {
+      throw std::runtime_error("Areas::populateFromWelshStatsJSON: "
+                               "Invalid JSON: " +
+                               std::string(ex.what()));
+    }
+
+    IngestRow row{};
+    try {
+      row.code = data[JSON_CODE].get<std::string>();
+      row.name = data[JSON_NAME].get<std::string>();
+    } catch (const nlohmann::detail::type_error& ex) {
+      throw std::out_of_range("Areas::populateFromWelshStatsJSON: "
+                              "Column specification did not match file for "
+                              "COL_AUTHORITY_CODE or COL_AREA_NAME!");
+    }
+
+    if (mMultipleMeasures) {
+      row.measureCode = data[JSON_MEASURE_CODE].get<std::string>();
+      std::transform(row.measureCode.begin(),
+                     row.measureCode.end(),
+                     row.measureCode.begin(),
+                     ::tolower);
+      if (mMeasuresFilter != nullptr &&
+          mMeasuresFilter->count(row.measureCode) == 0) {
+        continue;
+      }
+    }
+
+    const CellState yearState =
+        decodeJSONYearCell(data[JSON_YEAR], row.year);
+    if (yearState == CellState::Invalid) {
+      throw std::out_of_range("Areas::populateFromWelshStatsJSON: "
+                              "Column specification did not match file for "
+                              "YEAR!");
+    }
+    if (yearState == CellState::Missing ||
+        (mYearsFilter != nullptr &&
+         (row.year < std::get<0>(*mYearsFilter) ||
+          row.year > std::get<1>(*mYearsFilter)))) {
+      continue;
+    }
+
+    // Some datasets store numerical data as strings, and some values are
+    // missing, which are left out by the inserter
+    const CellState valueState =
+        decodeJSONValueCell(data[JSON_VALUE], row.value);
+    if (valueState == CellState::Invalid) {
+      throw std::out_of_range("Areas::populateFromWelshStatsJSON: "
+                              "Column specification did not match file for "
+                              "VALUE!");
+    }
+    row.missing = valueState == CellState::Missing;
+
+    if (mValueFilter != nullptr &&
+        (row.missing ||
+         !mValueFilter->keepRow(mMultipleMeasures ? row.measureCode
+                                                  : mValueMeasureCode,
+                                row.value))) {
+      continue;
+    }
+
+    if (mMultipleMeasures) {
+      row.measureName = data[JSON_MEASURE_NAME].get<std::string>();
+    }
+
+    rows.push_back(std::move(row));
+  }
+}
+
+/*
+  The inserter: take the next batch of rows, in the order of the blocks they
+  were read in, waiting for it to be parsed if need be.
+
+  @param batch
+    Set to the next batch
+
+  @return
+    false once every batch has been taken
+
+  @throws
+    The error reading or parsing the block of the batch, if any
+*/
+bool IngestPipeline::next(IngestBatch& batch) {
+  const auto waitStart = std::chrono::steady_clock::now();
+  mInsertStats.busy += waitStart - mLastReturn;
+
+  unsigned int spins = 0;
+  bool waited = false;
+  for (;;) {
+    auto pendingIt = mPending.find(mNextSeq);
+    if (pendingIt != mPending.end()) {
+      batch = std::move(pendingIt->second);
+      mPending.erase(pendingIt);
+      break;
+    }
+
+    IngestBatch popped;
+    if (mBatches.tryPop(popped)) {
+      if (popped.seq == mNextSeq) {
+        batch = std::move(popped);
+        break;
+      }
+      const uint64_t seq = popped.seq;
+      mPending.emplace(seq, std::move(popped));
+      continue;
+    }
+
+    if (mReadEnded.load(std::memory_order_acquire) &&
+        mNextSeq >= mReadCount.load(std::memory_order_acquire)) {
+      mLastReturn = std::chrono::steady_clock::now();
+      return false;
+    }
+
+    if (!waited) {
+      waited = true;
+      mInsertStats.stalls++;
+    }
+    backOff(spins);
+  }
+
+  mNextSeq++;
+  mApplied.store(mNextSeq, std::memory_order_release);
+  mLastReturn = std::chrono::steady_clock::now();
+
+  if (batch.error != nullptr) {
+    std::rethrow_exception(batch.error);
+  }
+
+  mInsertStats.blocks++;
+  mInsertStats.amount += batch.rows.size();
+  return true;
+}
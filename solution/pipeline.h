@@ -0,0 +1,306 @@
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the IngestPipeline class, which parses a data file on
+  several threads, in three stages:
+
+    reader   — one thread reads the stream in blocks of whole rows (lines of
+               a CSV file, or the objects in the "value" array of a
+               WelshStatsJSON file, found without parsing them)
+    parsers  — a number of threads parse the blocks into batches of typed
+               rows (IngestRow), applying the measures, years, and value
+               filters
+    inserter — the thread that called Areas::populate() takes the batches,
+               in the order of the blocks, and adds the rows to the Areas
+
+  Only the inserter touches the Areas (and its SymbolTable), so the parsers
+  need no locks, and the rows are added in the same order as when the file
+  is parsed on one thread, so the data is the same.
+
+  The stages are connected by bounded lock-free queues (RingQueue). The
+  reader only reads so many blocks ahead of the inserter, so when the
+  parsers or the inserter fall behind, the reader waits (a "stall") rather
+  than reading more, and the memory used is bounded however large the file.
+
+  The pipeline is used by Areas::populate() when more than one thread is set
+  (see Areas::setIngestThreads()), and the work of each stage is totalled
+  across every pipeline (see getIngestStats()).
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <istream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "datasets.h"
+#include "projection.h"
+#include "valuefilter.h"
+
+/*
+  A bounded queue that any number of threads can push to and pop from
+  without locks (Dmitry Vyukov's bounded MPMC queue), which we use with one
+  producer and many consumers between the reader and the parsers, and many
+  producers and one consumer between the parsers and the inserter.
+
+  Each slot has a sequence number, which says whether the slot is free to be
+  pushed to or full and ready to be popped from on the current lap of the
+  ring, so the producers and consumers only contend for the head and tail.
+*/
+template <typename T>
+class RingQueue {
+protected:
+  struct Slot {
+    std::atomic<size_t> seq;
+    T value;
+  };
+
+  std::unique_ptr<Slot[]> mSlots;
+  const size_t mMask;
+  alignas(64) std::atomic<size_t> mHead;
+  alignas(64) std::atomic<size_t> mTail;
+
+  static size_t roundUp(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+      size *= 2;
+    }
+    return size;
+  }
+
+public:
+  /*
+    Construct a queue of at least the given capacity (rounded up to a power
+    of two).
+  */
+  explicit RingQueue(size_t capacity)
+      : mSlots(new Slot[roundUp(capacity)]),
+        mMask(roundUp(capacity) - 1),
+        mHead(0),
+        mTail(0) {
+    for (size_t i = 0; i <= mMask; i++) {
+      mSlots[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  RingQueue(const RingQueue& other) = delete;
+  RingQueue& operator=(const RingQueue& other) = delete;
+
+  size_t capacity() const noexcept {
+    return mMask + 1;
+  }
+
+  /*
+    Push a value, unless the queue is full.
+  */
+  bool tryPush(T&& value) {
+    size_t pos = mTail.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+      slot = &mSlots[pos & mMask];
+      const size_t seq = slot->seq.load(std::memory_order_acquire);
+      const intptr_t diff =
+          static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (mTail.compare_exchange_weak(pos,
+                                        pos + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = mTail.load(std::memory_order_relaxed);
+      }
+    }
+
+    slot->value = std::move(value);
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /*
+    Pop the oldest value, unless the queue is empty.
+  */
+  bool tryPop(T& value) {
+    size_t pos = mHead.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+      slot = &mSlots[pos & mMask];
+      const size_t seq = slot->seq.load(std::memory_order_acquire);
+      const intptr_t diff =
+          static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (mHead.compare_exchange_weak(pos,
+                                        pos + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = mHead.load(std::memory_order_relaxed);
+      }
+    }
+
+    value = std::move(slot->value);
+    slot->seq.store(pos + mMask + 1, std::memory_order_release);
+    return true;
+  }
+};
+
+/*
+  A row parsed from a data file, ready to be added to an Areas instance. Which
+  members are used depends on the type of file:
+
+    AuthorityCodeCSV   — code, name and nameWelsh
+    WelshStatsJSON     — code, name, measureCode (in lowercase, or empty for
+                         a dataset with a single measure), measureName, year
+                         and value (unless missing is set)
+    AuthorityByYearCSV — code and values, by year
+*/
+struct IngestRow {
+  std::string code;
+  std::string name;
+  std::string nameWelsh;
+  std::string measureCode;
+  std::string measureName;
+  unsigned int year;
+  double value;
+  bool missing;
+  std::vector<std::pair<unsigned int, double>> values;
+};
+
+/*
+  A block of whole rows read from a data file. The rows of a JSON file are
+  given as the offset and length of each row's object within the text.
+*/
+struct IngestBlock {
+  uint64_t seq;
+  unsigned int firstLine;
+  std::string text;
+  std::vector<std::pair<size_t, size_t>> rows;
+  std::exception_ptr error;
+};
+
+/*
+  The rows parsed from a block, or the error reading or parsing it.
+*/
+struct IngestBatch {
+  uint64_t seq;
+  std::vector<IngestRow> rows;
+  std::exception_ptr error;
+};
+
+/*
+  The work of a stage of every IngestPipeline so far: the number of blocks
+  (or batches) it has processed, the bytes read (reader) or rows parsed or
+  added (parsers and inserter), the time spent working, and the number of
+  times it had to wait for the next stage to make room in a queue (or, for
+  the inserter, for a batch to be parsed).
+*/
+struct IngestStageStats {
+  uint64_t blocks;
+  uint64_t amount;
+  std::chrono::nanoseconds busy;
+  uint64_t stalls;
+};
+
+struct IngestStats {
+  unsigned int pipelines;
+  IngestStageStats read;
+  IngestStageStats parse;
+  IngestStageStats insert;
+};
+
+IngestStats getIngestStats() noexcept;
+
+class IngestPipeline {
+protected:
+  std::istream& mStream;
+  const BethYw::SourceDataType mType;
+  const std::unordered_set<std::string>* const mMeasuresFilter;
+  const std::tuple<unsigned int, unsigned int>* const mYearsFilter;
+  const ValueFilter* const mValueFilter;
+  const std::vector<int> mColHeaders;
+  const unsigned int mFirstLine;
+
+  std::string mColCode;
+  std::string mColName;
+  std::string mColMeasureCode;
+  std::string mColMeasureName;
+  std::string mColYear;
+  std::string mColValue;
+  bool mMultipleMeasures;
+  std::string mValueMeasureCode;
+  JSONProjection mProjection;
+
+  const size_t mWindow;
+  RingQueue<IngestBlock> mBlocks;
+  RingQueue<IngestBatch> mBatches;
+  std::map<uint64_t, IngestBatch> mPending;
+
+  std::atomic<bool> mStopping;
+  std::atomic<bool> mReadEnded;
+  std::atomic<uint64_t> mReadCount;
+  std::atomic<uint64_t> mApplied;
+  uint64_t mNextSeq;
+
+  std::thread mReader;
+  std::vector<std::thread> mParsers;
+
+  std::chrono::steady_clock::time_point mLastReturn;
+  IngestStageStats mInsertStats;
+
+  void readBlocks();
+  void readCSVBlocks(uint64_t& seq, IngestStageStats& stats);
+  void readJSONBlocks(uint64_t& seq, IngestStageStats& stats);
+  bool pushBlock(IngestBlock&& block, IngestStageStats& stats);
+  void parseBlocks();
+  void parseAuthorityCodeCSV(const IngestBlock& block,
+                             std::vector<IngestRow>& rows) const;
+  void parseAuthorityByYearCSV(const IngestBlock& block,
+                               std::vector<IngestRow>& rows) const;
+  void parseWelshStatsJSON(const IngestBlock& block,
+                           std::vector<IngestRow>& rows) const;
+  void stop();
+
+public:
+  IngestPipeline(std::istream& is,
+                 BethYw::SourceDataType type,
+                 const BethYw::SourceColumnMapping& cols,
+                 const std::unordered_set<std::string>* measuresFilter,
+                 const std::tuple<unsigned int, unsigned int>* yearsFilter,
+                 const ValueFilter* valueFilter,
+                 const std::vector<int>& colHeaders,
+                 unsigned int firstLine,
+                 unsigned int parsers);
+  ~IngestPipeline();
+
+  IngestPipeline(const IngestPipeline& other) = delete;
+  IngestPipeline& operator=(const IngestPipeline& other) = delete;
+
+  bool isMultipleMeasures() const noexcept;
+  const std::string& getSingleMeasureCode() const noexcept;
+  const std::string& getSingleMeasureName() const noexcept;
+
+  bool next(IngestBatch& batch);
+};
+
+#endif // PIPELINE_H_
@@ -0,0 +1,735 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the implementation of the JSONProjection and
+  JSONRowReader classes. See the header file for additional comments.
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "lib_json.hpp"
+
+#include "fingerprint.h"
+#include "projection.h"
+
+constexpr size_t JSONProjection::NPOS;
+
+/*
+  The smallest perfect hash table built, and the number of seeds tried for
+  each size of table before trying a table twice the size.
+*/
+const size_t PROJECTION_MIN_SLOTS = 8;
+const uint64_t PROJECTION_SEEDS = 256;
+
+/*
+  The most columns a JSONProjection can have, as a row keeps track of which
+  it has seen in a 64-bit mask.
+*/
+const size_t PROJECTION_MAX_COLUMNS = 64;
+
+/*
+  Throw the error for text that is not valid JSON.
+*/
+[[noreturn]] static void projectionSyntaxError(const std::string& expected,
+                                               size_t pos) {
+  throw std::invalid_argument("Expected " + expected + " at byte " +
+                              std::to_string(pos));
+}
+
+/*
+  @return
+    The character at pos, or '\0' at the end of the text
+*/
+static inline char projectionPeek(std::string_view text, size_t pos) noexcept {
+  return pos < text.size() ? text[pos] : '\0';
+}
+
+/*
+  Move past the character c, which must be at pos.
+*/
+static void projectionExpect(std::string_view text, size_t& pos, char c) {
+  if (projectionPeek(text, pos) != c) {
+    projectionSyntaxError(std::string("'") + c + "'", pos);
+  }
+  pos++;
+}
+
+/*
+  Move past the literal (true, false, or null) that must be at pos.
+*/
+static void projectionExpectLiteral(std::string_view text,
+                                    size_t& pos,
+                                    std::string_view literal) {
+  if (text.substr(pos, literal.size()) != literal) {
+    projectionSyntaxError(std::string(literal), pos);
+  }
+  pos += literal.size();
+}
+
+/*
+  Move past a string, without unescaping it.
+*/
+static void projectionSkipString(std::string_view text, size_t& pos) {
+  const size_t start = pos;
+  pos++;
+  for (;;) {
+    pos = text.find_first_of("\"\\", pos);
+    if (pos == std::string_view::npos) {
+      projectionSyntaxError("the end of the string", start);
+    } else if (text[pos] == '"') {
+      pos++;
+      return;
+    }
+    pos += 2;
+  }
+}
+
+/*
+  Read the four hexadecimal digits of a \u escape.
+*/
+static unsigned int projectionReadHex(std::string_view text, size_t& pos) {
+  unsigned int codePoint = 0;
+  const char* first = text.data() + pos;
+  const char* last = text.data() + std::min(text.size(), pos + 4);
+  const auto result = std::from_chars(first, last, codePoint, 16);
+  if (result.ec != std::errc() || result.ptr != first + 4) {
+    projectionSyntaxError("four hexadecimal digits", pos);
+  }
+  pos += 4;
+  return codePoint;
+}
+
+/*
+  Append a code point to a string, encoded as UTF-8.
+*/
+static void projectionAppendUTF8(std::string& str, unsigned int codePoint) {
+  if (codePoint < 0x80) {
+    str.push_back(static_cast<char>(codePoint));
+  } else if (codePoint < 0x800) {
+    str.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+    str.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+  } else if (codePoint < 0x10000) {
+    str.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+    str.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+    str.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+  } else {
+    str.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+    str.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+    str.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+    str.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+  }
+}
+
+/*
+  Move past any digits at pos.
+
+  @return
+    The number of digits
+*/
+static size_t projectionSkipDigits(std::string_view text, size_t& pos) {
+  const size_t start = pos;
+  while (std::isdigit(static_cast<unsigned char>(projectionPeek(text, pos)))) {
+    pos++;
+  }
+  return pos - start;
+}
+
+/*
+  Read a number, as nlohmann::json would: an integer without a fraction or
+  exponent is kept as an integer (signed only if it is negative), unless it
+  is too large for one.
+*/
+static void projectionReadNumber(std::string_view text,
+                                 size_t& pos,
+                                 nlohmann::json& value) {
+  const size_t start = pos;
+  bool integer = true;
+
+  if (projectionPeek(text, pos) == '-') {
+    pos++;
+  }
+
+  if (projectionPeek(text, pos) == '0') {
+    pos++;
+  } else if (projectionSkipDigits(text, pos) == 0) {
+    projectionSyntaxError("a value", start);
+  }
+
+  if (projectionPeek(text, pos) == '.') {
+    integer = false;
+    pos++;
+    if (projectionSkipDigits(text, pos) == 0) {
+      projectionSyntaxError("a digit", pos);
+    }
+  }
+
+  if (projectionPeek(text, pos) == 'e' || projectionPeek(text, pos) == 'E') {
+    integer = false;
+    pos++;
+    if (projectionPeek(text, pos) == '+' || projectionPeek(text, pos) == '-') {
+      pos++;
+    }
+    if (projectionSkipDigits(text, pos) == 0) {
+      projectionSyntaxError("a digit", pos);
+    }
+  }
+
+  const char* first = text.data() + start;
+  const char* last = text.data() + pos;
+  if (integer) {
+    if (*first == '-') {
+      nlohmann::json::number_integer_t number = 0;
+      if (std::from_chars(first, last, number).ec == std::errc()) {
+        value = number;
+        return;
+      }
+    } else {
+      nlohmann::json::number_unsigned_t number = 0;
+      if (std::from_chars(first, last, number).ec == std::errc()) {
+        value = number;
+        return;
+      }
+    }
+  }
+
+  nlohmann::json::number_float_t number = 0;
+  const auto result = std::from_chars(first, last, number);
+  if (result.ec != std::errc() || result.ptr != last) {
+    projectionSyntaxError("a number", start);
+  }
+  value = number;
+}
+
+/*
+  Construct a JSONProjection of the given columns: a row read by readRow()
+  has the value of the key columns[i] at index i.
+
+  The perfect hash is found by trying seeds for a hash of the column names
+  until one gives each name a slot of its own, in a table at least twice
+  the size of the number of names (doubling it if no seed works).
+
+  @param columns
+    The names of the keys to keep
+
+  @throws
+    std::invalid_argument if there are more than 64 columns
+
+  @example
+    JSONProjection projection({"Localauthority_Code", "Data"});
+*/
+JSONProjection::JSONProjection(const std::vector<std::string>& columns)
+    : mColumns(columns.size()), mSeed(0), mMask(0), mSlots() {
+  if (columns.size() > PROJECTION_MAX_COLUMNS) {
+    throw std::invalid_argument("JSONProjection: Too many columns");
+  }
+
+  // A name may be given for more than one column
+  std::vector<std::pair<std::string, std::vector<size_t>>> names;
+  for (size_t i = 0; i < columns.size(); i++) {
+    auto it = std::find_if(names.begin(),
+                           names.end(),
+                           [&columns, i](const auto& name) {
+                             return name.first == columns[i];
+                           });
+    if (it == names.end()) {
+      names.emplace_back(columns[i], std::vector<size_t>{i});
+    } else {
+      it->second.push_back(i);
+    }
+  }
+
+  for (size_t size = PROJECTION_MIN_SLOTS; ; size *= 2) {
+    if (size < names.size() * 2) {
+      continue;
+    }
+
+    for (uint64_t seed = 1; seed <= PROJECTION_SEEDS; seed++) {
+      std::vector<bool> used(size, false);
+      bool perfect = true;
+      for (auto it = names.cbegin(); perfect && it != names.cend(); it++) {
+        const size_t slot =
+            FileFingerprint::hash(it->first.data(), it->first.size(), seed) &
+            (size - 1);
+        perfect = !used[slot];
+        used[slot] = true;
+      }
+
+      if (perfect) {
+        mSeed = seed;
+        mMask = size - 1;
+        mSlots.assign(size, Slot{false, std::string(), {}});
+        for (auto it = names.begin(); it != names.end(); it++) {
+          Slot& slot = mSlots[FileFingerprint::hash(it->first.data(),
+                                                    it->first.size(),
+                                                    seed) &
+                              mMask];
+          slot.used = true;
+          slot.name = std::move(it->first);
+          slot.columns = std::move(it->second);
+        }
+        return;
+      }
+    }
+  }
+}
+
+/*
+  @return
+    The number of columns in a row
+*/
+size_t JSONProjection::size() const noexcept {
+  return mColumns;
+}
+
+/*
+  Find the slot of a key, with a single hash and comparison.
+
+  @return
+    The slot, or nullptr if the key is not one of the columns
+*/
+const JSONProjection::Slot* JSONProjection::findSlot(
+    std::string_view key) const noexcept {
+  if (mSlots.empty()) {
+    return nullptr;
+  }
+
+  const Slot& slot =
+      mSlots[FileFingerprint::hash(key.data(), key.size(), mSeed) & mMask];
+  if (!slot.used || slot.name != key) {
+    return nullptr;
+  }
+
+  return &slot;
+}
+
+/*
+  Find the column of a key.
+
+  @param key
+    The (unescaped) key
+
+  @return
+    The index of the (first) column with the name key, or
+    JSONProjection::NPOS if it is not one of the columns
+*/
+size_t JSONProjection::find(std::string_view key) const noexcept {
+  const Slot* slot = findSlot(key);
+  return slot == nullptr ? NPOS : slot->columns.front();
+}
+
+/*
+  Read the object at pos (after any whitespace), keeping the values of the
+  keys that are columns and skipping the rest. A column the object does not
+  have is null, as is every column if the value at pos is not an object.
+
+  The strings of the row are reused where they can be, so that reading row
+  after row into the same vector does not allocate for each.
+
+  @param text
+    The text the object is in
+
+  @param pos
+    The position of the object, which is set to the position after it
+
+  @param row
+    Set to the value of each column
+
+  @throws
+    std::invalid_argument if the text is not valid JSON
+*/
+void JSONProjection::readRow(std::string_view text,
+                             size_t& pos,
+                             std::vector<nlohmann::json>& row) const {
+  row.resize(mColumns);
+  uint64_t seen = 0;
+
+  skipWhitespace(text, pos);
+  if (projectionPeek(text, pos) != '{') {
+    skipValue(text, pos);
+  } else {
+    pos++;
+    skipWhitespace(text, pos);
+    if (projectionPeek(text, pos) == '}') {
+      pos++;
+    } else {
+      std::string unescaped;
+      for (;;) {
+        skipWhitespace(text, pos);
+        const std::string_view key = readKey(text, pos, unescaped);
+        skipWhitespace(text, pos);
+        projectionExpect(text, pos, ':');
+        skipWhitespace(text, pos);
+
+        const Slot* slot = findSlot(key);
+        if (slot == nullptr) {
+          skipValue(text, pos);
+        } else {
+          const size_t column = slot->columns.front();
+          readValue(text, pos, row[column]);
+          seen |= uint64_t(1) << column;
+          for (size_t i = 1; i < slot->columns.size(); i++) {
+            row[slot->columns[i]] = row[column];
+            seen |= uint64_t(1) << slot->columns[i];
+          }
+        }
+
+        skipWhitespace(text, pos);
+        if (projectionPeek(text, pos) == '}') {
+          pos++;
+          break;
+        }
+        projectionExpect(text, pos, ',');
+      }
+    }
+  }
+
+  for (size_t i = 0; i < mColumns; i++) {
+    if ((seen & (uint64_t(1) << i)) == 0) {
+      row[i] = nullptr;
+    }
+  }
+}
+
+/*
+  Read the value at pos into value.
+*/
+void JSONProjection::readValue(std::string_view text,
+                               size_t& pos,
+                               nlohmann::json& value) const {
+  switch (projectionPeek(text, pos)) {
+    case '"':
+      if (!value.is_string()) {
+        value = std::string();
+      }
+      readString(text, pos, value.get_ref<std::string&>());
+      break;
+
+    case '{':
+    case '[': {
+      // A column that is an object or an array is rare enough to parse
+      // normally
+      const size_t start = pos;
+      skipValue(text, pos);
+      try {
+        value = nlohmann::json::parse(text.substr(start, pos - start));
+      } catch (const nlohmann::json::exception& ex) {
+        throw std::invalid_argument(ex.what());
+      }
+      break;
+    }
+
+    case 't':
+      projectionExpectLiteral(text, pos, "true");
+      value = true;
+      break;
+
+    case 'f':
+      projectionExpectLiteral(text, pos, "false");
+      value = false;
+      break;
+
+    case 'n':
+      projectionExpectLiteral(text, pos, "null");
+      value = nullptr;
+      break;
+
+    default:
+      projectionReadNumber(text, pos, value);
+      break;
+  }
+}
+
+/*
+  Move pos past any whitespace.
+*/
+void JSONProjection::skipWhitespace(std::string_view text,
+                                    size_t& pos) noexcept {
+  while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\n' ||
+                               text[pos] == '\r' || text[pos] == '\t')) {
+    pos++;
+  }
+}
+
+/*
+  Move pos past the value at it, checking only that its quotes and brackets
+  match, without decoding it.
+
+  @throws
+    std::invalid_argument if the value is not terminated
+*/
+void JSONProjection::skipValue(std::string_view text, size_t& pos) {
+  const char c = projectionPeek(text, pos);
+  if (c == '"') {
+    projectionSkipString(text, pos);
+  } else if (c == '{' || c == '[') {
+    // The closing brackets expected, innermost last
+    std::string closers;
+    while (pos < text.size()) {
+      const char next = text[pos];
+      if (next == '"') {
+        projectionSkipString(text, pos);
+        continue;
+      } else if (next == '{') {
+        closers.push_back('}');
+      } else if (next == '[') {
+        closers.push_back(']');
+      } else if (next == '}' || next == ']') {
+        if (next != closers.back()) {
+          projectionSyntaxError(std::string("'") + closers.back() + "'", pos);
+        }
+        closers.pop_back();
+        if (closers.empty()) {
+          pos++;
+          return;
+        }
+      }
+      pos++;
+    }
+    projectionSyntaxError(std::string("'") + closers.back() + "'", pos);
+  } else {
+    // A number or literal, which ends at the next delimiter
+    const size_t start = pos;
+    while (pos < text.size() &&
+           (std::isalnum(static_cast<unsigned char>(text[pos])) ||
+            text[pos] == '-' || text[pos] == '+' || text[pos] == '.')) {
+      pos++;
+    }
+    if (pos == start) {
+      projectionSyntaxError("a value", pos);
+    }
+  }
+}
+
+/*
+  Read the key at pos. Keys are seldom escaped, so the key is usually a view
+  of the text itself, and only unescaped (into unescaped) if it must be.
+
+  @return
+    The key, which is valid as long as text and unescaped are
+
+  @throws
+    std::invalid_argument if there is not a string at pos
+*/
+std::string_view JSONProjection::readKey(std::string_view text,
+                                         size_t& pos,
+                                         std::string& unescaped) {
+  if (projectionPeek(text, pos) != '"') {
+    projectionSyntaxError("a key", pos);
+  }
+
+  const size_t end = text.find_first_of("\"\\", pos + 1);
+  if (end != std::string_view::npos && text[end] == '"') {
+    const std::string_view key = text.substr(pos + 1, end - pos - 1);
+    pos = end + 1;
+    return key;
+  }
+
+  readString(text, pos, unescaped);
+  return unescaped;
+}
+
+/*
+  Read and unescape the string at pos.
+
+  @param str
+    Set to the string
+
+  @throws
+    std::invalid_argument if there is not a valid string at pos
+*/
+void JSONProjection::readString(std::string_view text,
+                                size_t& pos,
+                                std::string& str) {
+  projectionExpect(text, pos, '"');
+  str.clear();
+
+  for (;;) {
+    const size_t start = pos;
+    while (pos < text.size() && text[pos] != '"' && text[pos] != '\\' &&
+           static_cast<unsigned char>(text[pos]) >= 0x20) {
+      pos++;
+    }
+    str.append(text.data() + start, pos - start);
+
+    const char c = projectionPeek(text, pos);
+    if (c == '"') {
+      pos++;
+      return;
+    } else if (c != '\\') {
+      projectionSyntaxError("the end of the string", pos);
+    }
+
+    pos++;
+    switch (projectionPeek(text, pos++)) {
+      case '"':  str.push_back('"');  break;
+      case '\\': str.push_back('\\'); break;
+      case '/':  str.push_back('/');  break;
+      case 'b':  str.push_back('\b'); break;
+      case 'f':  str.push_back('\f'); break;
+      case 'n':  str.push_back('\n'); break;
+      case 'r':  str.push_back('\r'); break;
+      case 't':  str.push_back('\t'); break;
+
+      case 'u': {
+        unsigned int codePoint = projectionReadHex(text, pos);
+        if (codePoint >= 0xD800 && codePoint <= 0xDBFF) {
+          // A surrogate pair
+          projectionExpect(text, pos, '\\');
+          projectionExpect(text, pos, 'u');
+          const unsigned int low = projectionReadHex(text, pos);
+          if (low < 0xDC00 || low > 0xDFFF) {
+            projectionSyntaxError("a low surrogate", pos - 4);
+          }
+          codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+        } else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF) {
+          projectionSyntaxError("a high surrogate", pos - 4);
+        }
+        projectionAppendUTF8(str, codePoint);
+        break;
+      }
+
+      default:
+        projectionSyntaxError("an escape", pos - 1);
+    }
+  }
+}
+
+/*
+  Construct a JSONRowReader. Nothing is read until the first call to next().
+
+  @param projection
+    The columns to keep from each row
+
+  @param text
+    The document, which must outlive the reader
+
+  @example
+    JSONRowReader reader(projection, contents);
+    std::vector<nlohmann::json> row;
+    while (reader.next(row)) {
+      ...
+    }
+*/
+JSONRowReader::JSONRowReader(const JSONProjection& projection,
+                             std::string_view text)
+    : mProjection(projection),
+      mText(text),
+      mPos(0),
+      mStarted(false),
+      mInRows(false),
+      mFirstRow(true),
+      mNextLink() {}
+
+/*
+  Read the members of the document until the start of the rows (the "value"
+  array) or the end of the document, keeping the link to the next page if
+  there is one.
+*/
+void JSONRowReader::readMembers() {
+  std::string unescaped;
+  for (;;) {
+    JSONProjection::skipWhitespace(mText, mPos);
+    const std::string_view key =
+        JSONProjection::readKey(mText, mPos, unescaped);
+    JSONProjection::skipWhitespace(mText, mPos);
+    projectionExpect(mText, mPos, ':');
+    JSONProjection::skipWhitespace(mText, mPos);
+
+    const char c = projectionPeek(mText, mPos);
+    if (key == "value" && c == '[') {
+      mPos++;
+      mInRows = true;
+      mFirstRow = true;
+      return;
+    } else if (key == "odata.nextLink" && c == '"') {
+      JSONProjection::readString(mText, mPos, mNextLink);
+    } else {
+      JSONProjection::skipValue(mText, mPos);
+    }
+
+    JSONProjection::skipWhitespace(mText, mPos);
+    if (projectionPeek(mText, mPos) == '}') {
+      mPos++;
+      break;
+    }
+    projectionExpect(mText, mPos, ',');
+  }
+}
+
+/*
+  Read the next row.
+
+  @param row
+    Set to the value of each column of the projection
+
+  @return
+    false once every row has been read
+
+  @throws
+    std::invalid_argument if the text is not valid JSON
+*/
+bool JSONRowReader::next(std::vector<nlohmann::json>& row) {
+  if (!mStarted) {
+    mStarted = true;
+    JSONProjection::skipWhitespace(mText, mPos);
+    projectionExpect(mText, mPos, '{');
+    JSONProjection::skipWhitespace(mText, mPos);
+    if (projectionPeek(mText, mPos) == '}') {
+      mPos++;
+    } else {
+      readMembers();
+    }
+  }
+
+  if (!mInRows) {
+    return false;
+  }
+
+  JSONProjection::skipWhitespace(mText, mPos);
+  if (projectionPeek(mText, mPos) == ']') {
+    mPos++;
+    mInRows = false;
+
+    JSONProjection::skipWhitespace(mText, mPos);
+    if (projectionPeek(mText, mPos) == '}') {
+      mPos++;
+    } else {
+      projectionExpect(mText, mPos, ',');
+      readMembers();
+    }
+    return false;
+  }
+
+  if (!mFirstRow) {
+    projectionExpect(mText, mPos, ',');
+  }
+  mFirstRow = false;
+
+  mProjection.readRow(mText, mPos, row);
+  return true;
+}
+
+/*
+  @return
+    The link to the next page of the dataset, or an empty string if there
+    is none (or the rows have not all been read)
+*/
+const std::string& JSONRowReader::getNextLink() const noexcept {
+  return mNextLink;
+}
@@ -0,0 +1,111 @@
+#ifndef PROJECTION_H_
+#define PROJECTION_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the JSONProjection and JSONRowReader classes, which read
+  the rows of a WelshStatsJSON file, keeping only the columns that are needed
+  (projection pushdown).
+
+  A StatsWales row has around fifteen keys (SortOrder, Hierarchy, AltCode1,
+  RowKey, PartitionKey, ItemNotes, ...), but a SourceColumnMapping in
+  datasets.h needs at most six, and most of the bytes of a file are columns
+  that are never read. Rather than parse each row into a nlohmann::json DOM,
+  the text of a row is scanned, and each key is looked up in a perfect hash
+  of the needed column names. The value of a key that is not needed is
+  skipped over without being unescaped, allocated, or added to a DOM; only
+  the values of needed keys are decoded.
+
+  The values skipped over are only checked for the structure of the JSON
+  (matching quotes and brackets), not that every number or escape in them is
+  valid.
+ */
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lib_json.hpp"
+
+class JSONProjection {
+protected:
+  /*
+    A slot of the perfect hash table, holding a column name and the indexes
+    in a row it is given at (a name may be given for more than one column).
+  */
+  struct Slot {
+    bool used;
+    std::string name;
+    std::vector<size_t> columns;
+  };
+
+  size_t mColumns;
+  uint64_t mSeed;
+  size_t mMask;
+  std::vector<Slot> mSlots;
+
+  const Slot* findSlot(std::string_view key) const noexcept;
+  void readValue(std::string_view text,
+                 size_t& pos,
+                 nlohmann::json& value) const;
+
+public:
+  explicit JSONProjection(const std::vector<std::string>& columns);
+  ~JSONProjection() = default;
+
+  JSONProjection(const JSONProjection& other) = default;
+  JSONProjection& operator=(const JSONProjection& other) = default;
+
+  size_t size() const noexcept;
+  size_t find(std::string_view key) const noexcept;
+
+  void readRow(std::string_view text,
+               size_t& pos,
+               std::vector<nlohmann::json>& row) const;
+
+  static constexpr size_t NPOS = static_cast<size_t>(-1);
+
+  static void skipWhitespace(std::string_view text, size_t& pos) noexcept;
+  static void skipValue(std::string_view text, size_t& pos);
+  static std::string_view readKey(std::string_view text,
+                                  size_t& pos,
+                                  std::string& unescaped);
+  static void readString(std::string_view text,
+                         size_t& pos,
+                         std::string& str);
+};
+
+/*
+  Reads the rows in the "value" array of a WelshStatsJSON document, and the
+  link to its next page ("odata.nextLink"), if any, skipping everything else.
+*/
+class JSONRowReader {
+protected:
+  const JSONProjection& mProjection;
+  std::string_view mText;
+  size_t mPos;
+  bool mStarted;
+  bool mInRows;
+  bool mFirstRow;
+  std::string mNextLink;
+
+  void readMembers();
+
+public:
+  JSONRowReader(const JSONProjection& projection, std::string_view text);
+  ~JSONRowReader() = default;
+
+  JSONRowReader(const JSONRowReader& other) = delete;
+  JSONRowReader& operator=(const JSONRowReader& other) = delete;
+
+  bool next(std::vector<nlohmann::json>& row);
+  const std::string& getNextLink() const noexcept;
+};
+
+#endif // PROJECTION_H_
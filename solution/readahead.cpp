@@ -0,0 +1,419 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the implementation of the ReadAheadBuffer,
+  FileBlockReader and PipeBlockReader classes. See the header file for additional comments.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#endif
+
+#include "readahead.h"
+
+/*
+  The totals reported by getReadAheadStats(), which are updated by the
+  streams of every ReadAheadBuffer.
+*/
+static std::atomic<uint64_t> readAheadBlocks(0);
+static std::atomic<uint64_t> readAheadWaits(0);
+static std::atomic<int64_t> readAheadWaitNanos(0);
+
+/*
+  Retrieve the number of blocks read by every ReadAheadBuffer so far, how
+  many of them the stream had to wait for (i.e. they had not been read ahead
+  in time), and the total time spent waiting.
+
+  @return
+    The totals
+
+  @example
+    ReadAheadStats stats = getReadAheadStats();
+    std::cerr << stats.waitTime.count() << "ns waiting for I/O";
+*/
+ReadAheadStats getReadAheadStats() noexcept {
+  return ReadAheadStats{
+      readAheadBlocks,
+      readAheadWaits,
+      std::chrono::nanoseconds(readAheadWaitNanos)};
+}
+
+/*
+  Constructor for a reader of a plain file, which hints to the OS that the
+  file will be read sequentially, so that it reads further ahead itself.
+
+  @param path
+    The path to the file
+
+  @throws
+    std::runtime_error if the file cannot be opened
+
+  @example
+    ReadAheadBuffer buffer(std::make_unique<FileBlockReader>("popu1009.json"),
+                           1024 * 1024,
+                           2);
+*/
+FileBlockReader::FileBlockReader(const std::string& path)
+    : mPath(path), mFile(std::fopen(path.c_str(), "r")) {
+  if (mFile == nullptr) {
+    throw std::runtime_error("FileBlockReader: Failed to open file " + path);
+  }
+
+  // Our blocks are large, so the stdio buffer would only add a copy
+  std::setvbuf(mFile, nullptr, _IONBF, 0);
+
+#if !defined(_WIN32) && defined(POSIX_FADV_SEQUENTIAL)
+  posix_fadvise(fileno(mFile), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+FileBlockReader::~FileBlockReader() {
+  std::fclose(mFile);
+}
+
+/*
+  Read the next block of the file.
+
+  @param data
+    The buffer to read into
+
+  @param size
+    The size of the buffer
+
+  @return
+    The number of bytes read, which is 0 only at the end of the file
+
+  @throws
+    std::runtime_error if the file cannot be read
+*/
+size_t FileBlockReader::read(char* data, size_t size) {
+  const size_t length = std::fread(data, 1, size, mFile);
+  if (length < size && std::ferror(mFile)) {
+    throw std::runtime_error("FileBlockReader: Failed to read " + mPath);
+  }
+
+  return length;
+}
+
+/*
+  Go back to the start of the file.
+
+  @throws
+    std::runtime_error if the file cannot be seeked
+*/
+void FileBlockReader::rewind() {
+  if (std::fseek(mFile, 0, SEEK_SET) != 0) {
+    throw std::runtime_error("FileBlockReader: Failed to rewind " + mPath);
+  }
+  std::clearerr(mFile);
+}
+
+/*
+  Constructor for a reader of a stream that can only be read once.
+
+  @param file
+    The stream, which is left open
+
+  @param name
+    The name of the stream, for errors
+
+  @example
+    ReadAheadBuffer buffer(
+        std::make_unique<PipeBlockReader>(stdin, "the standard input"),
+        64 * 1024,
+        4);
+*/
+PipeBlockReader::PipeBlockReader(std::FILE* file, const std::string& name)
+    : mName(name), mFile(file) {}
+
+/*
+  Read the next block of the stream, which may wait for the block to be
+  written to it.
+
+  @param data
+    The buffer to read into
+
+  @param size
+    The size of the buffer
+
+  @return
+    The number of bytes read, which is 0 only at the end of the stream
+
+  @throws
+    std::runtime_error if the stream cannot be read
+*/
+size_t PipeBlockReader::read(char* data, size_t size) {
+  const size_t length = std::fread(data, 1, size, mFile);
+  if (length < size && std::ferror(mFile)) {
+    throw std::runtime_error("PipeBlockReader: Failed to read " + mName);
+  }
+
+  return length;
+}
+
+/*
+  A stream that can only be read once cannot go back to its start.
+
+  @throws
+    std::runtime_error always
+*/
+void PipeBlockReader::rewind() {
+  throw std::runtime_error("PipeBlockReader: Cannot read " + mName +
+                           " again");
+}
+
+/*
+  Constructor for a stream buffer that reads blocks from a BlockReader ahead
+  of them being read from the stream, starting the thread that reads them.
+
+  @param reader
+    The source of the blocks
+
+  @param blockSize
+    The size of each block
+
+  @param numBlocks
+    The number of blocks in the ring, i.e. the block being read from the
+    stream and up to numBlocks - 1 blocks read ahead of it (at least 2)
+
+  @example
+    ReadAheadBuffer buffer(std::make_unique<GzipReader>("popu1009.json.gz"),
+                           64 * 1024,
+                           4);
+    std::istream stream(&buffer);
+*/
+ReadAheadBuffer::ReadAheadBuffer(std::unique_ptr<BlockReader> reader,
+                                 size_t blockSize,
+                                 size_t numBlocks)
+    : mReader(std::move(reader)),
+      mBlocks(std::max<size_t>(numBlocks, 2), std::vector<char>(blockSize)),
+      mLengths(mBlocks.size(), 0),
+      mThread(),
+      mMutex(),
+      mChanged(),
+      mHead(0),
+      mFilled(0),
+      mHolding(false),
+      mEnded(false),
+      mStopping(false),
+      mError(),
+      mBlockStart(0) {
+  start();
+}
+
+/*
+  Stop the thread, waiting for the block being read (if any).
+*/
+ReadAheadBuffer::~ReadAheadBuffer() {
+  stop();
+}
+
+/*
+  Start reading blocks into an empty ring from the current position of the
+  BlockReader.
+*/
+void ReadAheadBuffer::start() {
+  mHead = 0;
+  mFilled = 0;
+  mHolding = false;
+  mEnded = false;
+  mStopping = false;
+  mError = nullptr;
+  mBlockStart = 0;
+  setg(nullptr, nullptr, nullptr);
+
+  mThread = std::thread(&ReadAheadBuffer::readBlocks, this);
+}
+
+/*
+  Stop reading blocks, and wait for the thread to finish.
+*/
+void ReadAheadBuffer::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStopping = true;
+    mChanged.notify_all();
+  }
+
+  if (mThread.joinable()) {
+    mThread.join();
+  }
+}
+
+/*
+  Read blocks into the ring until the end of the input, an error, or we are
+  stopped. This runs on mThread, and waits whenever every block in the ring
+  is full. A block is only filled while it is not part of the ring that the
+  stream can see, so it is filled without holding the lock.
+*/
+void ReadAheadBuffer::readBlocks() {
+  while (true) {
+    size_t slot;
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mChanged.wait(lock, [this]() {
+        return mStopping || mFilled < mBlocks.size();
+      });
+      if (mStopping) {
+        return;
+      }
+      slot = (mHead + mFilled) % mBlocks.size();
+    }
+
+    size_t length = 0;
+    std::exception_ptr error;
+    try {
+      length = mReader->read(mBlocks[slot].data(), mBlocks[slot].size());
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (error || length == 0) {
+      mError = error;
+      mEnded = true;
+      mChanged.notify_all();
+      return;
+    }
+
+    mLengths[slot] = length;
+    mFilled++;
+    mChanged.notify_all();
+  }
+}
+
+/*
+  Release the block being read from the stream (if any) back to the ring,
+  and wait for the next block.
+
+  @return
+    The length of the next block, which is 0 at the end of the input
+
+  @throws
+    The error reading the input, if the blocks before it have all been read
+*/
+size_t ReadAheadBuffer::nextBlock() {
+  std::unique_lock<std::mutex> lock(mMutex);
+  if (mHolding) {
+    mHead = (mHead + 1) % mBlocks.size();
+    mFilled--;
+    mHolding = false;
+    mChanged.notify_all();
+  }
+
+  // Time spent waiting here is time the parser is waiting on I/O
+  if (mFilled == 0 && !mEnded) {
+    const auto waitStart = std::chrono::steady_clock::now();
+    mChanged.wait(lock, [this]() { return mFilled > 0 || mEnded; });
+    readAheadWaits += mFilled > 0 ? 1 : 0;
+    readAheadWaitNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - waitStart).count();
+  }
+
+  if (mFilled == 0) {
+    setg(nullptr, nullptr, nullptr);
+    if (mError) {
+      std::rethrow_exception(mError);
+    }
+    return 0;
+  }
+
+  mHolding = true;
+  readAheadBlocks++;
+  char* block = mBlocks[mHead].data();
+  setg(block, block, block + mLengths[mHead]);
+
+  return mLengths[mHead];
+}
+
+/*
+  Move on to the next block.
+
+  @return
+    The next character, or EOF at the end of the input
+*/
+ReadAheadBuffer::int_type ReadAheadBuffer::underflow() {
+  if (gptr() < egptr()) {
+    return traits_type::to_int_type(*gptr());
+  }
+
+  mBlockStart += egptr() - eback();
+  return nextBlock() == 0 ? traits_type::eof()
+                          : traits_type::to_int_type(*gptr());
+}
+
+/*
+  Seek to a position relative to the start of, or the current position in,
+  the input. The end of the input is not known until it has been read, so
+  seeking relative to it is not supported.
+
+  @return
+    The new position, or -1 if it cannot be seeked to
+*/
+ReadAheadBuffer::pos_type ReadAheadBuffer::seekoff(
+    off_type off,
+    std::ios_base::seekdir dir,
+    std::ios_base::openmode which) {
+  if (dir == std::ios_base::end) {
+    return pos_type(off_type(-1));
+  } else if (dir == std::ios_base::cur) {
+    off += mBlockStart + (gptr() - eback());
+  }
+
+  return seekpos(pos_type(off), which);
+}
+
+/*
+  Seek to a position in the input. Within the current block, this just
+  moves within it, otherwise the input is read up to the position, from its
+  start if the position is before the current block.
+
+  @return
+    The new position, or -1 if it is beyond the end of the input
+*/
+ReadAheadBuffer::pos_type ReadAheadBuffer::seekpos(
+    pos_type pos,
+    std::ios_base::openmode which) {
+  const off_type target = off_type(pos);
+  if (!(which & std::ios_base::in) || target < 0) {
+    return pos_type(off_type(-1));
+  }
+
+  if (target < mBlockStart) {
+    stop();
+    mReader->rewind();
+    start();
+  }
+
+  while (target > mBlockStart + (egptr() - eback())) {
+    mBlockStart += egptr() - eback();
+    if (nextBlock() == 0) {
+      return pos_type(off_type(-1));
+    }
+  }
+
+  setg(eback(), eback() + (target - mBlockStart), egptr());
+  return pos;
+}
@@ -0,0 +1,161 @@
+#ifndef READAHEAD_H_
+#define READAHEAD_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the ReadAheadBuffer class, a stream buffer that reads
+  blocks of its input on a thread of its own, ahead of them being parsed,
+  so that reading (e.g. decompressing, see compressed.h) overlaps parsing.
+
+  A BlockReader produces the blocks. The blocks are kept in a ring of a
+  fixed number of buffers: the thread fills the free buffers in turn, and
+  waits when they are all full, while the stream reads from the oldest. So
+  memory is bounded by the size of the ring, however large the input.
+
+  A FileBlockReader reads a plain file in large blocks, hinting to the OS
+  that it is read sequentially. With a ring of two blocks, the next block of
+  the file is read while the parser works through the current one, i.e. the
+  file is double buffered (see InputOptions::readAhead). A
+  PipeBlockReader reads the standard input (or a pipe) in the same way, but
+  it cannot go back to its start.
+
+  The time the stream spends waiting for a block that has not been read yet
+  is totalled across every ReadAheadBuffer (see getReadAheadStats()), which
+  is the time spent waiting on I/O rather than parsing.
+
+  The stream can be seeked within, as the parsers do to check that a stream
+  is readable, but seeking back before the current block reads the input
+  again from its start. An error reading the input is thrown from the stream
+  once the blocks before it have been read.
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <ios>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+  The source of the blocks for a ReadAheadBuffer, which is only used from
+  the ReadAheadBuffer's thread.
+*/
+class BlockReader {
+public:
+  virtual ~BlockReader() = default;
+
+  /*
+    Read up to size bytes into data, returning the number read, which is 0
+    only at the end of the input. Throws std::runtime_error on failure.
+  */
+  virtual size_t read(char* data, size_t size) = 0;
+
+  /*
+    Go back to the start of the input. Throws std::runtime_error on failure.
+  */
+  virtual void rewind() = 0;
+};
+
+/*
+  A BlockReader for a plain file.
+*/
+class FileBlockReader : public BlockReader {
+protected:
+  const std::string mPath;
+  std::FILE* mFile;
+
+public:
+  explicit FileBlockReader(const std::string& path);
+  virtual ~FileBlockReader();
+
+  FileBlockReader(const FileBlockReader& other) = delete;
+  FileBlockReader& operator=(const FileBlockReader& other) = delete;
+
+  virtual size_t read(char* data, size_t size);
+  virtual void rewind();
+};
+
+/*
+  A BlockReader for a stream that can only be read once, from start to end,
+  e.g. the standard input or a pipe, which it does not close.
+*/
+class PipeBlockReader : public BlockReader {
+protected:
+  const std::string mName;
+  std::FILE* mFile;
+
+public:
+  PipeBlockReader(std::FILE* file, const std::string& name);
+  virtual ~PipeBlockReader() = default;
+
+  PipeBlockReader(const PipeBlockReader& other) = delete;
+  PipeBlockReader& operator=(const PipeBlockReader& other) = delete;
+
+  virtual size_t read(char* data, size_t size);
+  virtual void rewind();
+};
+
+/*
+  The blocks read by every ReadAheadBuffer so far, how many of them the
+  stream had to wait for, and for how long in total.
+*/
+struct ReadAheadStats {
+  uint64_t blocks;
+  uint64_t waits;
+  std::chrono::nanoseconds waitTime;
+};
+
+ReadAheadStats getReadAheadStats() noexcept;
+
+class ReadAheadBuffer : public std::streambuf {
+protected:
+  std::unique_ptr<BlockReader> mReader;
+  std::vector<std::vector<char>> mBlocks;
+  std::vector<size_t> mLengths;
+
+  std::thread mThread;
+  std::mutex mMutex;
+  std::condition_variable mChanged;
+  size_t mHead;
+  size_t mFilled;
+  bool mHolding;
+  bool mEnded;
+  bool mStopping;
+  std::exception_ptr mError;
+
+  std::streamoff mBlockStart;
+
+  void start();
+  void stop();
+  void readBlocks();
+  size_t nextBlock();
+
+  virtual int_type underflow();
+  virtual pos_type seekoff(off_type off,
+                           std::ios_base::seekdir dir,
+                           std::ios_base::openmode which);
+  virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+
+public:
+  ReadAheadBuffer(std::unique_ptr<BlockReader> reader,
+                  size_t blockSize,
+                  size_t numBlocks);
+  virtual ~ReadAheadBuffer();
+
+  ReadAheadBuffer(const ReadAheadBuffer& other) = delete;
+  ReadAheadBuffer& operator=(const ReadAheadBuffer& other) = delete;
+};
+
+#endif // READAHEAD_H_
@@ -0,0 +1,461 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the implementation of the RowIndex class. See the header
+  file for additional comments.
+*/
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "lib_json.hpp"
+
+#include "datasets.h"
+#include "fingerprint.h"
+#include "rowindex.h"
+#include "structural.h"
+
+/*
+  An alias for the imported JSON parsing library.
+*/
+using json = nlohmann::json;
+
+const unsigned int RowIndex::VERSION;
+
+/*
+  The number of bytes of a file given to the StructuralScanner at a time, so
+  that the positions it finds for a large file are not all held at once.
+*/
+const size_t ROWINDEX_SCAN_CHUNK = 64 * 1024;
+
+/*
+  Find the rows of the "value" array in the contents of a WelshStatsJSON file,
+  calling found with the byte range of each row object in turn.
+
+  This only tracks the nesting of objects and arrays (skipping over strings),
+  visiting the structural characters found by a StructuralScanner, so it is
+  much cheaper than parsing the file.
+
+  @throws
+    std::runtime_error if the file does not contain a "value" array
+*/
+static void scanRows(const std::string& contents,
+                     const std::function<void(size_t, size_t)>& found) {
+  size_t depth = 0;
+  size_t rowBegin = 0;
+  size_t stringBegin = 0;
+  bool inString = false;
+  bool inValue = false;
+  bool foundValue = false;
+  std::string lastString;
+
+  StructuralScanner scanner(ScanFormat::JSON);
+  std::vector<size_t> positions;
+
+  for (size_t chunk = 0; chunk < contents.size();
+       chunk += ROWINDEX_SCAN_CHUNK) {
+    positions.clear();
+    scanner.scan(contents.data() + chunk,
+                 std::min(ROWINDEX_SCAN_CHUNK, contents.size() - chunk),
+                 chunk,
+                 positions);
+
+    for (auto it = positions.cbegin(); it != positions.cend(); it++) {
+      const size_t i = *it;
+      const char c = contents[i];
+      if (c == '"') {
+        // Remember the string if it may be a top-level key
+        if (!inString) {
+          stringBegin = i + 1;
+        } else if (depth == 1) {
+          lastString.assign(contents, stringBegin, i - stringBegin);
+        }
+        inString = !inString;
+      } else if (c == '{' || c == '[') {
+        depth++;
+        if (depth == 2 && c == '[' && lastString == "value") {
+          inValue = true;
+          foundValue = true;
+        } else if (depth == 3 && inValue) {
+          rowBegin = i;
+        }
+      } else if (c == '}' || c == ']') {
+        if (depth == 0) {
+          throw std::runtime_error("RowIndex: Unbalanced JSON");
+        } else if (depth == 3 && inValue) {
+          found(rowBegin, i + 1);
+        } else if (depth == 2) {
+          inValue = false;
+        }
+        depth--;
+      }
+    }
+  }
+
+  if (!foundValue) {
+    throw std::runtime_error("RowIndex: No value array found");
+  }
+}
+
+/*
+  Construct an empty RowIndex.
+*/
+RowIndex::RowIndex() : mFingerprint(), mColumns(), mGroups() {}
+
+/*
+  Build a RowIndex for the contents of a WelshStatsJSON file.
+
+  @param contents
+    The contents of the file
+
+  @param fingerprint
+    The fingerprint of the file
+
+  @param cols
+    The column mapping for the dataset
+
+  @throws
+    std::runtime_error if the contents cannot be indexed, e.g. a row does not
+    have the columns we index by
+*/
+RowIndex::RowIndex(const std::string& contents,
+                   const FileFingerprint& fingerprint,
+                   const BethYw::SourceColumnMapping& cols)
+    : mFingerprint(fingerprint), mColumns(keyColumns(cols)), mGroups() {
+  using Key = std::tuple<std::string, std::string, std::string>;
+  std::map<Key, RowGroup> groups;
+  RowGroup* lastGroup = nullptr;
+
+  scanRows(contents, [&](size_t begin, size_t end) {
+    Key key;
+    try {
+      const json row = json::parse(contents.cbegin() + begin,
+                                   contents.cbegin() + end);
+      std::get<0>(key) = row.at(mColumns[0]).get<std::string>();
+      std::get<1>(key) = row.at(mColumns[1]).get<std::string>();
+      if (!mColumns[2].empty()) {
+        std::get<2>(key) = row.at(mColumns[2]).get<std::string>();
+      }
+    } catch (const json::exception& ex) {
+      throw std::runtime_error("RowIndex: Failed to index row: " +
+                               std::string(ex.what()));
+    }
+
+    auto groupIt = groups.find(key);
+    if (groupIt == groups.end()) {
+      RowGroup group{std::get<0>(key), std::get<1>(key), std::get<2>(key), {}};
+      groupIt = groups.emplace(std::move(key), std::move(group)).first;
+    }
+
+    // Consecutive rows in the same group share a range, which then includes
+    // the separators between them
+    RowGroup& group = groupIt->second;
+    if (&group == lastGroup) {
+      group.ranges.back().end = end;
+    } else {
+      group.ranges.push_back(RowRange{begin, end});
+    }
+    lastGroup = &group;
+  });
+
+  mGroups.reserve(groups.size());
+  for (auto it = groups.begin(); it != groups.end(); it++) {
+    mGroups.push_back(std::move(it->second));
+  }
+}
+
+/*
+  Retrieve the RowIndex for a WelshStatsJSON file. If there is a cached index
+  alongside the file that was built from the same version of the file (and
+  with the same columns), it is used. Otherwise, the index is built and we
+  try to cache it; failing to write the cache is not an error.
+
+  @param path
+    The path to the dataset file
+
+  @param cols
+    The column mapping for the dataset
+
+  @return
+    The RowIndex for the file
+
+  @throws
+    std::runtime_error if the file cannot be read or indexed
+
+  @example
+    RowIndex index = RowIndex::forFile("datasets/popu1009.json",
+                                       BethYw::InputFiles::DATASETS[0].COLS);
+*/
+RowIndex RowIndex::forFile(const std::string& path,
+                           const BethYw::SourceColumnMapping& cols) {
+  const std::string sidecar = sidecarPath(path);
+  const std::vector<std::string> columns = keyColumns(cols);
+
+  std::string cached;
+  if (readFileContents(sidecar, cached)) {
+    try {
+      RowIndex index = fromJSON(cached);
+      if (index.mColumns == columns && index.mFingerprint.matches(path)) {
+        return index;
+      }
+    } catch (const std::runtime_error& ex) {
+      // The cached index is corrupt, so we rebuild it
+    }
+  }
+
+  const FileFingerprint fingerprint = FileFingerprint::of(path);
+  std::string contents;
+  if (!readFileContents(path, contents)) {
+    throw std::runtime_error("RowIndex::forFile: Failed to read " + path);
+  }
+
+  RowIndex index(contents, fingerprint, cols);
+  writeFileAtomically(sidecar, index.toJSON());
+
+  return index;
+}
+
+/*
+  Retrieve the path of the cached index for a dataset file.
+
+  @param path
+    The path to the dataset file
+
+  @return
+    The path of the cached index
+*/
+std::string RowIndex::sidecarPath(const std::string& path) {
+  return path + ".idx";
+}
+
+/*
+  Retrieve the names of the columns a RowIndex groups rows by: the local
+  authority code, the English area name, and the measure code (or an empty
+  string for datasets with a single measure).
+
+  @param cols
+    The column mapping for the dataset
+
+  @return
+    The names of the three columns
+
+  @throws
+    std::runtime_error if the column mapping is incomplete
+*/
+std::vector<std::string> RowIndex::keyColumns(
+    const BethYw::SourceColumnMapping& cols) {
+  auto codeIt = cols.find(BethYw::AUTH_CODE);
+  auto nameIt = cols.find(BethYw::AUTH_NAME_ENG);
+  if (codeIt == cols.end() || nameIt == cols.end()) {
+    throw std::runtime_error("RowIndex: Incomplete column specification!");
+  }
+
+  auto measureIt = cols.find(BethYw::MEASURE_CODE);
+  return {codeIt->second,
+          nameIt->second,
+          measureIt == cols.end() ? "" : measureIt->second};
+}
+
+/*
+  Retrieve the fingerprint of the file this index was built from.
+
+  @return
+    The fingerprint
+*/
+const FileFingerprint& RowIndex::getFingerprint() const noexcept {
+  return mFingerprint;
+}
+
+/*
+  Retrieve the names of the columns this index groups rows by.
+
+  @return
+    The column names, as returned by keyColumns()
+*/
+const std::vector<std::string>& RowIndex::getColumns() const noexcept {
+  return mColumns;
+}
+
+/*
+  Retrieve the groups of rows, sorted by their code, name and measure.
+
+  @return
+    The groups
+*/
+const std::vector<RowGroup>& RowIndex::getGroups() const noexcept {
+  return mGroups;
+}
+
+/*
+  Select the byte ranges of the groups of rows matching a predicate.
+
+  @param predicate
+    A function returning true for the groups to select
+
+  @return
+    The ranges of the selected rows, in the order they appear in the file
+
+  @example
+    auto ranges = index.select([](const RowGroup& group) {
+      return group.code == "W06000023";
+    });
+*/
+std::vector<RowRange> RowIndex::select(
+    const std::function<bool(const RowGroup&)>& predicate) const {
+  std::vector<RowRange> ranges;
+  for (auto it = mGroups.cbegin(); it != mGroups.cend(); it++) {
+    if (predicate(*it)) {
+      ranges.insert(ranges.end(), it->ranges.cbegin(), it->ranges.cend());
+    }
+  }
+
+  std::sort(ranges.begin(), ranges.end(),
+            [](const RowRange& a, const RowRange& b) {
+              return a.begin < b.begin;
+            });
+
+  return ranges;
+}
+
+/*
+  Read the given ranges of rows from a WelshStatsJSON file, and wrap them in
+  a "value" array, so that the result can be passed to
+  Areas::populateFromWelshStatsJSON() in place of the whole file.
+
+  @param is
+    The stream of the dataset file
+
+  @param ranges
+    The ranges of rows to read, e.g. from select()
+
+  @return
+    A WelshStatsJSON document containing only the given rows
+
+  @throws
+    std::runtime_error if a range cannot be read
+*/
+std::string RowIndex::extract(std::istream& is,
+                              const std::vector<RowRange>& ranges) {
+  std::string out = "{\"value\":[";
+  for (auto it = ranges.cbegin(); it != ranges.cend(); it++) {
+    if (it != ranges.cbegin()) {
+      out.push_back(',');
+    }
+
+    const size_t offset = out.size();
+    out.resize(offset + (it->end - it->begin));
+    is.seekg(it->begin);
+    is.read(&out[offset], it->end - it->begin);
+    if (!is) {
+      throw std::runtime_error("RowIndex::extract: Failed to read rows");
+    }
+  }
+  out += "]}";
+
+  return out;
+}
+
+/*
+  Serialise the index, e.g. to cache it.
+
+  @return
+    The index as a JSON document
+*/
+std::string RowIndex::toJSON() const {
+  json groups = json::array();
+  for (auto it = mGroups.cbegin(); it != mGroups.cend(); it++) {
+    json ranges = json::array();
+    for (auto rangeIt = it->ranges.cbegin();
+         rangeIt != it->ranges.cend();
+         rangeIt++) {
+      ranges.push_back(rangeIt->begin);
+      ranges.push_back(rangeIt->end);
+    }
+
+    groups.push_back({
+      {"code", it->code},
+      {"name", it->name},
+      {"measure", it->measure},
+      {"ranges", std::move(ranges)}
+    });
+  }
+
+  json j = {
+    {"version", VERSION},
+    {"size", mFingerprint.getSize()},
+    {"modified", mFingerprint.getModified()},
+    {"hash", mFingerprint.getHash()},
+    {"columns", mColumns},
+    {"groups", std::move(groups)}
+  };
+
+  return j.dump();
+}
+
+/*
+  Deserialise an index written by toJSON().
+
+  @param str
+    The index as a JSON document
+
+  @return
+    The index
+
+  @throws
+    std::runtime_error if the document is not a valid index
+*/
+RowIndex RowIndex::fromJSON(const std::string& str) {
+  RowIndex index;
+  try {
+    const json j = json::parse(str);
+    if (j.at("version").get<unsigned int>() != VERSION) {
+      throw std::runtime_error("RowIndex::fromJSON: Unsupported version");
+    }
+
+    index.mFingerprint = FileFingerprint(j.at("size").get<uint64_t>(),
+                                         j.at("modified").get<int64_t>(),
+                                         j.at("hash").get<uint64_t>());
+    index.mColumns = j.at("columns").get<std::vector<std::string>>();
+    if (index.mColumns.size() != 3) {
+      throw std::runtime_error("RowIndex::fromJSON: Invalid columns");
+    }
+
+    for (const auto& group : j.at("groups")) {
+      const auto ranges = group.at("ranges").get<std::vector<uint64_t>>();
+      if (ranges.size() % 2 != 0) {
+        throw std::runtime_error("RowIndex::fromJSON: Invalid ranges");
+      }
+
+      RowGroup rowGroup{group.at("code").get<std::string>(),
+                        group.at("name").get<std::string>(),
+                        group.at("measure").get<std::string>(),
+                        {}};
+      for (size_t i = 0; i < ranges.size(); i += 2) {
+        if (ranges[i] >= ranges[i + 1] ||
+            ranges[i + 1] > index.mFingerprint.getSize()) {
+          throw std::runtime_error("RowIndex::fromJSON: Invalid ranges");
+        }
+        rowGroup.ranges.push_back(RowRange{ranges[i], ranges[i + 1]});
+      }
+      index.mGroups.push_back(std::move(rowGroup));
+    }
+  } catch (const json::exception& ex) {
+    throw std::runtime_error("RowIndex::fromJSON: Invalid index: " +
+                             std::string(ex.what()));
+  }
+
+  return index;
+}
@@ -0,0 +1,93 @@
+#ifndef ROWINDEX_H_
+#define ROWINDEX_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the RowIndex class, a sidecar index for WelshStatsJSON
+  dataset files.
+
+  A RowIndex records where in the file the rows for each combination of local
+  authority code, English area name, and measure code are, as byte ranges of
+  consecutive rows in the "value" array. When the areas (or measures) to
+  import are filtered, we can then read and parse only the ranges of the rows
+  that might be imported, rather than the whole file.
+
+  Building the index requires parsing every row, so the index is cached in a
+  file alongside the dataset (see RowIndex::forFile()), along with the
+  FileFingerprint of the dataset it was built from. The cached index is only
+  used if the dataset still has the same fingerprint.
+ */
+
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "datasets.h"
+#include "fingerprint.h"
+
+/*
+  A half-open byte range [begin, end) of one or more consecutive rows.
+*/
+struct RowRange {
+  uint64_t begin;
+  uint64_t end;
+};
+
+/*
+  The rows in a file with a given local authority code, English area name,
+  and measure code (which is empty for datasets with a single measure).
+*/
+struct RowGroup {
+  std::string code;
+  std::string name;
+  std::string measure;
+  std::vector<RowRange> ranges;
+};
+
+class RowIndex {
+protected:
+  FileFingerprint mFingerprint;
+  std::vector<std::string> mColumns;
+  std::vector<RowGroup> mGroups;
+
+public:
+  static const unsigned int VERSION = 1;
+
+  RowIndex();
+  RowIndex(const std::string& contents,
+           const FileFingerprint& fingerprint,
+           const BethYw::SourceColumnMapping& cols);
+  ~RowIndex() = default;
+
+  RowIndex(const RowIndex& other) = default;
+  RowIndex& operator=(const RowIndex& other) = default;
+  RowIndex(RowIndex&& other) = default;
+  RowIndex& operator=(RowIndex&& other) = default;
+
+  static RowIndex forFile(const std::string& path,
+                          const BethYw::SourceColumnMapping& cols);
+  static std::string sidecarPath(const std::string& path);
+  static std::vector<std::string> keyColumns(
+      const BethYw::SourceColumnMapping& cols);
+
+  const FileFingerprint& getFingerprint() const noexcept;
+  const std::vector<std::string>& getColumns() const noexcept;
+  const std::vector<RowGroup>& getGroups() const noexcept;
+
+  std::vector<RowRange> select(
+      const std::function<bool(const RowGroup&)>& predicate) const;
+  static std::string extract(std::istream& is,
+                             const std::vector<RowRange>& ranges);
+
+  std::string toJSON() const;
+  static RowIndex fromJSON(const std::string& str);
+};
+
+#endif // ROWINDEX_H_
@@ -0,0 +1,388 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the implementation of the TaskScheduler class. See the
+  header file for additional comments.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "scheduler.h"
+
+/*
+  The scheduler whose worker the current thread is (if any), and which one,
+  so that the tasks a task makes ready go on the deque of the thread that ran
+  it.
+*/
+static thread_local const TaskScheduler* currentScheduler = nullptr;
+static thread_local unsigned int currentWorker = 0;
+
+/*
+  Construct the state of a task that is yet to be added.
+*/
+TaskScheduler::TaskState::TaskState(Task&& fn)
+    : fn(std::move(fn)),
+      mutex(),
+      dependents(),
+      done(false),
+      waitingFor(1),
+      error(nullptr) {}
+
+/*
+  Constructor for a scheduler, which starts the threads that run the tasks.
+  The thread that calls wait() is one of them, so with one thread, every
+  task is run by wait() on the calling thread.
+
+  @param threads
+    The number of threads to run tasks on, at least 1
+
+  @example
+    TaskScheduler scheduler(std::thread::hardware_concurrency());
+*/
+TaskScheduler::TaskScheduler(unsigned int threads)
+    : mThreads(std::max(threads, 1u)),
+      mWorkers(),
+      mWorkerThreads(),
+      mTasksMutex(),
+      mTasks(),
+      mUnfinished(0),
+      mQueued(0),
+      mSleeping(0),
+      mSleepMutex(),
+      mSleep(),
+      mStopping(false),
+      mExecuted(0),
+      mStolen(0),
+      mNextWorker(0) {
+  for (unsigned int i = 0; i < mThreads; i++) {
+    mWorkers.push_back(std::make_unique<Worker>());
+  }
+
+  for (unsigned int i = 1; i < mThreads; i++) {
+    mWorkerThreads.emplace_back(&TaskScheduler::work, this, i);
+  }
+}
+
+/*
+  Finish any tasks that have not been waited for (ignoring their errors) and
+  stop the threads.
+*/
+TaskScheduler::~TaskScheduler() {
+  runUntilIdle();
+
+  mStopping = true;
+  {
+    std::lock_guard<std::mutex> lock(mSleepMutex);
+    mSleep.notify_all();
+  }
+
+  for (auto it = mWorkerThreads.begin(); it != mWorkerThreads.end(); it++) {
+    it->join();
+  }
+}
+
+/*
+  @return
+    The number of threads tasks are run on
+*/
+unsigned int TaskScheduler::getThreads() const noexcept {
+  return mThreads;
+}
+
+/*
+  @return
+    The number of tasks that have been run (or skipped because a task they
+    depend on failed)
+*/
+uint64_t TaskScheduler::getExecuted() const noexcept {
+  return mExecuted;
+}
+
+/*
+  @return
+    The number of tasks that were stolen from the deque of another thread
+*/
+uint64_t TaskScheduler::getStolen() const noexcept {
+  return mStolen;
+}
+
+/*
+  Add a task, which is run once the tasks it depends on have finished. The
+  task may be run before this function returns.
+
+  If a task throws an exception, the tasks that depend on it are not run,
+  and wait() throws the exception.
+
+  @param fn
+    The task
+
+  @param after
+    The IDs of the tasks that must finish before the task is run
+
+  @return
+    The ID of the task, which is valid until wait() returns
+
+  @throws
+    std::out_of_range if a task in after does not exist
+
+  @example
+    TaskScheduler scheduler(4);
+    auto load = scheduler.submit([&]() { ... });
+    scheduler.submit([&]() { ... }, {load});
+    scheduler.wait();
+*/
+TaskScheduler::TaskId TaskScheduler::submit(Task fn,
+                                            const std::vector<TaskId>& after) {
+  auto owned = std::make_unique<TaskState>(std::move(fn));
+  TaskState* task = owned.get();
+
+  TaskId id;
+  std::vector<TaskState*> dependencies;
+  {
+    std::lock_guard<std::mutex> lock(mTasksMutex);
+    for (auto it = after.cbegin(); it != after.cend(); it++) {
+      if (*it >= mTasks.size()) {
+        throw std::out_of_range("TaskScheduler::submit: No task with the ID " +
+                                std::to_string(*it));
+      }
+      dependencies.push_back(mTasks[*it].get());
+    }
+
+    id = mTasks.size();
+    mTasks.push_back(std::move(owned));
+  }
+  mUnfinished++;
+
+  for (auto it = dependencies.begin(); it != dependencies.end(); it++) {
+    TaskState* dependency = *it;
+    std::lock_guard<std::mutex> lock(dependency->mutex);
+    if (!dependency->done) {
+      task->waitingFor++;
+      dependency->dependents.push_back(task);
+    } else if (dependency->error != nullptr) {
+      std::lock_guard<std::mutex> taskLock(task->mutex);
+      if (task->error == nullptr) {
+        task->error = dependency->error;
+      }
+    }
+  }
+
+  if (--task->waitingFor == 0) {
+    push(task);
+  }
+
+  return id;
+}
+
+/*
+  Run tasks on the calling thread, alongside the others, until every task
+  has finished. The tasks are then forgotten, so their IDs may be reused.
+
+  This must not be called by a task.
+
+  @throws
+    The exception thrown by the first task (by ID) that failed, if any
+*/
+void TaskScheduler::wait() {
+  runUntilIdle();
+
+  std::exception_ptr error = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mTasksMutex);
+    for (auto it = mTasks.cbegin(); it != mTasks.cend(); it++) {
+      if ((*it)->error != nullptr) {
+        error = (*it)->error;
+        break;
+      }
+    }
+    mTasks.clear();
+  }
+
+  if (error != nullptr) {
+    std::rethrow_exception(error);
+  }
+}
+
+/*
+  Run tasks on the calling thread, as worker 0, until every task has
+  finished.
+*/
+void TaskScheduler::runUntilIdle() {
+  const TaskScheduler* previousScheduler = currentScheduler;
+  const unsigned int previousWorker = currentWorker;
+  currentScheduler = this;
+  currentWorker = 0;
+
+  while (mUnfinished > 0) {
+    TaskState* task = pop(0);
+    if (task != nullptr) {
+      execute(task);
+    } else {
+      sleepUntilQueued(true);
+    }
+  }
+
+  currentScheduler = previousScheduler;
+  currentWorker = previousWorker;
+}
+
+/*
+  A worker thread: run tasks until the scheduler is destroyed.
+
+  @param worker
+    The index of the worker's deque
+*/
+void TaskScheduler::work(unsigned int worker) {
+  currentScheduler = this;
+  currentWorker = worker;
+
+  for (;;) {
+    TaskState* task = pop(worker);
+    if (task != nullptr) {
+      execute(task);
+    } else if (mStopping) {
+      return;
+    } else {
+      sleepUntilQueued(false);
+    }
+  }
+}
+
+/*
+  Wait for a task to be queued (or, if untilIdle, for every task to have
+  finished, or the scheduler to be stopping).
+*/
+void TaskScheduler::sleepUntilQueued(bool untilIdle) {
+  std::unique_lock<std::mutex> lock(mSleepMutex);
+  mSleeping++;
+  mSleep.wait(lock, [this, untilIdle]() {
+    return mQueued > 0 || mStopping || (untilIdle && mUnfinished == 0);
+  });
+  mSleeping--;
+}
+
+/*
+  Queue a task that is ready to run: on the deque of the current thread if it
+  is one of ours, or otherwise on each deque in turn, and wake a sleeping
+  thread to run it.
+*/
+void TaskScheduler::push(TaskState* task) {
+  const unsigned int worker = currentScheduler == this
+                                  ? currentWorker
+                                  : mNextWorker++ % mThreads;
+  {
+    std::lock_guard<std::mutex> lock(mWorkers[worker]->mutex);
+    mWorkers[worker]->tasks.push_back(task);
+  }
+  mQueued++;
+
+  if (mSleeping > 0) {
+    std::lock_guard<std::mutex> lock(mSleepMutex);
+    mSleep.notify_one();
+  }
+}
+
+/*
+  Take the next task for a worker: the newest task on its own deque, or
+  failing that, the oldest task on another's.
+
+  @param worker
+    The index of the worker's deque
+
+  @return
+    The task, or nullptr if there are none queued
+*/
+TaskScheduler::TaskState* TaskScheduler::pop(unsigned int worker) {
+  {
+    Worker& own = *mWorkers[worker];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      TaskState* task = own.tasks.back();
+      own.tasks.pop_back();
+      mQueued--;
+      return task;
+    }
+  }
+
+  for (unsigned int i = 1; i < mThreads; i++) {
+    Worker& victim = *mWorkers[(worker + i) % mThreads];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      TaskState* task = victim.tasks.front();
+      victim.tasks.pop_front();
+      mQueued--;
+      mStolen++;
+      return task;
+    }
+  }
+
+  return nullptr;
+}
+
+/*
+  Run a task, unless a task it depends on failed, and then finish it.
+*/
+void TaskScheduler::execute(TaskState* task) {
+  if (task->error == nullptr) {
+    try {
+      task->fn();
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(task->mutex);
+      task->error = std::current_exception();
+    }
+  }
+
+  // Release anything the task holds on to now, rather than at wait()
+  task->fn = nullptr;
+  finish(task);
+}
+
+/*
+  Mark a task as finished, passing on its error (if any) to the tasks that
+  depend on it, and queue those that are now ready.
+*/
+void TaskScheduler::finish(TaskState* task) {
+  std::vector<TaskState*> dependents;
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->done = true;
+    dependents.swap(task->dependents);
+    error = task->error;
+  }
+  mExecuted++;
+
+  for (auto it = dependents.begin(); it != dependents.end(); it++) {
+    TaskState* dependent = *it;
+    if (error != nullptr) {
+      std::lock_guard<std::mutex> lock(dependent->mutex);
+      if (dependent->error == nullptr) {
+        dependent->error = error;
+      }
+    }
+
+    if (--dependent->waitingFor == 0) {
+      push(dependent);
+    }
+  }
+
+  if (--mUnfinished == 0) {
+    std::lock_guard<std::mutex> lock(mSleepMutex);
+    mSleep.notify_all();
+  }
+}
@@ -0,0 +1,105 @@
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the TaskScheduler class, which runs tasks (functions) on
+  a number of threads, by work stealing: each thread has a deque of tasks of
+  its own, which it takes from the back of (so the tasks it has just made
+  ready run while their data is still in its cache), and when it runs out, it
+  steals from the front of the others' deques.
+
+  A task can be given tasks it depends on, and only runs once they have all
+  finished. BethYw::run() uses this to load the datasets and render the areas
+  in parallel, while the data is merged in the same order as on one thread,
+  so the output is the same.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskScheduler {
+public:
+  using TaskId = size_t;
+  using Task = std::function<void()>;
+
+protected:
+  struct TaskState {
+    Task fn;
+
+    // Guards dependents and done, as tasks are added while others finish
+    std::mutex mutex;
+    std::vector<TaskState*> dependents;
+    bool done;
+
+    // The number of dependencies still to finish, plus one until the task
+    // has been added, so that it is not run before then
+    std::atomic<size_t> waitingFor;
+
+    // Set by the task, or the first dependency that failed, in which case
+    // the task is not run
+    std::exception_ptr error;
+
+    explicit TaskState(Task&& fn);
+  };
+
+  struct Worker {
+    std::mutex mutex;
+    std::deque<TaskState*> tasks;
+  };
+
+  const unsigned int mThreads;
+  std::vector<std::unique_ptr<Worker>> mWorkers;
+  std::vector<std::thread> mWorkerThreads;
+
+  std::mutex mTasksMutex;
+  std::vector<std::unique_ptr<TaskState>> mTasks;
+  std::atomic<size_t> mUnfinished;
+
+  std::atomic<size_t> mQueued;
+  std::atomic<unsigned int> mSleeping;
+  std::mutex mSleepMutex;
+  std::condition_variable mSleep;
+  std::atomic<bool> mStopping;
+
+  std::atomic<uint64_t> mExecuted;
+  std::atomic<uint64_t> mStolen;
+  std::atomic<unsigned int> mNextWorker;
+
+  void work(unsigned int worker);
+  void push(TaskState* task);
+  TaskState* pop(unsigned int worker);
+  void execute(TaskState* task);
+  void finish(TaskState* task);
+  void runUntilIdle();
+  void sleepUntilQueued(bool untilIdle);
+
+public:
+  explicit TaskScheduler(unsigned int threads);
+  ~TaskScheduler();
+
+  TaskScheduler(const TaskScheduler& other) = delete;
+  TaskScheduler& operator=(const TaskScheduler& other) = delete;
+
+  unsigned int getThreads() const noexcept;
+  uint64_t getExecuted() const noexcept;
+  uint64_t getStolen() const noexcept;
+
+  TaskId submit(Task fn, const std::vector<TaskId>& after = {});
+  void wait();
+};
+
+#endif // SCHEDULER_H_
@@ -0,0 +1,509 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the implementation of the DatasetSnapshot class. See the
+  header file for additional comments.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "lib_json.hpp"
+
+#include "area.h"
+#include "areas.h"
+#include "datasets.h"
+#include "fingerprint.h"
+#include "measure.h"
+#include "snapshot.h"
+
+/*
+  An alias for the imported JSON parsing library.
+*/
+using json = nlohmann::json;
+
+const unsigned int DatasetSnapshot::VERSION;
+
+/*
+  Construct an empty DatasetSnapshot, for an import that contributed nothing.
+*/
+DatasetSnapshot::DatasetSnapshot()
+    : mFingerprint(), mImport(), mAreas(), mAreaNames() {}
+
+/*
+  Take a snapshot of the data imported from a dataset file into an Areas
+  instance of its own. Area objects without any Measures are left out, as
+  they can only be (empty) copies of Areas that were imported beforehand.
+
+  @param areas
+    The Areas instance the dataset was imported into
+
+  @param fingerprint
+    The fingerprint of the file, taken before it was imported
+
+  @param import
+    The description of the import from describeImport()
+
+  @example
+    Areas data = Areas();
+    auto fingerprint = FileFingerprint::of("datasets/popu1009.json");
+    ...
+    DatasetSnapshot snapshot(data, fingerprint, import);
+*/
+DatasetSnapshot::DatasetSnapshot(const Areas& areas,
+                                 const FileFingerprint& fingerprint,
+                                 const std::vector<std::string>& import)
+    : mFingerprint(fingerprint), mImport(import), mAreas(), mAreaNames() {
+  for (auto areaIt = areas.cbegin(); areaIt != areas.cend(); areaIt++) {
+    if (areaIt->size() == 0) {
+      continue;
+    }
+
+    SnapshotArea area;
+    area.code = areaIt->getLocalAuthorityCode();
+
+    const auto& names = areaIt->getNames();
+    area.names.assign(names.cbegin(), names.cend());
+
+    for (auto measureIt = areaIt->cbegin();
+         measureIt != areaIt->cend();
+         measureIt++) {
+      const Measure& measure = measureIt->second;
+      area.measures.push_back(SnapshotMeasure{measure.getCodename(),
+                                              measure.getLabel(),
+                                              measure.getSum(),
+                                              {measure.cbegin(),
+                                               measure.cend()}});
+    }
+
+    mAreas.push_back(std::move(area));
+  }
+
+  const auto& areaNames = areas.getAreaNames();
+  for (auto it = areaNames.cbegin(); it != areaNames.cend(); it++) {
+    mAreaNames.emplace_back(it->first, it->second.str());
+  }
+}
+
+/*
+  Read the snapshot saved alongside a dataset file. Check that it is for the
+  current version of the file, and the same import, with isFor() before
+  restoring it.
+
+  @param path
+    The path to the dataset file
+
+  @return
+    The DatasetSnapshot saved for the file
+
+  @throws
+    std::runtime_error if there is no snapshot, or it is corrupt
+
+  @example
+    DatasetSnapshot snapshot =
+        DatasetSnapshot::forFile("datasets/popu1009.json");
+*/
+DatasetSnapshot DatasetSnapshot::forFile(const std::string& path) {
+  std::string cached;
+  if (!readFileContents(sidecarPath(path), cached)) {
+    throw std::runtime_error("DatasetSnapshot::forFile: No snapshot for " +
+                             path);
+  }
+
+  return fromJSON(cached);
+}
+
+/*
+  Retrieve the path of the saved snapshot for a dataset file.
+
+  @param path
+    The path to the dataset file
+
+  @return
+    The path of the saved snapshot
+*/
+std::string DatasetSnapshot::sidecarPath(const std::string& path) {
+  return path + ".snap";
+}
+
+/*
+  Describe everything, other than the contents of the dataset file, that
+  determines what importing it contributes to an Areas instance, so that a
+  snapshot is only restored for the same import.
+
+  This is the dataset definition and the filters. The parsers also match the
+  areas filter against the names of the Area objects imported beforehand
+  (e.g. the Welsh names from areas.csv), so when the areas are filtered, the
+  authority codes and names of the existing Areas are included as a hash.
+
+  @param source
+    The InputFileSource for the dataset
+
+  @param areasFilter
+    An unordered set of areas to filter, or empty to import all areas
+
+  @param measuresFilter
+    An unordered set of measures to filter, or empty to import all measures
+
+  @param yearsFilter
+    The range of years to import, which should both be 0 to import all years
+
+  @param existing
+    The Areas instance the dataset will be merged into
+
+  @param valueFilter
+    The ValueFilter of the rows to import, or nullptr to import every row
+
+  @return
+    The description of the import
+*/
+std::vector<std::string> DatasetSnapshot::describeImport(
+    const BethYw::InputFileSource& source,
+    const StringFilterSet& areasFilter,
+    const StringFilterSet& measuresFilter,
+    const YearFilterTuple& yearsFilter,
+    const Areas& existing,
+    const ValueFilter* valueFilter) {
+  std::vector<std::string> import;
+  import.push_back("parser:" +
+                   std::to_string(static_cast<int>(source.PARSER)));
+  for (auto it = source.COLS.cbegin(); it != source.COLS.cend(); it++) {
+    import.push_back("column:" + std::to_string(static_cast<int>(it->first)) +
+                     ":" + it->second);
+  }
+
+  // The filters are unordered sets, so we sort them to compare them
+  std::vector<std::string> areas(areasFilter.cbegin(), areasFilter.cend());
+  std::sort(areas.begin(), areas.end());
+  for (const auto& area : areas) {
+    import.push_back("area:" + area);
+  }
+
+  std::vector<std::string> measures(measuresFilter.cbegin(),
+                                    measuresFilter.cend());
+  std::sort(measures.begin(), measures.end());
+  for (const auto& measure : measures) {
+    import.push_back("measure:" + measure);
+  }
+
+  import.push_back("years:" + std::to_string(std::get<0>(yearsFilter)) +
+                   "-" + std::to_string(std::get<1>(yearsFilter)));
+
+  // Only the row predicate is applied by the parsers, and it is described
+  // canonically, so equivalent expressions share a snapshot
+  if (valueFilter != nullptr && valueFilter->hasRowPredicate()) {
+    import.push_back("where:" + valueFilter->describeRows());
+  }
+
+  if (!areasFilter.empty()) {
+    uint64_t hash = FileFingerprint::hash(nullptr, 0);
+    for (auto areaIt = existing.cbegin();
+         areaIt != existing.cend();
+         areaIt++) {
+      // Each string is hashed with its terminating null as a separator
+      const std::string& code = areaIt->getLocalAuthorityCode();
+      hash = FileFingerprint::hash(code.c_str(), code.size() + 1, hash);
+
+      const auto& names = areaIt->getNames();
+      for (auto it = names.cbegin(); it != names.cend(); it++) {
+        hash = FileFingerprint::hash(it->first.c_str(),
+                                     it->first.size() + 1,
+                                     hash);
+        hash = FileFingerprint::hash(it->second.c_str(),
+                                     it->second.size() + 1,
+                                     hash);
+      }
+    }
+
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx",
+                  static_cast<unsigned long long>(hash));
+    import.push_back(std::string("existing:") + hex);
+  }
+
+  return import;
+}
+
+/*
+  Retrieve the fingerprint of the file this snapshot was taken from.
+
+  @return
+    The fingerprint
+*/
+const FileFingerprint& DatasetSnapshot::getFingerprint() const noexcept {
+  return mFingerprint;
+}
+
+/*
+  Retrieve the description of the import this snapshot was taken from.
+
+  @return
+    The description from describeImport()
+*/
+const std::vector<std::string>& DatasetSnapshot::getImport() const noexcept {
+  return mImport;
+}
+
+/*
+  Retrieve the saved Area objects, in authority code order.
+
+  @return
+    The saved Areas
+*/
+const std::vector<SnapshotArea>& DatasetSnapshot::getAreas() const noexcept {
+  return mAreas;
+}
+
+/*
+  Check whether this snapshot can be restored in place of importing a file,
+  i.e. the file still has the same fingerprint (including the hash of its
+  contents) and the import is the same.
+
+  @param path
+    The path to the dataset file
+
+  @param import
+    The description of the import from describeImport()
+
+  @return
+    true if the snapshot can be restored
+*/
+bool DatasetSnapshot::isFor(
+    const std::string& path,
+    const std::vector<std::string>& import) const noexcept {
+  return mImport == import && mFingerprint.matches(path);
+}
+
+/*
+  Restore the snapshot into an Areas instance, giving the same result as
+  importing the file did when the snapshot was taken. This should be an
+  Areas instance of its own, to be merged with MergePolicy::Import.
+
+  @param areas
+    The Areas instance to restore the snapshot into
+
+  @example
+    Areas data = Areas();
+    DatasetSnapshot snapshot =
+        DatasetSnapshot::forFile("datasets/popu1009.json");
+    snapshot.restore(data);
+*/
+void DatasetSnapshot::restore(Areas& areas) const {
+  for (const SnapshotArea& saved : mAreas) {
+    std::string code = saved.code;
+    Area area(code, areas.get_allocator());
+    for (const auto& name : saved.names) {
+      area.setName(name.first, name.second);
+    }
+
+    for (const SnapshotMeasure& savedMeasure : saved.measures) {
+      Measure measure(savedMeasure.code,
+                      savedMeasure.label,
+                      area.get_allocator());
+      for (const auto& value : savedMeasure.values) {
+        measure.setValue(value.first, value.second);
+      }
+      measure.restoreSum(savedMeasure.sum);
+
+      area.setMeasure(savedMeasure.code, std::move(measure));
+    }
+
+    areas.setArea(code, std::move(area));
+  }
+
+  for (const auto& name : mAreaNames) {
+    areas.setAreaName(name.first, name.second);
+  }
+}
+
+/*
+  Save the snapshot alongside a dataset file. Failing to save a snapshot is
+  not an error, the file will simply be imported again next time.
+
+  @param path
+    The path to the dataset file
+
+  @return
+    true if the snapshot was saved
+*/
+bool DatasetSnapshot::save(const std::string& path) const noexcept {
+  try {
+    return writeFileAtomically(sidecarPath(path), toJSON());
+  } catch (const std::exception& ex) {
+    return false;
+  }
+}
+
+/*
+  Count the values that differ between two snapshots of a dataset, e.g.
+  before and after its file changed: those for an area, measure and year in
+  only one of the snapshots, and those whose value has changed.
+
+  @param other
+    The other snapshot
+
+  @return
+    The number of values added, removed or changed
+
+  @example
+    DatasetSnapshot before = DatasetSnapshot::forFile(path);
+    ...
+    DatasetSnapshot after = DatasetSnapshot::forFile(path);
+    size_t changed = before.countChangedValues(after);
+*/
+size_t DatasetSnapshot::countChangedValues(
+    const DatasetSnapshot& other) const {
+  using ValueKey = std::tuple<std::string, std::string, int>;
+
+  std::map<ValueKey, double> values;
+  for (const SnapshotArea& area : mAreas) {
+    for (const SnapshotMeasure& measure : area.measures) {
+      for (const auto& value : measure.values) {
+        values.emplace(ValueKey(area.code, measure.code, value.first),
+                       value.second);
+      }
+    }
+  }
+
+  size_t changed = 0;
+  for (const SnapshotArea& area : other.mAreas) {
+    for (const SnapshotMeasure& measure : area.measures) {
+      for (const auto& value : measure.values) {
+        auto it = values.find(ValueKey(area.code, measure.code, value.first));
+        if (it == values.end()) {
+          changed++;
+        } else {
+          if (it->second != value.second) {
+            changed++;
+          }
+          values.erase(it);
+        }
+      }
+    }
+  }
+
+  // Whatever is left was removed
+  return changed + values.size();
+}
+
+/*
+  Serialise the snapshot, e.g. to save it. The Areas and Measures are
+  written as arrays rather than objects, as they are read back far more
+  often than they are written.
+
+  @return
+    The snapshot as a JSON document
+*/
+std::string DatasetSnapshot::toJSON() const {
+  json areas = json::array();
+  for (const SnapshotArea& area : mAreas) {
+    json measures = json::array();
+    for (const SnapshotMeasure& measure : area.measures) {
+      json years = json::array();
+      json values = json::array();
+      for (const auto& value : measure.values) {
+        years.push_back(value.first);
+        values.push_back(value.second);
+      }
+
+      measures.push_back({measure.code,
+                          measure.label,
+                          measure.sum,
+                          std::move(years),
+                          std::move(values)});
+    }
+
+    areas.push_back({area.code, area.names, std::move(measures)});
+  }
+
+  json j = {
+    {"version", VERSION},
+    {"size", mFingerprint.getSize()},
+    {"modified", mFingerprint.getModified()},
+    {"hash", mFingerprint.getHash()},
+    {"import", mImport},
+    {"areas", std::move(areas)},
+    {"names", mAreaNames}
+  };
+
+  return j.dump();
+}
+
+/*
+  Deserialise a snapshot written by toJSON().
+
+  @param str
+    The snapshot as a JSON document
+
+  @return
+    The snapshot
+
+  @throws
+    std::runtime_error if the document is not a valid snapshot
+*/
+DatasetSnapshot DatasetSnapshot::fromJSON(const std::string& str) {
+  DatasetSnapshot snapshot;
+  try {
+    const json j = json::parse(str);
+    if (j.at("version").get<unsigned int>() != VERSION) {
+      throw std::runtime_error("DatasetSnapshot::fromJSON: "
+                               "Unsupported version");
+    }
+
+    snapshot.mFingerprint = FileFingerprint(j.at("size").get<uint64_t>(),
+                                            j.at("modified").get<int64_t>(),
+                                            j.at("hash").get<uint64_t>());
+    snapshot.mImport = j.at("import").get<std::vector<std::string>>();
+
+    for (const auto& savedArea : j.at("areas")) {
+      SnapshotArea area;
+      area.code = savedArea.at(0).get<std::string>();
+      area.names = savedArea.at(1)
+          .get<std::vector<std::pair<std::string, std::string>>>();
+
+      for (const auto& savedMeasure : savedArea.at(2)) {
+        const auto years = savedMeasure.at(3).get<std::vector<int>>();
+        const auto values = savedMeasure.at(4).get<std::vector<double>>();
+        if (years.size() != values.size()) {
+          throw std::runtime_error("DatasetSnapshot::fromJSON: "
+                                   "Invalid values");
+        }
+
+        SnapshotMeasure measure;
+        measure.code = savedMeasure.at(0).get<std::string>();
+        measure.label = savedMeasure.at(1).get<std::string>();
+        measure.sum = savedMeasure.at(2).get<double>();
+        measure.values.reserve(years.size());
+        for (size_t i = 0; i < years.size(); i++) {
+          measure.values.emplace_back(years[i], values[i]);
+        }
+
+        area.measures.push_back(std::move(measure));
+      }
+
+      snapshot.mAreas.push_back(std::move(area));
+    }
+
+    snapshot.mAreaNames = j.at("names")
+        .get<std::vector<std::pair<std::string, std::string>>>();
+  } catch (const json::exception& ex) {
+    throw std::runtime_error("DatasetSnapshot::fromJSON: Invalid snapshot: " +
+                             std::string(ex.what()));
+  }
+
+  return snapshot;
+}
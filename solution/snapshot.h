@@ -0,0 +1,110 @@
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the DatasetSnapshot class, a saved copy of what importing
+  a dataset file contributed to an Areas instance: the Area objects (with
+  their names) and Measures (with their labels and values) it added to, and
+  the names it mapped to authority codes.
+
+  BethYw::loadDatasets() imports each dataset into an Areas instance of its
+  own, and merges these into the main Areas instance in order with
+  MergePolicy::Import, which gives the same result as importing the datasets
+  one after another. Each dataset's contribution is saved alongside the
+  dataset file (see DatasetSnapshot::sidecarPath()), along with the
+  FileFingerprint of the file and a description of the import (the dataset
+  definition, the filters, and, if the areas are filtered, the Areas they were
+  matched against). On the next run, each dataset whose file and import are
+  unchanged is restored from its snapshot rather than parsed again, so only
+  the datasets that have changed are parsed. A missing, stale, or corrupt
+  snapshot is ignored and the dataset is parsed in full.
+ */
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "areas.h"
+#include "datasets.h"
+#include "fingerprint.h"
+
+/*
+  A saved Measure. The values are kept in year order along with the running
+  sum from the Measure (see Measure::restoreSum()).
+*/
+struct SnapshotMeasure {
+  std::string code;
+  std::string label;
+  double sum;
+  std::vector<std::pair<int, double>> values;
+};
+
+/*
+  A saved Area, with the names it was given by the import.
+*/
+struct SnapshotArea {
+  std::string code;
+  std::vector<std::pair<std::string, std::string>> names;
+  std::vector<SnapshotMeasure> measures;
+};
+
+class DatasetSnapshot {
+protected:
+  FileFingerprint mFingerprint;
+  std::vector<std::string> mImport;
+  std::vector<SnapshotArea> mAreas;
+  std::vector<std::pair<std::string, std::string>> mAreaNames;
+
+public:
+  static const unsigned int VERSION = 1;
+
+  DatasetSnapshot();
+  DatasetSnapshot(const Areas& areas,
+                  const FileFingerprint& fingerprint,
+                  const std::vector<std::string>& import);
+  ~DatasetSnapshot() = default;
+
+  DatasetSnapshot(const DatasetSnapshot& other) = default;
+  DatasetSnapshot& operator=(const DatasetSnapshot& other) = default;
+  DatasetSnapshot(DatasetSnapshot&& other) = default;
+  DatasetSnapshot& operator=(DatasetSnapshot&& other) = default;
+
+  static DatasetSnapshot forFile(const std::string& path);
+  static std::string sidecarPath(const std::string& path);
+  static std::vector<std::string> describeImport(
+      const BethYw::InputFileSource& source,
+      const StringFilterSet& areasFilter,
+      const StringFilterSet& measuresFilter,
+      const YearFilterTuple& yearsFilter,
+      const Areas& existing,
+      const ValueFilter* valueFilter = nullptr);
+
+  const FileFingerprint& getFingerprint() const noexcept;
+  const std::vector<std::string>& getImport() const noexcept;
+  const std::vector<SnapshotArea>& getAreas() const noexcept;
+  bool isFor(const std::string& path,
+             const std::vector<std::string>& import) const noexcept;
+
+  void restore(Areas& areas) const;
+  bool save(const std::string& path) const noexcept;
+  size_t countChangedValues(const DatasetSnapshot& other) const;
+
+  std::string toJSON() const;
+  static DatasetSnapshot fromJSON(const std::string& str);
+};
+
+/*
+  The DatasetSnapshots of the datasets imported by a long-running process,
+  by dataset code (see BethYw::InputFileSource), so that unchanged datasets
+  can be restored from memory when the data is reloaded.
+*/
+using DatasetSnapshots = std::map<std::string, DatasetSnapshot>;
+
+#endif // SNAPSHOT_H_
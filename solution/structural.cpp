@@ -0,0 +1,561 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the implementation of the StructuralScanner class. See
+  the header file for additional comments.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "structural.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define STRUCTURAL_X86_64 1
+#include <immintrin.h>
+#else
+#define STRUCTURAL_X86_64 0
+#endif
+
+/*
+  The number of bytes classified at a time, one per bit of a mask.
+*/
+const size_t SCAN_BLOCK_SIZE = 64;
+
+/*
+  The masks of a block of 64 bytes: bit i is set if byte i is a quote, a
+  backslash, or one of the structural characters of the format.
+*/
+struct ScanMasks {
+  uint64_t quote;
+  uint64_t backslash;
+  uint64_t structural;
+};
+
+/*
+  @return
+    The index of the lowest set bit of a mask, which must not be 0
+*/
+static inline unsigned int scanLowestBit(uint64_t mask) noexcept {
+#if defined(__GNUC__)
+  return static_cast<unsigned int>(__builtin_ctzll(mask));
+#else
+  unsigned int i = 0;
+  while ((mask & 1) == 0) {
+    mask >>= 1;
+    i++;
+  }
+  return i;
+#endif
+}
+
+/*
+  @return
+    The number of set bits in a mask
+*/
+static inline unsigned int scanCountBits(uint64_t mask) noexcept {
+#if defined(__GNUC__)
+  return static_cast<unsigned int>(__builtin_popcountll(mask));
+#else
+  unsigned int count = 0;
+  while (mask != 0) {
+    mask &= mask - 1;
+    count++;
+  }
+  return count;
+#endif
+}
+
+/*
+  @return
+    A mask where bit i is the XOR of bits 0 to i of mask, i.e. for a mask of
+    quotes, the bits from an opening quote up to its closing quote
+*/
+static inline uint64_t scanPrefixXor(uint64_t mask) noexcept {
+  mask ^= mask << 1;
+  mask ^= mask << 2;
+  mask ^= mask << 4;
+  mask ^= mask << 8;
+  mask ^= mask << 16;
+  mask ^= mask << 32;
+  return mask;
+}
+
+/*
+  Find the characters escaped by the backslashes of a block. Each backslash
+  that is not itself escaped escapes the character after it, so in a run of
+  backslashes, every other one is an escape. Backslashes only appear inside
+  strings, and are rare, so they are visited one at a time.
+
+  @param backslash
+    The mask of backslashes in the block
+
+  @param last
+    The index of the last byte of the block
+
+  @param carry
+    1 if the first byte of the block is escaped (by the last of the previous
+    block), which is set for the next block
+
+  @return
+    The mask of escaped characters
+*/
+static inline uint64_t scanEscaped(uint64_t backslash,
+                                   unsigned int last,
+                                   uint64_t& carry) noexcept {
+  uint64_t escaped = carry;
+  backslash &= ~carry;
+  carry = 0;
+
+  while (backslash != 0) {
+    const unsigned int i = scanLowestBit(backslash);
+    backslash &= backslash - 1;
+    if (i == last) {
+      carry = 1;
+      break;
+    }
+
+    const uint64_t next = uint64_t(1) << (i + 1);
+    escaped |= next;
+    backslash &= ~next;
+  }
+
+  return escaped;
+}
+
+/*
+  Classify a block one byte at a time.
+*/
+static void classifyScalar(const char* block,
+                           ScanFormat format,
+                           ScanMasks& masks) noexcept {
+  masks = ScanMasks{0, 0, 0};
+  for (size_t i = 0; i < SCAN_BLOCK_SIZE; i++) {
+    const uint64_t bit = uint64_t(1) << i;
+    switch (block[i]) {
+      case '"':
+        masks.quote |= bit;
+        break;
+
+      case '\\':
+        masks.backslash |= bit;
+        break;
+
+      case '{':
+      case '}':
+      case '[':
+      case ']':
+      case ':':
+        if (format == ScanFormat::JSON) {
+          masks.structural |= bit;
+        }
+        break;
+
+      case ',':
+        masks.structural |= bit;
+        break;
+
+      case '\n':
+        if (format == ScanFormat::CSV) {
+          masks.structural |= bit;
+        }
+        break;
+    }
+  }
+}
+
+#if STRUCTURAL_X86_64
+
+/*
+  Classify a block 16 bytes at a time with SSE2. The brackets are matched
+  two at a time, as setting bit 5 of [ and ] gives { and }.
+*/
+__attribute__((target("sse2")))
+static void classifySSE2(const char* block,
+                         ScanFormat format,
+                         ScanMasks& masks) noexcept {
+  masks = ScanMasks{0, 0, 0};
+  const __m128i caseBit = _mm_set1_epi8(0x20);
+
+  for (size_t i = 0; i < SCAN_BLOCK_SIZE; i += 16) {
+    const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+    __m128i structural =
+        _mm_cmpeq_epi8(bytes, _mm_set1_epi8(','));
+
+    if (format == ScanFormat::JSON) {
+      const __m128i folded = _mm_or_si128(bytes, caseBit);
+      structural = _mm_or_si128(
+          structural,
+          _mm_or_si128(
+              _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')),
+                           _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+              _mm_cmpeq_epi8(bytes, _mm_set1_epi8(':'))));
+
+      const uint64_t quote = static_cast<uint16_t>(_mm_movemask_epi8(
+          _mm_cmpeq_epi8(bytes, _mm_set1_epi8('"'))));
+      const uint64_t backslash = static_cast<uint16_t>(_mm_movemask_epi8(
+          _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\'))));
+      masks.quote |= quote << i;
+      masks.backslash |= backslash << i;
+    } else {
+      structural = _mm_or_si128(structural,
+                                _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')));
+    }
+
+    const uint64_t found =
+        static_cast<uint16_t>(_mm_movemask_epi8(structural));
+    masks.structural |= found << i;
+  }
+}
+
+/*
+  Classify a block 32 bytes at a time with AVX2, as classifySSE2() does.
+*/
+__attribute__((target("avx2")))
+static void classifyAVX2(const char* block,
+                         ScanFormat format,
+                         ScanMasks& masks) noexcept {
+  masks = ScanMasks{0, 0, 0};
+  const __m256i caseBit = _mm256_set1_epi8(0x20);
+
+  for (size_t i = 0; i < SCAN_BLOCK_SIZE; i += 32) {
+    const __m256i bytes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+    __m256i structural =
+        _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(','));
+
+    if (format == ScanFormat::JSON) {
+      const __m256i folded = _mm256_or_si256(bytes, caseBit);
+      structural = _mm256_or_si256(
+          structural,
+          _mm256_or_si256(
+              _mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')),
+                              _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))),
+              _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(':'))));
+
+      const uint64_t quote = static_cast<uint32_t>(_mm256_movemask_epi8(
+          _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('"'))));
+      const uint64_t backslash = static_cast<uint32_t>(_mm256_movemask_epi8(
+          _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\\'))));
+      masks.quote |= quote << i;
+      masks.backslash |= backslash << i;
+    } else {
+      structural = _mm256_or_si256(
+          structural,
+          _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n')));
+    }
+
+    const uint64_t found =
+        static_cast<uint32_t>(_mm256_movemask_epi8(structural));
+    masks.structural |= found << i;
+  }
+}
+
+#endif // STRUCTURAL_X86_64
+
+/*
+  The state carried from one block to the next: all ones if the last block
+  ended inside a string, and 1 if its last byte was an escaping backslash.
+*/
+struct ScanCarry {
+  uint64_t inString;
+  uint64_t escaped;
+};
+
+/*
+  Find the structural characters of whole blocks with a classify function.
+  This is inlined into a loop for each kernel (below), so that the classify
+  function, which is compiled for the kernel's instructions, is inlined too
+  rather than called for every block.
+
+  @param data
+    The blocks to scan
+
+  @param length
+    The number of bytes in data, a multiple of SCAN_BLOCK_SIZE
+
+  @param last
+    The index of the last byte that is part of the file in the last block,
+    which is less than SCAN_BLOCK_SIZE - 1 if it has been padded
+
+  @param base
+    The position in the file of data
+
+  @param format
+    Whether the blocks are JSON or CSV
+
+  @param carry
+    The state carried from the previous block, which is set for the next
+
+  @param positions
+    The positions of the structural characters found are appended to this
+*/
+template <void (*Classify)(const char*, ScanFormat, ScanMasks&) noexcept>
+static inline void scanBlocks(const char* data,
+                              size_t length,
+                              unsigned int last,
+                              size_t base,
+                              ScanFormat format,
+                              ScanCarry& carry,
+                              std::vector<size_t>& positions) {
+  for (size_t begin = 0; begin < length; begin += SCAN_BLOCK_SIZE) {
+    ScanMasks masks;
+    Classify(data + begin, format, masks);
+
+    uint64_t found = masks.structural;
+    if (format == ScanFormat::JSON) {
+      uint64_t quotes = masks.quote;
+      if (masks.backslash != 0 || carry.escaped != 0) {
+        quotes &= ~scanEscaped(masks.backslash,
+                               begin + SCAN_BLOCK_SIZE == length
+                                   ? last
+                                   : SCAN_BLOCK_SIZE - 1,
+                               carry.escaped);
+      }
+
+      // Bits from an opening quote up to (not including) its closing quote
+      const uint64_t inString = scanPrefixXor(quotes) ^ carry.inString;
+      carry.inString =
+          static_cast<uint64_t>(static_cast<int64_t>(inString) >> 63);
+      found = (found & ~inString) | quotes;
+    }
+
+    // The positions are written into space made for all of them at once,
+    // rather than pushed back one at a time
+    if (found != 0) {
+      const size_t at = positions.size();
+      positions.resize(at + scanCountBits(found));
+      size_t* out = positions.data() + at;
+      while (found != 0) {
+        *out++ = base + begin + scanLowestBit(found);
+        found &= found - 1;
+      }
+    }
+  }
+}
+
+static void scanBlocksScalar(const char* data,
+                             size_t length,
+                             unsigned int last,
+                             size_t base,
+                             ScanFormat format,
+                             ScanCarry& carry,
+                             std::vector<size_t>& positions) {
+  scanBlocks<classifyScalar>(data, length, last, base, format, carry,
+                             positions);
+}
+
+#if STRUCTURAL_X86_64
+
+__attribute__((target("sse2")))
+static void scanBlocksSSE2(const char* data,
+                           size_t length,
+                           unsigned int last,
+                           size_t base,
+                           ScanFormat format,
+                           ScanCarry& carry,
+                           std::vector<size_t>& positions) {
+  scanBlocks<classifySSE2>(data, length, last, base, format, carry,
+                           positions);
+}
+
+__attribute__((target("avx2")))
+static void scanBlocksAVX2(const char* data,
+                           size_t length,
+                           unsigned int last,
+                           size_t base,
+                           ScanFormat format,
+                           ScanCarry& carry,
+                           std::vector<size_t>& positions) {
+  scanBlocks<classifyAVX2>(data, length, last, base, format, carry,
+                           positions);
+}
+
+#endif // STRUCTURAL_X86_64
+
+/*
+  Construct a StructuralScanner, at the start of a file.
+
+  @param format
+    Whether the file is JSON or CSV
+
+  @param kernel
+    The instructions to use, or if the CPU does not have them, the best it
+    does have
+
+  @example
+    StructuralScanner scanner(ScanFormat::JSON);
+    std::vector<size_t> positions;
+    scanner.scan(contents.data(), contents.size(), 0, positions);
+*/
+StructuralScanner::StructuralScanner(ScanFormat format,
+                                     ScanKernel kernel) noexcept
+    : mFormat(format),
+      mKernel(isSupported(kernel) ? kernel : bestKernel()),
+      mInString(0),
+      mEscaped(0) {}
+
+/*
+  @return
+    The fastest kernel the CPU supports
+*/
+ScanKernel StructuralScanner::bestKernel() noexcept {
+#if STRUCTURAL_X86_64
+  if (__builtin_cpu_supports("avx2")) {
+    return ScanKernel::AVX2;
+  }
+  return ScanKernel::SSE2;
+#else
+  return ScanKernel::Scalar;
+#endif
+}
+
+/*
+  @return
+    true if the CPU supports the kernel
+*/
+bool StructuralScanner::isSupported(ScanKernel kernel) noexcept {
+  switch (kernel) {
+    case ScanKernel::Scalar:
+      return true;
+
+#if STRUCTURAL_X86_64
+    case ScanKernel::SSE2:
+      return true;
+
+    case ScanKernel::AVX2:
+      return __builtin_cpu_supports("avx2");
+#endif
+
+    default:
+      return false;
+  }
+}
+
+/*
+  @return
+    The name of a kernel, e.g. for benchmarks
+*/
+std::string StructuralScanner::kernelName(ScanKernel kernel) {
+  switch (kernel) {
+    case ScanKernel::SSE2:
+      return "SSE2";
+
+    case ScanKernel::AVX2:
+      return "AVX2";
+
+    default:
+      return "scalar";
+  }
+}
+
+/*
+  @return
+    Whether the scanner finds the characters of JSON or CSV
+*/
+ScanFormat StructuralScanner::getFormat() const noexcept {
+  return mFormat;
+}
+
+/*
+  @return
+    The kernel the scanner uses
+*/
+ScanKernel StructuralScanner::getKernel() const noexcept {
+  return mKernel;
+}
+
+/*
+  @return
+    true if the data scanned so far ended inside a string
+*/
+bool StructuralScanner::isInString() const noexcept {
+  return mInString != 0;
+}
+
+/*
+  Find the structural characters of the next part of a file. A file may be
+  scanned in parts of any length, and strings and escapes that span two
+  parts are followed from one call to the next.
+
+  @param data
+    The next part of the file
+
+  @param length
+    The number of bytes in data
+
+  @param offset
+    Added to each position, e.g. the position of data in the file
+
+  @param positions
+    The positions of the structural characters found are appended to this,
+    in order
+*/
+void StructuralScanner::scan(const char* data,
+                             size_t length,
+                             size_t offset,
+                             std::vector<size_t>& positions) {
+  // The whole blocks are scanned where they are, and a block at the end that
+  // is not whole is copied, and padded with spaces (which are never
+  // structural)
+  const size_t whole = length - length % SCAN_BLOCK_SIZE;
+  char tail[SCAN_BLOCK_SIZE];
+  std::memset(tail, ' ', SCAN_BLOCK_SIZE);
+  std::memcpy(tail, data + whole, length - whole);
+
+  auto scanBlocksWith = scanBlocksScalar;
+  switch (mKernel) {
+#if STRUCTURAL_X86_64
+    case ScanKernel::AVX2:
+      scanBlocksWith = scanBlocksAVX2;
+      break;
+
+    case ScanKernel::SSE2:
+      scanBlocksWith = scanBlocksSSE2;
+      break;
+#endif
+
+    default:
+      break;
+  }
+
+  ScanCarry carry{mInString, mEscaped};
+  scanBlocksWith(data,
+                 whole,
+                 SCAN_BLOCK_SIZE - 1,
+                 offset,
+                 mFormat,
+                 carry,
+                 positions);
+  if (whole < length) {
+    scanBlocksWith(tail,
+                   SCAN_BLOCK_SIZE,
+                   static_cast<unsigned int>(length - whole - 1),
+                   offset + whole,
+                   mFormat,
+                   carry,
+                   positions);
+  }
+  mInString = carry.inString;
+  mEscaped = carry.escaped;
+}
+
+/*
+  Return to the start of a file, forgetting any string or escape that the
+  data scanned so far ended in.
+*/
+void StructuralScanner::reset() noexcept {
+  mInString = 0;
+  mEscaped = 0;
+}
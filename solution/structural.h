@@ -0,0 +1,91 @@
+#ifndef STRUCTURAL_H_
+#define STRUCTURAL_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the StructuralScanner class, which finds the structural
+  characters of a JSON or CSV file 64 bytes at a time, with SIMD instructions
+  where the CPU has them.
+
+  For each block of 64 bytes, a kernel compares every byte against the
+  characters of interest at once, giving a 64-bit mask per character class.
+  For JSON, the quotes that are not escaped are then turned into a mask of
+  the bytes inside strings with a prefix XOR, so that brackets, colons and
+  commas inside strings can be masked out without a branch per byte. Only
+  the positions of the bits left set are written out, so the parsers that
+  consume them (the WelshStatsJSON row splitters of RowIndex and the
+  IngestPipeline, and the AuthorityByYearCSV cell splitter) visit a handful
+  of positions per row rather than every byte.
+
+  The kernel is chosen when the program runs: AVX2 (32 bytes per compare) or
+  SSE2 (16 bytes, which every x86-64 CPU has), with a scalar fallback for
+  other CPUs, which finds the same positions.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+  The characters a StructuralScanner finds:
+
+    JSON — quotes that are not escaped, and { } [ ] : , outside strings
+    CSV  — commas and newlines (the CSV files have no quoted cells)
+
+  A backslash escapes the quote after it wherever it is, as in valid JSON a
+  backslash is only found inside a string.
+*/
+enum class ScanFormat {
+  JSON,
+  CSV
+};
+
+/*
+  The instructions a StructuralScanner uses to classify each block.
+*/
+enum class ScanKernel {
+  Scalar,
+  SSE2,
+  AVX2
+};
+
+class StructuralScanner {
+protected:
+  ScanFormat mFormat;
+  ScanKernel mKernel;
+
+  // Carried from the end of one call of scan() to the next: all ones if it
+  // ended inside a string, and 1 if its last byte was an escaping backslash
+  uint64_t mInString;
+  uint64_t mEscaped;
+
+public:
+  explicit StructuralScanner(ScanFormat format,
+                             ScanKernel kernel = bestKernel()) noexcept;
+  ~StructuralScanner() = default;
+
+  StructuralScanner(const StructuralScanner& other) = default;
+  StructuralScanner& operator=(const StructuralScanner& other) = default;
+
+  static ScanKernel bestKernel() noexcept;
+  static bool isSupported(ScanKernel kernel) noexcept;
+  static std::string kernelName(ScanKernel kernel);
+
+  ScanFormat getFormat() const noexcept;
+  ScanKernel getKernel() const noexcept;
+  bool isInString() const noexcept;
+
+  void scan(const char* data,
+            size_t length,
+            size_t offset,
+            std::vector<size_t>& positions);
+  void reset() noexcept;
+};
+
+#endif // STRUCTURAL_H_
@@ -0,0 +1,153 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the implementation of the SymbolTable class. See the
+  header file for additional comments.
+*/
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "symbols.h"
+
+/*
+  Construct an empty SymbolTable.
+
+  @param resource
+    The memory resource for the table's containers, by default the default
+    memory resource
+
+  @example
+    SymbolTable symbols;
+*/
+SymbolTable::SymbolTable(std::pmr::memory_resource* resource)
+    : mStrings(resource), mIds(resource) {}
+
+/*
+  Intern a string, returning its Symbol. If the string has been interned
+  before, the existing Symbol is returned and no memory is allocated.
+
+  @param str
+    The string to intern
+
+  @return
+    The Symbol for str
+
+  @example
+    SymbolTable symbols;
+    Symbol pop = symbols.intern("pop");
+*/
+Symbol SymbolTable::intern(const std::string& str) {
+  auto existingIt = mIds.find(&str);
+  if (existingIt != mIds.end()) {
+    return existingIt->second;
+  }
+
+  return intern(std::make_shared<const std::string>(str));
+}
+
+/*
+  Intern a string that is already held in shared storage (e.g. one taken from
+  an existing Measure). If an equal string has already been interned, the
+  existing Symbol is returned, otherwise the table adopts ref as the storage
+  for the new Symbol.
+
+  @param ref
+    A shared reference to the string to intern
+
+  @return
+    The Symbol for the string
+
+  @throws
+    std::invalid_argument if ref is empty
+*/
+Symbol SymbolTable::intern(const SymbolRef& ref) {
+  if (!ref) {
+    throw std::invalid_argument("SymbolTable::intern: Cannot intern a null "
+                                "reference");
+  }
+
+  auto existingIt = mIds.find(ref.get());
+  if (existingIt != mIds.end()) {
+    return existingIt->second;
+  }
+
+  const Symbol id = static_cast<Symbol>(mStrings.size());
+  mStrings.push_back(ref);
+  mIds.emplace(ref.get(), id);
+
+  return id;
+}
+
+/*
+  Find the Symbol of a string without interning it.
+
+  @param str
+    The string to search for
+
+  @return
+    The Symbol for str, or NO_SYMBOL if str has not been interned
+*/
+Symbol SymbolTable::find(const std::string& str) const noexcept {
+  auto existingIt = mIds.find(&str);
+  if (existingIt == mIds.end()) {
+    return NO_SYMBOL;
+  }
+
+  return existingIt->second;
+}
+
+/*
+  Retrieve the shared storage for a Symbol, e.g. to give to a new Measure.
+
+  @param id
+    The Symbol to retrieve
+
+  @return
+    A shared reference to the interned string
+
+  @throws
+    std::out_of_range if id was not issued by this SymbolTable
+*/
+const SymbolRef& SymbolTable::ref(Symbol id) const {
+  if (id >= mStrings.size()) {
+    throw std::out_of_range("SymbolTable::ref: No symbol " +
+                            std::to_string(id));
+  }
+
+  return mStrings[id];
+}
+
+/*
+  Materialise the string for a Symbol.
+
+  @param id
+    The Symbol to retrieve
+
+  @return
+    The interned string
+
+  @throws
+    std::out_of_range if id was not issued by this SymbolTable
+*/
+const std::string& SymbolTable::str(Symbol id) const {
+  return *ref(id);
+}
+
+/*
+  Retrieve the number of distinct strings interned.
+
+  @return
+    The number of Symbols issued
+*/
+size_t SymbolTable::size() const noexcept {
+  return mStrings.size();
+}
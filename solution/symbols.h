@@ -0,0 +1,112 @@
+#ifndef SYMBOLS_H_
+#define SYMBOLS_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the SymbolTable class, which interns strings such as
+  local authority codes, measure codes and measure labels. Each distinct
+  string is stored once, and is given a compact integer identifier (a Symbol)
+  that the parsers can hash and compare cheaply.
+
+  Area and Measure objects hold a shared reference (SymbolRef) to the interned
+  string rather than their own copy, so the strings remain valid even if the
+  object outlives the SymbolTable that created it.
+ */
+
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+  A compact identifier for an interned string, only meaningful to the
+  SymbolTable that issued it.
+*/
+using Symbol = unsigned int;
+
+/*
+  A shared reference to the storage of an interned string.
+*/
+using SymbolRef = std::shared_ptr<const std::string>;
+
+/*
+  The Symbol returned by SymbolTable::find() when a string is not interned.
+*/
+const Symbol NO_SYMBOL = static_cast<Symbol>(-1);
+
+/*
+  Order SymbolRefs by the strings they refer to. The comparator is transparent
+  so that containers keyed by SymbolRef can be searched with a std::string.
+*/
+struct SymbolLess {
+  using is_transparent = void;
+
+  bool operator()(const SymbolRef& lhs, const SymbolRef& rhs) const {
+    return lhs != rhs && *lhs < *rhs;
+  }
+  bool operator()(const SymbolRef& lhs, const std::string& rhs) const {
+    return *lhs < rhs;
+  }
+  bool operator()(const std::string& lhs, const SymbolRef& rhs) const {
+    return lhs < *rhs;
+  }
+};
+
+/*
+  SymbolTable maps strings to Symbols and back again. Symbols are issued
+  sequentially from 0 and are never reused.
+
+  The table's own containers are allocated from the given memory resource.
+  The interned strings are always allocated on the heap, as they are shared
+  with objects that may outlive the table.
+*/
+class SymbolTable {
+protected:
+  /*
+    The index is keyed by a pointer into the interned storage, so the key
+    does not duplicate the string itself.
+  */
+  struct StringPtrHash {
+    size_t operator()(const std::string* str) const {
+      return std::hash<std::string>()(*str);
+    }
+  };
+  struct StringPtrEqual {
+    bool operator()(const std::string* lhs, const std::string* rhs) const {
+      return *lhs == *rhs;
+    }
+  };
+
+  std::pmr::vector<SymbolRef> mStrings;
+  std::pmr::unordered_map<const std::string*,
+                          Symbol,
+                          StringPtrHash,
+                          StringPtrEqual> mIds;
+
+public:
+  explicit SymbolTable(
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+  ~SymbolTable() = default;
+
+  SymbolTable(const SymbolTable& other) = delete;
+  SymbolTable& operator=(const SymbolTable& other) = delete;
+  SymbolTable(SymbolTable&& other) = default;
+  SymbolTable& operator=(SymbolTable&& other) = default;
+
+  Symbol intern(const std::string& str);
+  Symbol intern(const SymbolRef& ref);
+  Symbol find(const std::string& str) const noexcept;
+
+  const SymbolRef& ref(Symbol id) const;
+  const std::string& str(Symbol id) const;
+  size_t size() const noexcept;
+};
+
+#endif // SYMBOLS_H_
@@ -0,0 +1,255 @@
+#ifndef STUBSERVER_H_
+#define STUBSERVER_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  A stand-in HTTP server for the tests, which serves fixed responses on a
+  free port on the loopback interface, with a thread for each connection.
+  Each request is answered with the body set for its target, or a 404, and
+  connections are kept alive unless the client asks for them to be closed.
+  A body may be given an ETag, in which case a request with a matching
+  If-None-Match header is answered with a 304. The Host header of the last
+  request is kept, for the tests to check.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+class StubServer {
+protected:
+  int mFd;
+  unsigned short mPort;
+  std::atomic<bool> mStop;
+  std::atomic<unsigned int> mRequests;
+  std::atomic<unsigned int> mConnections;
+  std::atomic<unsigned int> mNotModified;
+  std::atomic<unsigned int> mDelayMs;
+  std::mutex mMutex;
+  std::string mLastHost;
+  std::map<std::string, std::pair<std::string, std::string>> mBodies;
+  std::thread mThread;
+  std::vector<std::thread> mConnectionThreads;
+
+  // Read from a connection, returning false if it closes or we are stopped
+  bool readSome(int fd, std::string& buffer) {
+    char chunk[4096];
+    while (!mStop) {
+      struct pollfd pfd = {fd, POLLIN, 0};
+      if (poll(&pfd, 1, 20) <= 0) {
+        continue;
+      }
+
+      const ssize_t length = recv(fd, chunk, sizeof(chunk), 0);
+      if (length <= 0) {
+        return false;
+      }
+      buffer.append(chunk, static_cast<size_t>(length));
+      return true;
+    }
+
+    return false;
+  }
+
+  // Answer the requests on a connection until it closes
+  void serve(int fd) {
+    std::string buffer;
+    while (true) {
+      size_t headersEnd;
+      while ((headersEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+        if (!readSome(fd, buffer)) {
+          close(fd);
+          return;
+        }
+      }
+
+      std::string request = buffer.substr(0, headersEnd + 2);
+      buffer.erase(0, headersEnd + 4);
+      mRequests++;
+
+      std::string lower = request;
+      std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+
+      // The request line, e.g. GET /popu1009 HTTP/1.1
+      const size_t targetStart = request.find(' ') + 1;
+      const std::string target = request.substr(
+          targetStart,
+          request.find(' ', targetStart) - targetStart);
+
+      std::string ifNoneMatch;
+      const size_t conditionPos = lower.find("\r\nif-none-match: ");
+      if (conditionPos != std::string::npos) {
+        const size_t valueStart = conditionPos + 17;
+        ifNoneMatch = request.substr(
+            valueStart,
+            request.find("\r\n", valueStart) - valueStart);
+      }
+      const size_t hostPos = lower.find("\r\nhost: ");
+      if (hostPos != std::string::npos) {
+        const size_t valueStart = hostPos + 8;
+        std::lock_guard<std::mutex> lock(mMutex);
+        mLastHost = request.substr(
+            valueStart,
+            request.find("\r\n", valueStart) - valueStart);
+      }
+      const bool closing =
+          lower.find("\r\nconnection: close") != std::string::npos;
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(mDelayMs));
+
+      std::string response;
+      {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mBodies.find(target);
+        if (it == mBodies.end()) {
+          response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n";
+        } else if (!it->second.second.empty() &&
+                   ifNoneMatch == it->second.second) {
+          response = "HTTP/1.1 304 Not Modified\r\nETag: " +
+                     it->second.second + "\r\n";
+          mNotModified++;
+        } else {
+          response = "HTTP/1.1 200 OK\r\n"
+                     "Content-Type: application/json\r\n"
+                     "Content-Length: " +
+                     std::to_string(it->second.first.size()) + "\r\n";
+          if (!it->second.second.empty()) {
+            response += "ETag: " + it->second.second + "\r\n";
+          }
+          response += closing ? "Connection: close\r\n\r\n" : "\r\n";
+          response += it->second.first;
+        }
+      }
+      if (response.compare(0, 12, "HTTP/1.1 200") != 0) {
+        response += closing ? "Connection: close\r\n\r\n" : "\r\n";
+      }
+
+      for (size_t sent = 0; sent < response.size(); ) {
+        const ssize_t length = send(fd,
+                                    response.data() + sent,
+                                    response.size() - sent,
+                                    MSG_NOSIGNAL);
+        if (length <= 0) {
+          close(fd);
+          return;
+        }
+        sent += static_cast<size_t>(length);
+      }
+
+      if (closing) {
+        close(fd);
+        return;
+      }
+    }
+  }
+
+public:
+  StubServer()
+      : mFd(-1),
+        mPort(0),
+        mStop(false),
+        mRequests(0),
+        mConnections(0),
+        mNotModified(0),
+        mDelayMs(0) {
+    mFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (mFd < 0) {
+      throw std::runtime_error("StubServer: Failed to create socket");
+    }
+
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t length = sizeof(address);
+    if (bind(mFd, reinterpret_cast<struct sockaddr*>(&address), length) != 0 ||
+        listen(mFd, 16) != 0 ||
+        getsockname(mFd,
+                    reinterpret_cast<struct sockaddr*>(&address),
+                    &length) != 0) {
+      close(mFd);
+      throw std::runtime_error("StubServer: Failed to listen");
+    }
+    mPort = ntohs(address.sin_port);
+
+    mThread = std::thread([this]() {
+      while (!mStop) {
+        struct pollfd pfd = {mFd, POLLIN, 0};
+        if (poll(&pfd, 1, 20) <= 0) {
+          continue;
+        }
+
+        const int fd = accept(mFd, nullptr, nullptr);
+        if (fd >= 0) {
+          mConnections++;
+          mConnectionThreads.emplace_back(&StubServer::serve, this, fd);
+        }
+      }
+    });
+  }
+
+  ~StubServer() {
+    mStop = true;
+    mThread.join();
+    for (auto& thread : mConnectionThreads) {
+      thread.join();
+    }
+    close(mFd);
+  }
+
+  StubServer(const StubServer& other) = delete;
+  StubServer& operator=(const StubServer& other) = delete;
+
+  std::string url(const std::string& target) const {
+    return "http://127.0.0.1:" + std::to_string(mPort) + target;
+  }
+
+  void setBody(const std::string& target,
+               const std::string& body,
+               const std::string& etag = "") {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mBodies[target] = std::make_pair(body, etag);
+  }
+
+  void setDelay(unsigned int delayMs) {
+    mDelayMs = delayMs;
+  }
+
+  unsigned int getRequestCount() const {
+    return mRequests;
+  }
+
+  unsigned int getConnectionCount() const {
+    return mConnections;
+  }
+
+  unsigned int getNotModifiedCount() const {
+    return mNotModified;
+  }
+
+  std::string getLastHost() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mLastHost;
+  }
+};
+
+#endif // STUBSERVER_H_
@@ -0,0 +1,120 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <fstream>
+#include <string>
+
+#include "../datasets.h"
+#include "../areas.h"
+#include "../symbols.h"
+
+SCENARIO( "strings can be interned in a SymbolTable", "[SymbolTable][intern]" ) {
+
+  GIVEN( "a newly constructed SymbolTable" ) {
+
+    SymbolTable symbols;
+
+    WHEN( "the same string is interned twice" ) {
+
+      const Symbol first  = symbols.intern("W06000023");
+      const Symbol second = symbols.intern(std::string("W06000023"));
+
+      THEN( "the same Symbol is returned and only one string is stored" ) {
+
+        REQUIRE( first == second );
+        REQUIRE( symbols.size() == 1 );
+        REQUIRE( symbols.str(first) == "W06000023" );
+
+      } // THEN
+
+    } // WHEN
+
+    WHEN( "two different strings are interned" ) {
+
+      const Symbol pop  = symbols.intern("pop");
+      const Symbol dens = symbols.intern("dens");
+
+      THEN( "they are given different Symbols" ) {
+
+        REQUIRE( pop != dens );
+        REQUIRE( symbols.find("pop") == pop );
+        REQUIRE( symbols.find("dens") == dens );
+
+      } // THEN
+
+    } // WHEN
+
+    WHEN( "an uninterned string is searched for" ) {
+
+      THEN( "NO_SYMBOL is returned" ) {
+
+        REQUIRE( symbols.find("area") == NO_SYMBOL );
+        REQUIRE_THROWS_AS( symbols.str(0), std::out_of_range );
+
+      } // THEN
+
+    } // WHEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "an Areas instance interns the codes and labels it imports", "[Areas][SymbolTable]" ) {
+
+  auto get_istream = [](const std::string &path) {
+    return std::ifstream(path);
+  };
+
+  GIVEN( "a newly constructed Areas instance" ) {
+
+    Areas areas = Areas();
+
+    AND_GIVEN( "a valid popu1009.json file as an open std::istream" ) {
+
+      auto stream = get_istream("datasets/popu1009.json");
+      REQUIRE( stream.is_open() );
+
+      WHEN( "the file is imported" ) {
+
+        areas.populateFromWelshStatsJSON(stream, BethYw::InputFiles::POPDEN.COLS);
+
+        THEN( "Measures with the same code share their codename and label" ) {
+
+          Measure& first  = areas.getArea("W06000001").getMeasure("dens");
+          Measure& second = areas.getArea("W06000002").getMeasure("dens");
+
+          REQUIRE( first.getCodenameRef() == second.getCodenameRef() );
+          REQUIRE( first.getLabelRef() == second.getLabelRef() );
+          REQUIRE( first.getLabel() == "Population density" );
+
+        } // THEN
+
+        AND_THEN( "each Area shares its authority code with the SymbolTable" ) {
+
+          const Symbol code = areas.getSymbols().find("W06000001");
+          REQUIRE( code != NO_SYMBOL );
+          REQUIRE( areas.getArea("W06000001").getLocalAuthorityCodeRef() ==
+                   areas.getSymbols().ref(code) );
+
+        } // AND_THEN
+
+      } // WHEN
+
+    } // AND_GIVEN
+
+  } // GIVEN
+
+} // SCENARIO
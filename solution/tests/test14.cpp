@@ -0,0 +1,123 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "../areas.h"
+#include "../authoritycode.h"
+
+SCENARIO( "an AuthorityCode packs and orders authority codes", "[AuthorityCode]" ) {
+
+  GIVEN( "a nine-character StatsWales authority code" ) {
+
+    AuthorityCode code("W06000023");
+
+    THEN( "the code is packed and can be converted back to a string" ) {
+
+      REQUIRE( code.isPacked() );
+      REQUIRE( code.str() == "W06000023" );
+      REQUIRE( code == AuthorityCode(std::string("W06000023")) );
+      REQUIRE( code != AuthorityCode("W06000024") );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a code that does not fit into an integer" ) {
+
+    AuthorityCode code("W06000023-and-more");
+
+    THEN( "the code falls back to a string" ) {
+
+      REQUIRE_FALSE( code.isPacked() );
+      REQUIRE( code.str() == "W06000023-and-more" );
+      REQUIRE( code == AuthorityCode("W06000023-and-more") );
+      REQUIRE( code != AuthorityCode("W06000023") );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a mix of packed, short, and fallback codes" ) {
+
+    std::vector<std::string> strings = {
+      "W92000004", "W06000001", "W06000023", "W06", "", "W06000001X",
+      "K02000001", "W11000028", "Wales", "W06000002", "Cymru (Wales)"
+    };
+
+    WHEN( "they are sorted as AuthorityCodes" ) {
+
+      std::vector<AuthorityCode> codes(strings.begin(), strings.end());
+      std::sort(codes.begin(), codes.end());
+      std::sort(strings.begin(), strings.end());
+
+      THEN( "the order matches the order of the strings" ) {
+
+        for (size_t i = 0; i < strings.size(); i++) {
+          REQUIRE( codes[i].str() == strings[i] );
+        }
+
+      } // THEN
+
+    } // WHEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "an Areas instance iterates in authority code order", "[Areas][AuthorityCode]" ) {
+
+  GIVEN( "an Areas instance with Areas added out of order" ) {
+
+    Areas areas = Areas();
+
+    for (std::string code : {"W06000023", "W06000001", "W92000004", "W06000011"}) {
+      areas.setArea(code, Area(code));
+    }
+
+    THEN( "iteration visits the Areas sorted by their authority codes" ) {
+
+      std::vector<std::string> codes;
+      for (auto it = areas.cbegin(); it != areas.cend(); it++) {
+        codes.push_back(it->getLocalAuthorityCode());
+      }
+
+      REQUIRE( codes == std::vector<std::string>({"W06000001", "W06000011", "W06000023", "W92000004"}) );
+      REQUIRE( areas.crbegin()->getLocalAuthorityCode() == "W92000004" );
+
+      AND_WHEN( "another Area is added" ) {
+
+        std::string code = "W06000002";
+        areas.setArea(code, Area(code));
+
+        THEN( "the order includes the new Area" ) {
+
+          auto it = areas.cbegin();
+          it++;
+          REQUIRE( it->getLocalAuthorityCode() == "W06000002" );
+          REQUIRE( areas.size() == 5 );
+
+        } // THEN
+
+      } // AND_WHEN
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
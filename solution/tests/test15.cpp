@@ -0,0 +1,129 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <memory_resource>
+#include <sstream>
+#include <string>
+
+#include "../areas.h"
+#include "../datasets.h"
+
+SCENARIO( "an Areas instance allocates from its arena", "[Areas][AreasMemory]" ) {
+
+  const std::string csv =
+    "AuthorityCode,1991,2001,2011\n"
+    "W06000001,69123,67806,69913\n"
+    "W06000002,115007,116844,121523\n";
+
+  GIVEN( "an Areas instance using an arena and one using the default memory resource" ) {
+
+    Areas arena = Areas();
+    Areas heap  = Areas(AreasMemory::Default);
+
+    for (Areas* areas : {&arena, &heap}) {
+      std::istringstream stream(csv);
+      areas->populateFromAuthorityByYearCSV(stream, BethYw::InputFiles::COMPLETE_POP.COLS);
+    }
+
+    THEN( "both contain the same data" ) {
+
+      REQUIRE( arena.size() == 2 );
+      REQUIRE( arena.toJSON() == heap.toJSON() );
+
+    } // THEN
+
+    THEN( "the Areas and their Measures allocate from the arena" ) {
+
+      REQUIRE( arena.get_allocator().resource() != std::pmr::get_default_resource() );
+      REQUIRE( heap.get_allocator().resource() == std::pmr::get_default_resource() );
+
+      Area& area = arena.getArea("W06000001");
+      REQUIRE( area.get_allocator() == arena.get_allocator() );
+      REQUIRE( area.getMeasure("pop").get_allocator() == arena.get_allocator() );
+
+    } // THEN
+
+    WHEN( "an Area is copied out of the Areas instance using the arena" ) {
+
+      Area copy = Area("W00000000");
+      {
+        Areas scoped = Areas();
+        std::istringstream stream(csv);
+        scoped.populateFromAuthorityByYearCSV(stream, BethYw::InputFiles::COMPLETE_POP.COLS);
+        copy = scoped.getArea("W06000002");
+      }
+
+      THEN( "the copy outlives the arena" ) {
+
+        REQUIRE( copy.get_allocator().resource() == std::pmr::get_default_resource() );
+        REQUIRE( copy.getLocalAuthorityCode() == "W06000002" );
+        REQUIRE( copy.getMeasure("pop").getValue(2011) == 121523 );
+
+      } // THEN
+
+    } // WHEN
+
+    WHEN( "the Areas instance using the arena is move assigned to" ) {
+
+      arena = std::move(heap);
+
+      THEN( "it takes the data and memory resource of the other instance" ) {
+
+        REQUIRE( arena.size() == 2 );
+        REQUIRE( arena.get_allocator().resource() == std::pmr::get_default_resource() );
+        REQUIRE( arena.getArea("W06000001").getMeasure("pop").getValue(1991) == 69123 );
+
+      } // THEN
+
+      THEN( "the other instance is left empty, using the default memory resource" ) {
+
+        REQUIRE( heap.size() == 0 );
+        REQUIRE( heap.get_allocator().resource() == std::pmr::get_default_resource() );
+
+      } // THEN
+
+    } // WHEN
+
+    WHEN( "the Areas instance using the arena is move constructed from" ) {
+
+      const std::pmr::memory_resource* resource = arena.get_allocator().resource();
+      Areas moved = Areas(std::move(arena));
+
+      THEN( "the new instance takes the data and arena of the other instance" ) {
+
+        REQUIRE( moved.size() == 2 );
+        REQUIRE( moved.get_allocator().resource() == resource );
+        REQUIRE( moved.getArea("W06000001").getMeasure("pop").getValue(1991) == 69123 );
+
+      } // THEN
+
+      THEN( "the other instance is left empty, using the default memory resource, and can be reused" ) {
+
+        REQUIRE( arena.size() == 0 );
+        REQUIRE( arena.get_allocator().resource() == std::pmr::get_default_resource() );
+
+        std::istringstream stream(csv);
+        arena.populateFromAuthorityByYearCSV(stream, BethYw::InputFiles::COMPLETE_POP.COLS);
+        REQUIRE( arena.toJSON() == moved.toJSON() );
+        REQUIRE( arena.getArea("W06000001").get_allocator().resource() == std::pmr::get_default_resource() );
+
+      } // THEN
+
+    } // WHEN
+
+  } // GIVEN
+
+} // SCENARIO
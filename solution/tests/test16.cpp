@@ -0,0 +1,210 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <memory_resource>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include "../areas.h"
+#include "../datasets.h"
+
+SCENARIO( "a Measure can be merged into another Measure", "[Measure][merge]" ) {
+
+  GIVEN( "two Measures with an overlapping year" ) {
+
+    Measure measure("pop", "Population");
+    measure.setValue(1999, 1.5);
+    measure.setValue(2000, 2.5);
+
+    Measure update("POP", "Population (people)");
+    update.setValue(2000, 3.25);
+    update.setValue(2001, 4.75);
+
+    Measure expected = measure;
+    expected.setLabel(update.getLabel());
+    for (auto it = update.begin(); it != update.end(); it++) {
+      expected.setValue(it->first, it->second);
+    }
+
+    WHEN( "the second Measure is merged into the first" ) {
+
+      measure.merge(std::move(update));
+
+      THEN( "the incoming label and values take precedence" ) {
+
+        REQUIRE( measure.getLabel() == "Population (people)" );
+        REQUIRE( measure.size() == 3 );
+        REQUIRE( measure.getValue(1999) == 1.5 );
+        REQUIRE( measure.getValue(2000) == 3.25 );
+        REQUIRE( measure.getValue(2001) == 4.75 );
+
+      } // THEN
+
+      THEN( "the result is the same as setting each value" ) {
+
+        REQUIRE( measure == expected );
+        REQUIRE( measure.getAverage() == expected.getAverage() );
+
+      } // THEN
+
+      THEN( "the merged Measure is left empty" ) {
+
+        REQUIRE( update.size() == 0 );
+
+      } // THEN
+
+    } // WHEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "an Area can be merged into another Area", "[Area][merge]" ) {
+
+  GIVEN( "two Areas with an overlapping name and Measure" ) {
+
+    Area area("W06000023");
+    area.setName("eng", "Powys");
+    Measure pop("pop", "Population");
+    pop.setValue(2000, 10);
+    area.setMeasure("pop", pop);
+
+    Area update("W06000023");
+    update.setName("eng", "Powys County");
+    update.setName("cym", "Powys");
+    Measure updatedPop("pop", "Population");
+    updatedPop.setValue(2000, 20);
+    updatedPop.setValue(2001, 30);
+    update.setMeasure("pop", updatedPop);
+    update.setMeasure("dens", Measure("dens", "Population density"));
+
+    WHEN( "the second Area is merged into the first" ) {
+
+      area.merge(std::move(update));
+
+      THEN( "the incoming names and Measures take precedence" ) {
+
+        REQUIRE( area.getName("eng") == "Powys County" );
+        REQUIRE( area.getName("cym") == "Powys" );
+        REQUIRE( area.size() == 2 );
+        REQUIRE( area.getMeasure("pop").getValue(2000) == 20 );
+        REQUIRE( area.getMeasure("pop").getValue(2001) == 30 );
+        REQUIRE_NOTHROW( area.getMeasure("dens") );
+
+      } // THEN
+
+      THEN( "the merged Area is left empty" ) {
+
+        REQUIRE( update.size() == 0 );
+        REQUIRE( update.getNames().empty() );
+
+      } // THEN
+
+    } // WHEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "an Areas instance can be merged into another Areas instance", "[Areas][merge]" ) {
+
+  const std::string csv1 =
+    "AuthorityCode,1991,2001\n"
+    "W06000001,69123,67806\n"
+    "W06000002,115007,116844\n";
+
+  const std::string csv2 =
+    "AuthorityCode,2001,2011\n"
+    "W06000002,116845,121523\n"
+    "W06000003,100000,100001\n";
+
+  GIVEN( "two Areas instances sharing a memory resource" ) {
+
+    std::pmr::unsynchronized_pool_resource pool;
+    Areas areas = Areas(&pool);
+    Areas update = Areas(&pool);
+
+    std::istringstream stream1(csv1);
+    areas.populateFromAuthorityByYearCSV(stream1, BethYw::InputFiles::COMPLETE_POP.COLS);
+    std::istringstream stream2(csv2);
+    update.populateFromAuthorityByYearCSV(stream2, BethYw::InputFiles::COMPLETE_POP.COLS);
+
+    Areas expected = Areas();
+    std::istringstream expected1(csv1);
+    expected.populateFromAuthorityByYearCSV(expected1, BethYw::InputFiles::COMPLETE_POP.COLS);
+    std::istringstream expected2(csv2);
+    expected.populateFromAuthorityByYearCSV(expected2, BethYw::InputFiles::COMPLETE_POP.COLS);
+
+    const Measure* movedMeasure = &update.getArea("W06000003").getMeasure("pop");
+
+    WHEN( "the second instance is merged into the first" ) {
+
+      areas.merge(std::move(update));
+
+      THEN( "the result is the same as importing both files into one instance" ) {
+
+        REQUIRE( areas.size() == 3 );
+        REQUIRE( areas.toJSON() == expected.toJSON() );
+        REQUIRE( areas.getArea("W06000002").getMeasure("pop").getValue(2001) == 116845 );
+
+      } // THEN
+
+      THEN( "the Measures of new Areas are moved rather than copied" ) {
+
+        REQUIRE( &areas.getArea("W06000003").getMeasure("pop") == movedMeasure );
+
+      } // THEN
+
+      THEN( "the merged instance is left empty" ) {
+
+        REQUIRE( update.size() == 0 );
+        REQUIRE_THROWS_AS( update.getArea("W06000003"), std::out_of_range );
+
+      } // THEN
+
+    } // WHEN
+
+  } // GIVEN
+
+  GIVEN( "two Areas instances with their own arenas" ) {
+
+    Areas areas = Areas();
+    Areas update = Areas();
+
+    std::istringstream stream1(csv1);
+    areas.populateFromAuthorityByYearCSV(stream1, BethYw::InputFiles::COMPLETE_POP.COLS);
+    std::istringstream stream2(csv2);
+    update.populateFromAuthorityByYearCSV(stream2, BethYw::InputFiles::COMPLETE_POP.COLS);
+
+    WHEN( "the second instance is merged into the first" ) {
+
+      areas.merge(std::move(update));
+
+      THEN( "the data is copied into the first instance's arena" ) {
+
+        REQUIRE( areas.size() == 3 );
+        REQUIRE( areas.getArea("W06000003").get_allocator() == areas.get_allocator() );
+        REQUIRE( areas.getArea("W06000002").getMeasure("pop").getValue(1991) == 115007 );
+        REQUIRE( areas.getArea("W06000002").getMeasure("pop").getValue(2011) == 121523 );
+
+      } // THEN
+
+    } // WHEN
+
+  } // GIVEN
+
+} // SCENARIO
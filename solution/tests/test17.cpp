@@ -0,0 +1,236 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../areas.h"
+#include "../datasets.h"
+#include "../fingerprint.h"
+#include "../rowindex.h"
+
+SCENARIO( "a RowIndex finds the rows of a WelshStatsJSON file", "[RowIndex]" ) {
+
+  const std::string contents =
+    "{\"odata.metadata\":\"value\",\"value\":[\n"
+    "{\"Localauthority_Code\":\"W06000001\",\"Localauthority_ItemName_ENG\":\"Isle of Anglesey\",\"Measure_Code\":\"DENS\",\"Measure_ItemName_ENG\":\"Density\",\"Year_Code\":\"2010\",\"Data\":1.5},\n"
+    "{\"Localauthority_Code\":\"W06000001\",\"Localauthority_ItemName_ENG\":\"Isle of Anglesey\",\"Measure_Code\":\"DENS\",\"Measure_ItemName_ENG\":\"Density\",\"Year_Code\":\"2011\",\"Data\":\"2.5\"},\n"
+    "{\"Localauthority_Code\":\"W06000023\",\"Localauthority_ItemName_ENG\":\"Powys {\\\"}\",\"Measure_Code\":\"POP\",\"Measure_ItemName_ENG\":\"Population\",\"Year_Code\":\"2010\",\"Data\":3},\n"
+    "{\"Localauthority_Code\":\"W06000001\",\"Localauthority_ItemName_ENG\":\"Isle of Anglesey\",\"Measure_Code\":\"POP\",\"Measure_ItemName_ENG\":\"Population\",\"Year_Code\":\"2010\",\"Data\":4}\n"
+    "],\"odata.nextLink\":\"http://example.com\"}";
+
+  const BethYw::SourceColumnMapping& cols = BethYw::InputFiles::DATASETS[0].COLS;
+
+  GIVEN( "a RowIndex built from the file" ) {
+
+    RowIndex index(contents, FileFingerprint(contents.size(), 0, 0), cols);
+
+    THEN( "the rows are grouped by authority code, name and measure" ) {
+
+      const auto& groups = index.getGroups();
+      REQUIRE( groups.size() == 3 );
+      REQUIRE( groups[0].code == "W06000001" );
+      REQUIRE( groups[0].measure == "DENS" );
+      REQUIRE( groups[2].name == "Powys {\"}" );
+
+      AND_THEN( "consecutive rows of a group share a range" ) {
+
+        REQUIRE( groups[0].ranges.size() == 1 );
+        REQUIRE( contents.substr(groups[0].ranges[0].begin, 1) == "{" );
+        REQUIRE( contents.substr(groups[0].ranges[0].end - 1, 1) == "}" );
+
+      } // AND_THEN
+
+    } // THEN
+
+    WHEN( "the rows for one area are selected and extracted" ) {
+
+      const auto ranges = index.select([](const RowGroup& group) {
+        return group.code == "W06000001";
+      });
+      std::istringstream file(contents);
+      std::istringstream rows(RowIndex::extract(file, ranges));
+
+      THEN( "importing them gives the same result as importing the file with an areas filter" ) {
+
+        StringFilterSet areasFilter = {"W06000001"};
+
+        Areas indexed = Areas();
+        indexed.populateFromWelshStatsJSON(rows, cols, &areasFilter);
+
+        Areas full = Areas();
+        std::istringstream stream(contents);
+        full.populateFromWelshStatsJSON(stream, cols, &areasFilter);
+
+        REQUIRE( ranges.size() == 2 );
+        REQUIRE( indexed.size() == 1 );
+        REQUIRE( indexed.toJSON() == full.toJSON() );
+
+      } // THEN
+
+    } // WHEN
+
+    WHEN( "the RowIndex is serialised and deserialised" ) {
+
+      RowIndex copy = RowIndex::fromJSON(index.toJSON());
+
+      THEN( "the copy has the same fingerprint, columns and groups" ) {
+
+        REQUIRE( copy.getFingerprint() == index.getFingerprint() );
+        REQUIRE( copy.getColumns() == index.getColumns() );
+        REQUIRE( copy.getGroups().size() == index.getGroups().size() );
+        REQUIRE( copy.getGroups()[1].ranges[0].begin == index.getGroups()[1].ranges[0].begin );
+
+      } // THEN
+
+    } // WHEN
+
+  } // GIVEN
+
+  GIVEN( "a corrupt serialised RowIndex" ) {
+
+    THEN( "deserialising it throws a std::runtime_error" ) {
+
+      REQUIRE_THROWS_AS( RowIndex::fromJSON("{\"version\":1"), std::runtime_error );
+      REQUIRE_THROWS_AS( RowIndex::fromJSON("{\"version\":999}"), std::runtime_error );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a file that is not a WelshStatsJSON file" ) {
+
+    THEN( "it cannot be indexed" ) {
+
+      REQUIRE_THROWS_AS( RowIndex("{\"rows\":[{}]}", FileFingerprint(), cols), std::runtime_error );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a dataset file on disk" ) {
+
+    const std::string path =
+        (std::filesystem::temp_directory_path() / "bethyw-test17.json").string();
+    const std::string sidecar = RowIndex::sidecarPath(path);
+    std::remove(sidecar.c_str());
+    {
+      std::ofstream file(path, std::ios::binary);
+      file << contents;
+    }
+
+    WHEN( "the RowIndex for the file is requested" ) {
+
+      RowIndex index = RowIndex::forFile(path, cols);
+
+      THEN( "the index is cached alongside the file and matches the file's fingerprint" ) {
+
+        REQUIRE( std::filesystem::exists(sidecar) );
+        REQUIRE( index.getFingerprint() == FileFingerprint::of(path) );
+        REQUIRE( index.getFingerprint().matches(path) );
+
+      } // THEN
+
+      AND_WHEN( "the file is changed" ) {
+
+        {
+          std::ofstream file(path, std::ios::binary | std::ios::app);
+          file << "\n";
+        }
+
+        THEN( "the cached index no longer matches and is rebuilt" ) {
+
+          REQUIRE_FALSE( index.getFingerprint().matches(path) );
+
+          RowIndex rebuilt = RowIndex::forFile(path, cols);
+          REQUIRE( rebuilt.getFingerprint().getSize() == contents.size() + 1 );
+          REQUIRE( RowIndex::forFile(path, cols).getFingerprint() == rebuilt.getFingerprint() );
+
+        } // THEN
+
+      } // AND_WHEN
+
+    } // WHEN
+
+    std::remove(sidecar.c_str());
+    std::remove(path.c_str());
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "a file can be written atomically by several writers at once", "[RowIndex]" ) {
+
+  GIVEN( "several threads writing different contents to the same file" ) {
+
+    const std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "bethyw-test17-atomic";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    const std::string path = (dir / "cache").string();
+
+    std::vector<std::string> payloads;
+    for (char c = 'a'; c < 'i'; c++) {
+      payloads.push_back(std::string(1 << 16, c));
+    }
+
+    std::vector<std::thread> writers;
+    std::vector<int> written(payloads.size(), 0);
+    for (unsigned int i = 0; i < payloads.size(); i++) {
+      writers.emplace_back([&, i]() {
+        for (int n = 0; n < 20; n++) {
+          written[i] += writeFileAtomically(path, payloads[i]) ? 1 : 0;
+        }
+      });
+    }
+    for (auto& writer : writers) {
+      writer.join();
+    }
+
+    THEN( "every write succeeds and the file holds one writer's complete contents" ) {
+
+      for (const auto& count : written) {
+        REQUIRE( count == 20 );
+      }
+
+      std::string contents;
+      REQUIRE( readFileContents(path, contents) );
+      REQUIRE( std::find(payloads.begin(), payloads.end(), contents) != payloads.end() );
+
+    } // THEN
+
+    THEN( "no temporary files are left behind" ) {
+
+      int files = 0;
+      for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        (void) entry;
+        files++;
+      }
+      REQUIRE( files == 1 );
+
+    } // THEN
+
+    std::filesystem::remove_all(dir);
+
+  } // GIVEN
+
+} // SCENARIO
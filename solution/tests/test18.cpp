@@ -0,0 +1,172 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+#include "../bloomfilter.h"
+#include "../catalog.h"
+#include "../datasets.h"
+#include "../fingerprint.h"
+
+SCENARIO( "a BloomFilter has no false negatives", "[BloomFilter]" ) {
+
+  GIVEN( "a BloomFilter with 1,000 strings inserted" ) {
+
+    BloomFilter filter(1000);
+    char str[16];
+    for (int i = 0; i < 1000; i++) {
+      std::snprintf(str, sizeof(str), "W%08d", i);
+      filter.insert(str);
+    }
+
+    THEN( "every inserted string may be contained, and few others are" ) {
+
+      size_t falsePositives = 0;
+      for (int i = 0; i < 1000; i++) {
+        std::snprintf(str, sizeof(str), "W%08d", i);
+        REQUIRE( filter.mayContain(str) );
+
+        std::snprintf(str, sizeof(str), "K%08d", i);
+        falsePositives += filter.mayContain(str);
+      }
+
+      REQUIRE( falsePositives < 50 );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "an empty BloomFilter" ) {
+
+    BloomFilter filter;
+
+    THEN( "it contains nothing" ) {
+
+      REQUIRE( filter.empty() );
+      REQUIRE_FALSE( filter.mayContain("W06000023") );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "a DatasetCatalog summarises the contents of a dataset file", "[DatasetCatalog]" ) {
+
+  GIVEN( "a WelshStatsJSON file" ) {
+
+    const std::string contents =
+      "{\"value\":[\n"
+      "{\"Localauthority_Code\":\"W06000001\",\"Localauthority_ItemName_ENG\":\"Isle of Anglesey\",\"Measure_Code\":\"DENS\",\"Measure_ItemName_ENG\":\"Density\",\"Year_Code\":\"2010\",\"Data\":1.5},\n"
+      "{\"Localauthority_Code\":\"W06000023\",\"Localauthority_ItemName_ENG\":\"Powys\",\"Measure_Code\":\"POP\",\"Measure_ItemName_ENG\":\"Population\",\"Year_Code\":\"2014\",\"Data\":3},\n"
+      "{\"Localauthority_Code\":\"W06000001\",\"Localauthority_ItemName_ENG\":\"Isle of Anglesey\",\"Measure_Code\":\"POP\",\"Measure_ItemName_ENG\":\"Population\",\"Year_Code\":\"2012\",\"Data\":4}\n"
+      "]}";
+
+    DatasetCatalog catalog(contents,
+                           FileFingerprint(contents.size(), 0, 0),
+                           BethYw::InputFiles::DATASETS[0]);
+
+    THEN( "it lists the distinct areas, measures, and range of years" ) {
+
+      REQUIRE( catalog.hasAreaList() );
+      REQUIRE( catalog.getNumAreas() == 2 );
+      REQUIRE( catalog.getAreas()[1].first == "W06000023" );
+      REQUIRE( catalog.getAreas()[1].second == "Powys" );
+      REQUIRE( catalog.getMeasures() == std::vector<std::string>({"dens", "pop"}) );
+      REQUIRE( catalog.getMinYear() == 2010 );
+      REQUIRE( catalog.getMaxYear() == 2014 );
+
+    } // THEN
+
+    THEN( "it can answer whether the file matches the filters" ) {
+
+      REQUIRE( catalog.mayContainArea("W06000023") );
+      REQUIRE_FALSE( catalog.mayContainArea("W06000024") );
+      REQUIRE( catalog.mayMatchAreas({"angle"}) );
+      REQUIRE_FALSE( catalog.mayMatchAreas({"swansea"}) );
+      REQUIRE( catalog.mayContainMeasures({"pop", "area"}) );
+      REQUIRE_FALSE( catalog.mayContainMeasures({"area"}) );
+      REQUIRE( catalog.mayContainYears(2014, 2020) );
+      REQUIRE_FALSE( catalog.mayContainYears(2015, 2020) );
+
+    } // THEN
+
+    THEN( "it can be serialised and deserialised" ) {
+
+      DatasetCatalog copy = DatasetCatalog::fromJSON(catalog.toJSON());
+      REQUIRE( copy.getFingerprint() == catalog.getFingerprint() );
+      REQUIRE( copy.getAreas() == catalog.getAreas() );
+      REQUIRE( copy.getMeasures() == catalog.getMeasures() );
+      REQUIRE( copy.getMaxYear() == 2014 );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "an AuthorityByYearCSV file with too many areas to list" ) {
+
+    std::ostringstream csv;
+    csv << "AuthorityCode,1991,2001\n";
+    char code[16];
+    for (size_t i = 0; i < DatasetCatalog::MAX_LISTED_AREAS * 2; i++) {
+      std::snprintf(code, sizeof(code), "W%08zu", i * 10);
+      csv << code << ",1,2\n";
+    }
+
+    DatasetCatalog catalog(csv.str(),
+                           FileFingerprint(),
+                           BethYw::InputFiles::COMPLETE_POP);
+
+    THEN( "the areas are summarised with BloomFilters" ) {
+
+      REQUIRE_FALSE( catalog.hasAreaList() );
+      REQUIRE( catalog.getNumAreas() == DatasetCatalog::MAX_LISTED_AREAS * 2 );
+      REQUIRE( catalog.getMeasures() == std::vector<std::string>({"pop"}) );
+      REQUIRE( catalog.getMinYear() == 1991 );
+      REQUIRE( catalog.getMaxYear() == 2001 );
+
+      REQUIRE( catalog.mayContainArea("W00000010") );
+      REQUIRE( catalog.mayMatchAreas({"w0000001"}) );
+      REQUIRE( catalog.mayMatchAreas({"W"}) );
+      REQUIRE_FALSE( catalog.mayMatchAreas({"K02000001"}) );
+
+      AND_THEN( "they survive serialisation" ) {
+
+        DatasetCatalog copy = DatasetCatalog::fromJSON(catalog.toJSON());
+        REQUIRE_FALSE( copy.hasAreaList() );
+        REQUIRE( copy.mayContainArea("W00000010") );
+        REQUIRE_FALSE( copy.mayMatchAreas({"K02000001"}) );
+
+      } // AND_THEN
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a file that is not valid" ) {
+
+    THEN( "it cannot be catalogued" ) {
+
+      REQUIRE_THROWS_AS( DatasetCatalog("{\"value\":[", FileFingerprint(), BethYw::InputFiles::DATASETS[0]), std::runtime_error );
+      REQUIRE_THROWS_AS( DatasetCatalog::fromJSON("[]"), std::runtime_error );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
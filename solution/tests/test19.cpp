@@ -0,0 +1,329 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+
+#include "../areas.h"
+#include "../bethyw.h"
+#include "../datasets.h"
+#include "../fingerprint.h"
+#include "../input.h"
+#include "../snapshot.h"
+
+/*
+  Check two Areas instances hold exactly the same data, including the running
+  sums behind the averages.
+*/
+static void requireSameAreas(Areas& lhs, Areas& rhs) {
+  REQUIRE( lhs.size() == rhs.size() );
+  REQUIRE( lhs.toJSON() == rhs.toJSON() );
+  REQUIRE( lhs.getAreaNames() == rhs.getAreaNames() );
+
+  for (auto lhsIt = lhs.cbegin(), rhsIt = rhs.cbegin();
+       lhsIt != lhs.cend();
+       lhsIt++, rhsIt++) {
+    REQUIRE( lhsIt->getLocalAuthorityCode() == rhsIt->getLocalAuthorityCode() );
+    REQUIRE( lhsIt->getNames() == rhsIt->getNames() );
+    REQUIRE( lhsIt->size() == rhsIt->size() );
+
+    for (auto measureIt = lhsIt->cbegin(), otherIt = rhsIt->cbegin();
+         measureIt != lhsIt->cend();
+         measureIt++, otherIt++) {
+      REQUIRE( measureIt->second == otherIt->second );
+    }
+  }
+}
+
+SCENARIO( "Areas can be merged as if the data had been imported in order", "[Areas][merge][DatasetSnapshot]" ) {
+
+  GIVEN( "an Areas instance with a named Area and a Measure" ) {
+
+    Areas areas = Areas();
+    std::string code = "W06000011";
+
+    Area area(code);
+    area.setName("eng", "Swansea");
+    Measure measure("pop", "Population");
+    measure.setValue(2010, 1);
+    area.setMeasure("pop", measure);
+    areas.setArea(code, area);
+    areas.setAreaName("Swansea", code);
+
+    WHEN( "an Areas instance with other names and labels is merged with MergePolicy::Import" ) {
+
+      Areas update = Areas();
+      Area updateArea(code);
+      updateArea.setName("eng", "City and County of Swansea");
+      Measure updateMeasure("pop", "Population (thousands)");
+      updateMeasure.setValue(2010, 2);
+      updateMeasure.setValue(2011, 3);
+      updateArea.setMeasure("pop", updateMeasure);
+      update.setArea(code, updateArea);
+      update.setAreaName("Swansea", "W06000099");
+
+      areas.merge(std::move(update), MergePolicy::Import);
+
+      THEN( "the existing names and labels are kept, and the values are updated" ) {
+
+        Area& merged = areas.getArea("Swansea");
+        REQUIRE( merged.getLocalAuthorityCode() == code );
+        REQUIRE( merged.getName("eng") == "Swansea" );
+        REQUIRE( merged.getMeasure("pop").getLabel() == "Population" );
+        REQUIRE( merged.getMeasure("pop").getValue(2010) == 2 );
+        REQUIRE( merged.getMeasure("pop").getValue(2011) == 3 );
+        REQUIRE( merged.getMeasure("pop").getAverage() == 2.5 );
+
+      } // THEN
+
+    } // WHEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+/*
+  Load a JSON and a CSV dataset from a temporary directory with and without
+  snapshots, and check the result is always the same as importing them
+  directly into a single Areas instance.
+*/
+static void requireSnapshotsMatchImport(
+    std::unordered_set<std::string> areasFilter) {
+  const std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "bethyw-test19";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+
+  const std::string dirStr = dir.string() + DIR_SEP;
+  for (const auto& file : {BethYw::InputFiles::AREAS.FILE,
+                           BethYw::InputFiles::POPDEN.FILE,
+                           BethYw::InputFiles::COMPLETE_POP.FILE}) {
+    std::filesystem::copy_file("datasets/" + file, dirStr + file);
+  }
+
+  std::vector<BethYw::InputFileSource> datasets = {
+      BethYw::InputFiles::POPDEN,
+      BethYw::InputFiles::COMPLETE_POP};
+  std::unordered_set<std::string> measuresFilter;
+  std::tuple<unsigned int, unsigned int> yearsFilter(0, 0);
+
+  // Import each dataset directly into a single Areas instance
+  Areas expected = Areas();
+  BethYw::loadAreas(expected, dirStr, areasFilter);
+  for (const auto& dataset : datasets) {
+    InputFile input(dirStr + dataset.FILE);
+    expected.populate(input.open(),
+                      dataset.PARSER,
+                      dataset.COLS,
+                      &areasFilter,
+                      &measuresFilter,
+                      &yearsFilter);
+  }
+
+  auto load = [&]() {
+    Areas areas = Areas();
+    BethYw::loadAreas(areas, dirStr, areasFilter);
+    BethYw::loadDatasets(areas,
+                         dirStr,
+                         datasets,
+                         areasFilter,
+                         measuresFilter,
+                         yearsFilter);
+    return areas;
+  };
+
+  WHEN( "the datasets are loaded without any snapshots" ) {
+
+    Areas cold = load();
+
+    THEN( "the result is the same and a snapshot is saved for each dataset" ) {
+
+      requireSameAreas(cold, expected);
+      for (const auto& dataset : datasets) {
+        REQUIRE( std::filesystem::exists(
+            DatasetSnapshot::sidecarPath(dirStr + dataset.FILE)) );
+      }
+
+    } // THEN
+
+    AND_WHEN( "the datasets are loaded again" ) {
+
+      Areas warm = load();
+
+      THEN( "the restored result is exactly the same" ) {
+
+        requireSameAreas(warm, expected);
+
+      } // THEN
+
+    } // AND_WHEN
+
+    AND_WHEN( "a snapshot is corrupt" ) {
+
+      const std::string path = dirStr + datasets[0].FILE;
+      {
+        std::ofstream file(DatasetSnapshot::sidecarPath(path),
+                           std::ios::trunc);
+        file << "{\"version\":1,\"areas\":[";
+      }
+
+      Areas rebuilt = load();
+
+      THEN( "the dataset is parsed again and the snapshot is replaced" ) {
+
+        requireSameAreas(rebuilt, expected);
+        REQUIRE_NOTHROW( DatasetSnapshot::forFile(path) );
+
+      } // THEN
+
+    } // AND_WHEN
+
+    AND_WHEN( "a dataset file changes" ) {
+
+      const std::string path = dirStr + datasets[1].FILE;
+      const std::string otherPath = dirStr + datasets[0].FILE;
+      const DatasetSnapshot before = DatasetSnapshot::forFile(path);
+      {
+        std::ofstream file(path, std::ios::binary | std::ios::app);
+        file << "\n";
+      }
+
+      THEN( "only its snapshot no longer matches, and it is replaced" ) {
+
+        REQUIRE_FALSE( before.isFor(path, before.getImport()) );
+        const DatasetSnapshot other = DatasetSnapshot::forFile(otherPath);
+        REQUIRE( other.isFor(otherPath, other.getImport()) );
+
+        Areas reloaded = load();
+        requireSameAreas(reloaded, expected);
+
+        const DatasetSnapshot after = DatasetSnapshot::forFile(path);
+        REQUIRE( after.isFor(path, before.getImport()) );
+        REQUIRE( after.getFingerprint().getSize() ==
+                 before.getFingerprint().getSize() + 1 );
+
+      } // THEN
+
+    } // AND_WHEN
+
+  } // WHEN
+
+  std::filesystem::remove_all(dir);
+}
+
+SCENARIO( "datasets are restored from snapshots when they have not changed", "[DatasetSnapshot][BethYw]" ) {
+
+  GIVEN( "no filters" ) {
+
+    requireSnapshotsMatchImport({});
+
+  } // GIVEN
+
+  GIVEN( "an areas filter matching a Welsh name from areas.csv and a code" ) {
+
+    requireSnapshotsMatchImport({"abertawe", "w06000023"});
+
+  } // GIVEN
+
+  GIVEN( "a dataset definition and filters" ) {
+
+    std::unordered_set<std::string> areasFilter, measuresFilter;
+    std::unordered_set<std::string> otherFilter = {"pop"};
+    std::tuple<unsigned int, unsigned int> yearsFilter(0, 0);
+    Areas empty = Areas();
+
+    THEN( "the description of the import changes with the filters" ) {
+
+      REQUIRE( DatasetSnapshot::describeImport(BethYw::InputFiles::POPDEN, areasFilter, measuresFilter, yearsFilter, empty) !=
+               DatasetSnapshot::describeImport(BethYw::InputFiles::POPDEN, areasFilter, otherFilter, yearsFilter, empty) );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "a DatasetSnapshot is restored rather than the file being parsed", "[DatasetSnapshot]" ) {
+
+  GIVEN( "a snapshot of a CSV dataset" ) {
+
+    const std::string path =
+        (std::filesystem::temp_directory_path() / "bethyw-test19.csv").string();
+    {
+      std::ofstream file(path, std::ios::binary);
+      file << "AuthorityCode,2010,2011\nW06000011,1,2\n";
+    }
+
+    BethYw::InputFileSource source = BethYw::InputFiles::COMPLETE_POP;
+    std::unordered_set<std::string> areasFilter, measuresFilter;
+    std::tuple<unsigned int, unsigned int> yearsFilter(0, 0);
+
+    Areas empty = Areas();
+    const auto import = DatasetSnapshot::describeImport(
+        source, areasFilter, measuresFilter, yearsFilter, empty);
+
+    // A snapshot that differs from the file shows which one was used
+    Areas saved = Areas();
+    std::string code = "W06000011";
+    Area area(code);
+    Measure measure("pop", "Population");
+    measure.setValue(2010, 100);
+    area.setMeasure("pop", measure);
+    saved.setArea(code, area);
+    DatasetSnapshot(saved, FileFingerprint::of(path), import).save(path);
+
+    WHEN( "the dataset is loaded" ) {
+
+      Areas areas = Areas();
+      REQUIRE( BethYw::restoreDataset(areas, path, import) );
+
+      THEN( "the values come from the snapshot" ) {
+
+        REQUIRE( areas.size() == 1 );
+        REQUIRE( areas.getArea(code).getMeasure("pop").getValue(2010) == 100 );
+        REQUIRE( areas.getArea(code).getMeasure("pop").size() == 1 );
+
+      } // THEN
+
+    } // WHEN
+
+    WHEN( "the snapshot is checked against a different import" ) {
+
+      std::unordered_set<std::string> otherFilter = {"W06000011"};
+      const auto otherImport = DatasetSnapshot::describeImport(
+          source, otherFilter, measuresFilter, yearsFilter, empty);
+
+      THEN( "it is not restored" ) {
+
+        Areas areas = Areas();
+        REQUIRE_FALSE( BethYw::restoreDataset(areas, path, otherImport) );
+        REQUIRE( areas.size() == 0 );
+
+      } // THEN
+
+    } // WHEN
+
+    std::remove(DatasetSnapshot::sidecarPath(path).c_str());
+    std::remove(path.c_str());
+
+  } // GIVEN
+
+} // SCENARIO
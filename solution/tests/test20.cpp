@@ -0,0 +1,234 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+
+#include "../areas.h"
+#include "../bethyw.h"
+#include "../datasets.h"
+#include "../snapshot.h"
+#include "../watch.h"
+
+#ifdef __linux__
+
+SCENARIO( "a DirectoryWatcher reports the files that change", "[DirectoryWatcher]" ) {
+
+  GIVEN( "a DirectoryWatcher on an empty directory" ) {
+
+    const std::filesystem::path dir =
+        std::filesystem::temp_directory_path() / "bethyw-test20-watch";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    DirectoryWatcher watcher(dir.string());
+
+    WHEN( "a file is written to twice, and another file is written to" ) {
+
+      for (int i = 0; i < 2; i++) {
+        std::ofstream file(dir / "a.csv", std::ios::binary | std::ios::app);
+        file << i << "\n";
+      }
+      {
+        std::ofstream file(dir / "b.csv", std::ios::binary);
+        file << "b\n";
+      }
+
+      THEN( "only the file of interest is reported, once" ) {
+
+        REQUIRE( watcher.wait({"a.csv"}, 50, 1000) ==
+                 std::set<std::string>({"a.csv"}) );
+        REQUIRE( watcher.wait({"a.csv"}, 50, 100).empty() );
+
+      } // THEN
+
+    } // WHEN
+
+    WHEN( "nothing is written" ) {
+
+      THEN( "nothing is reported after the timeout" ) {
+
+        REQUIRE( watcher.wait({"a.csv"}, 50, 100).empty() );
+
+      } // THEN
+
+    } // WHEN
+
+    std::filesystem::remove_all(dir);
+
+  } // GIVEN
+
+} // SCENARIO
+
+#endif // __linux__
+
+SCENARIO( "only the datasets that change are reloaded", "[BethYw][reloadDatasets]" ) {
+
+  GIVEN( "a JSON and a CSV dataset loaded with snapshots kept in memory" ) {
+
+    const std::filesystem::path dir =
+        std::filesystem::temp_directory_path() / "bethyw-test20-reload";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    const std::string dirStr = dir.string() + DIR_SEP;
+    for (const auto& file : {BethYw::InputFiles::AREAS.FILE,
+                             BethYw::InputFiles::POPDEN.FILE,
+                             BethYw::InputFiles::COMPLETE_POP.FILE}) {
+      std::filesystem::copy_file("datasets/" + file, dirStr + file);
+    }
+
+    std::vector<BethYw::InputFileSource> datasets = {
+        BethYw::InputFiles::POPDEN,
+        BethYw::InputFiles::COMPLETE_POP};
+    std::unordered_set<std::string> areasFilter, measuresFilter;
+    std::tuple<unsigned int, unsigned int> yearsFilter(0, 0);
+
+    Areas areas = Areas();
+    BethYw::loadAreas(areas, dirStr, areasFilter);
+    DatasetSnapshots snapshots;
+    BethYw::loadDatasets(areas,
+                         dirStr,
+                         datasets,
+                         areasFilter,
+                         measuresFilter,
+                         yearsFilter,
+                         &snapshots);
+
+    REQUIRE( snapshots.size() == 2 );
+    const double before =
+        areas.getArea("W06000001").getMeasure("pop").getValue(1991);
+    REQUIRE( before == 69123 );
+
+    WHEN( "a value in the CSV dataset is changed and the data is reloaded" ) {
+
+      const std::string path = dirStr + BethYw::InputFiles::COMPLETE_POP.FILE;
+      std::stringstream contents;
+      {
+        std::ifstream file(path, std::ios::binary);
+        contents << file.rdbuf();
+      }
+      std::string str = contents.str();
+      const size_t pos = str.find("W06000001,69123,");
+      REQUIRE( pos != std::string::npos );
+      str.replace(pos, 16, "W06000001,69124,");
+      {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << str;
+      }
+
+      const Measure density = areas.getArea("W06000001").getMeasure("dens");
+
+      const auto changes = BethYw::reloadDatasets(
+          areas,
+          dirStr,
+          datasets,
+          {BethYw::InputFiles::COMPLETE_POP.FILE},
+          snapshots,
+          areasFilter,
+          measuresFilter,
+          yearsFilter,
+          AreasMemory::Arena);
+
+      THEN( "the new value is in the data, and one value is reported changed" ) {
+
+        REQUIRE( areas.getArea("W06000001").getMeasure("pop").getValue(1991) ==
+                 69124 );
+        REQUIRE( areas.getArea("W06000001").getMeasure("dens") == density );
+        REQUIRE( changes == std::map<std::string, size_t>(
+                     {{BethYw::InputFiles::COMPLETE_POP.CODE, 1}}) );
+        REQUIRE( snapshots.size() == 2 );
+
+      } // THEN
+
+    } // WHEN
+
+    WHEN( "a page is added to the JSON dataset and the data is reloaded" ) {
+
+      const std::string page = "popu1009.2.json";
+      REQUIRE( BethYw::dataFileNames(dirStr, BethYw::InputFiles::POPDEN) ==
+               std::set<std::string>({"popu1009.json",
+                                      "popu1009.json.gz",
+                                      page}) );
+      {
+        std::ofstream file(dirStr + page, std::ios::binary | std::ios::trunc);
+        file << "{\"value\":[]}";
+      }
+
+      const auto changes = BethYw::reloadDatasets(
+          areas,
+          dirStr,
+          datasets,
+          {page},
+          snapshots,
+          areasFilter,
+          measuresFilter,
+          yearsFilter,
+          AreasMemory::Arena);
+
+      THEN( "the dataset with that page is reloaded, and the next page is "
+            "watched for" ) {
+
+        REQUIRE( changes == std::map<std::string, size_t>(
+                     {{BethYw::InputFiles::POPDEN.CODE, 0}}) );
+        REQUIRE( BethYw::dataFileNames(dirStr, BethYw::InputFiles::POPDEN)
+                     .count("popu1009.3.json") == 1 );
+        REQUIRE( BethYw::dataFileNames(dirStr,
+                                       BethYw::InputFiles::COMPLETE_POP) ==
+                 std::set<std::string>(
+                     {BethYw::InputFiles::COMPLETE_POP.FILE,
+                      BethYw::InputFiles::COMPLETE_POP.FILE + ".gz"}) );
+
+      } // THEN
+
+    } // WHEN
+
+    WHEN( "a dataset file is unreadable when the data is reloaded" ) {
+
+      std::filesystem::remove(dirStr + BethYw::InputFiles::POPDEN.FILE);
+
+      THEN( "an exception is thrown and the data is left unchanged" ) {
+
+        REQUIRE_THROWS_AS(
+            BethYw::reloadDatasets(areas,
+                                   dirStr,
+                                   datasets,
+                                   {BethYw::InputFiles::POPDEN.FILE},
+                                   snapshots,
+                                   areasFilter,
+                                   measuresFilter,
+                                   yearsFilter,
+                                   AreasMemory::Arena),
+            std::runtime_error);
+        REQUIRE( areas.getArea("W06000001").getMeasure("pop").getValue(1991) ==
+                 before );
+
+      } // THEN
+
+    } // WHEN
+
+    std::filesystem::remove_all(dir);
+
+  } // GIVEN
+
+} // SCENARIO
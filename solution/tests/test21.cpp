@@ -0,0 +1,299 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+
+#include "../lib_json.hpp"
+
+#include "../areas.h"
+#include "../bethyw.h"
+#include "../datasets.h"
+#include "../http.h"
+#include "../input.h"
+#include "../snapshot.h"
+
+#include "stubserver.h"
+
+/*
+  Split the rows of popu1009.json into pages of up to pageSize rows, each
+  linking to the next with the link given by linkTo(page number).
+*/
+template <typename LinkTo>
+static std::vector<std::string> splitIntoPages(size_t pageSize, LinkTo linkTo) {
+  nlohmann::json dataset;
+  {
+    std::ifstream file("datasets/popu1009.json");
+    file >> dataset;
+  }
+
+  const auto& rows = dataset["value"];
+  std::vector<std::string> pages;
+  for (size_t start = 0; start < rows.size(); start += pageSize) {
+    nlohmann::json page;
+    page["odata.metadata"] = dataset["odata.metadata"];
+    page["value"] = nlohmann::json::array();
+    for (size_t i = start; i < start + pageSize && i < rows.size(); i++) {
+      page["value"].push_back(rows[i]);
+    }
+    if (start + pageSize < rows.size()) {
+      page["odata.nextLink"] = linkTo(pages.size() + 2);
+    }
+    pages.push_back(page.dump());
+  }
+
+  return pages;
+}
+
+SCENARIO( "a dataset split into pages is imported as if it were one document", "[InputPages][Areas]" ) {
+
+  auto cols = BethYw::InputFiles::POPDEN.COLS;
+
+  Areas expected = Areas();
+  {
+    InputFile input("datasets/popu1009.json");
+    expected.populateFromWelshStatsJSON(input.open(), cols);
+  }
+
+  GIVEN( "the pages saved as numbered files" ) {
+
+    const std::filesystem::path dir =
+        std::filesystem::temp_directory_path() / "bethyw-test21";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    const std::string path = (dir / "popu1009.json").string();
+    const auto pages = splitIntoPages(400, [](size_t page) {
+      return "http://example.com/popu1009?page=" + std::to_string(page);
+    });
+    REQUIRE( pages.size() == 3 );
+    for (unsigned int page = 1; page <= pages.size(); page++) {
+      std::ofstream file(InputFilePages::pagePath(path, page));
+      file << pages[page - 1];
+    }
+
+    THEN( "the page files are numbered before the extension" ) {
+
+      REQUIRE( InputFilePages::pagePath(path, 1) == path );
+      REQUIRE( InputFilePages::pagePath(path, 2) ==
+               (dir / "popu1009.2.json").string() );
+      REQUIRE( InputFilePages::isPaged(path) );
+
+    } // THEN
+
+    WHEN( "the pages are imported" ) {
+
+      InputFilePages input(path);
+      Areas areas = Areas();
+      areas.populateFromWelshStatsJSONPages(input, cols);
+
+      THEN( "every page is read, and the data is the same" ) {
+
+        REQUIRE( input.getPageCount() == 3 );
+        REQUIRE( areas.toJSON() == expected.toJSON() );
+
+      } // THEN
+
+    } // WHEN
+
+    WHEN( "the dataset is loaded from the directory" ) {
+
+      const std::string dirStr = dir.string() + DIR_SEP;
+      std::vector<BethYw::InputFileSource> datasets = {
+          BethYw::InputFiles::POPDEN};
+      std::unordered_set<std::string> areasFilter, measuresFilter;
+      std::tuple<unsigned int, unsigned int> yearsFilter(0, 0);
+
+      Areas areas = Areas();
+      BethYw::loadDatasets(areas,
+                           dirStr,
+                           datasets,
+                           areasFilter,
+                           measuresFilter,
+                           yearsFilter);
+
+      THEN( "every page is imported, and no snapshot is saved for them" ) {
+
+        REQUIRE( areas.toJSON() == expected.toJSON() );
+        REQUIRE_FALSE( std::filesystem::exists(
+            DatasetSnapshot::sidecarPath(path)) );
+
+      } // THEN
+
+    } // WHEN
+
+    WHEN( "the pages are read in a batch" ) {
+
+      const std::string dirStr = dir.string() + DIR_SEP;
+      std::vector<BethYw::InputFileSource> datasets = {
+          BethYw::InputFiles::POPDEN};
+      std::unordered_set<std::string> areasFilter, measuresFilter;
+
+      auto batch = BethYw::batchDatasetFiles(dirStr,
+                                             datasets,
+                                             areasFilter,
+                                             measuresFilter);
+      auto probe = BethYw::batchDatasetFiles(dirStr,
+                                             datasets,
+                                             areasFilter,
+                                             measuresFilter);
+
+      InputOptions options;
+      options.batch = batch;
+      InputFilePages input(dirStr + BethYw::InputFiles::POPDEN.FILE, options);
+      Areas areas = Areas();
+      areas.populateFromWelshStatsJSONPages(input, cols);
+
+      THEN( "every page is in the batch, and the data is the same" ) {
+
+        REQUIRE( input.getPageCount() == 3 );
+        REQUIRE( areas.toJSON() == expected.toJSON() );
+
+        for (unsigned int page = 1; page <= pages.size(); page++) {
+          const std::string pagePath =
+              InputFilePages::pagePath(dirStr + "popu1009.json", page);
+          std::string contents;
+          if (probe->isUsingUring()) {
+            REQUIRE( probe->take(pagePath, contents) );
+            REQUIRE( contents == pages[page - 1] );
+          }
+          REQUIRE_FALSE( batch->take(pagePath, contents) );
+        }
+
+      } // THEN
+
+    } // WHEN
+
+    WHEN( "only the first page is saved" ) {
+
+      std::filesystem::remove(InputFilePages::pagePath(path, 2));
+      std::filesystem::remove(InputFilePages::pagePath(path, 3));
+
+      InputFilePages input(path);
+      Areas areas = Areas();
+      areas.populateFromWelshStatsJSONPages(input, cols);
+
+      THEN( "the pages end with the first page" ) {
+
+        REQUIRE_FALSE( InputFilePages::isPaged(path) );
+        REQUIRE( input.getPageCount() == 1 );
+        REQUIRE( areas.getArea("W06000001").getMeasure("dens").size() > 0 );
+
+      } // THEN
+
+    } // WHEN
+
+    std::filesystem::remove_all(dir);
+
+  } // GIVEN
+
+  GIVEN( "the pages served by a stand-in HTTP server" ) {
+
+    StubServer server;
+    const auto pages = splitIntoPages(300, [&server](size_t page) {
+      return server.url("/popu1009?page=" + std::to_string(page));
+    });
+    REQUIRE( pages.size() == 4 );
+    server.setBody("/popu1009", pages[0]);
+    for (size_t page = 2; page <= pages.size(); page++) {
+      server.setBody("/popu1009?page=" + std::to_string(page),
+                     pages[page - 1]);
+    }
+
+    WHEN( "the pages are imported from the first page's URL" ) {
+
+      InputHttp input(server.url("/popu1009"));
+      Areas areas = Areas();
+      areas.populateFromWelshStatsJSONPages(input, cols);
+
+      THEN( "every link is followed, and the data is the same" ) {
+
+        REQUIRE( input.getPageCount() == 4 );
+        REQUIRE( server.getRequestCount() == 4 );
+        REQUIRE( areas.toJSON() == expected.toJSON() );
+
+      } // THEN
+
+    } // WHEN
+
+    WHEN( "a page links to a page the server does not have" ) {
+
+      nlohmann::json page = nlohmann::json::parse(pages[0]);
+      page["odata.nextLink"] = server.url("/popu1009?page=99");
+      server.setBody("/broken", page.dump());
+
+      InputHttp input(server.url("/broken"));
+
+      THEN( "an exception is thrown" ) {
+
+        Areas areas = Areas();
+        REQUIRE_THROWS_AS( areas.populateFromWelshStatsJSONPages(input, cols),
+                           std::runtime_error );
+        REQUIRE( input.getPageCount() == 1 );
+
+      } // THEN
+
+    } // WHEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "an http:// URL is split into its parts", "[HttpUrl]" ) {
+
+  GIVEN( "a URL with a port and a query" ) {
+
+    HttpUrl url = HttpUrl::parse("http://localhost:8080/popu1009?page=2");
+
+    THEN( "the host, port and target are found" ) {
+
+      REQUIRE( url.host == "localhost" );
+      REQUIRE( url.port == "8080" );
+      REQUIRE( url.target == "/popu1009?page=2" );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a URL without a port or a path" ) {
+
+    HttpUrl url = HttpUrl::parse("http://open.statswales.gov.wales");
+
+    THEN( "the defaults are used" ) {
+
+      REQUIRE( url.port == "80" );
+      REQUIRE( url.target == "/" );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "an https:// URL" ) {
+
+    THEN( "an exception is thrown, as it is not supported" ) {
+
+      REQUIRE_THROWS_AS( HttpUrl::parse("https://open.statswales.gov.wales/"),
+                         std::runtime_error );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
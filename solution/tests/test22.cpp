@@ -0,0 +1,284 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../lib_json.hpp"
+
+#include "../areas.h"
+#include "../bethyw.h"
+#include "../datasets.h"
+#include "../http.h"
+#include "../input.h"
+
+#include "stubserver.h"
+
+/*
+  Serve the rows of popu1009.json from a stand-in server as pages of up to
+  pageSize rows at /popu1009, /popu1009?page=2, /popu1009?page=3..., each
+  with an ETag, returning the number of pages.
+*/
+static size_t servePopu1009Pages(StubServer& server, size_t pageSize) {
+  nlohmann::json dataset;
+  {
+    std::ifstream file("datasets/popu1009.json");
+    file >> dataset;
+  }
+
+  const auto& rows = dataset["value"];
+  size_t pages = 0;
+  for (size_t start = 0; start < rows.size(); start += pageSize) {
+    pages++;
+
+    nlohmann::json page;
+    page["odata.metadata"] = dataset["odata.metadata"];
+    page["value"] = nlohmann::json::array();
+    for (size_t i = start; i < start + pageSize && i < rows.size(); i++) {
+      page["value"].push_back(rows[i]);
+    }
+    if (start + pageSize < rows.size()) {
+      page["odata.nextLink"] =
+          server.url("/popu1009?page=" + std::to_string(pages + 1));
+    }
+
+    const std::string target =
+        pages == 1 ? "/popu1009" : "/popu1009?page=" + std::to_string(pages);
+    server.setBody(target, page.dump(), "\"v1-" + std::to_string(pages) + "\"");
+  }
+
+  return pages;
+}
+
+SCENARIO( "a dataset is fetched from the StatsWales OData API", "[InputHttp]" ) {
+
+  auto cols = BethYw::InputFiles::POPDEN.COLS;
+
+  Areas expected = Areas();
+  {
+    InputFile file("datasets/popu1009.json");
+    expected.populateFromWelshStatsJSON(file.open(), cols);
+  }
+
+  StubServer server;
+  const size_t pages = servePopu1009Pages(server, 200);
+  REQUIRE( pages > 3 );
+
+  GIVEN( "pages fetched ahead of being parsed" ) {
+
+    InputHttp input(server.url("/popu1009"), "", 2);
+    Areas areas = Areas();
+    areas.populateFromWelshStatsJSONPages(input, cols);
+
+    THEN( "every page is fetched once, on one kept-alive connection" ) {
+
+      REQUIRE( input.getPageCount() == pages );
+      REQUIRE( server.getRequestCount() == pages );
+      REQUIRE( server.getConnectionCount() == 1 );
+      REQUIRE( areas.toJSON() == expected.toJSON() );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "pages fetched as they are opened" ) {
+
+    InputHttp input(server.url("/popu1009"), "", 0);
+    Areas areas = Areas();
+    areas.populateFromWelshStatsJSONPages(input, cols);
+
+    THEN( "the data is the same, and the connection is still kept alive" ) {
+
+      REQUIRE( input.getPageCount() == pages );
+      REQUIRE( server.getConnectionCount() == 1 );
+      REQUIRE( areas.toJSON() == expected.toJSON() );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a slow server" ) {
+
+    server.setDelay(50);
+
+    THEN( "fetching pages ahead does not read beyond the last page" ) {
+
+      InputHttp input(server.url("/popu1009"), "", 3);
+      Areas areas = Areas();
+      areas.populateFromWelshStatsJSONPages(input, cols);
+
+      REQUIRE( input.getPageCount() == pages );
+      REQUIRE( server.getRequestCount() == pages );
+      REQUIRE( areas.toJSON() == expected.toJSON() );
+
+    } // THEN
+
+    THEN( "a source that is abandoned part way through stops fetching" ) {
+
+      {
+        InputHttp input(server.url("/popu1009"), "", 2);
+        input.open();
+      }
+
+      REQUIRE( server.getRequestCount() <= 3 );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "an on-disk cache of the pages" ) {
+
+    const std::string dir =
+        (std::filesystem::temp_directory_path() / "bethyw-test22").string();
+    std::filesystem::remove_all(dir);
+
+    {
+      InputHttp input(server.url("/popu1009"), dir);
+      Areas areas = Areas();
+      areas.populateFromWelshStatsJSONPages(input, cols);
+    }
+    REQUIRE( server.getNotModifiedCount() == 0 );
+
+    WHEN( "the dataset is fetched again without having changed" ) {
+
+      InputHttp input(server.url("/popu1009"), dir);
+      Areas areas = Areas();
+      areas.populateFromWelshStatsJSONPages(input, cols);
+
+      THEN( "every page is taken from the cache" ) {
+
+        REQUIRE( server.getRequestCount() == 2 * pages );
+        REQUIRE( server.getNotModifiedCount() == pages );
+        REQUIRE( areas.toJSON() == expected.toJSON() );
+
+      } // THEN
+
+    } // WHEN
+
+    WHEN( "a page has changed since it was cached" ) {
+
+      nlohmann::json page;
+      page["odata.metadata"] = "";
+      page["value"] = nlohmann::json::array();
+      const std::string last = "/popu1009?page=" + std::to_string(pages);
+      server.setBody(last, page.dump(), "\"v2\"");
+
+      InputHttp input(server.url("/popu1009"), dir);
+      Areas areas = Areas();
+      areas.populateFromWelshStatsJSONPages(input, cols);
+
+      THEN( "only that page is fetched in full" ) {
+
+        REQUIRE( server.getNotModifiedCount() == pages - 1 );
+        REQUIRE( input.getPageCount() == pages );
+        REQUIRE( areas.toJSON() != expected.toJSON() );
+
+      } // THEN
+
+    } // WHEN
+
+    std::filesystem::remove_all(dir);
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "an HttpConnection is kept alive between requests", "[HttpConnection]" ) {
+
+  StubServer server;
+  server.setBody("/a", "{\"a\":1}");
+  server.setBody("/b", "{\"b\":2}");
+
+  GIVEN( "a connection" ) {
+
+    HttpConnection connection;
+
+    WHEN( "several requests are made to the same server" ) {
+
+      HttpResponse first = connection.get(server.url("/a"));
+      HttpResponse second = connection.get(server.url("/b"));
+      HttpResponse missing = connection.get(server.url("/c"));
+
+      THEN( "they share one connection" ) {
+
+        REQUIRE( first.status == 200 );
+        REQUIRE( first.body == "{\"a\":1}" );
+        REQUIRE( second.status == 200 );
+        REQUIRE( second.body == "{\"b\":2}" );
+        REQUIRE( missing.status == 404 );
+        REQUIRE( connection.getConnectCount() == 1 );
+        REQUIRE( server.getConnectionCount() == 1 );
+
+      } // THEN
+
+      THEN( "the Host header names the server's port" ) {
+
+        const std::string url = server.url("/");
+        REQUIRE( server.getLastHost() ==
+                 url.substr(7, url.size() - 8) );
+
+      } // THEN
+
+    } // WHEN
+
+    WHEN( "the server does not answer within the timeout" ) {
+
+      server.setDelay(500);
+      connection.setTimeout(50);
+
+      THEN( "the request fails rather than waiting" ) {
+
+        REQUIRE_THROWS_AS( connection.get(server.url("/a")),
+                           std::runtime_error );
+
+      } // THEN
+
+    } // WHEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "the link to the next page is found without parsing the page", "[InputHttp]" ) {
+
+  GIVEN( "a page with a link after its rows" ) {
+
+    const std::string page =
+        "{\"value\":[{\"odata.nextLink\":1}],"
+        "\"odata.nextLink\" : \"http://localhost/p?a=1\\u0026page=2\"}";
+
+    THEN( "the last link is found and unescaped" ) {
+
+      REQUIRE( InputHttp::findNextLink(page) == "http://localhost/p?a=1&page=2" );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a page without a link" ) {
+
+    THEN( "an empty string is returned" ) {
+
+      REQUIRE( InputHttp::findNextLink("{\"value\":[]}") == "" );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
@@ -0,0 +1,297 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <zlib.h>
+
+#include "../archive.h"
+#include "../areas.h"
+#include "../bethyw.h"
+#include "../datasets.h"
+#include "../input.h"
+
+#include "testfile.h"
+
+/*
+  Append a little-endian integer to a record of a .zip file.
+*/
+static void appendZipInt(std::string& record, uint32_t value, size_t bytes) {
+  for (size_t i = 0; i < bytes; i++) {
+    record.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+/*
+  Write a .zip file of the given members (name, contents), stored or
+  deflated.
+*/
+static void writeZip(const std::string& path,
+                     const std::vector<std::pair<std::string, std::string>>&
+                         members,
+                     bool deflated) {
+  std::string local, central;
+  for (const auto& member : members) {
+    const std::string& contents = member.second;
+    const uint32_t crc = crc32(0L,
+                               reinterpret_cast<const Bytef*>(contents.data()),
+                               contents.size());
+
+    std::string data = contents;
+    if (deflated) {
+      z_stream z = {};
+      deflateInit2(&z, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+                   Z_DEFAULT_STRATEGY);
+      data.resize(deflateBound(&z, contents.size()));
+      z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(contents.data()));
+      z.avail_in = contents.size();
+      z.next_out = reinterpret_cast<Bytef*>(&data[0]);
+      z.avail_out = data.size();
+      deflate(&z, Z_FINISH);
+      data.resize(z.total_out);
+      deflateEnd(&z);
+    }
+
+    std::string fields;
+    appendZipInt(fields, 20, 2);               // version needed
+    appendZipInt(fields, 0, 2);                // flags
+    appendZipInt(fields, deflated ? 8 : 0, 2); // method
+    appendZipInt(fields, 0, 4);                // time and date
+    appendZipInt(fields, crc, 4);
+    appendZipInt(fields, data.size(), 4);
+    appendZipInt(fields, contents.size(), 4);
+    appendZipInt(fields, member.first.size(), 2);
+    appendZipInt(fields, 0, 2);                // extra field length
+
+    appendZipInt(central, 0x02014b50, 4);
+    appendZipInt(central, 20, 2);              // version made by
+    central += fields;
+    appendZipInt(central, 0, 2);               // comment length
+    appendZipInt(central, 0, 4);               // disk and internal attributes
+    appendZipInt(central, 0, 4);               // external attributes
+    appendZipInt(central, local.size(), 4);
+    central += member.first;
+
+    appendZipInt(local, 0x04034b50, 4);
+    local += fields + member.first + data;
+  }
+
+  std::string end;
+  appendZipInt(end, 0x06054b50, 4);
+  appendZipInt(end, 0, 4);                     // disk numbers
+  appendZipInt(end, members.size(), 2);
+  appendZipInt(end, members.size(), 2);
+  appendZipInt(end, central.size(), 4);
+  appendZipInt(end, local.size(), 4);
+  appendZipInt(end, 0, 2);                     // comment length
+
+  std::ofstream file(path, std::ios::binary);
+  file << local << central << end;
+}
+
+SCENARIO( "the members of a .zip file are read without extracting them", "[InputArchive][ZipArchive]" ) {
+
+  const std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "bethyw-test23";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+
+  const std::string areasCsv = readTestFile("datasets/areas.csv");
+  const std::string popu1009 = readTestFile("datasets/popu1009.json");
+
+  for (const bool deflate : {true, false}) {
+
+    GIVEN( std::string("a .zip file with ") +
+           (deflate ? "deflated" : "stored") + " members in a directory" ) {
+
+      const std::string path = (dir / "bundle.zip").string();
+      writeZip(path,
+               {{"bundle/", ""},
+                {"bundle/datasets/areas.csv", areasCsv},
+                {"bundle/datasets/popu1009.json", popu1009},
+                {"old/bundle/datasets/areas.csv", ""}},
+               deflate);
+
+      REQUIRE( ZipArchive::isArchive(path) );
+
+      WHEN( "the members are listed" ) {
+
+        ZipArchive archive(path);
+
+        THEN( "each member can be found by its name" ) {
+
+          REQUIRE( archive.getMembers().size() == 4 );
+          const ZipMember* member = archive.find("bundle/datasets/areas.csv");
+          REQUIRE( member != nullptr );
+          REQUIRE( member->size == areasCsv.size() );
+          REQUIRE( member->method == (deflate ? 8 : 0) );
+
+        } // THEN
+
+        THEN( "a member can be found by the end of its (shortest) name" ) {
+
+          const ZipMember* member = archive.find("popu1009.json");
+          REQUIRE( member != nullptr );
+          REQUIRE( member->name == "bundle/datasets/popu1009.json" );
+          REQUIRE( archive.find("areas.csv")->name ==
+                   "bundle/datasets/areas.csv" );
+          REQUIRE( archive.find("econ0080.json") == nullptr );
+
+        } // THEN
+
+      } // WHEN
+
+      WHEN( "a member is opened by a path within the .zip file" ) {
+
+        InputArchive input(path + "/datasets/popu1009.json");
+        std::istream& stream = input.open();
+
+        THEN( "its contents are read in full" ) {
+
+          std::stringstream contents;
+          contents << stream.rdbuf();
+          REQUIRE( contents.str() == popu1009 );
+
+        } // THEN
+
+        THEN( "it can be seeked within, as the parsers do" ) {
+
+          stream.seekg(1, stream.beg);
+          REQUIRE( stream.get() == popu1009[1] );
+          stream.seekg(popu1009.size() - 2, stream.beg);
+          REQUIRE( stream.get() == popu1009[popu1009.size() - 2] );
+          stream.seekg(0, stream.beg);
+          REQUIRE( stream.get() == popu1009[0] );
+
+        } // THEN
+
+      } // WHEN
+
+      WHEN( "the data directory is the .zip file" ) {
+
+        auto datasets = std::vector<BethYw::InputFileSource>{
+            BethYw::InputFiles::POPDEN};
+        auto areasFilter = std::unordered_set<std::string>();
+        auto measuresFilter = std::unordered_set<std::string>();
+        auto yearsFilter = std::make_tuple(0u, 0u);
+
+        Areas expected = Areas();
+        BethYw::loadAreas(expected, "datasets/", areasFilter);
+        BethYw::loadDatasets(expected,
+                             "datasets/",
+                             datasets,
+                             areasFilter,
+                             measuresFilter,
+                             yearsFilter);
+
+        Areas areas = Areas();
+        BethYw::loadAreas(areas, path + DIR_SEP, areasFilter);
+        BethYw::loadDatasets(areas,
+                             path + DIR_SEP,
+                             datasets,
+                             areasFilter,
+                             measuresFilter,
+                             yearsFilter);
+
+        THEN( "the data is the same as from the extracted files" ) {
+
+          REQUIRE( areas.size() == expected.size() );
+          REQUIRE( areas.toJSON() == expected.toJSON() );
+
+        } // THEN
+
+        THEN( "it cannot be watched for changes" ) {
+
+          REQUIRE( BethYw::watchDatasets(areas,
+                                         path + DIR_SEP,
+                                         datasets,
+                                         areasFilter,
+                                         measuresFilter,
+                                         yearsFilter,
+                                         AreasMemory::Arena,
+                                         true) == 1 );
+
+        } // THEN
+
+      } // WHEN
+
+    } // GIVEN
+
+  }
+
+  GIVEN( "a .zip file with a member that does not match its CRC-32" ) {
+
+    const std::string path = (dir / "corrupt.zip").string();
+    writeZip(path, {{"areas.csv", areasCsv}}, true);
+
+    // Change the stored CRC-32 in the central directory
+    std::string contents = readTestFile(path);
+    const size_t central = contents.find(std::string("PK\x01\x02", 4));
+    REQUIRE( central != std::string::npos );
+    contents[central + 16] ^= 0x01;
+    {
+      std::ofstream file(path, std::ios::binary);
+      file << contents;
+    }
+
+    InputArchive input(path, "areas.csv");
+
+    THEN( "an exception is thrown once the member has been read" ) {
+
+      std::istream& stream = input.open();
+      std::string line;
+      REQUIRE_THROWS_AS( [&]() { while (std::getline(stream, line)) {} }(),
+                         std::runtime_error );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "paths that are not within a .zip file" ) {
+
+    THEN( "they are not mistaken for one" ) {
+
+      REQUIRE_FALSE( InputArchive::isArchivePath("datasets/areas.csv") );
+      REQUIRE_FALSE( InputArchive::isArchivePath("datasets/areas.csv/x") );
+      REQUIRE_FALSE( InputArchive::isArchivePath("nonexistent/areas.csv") );
+      REQUIRE_THROWS_AS( InputArchive("datasets/areas.csv"),
+                         std::runtime_error );
+
+    } // THEN
+
+    THEN( "a missing member cannot be opened" ) {
+
+      const std::string path = (dir / "empty.zip").string();
+      writeZip(path, {}, true);
+
+      InputArchive input(path, "areas.csv");
+      REQUIRE_THROWS_AS( input.open(), std::runtime_error );
+
+    } // THEN
+
+  } // GIVEN
+
+  std::filesystem::remove_all(dir);
+
+} // SCENARIO
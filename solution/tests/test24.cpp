@@ -0,0 +1,281 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+
+#include <zlib.h>
+
+#include "../areas.h"
+#include "../bethyw.h"
+#include "../compressed.h"
+#include "../datasets.h"
+#include "../input.h"
+#include "../readahead.h"
+
+#include "testfile.h"
+
+/*
+  Write contents to a gzip file, appending a new gzip member if asked.
+*/
+static void writeGzip(const std::string& path,
+                      const std::string& contents,
+                      bool append = false) {
+  gzFile file = gzopen(path.c_str(), append ? "ab" : "wb");
+  gzwrite(file, contents.data(), contents.size());
+  gzclose(file);
+}
+
+SCENARIO( "compressed dataset files are decompressed as they are read", "[InputFile][GzipReader]" ) {
+
+  const std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "bethyw-test24";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+
+  const std::string popu1009 = readTestFile("datasets/popu1009.json");
+
+  GIVEN( "a gzip file" ) {
+
+    const std::string path = (dir / "popu1009.json.gz").string();
+    writeGzip(path, popu1009);
+
+    REQUIRE( detectCompression(path) == Compression::Gzip );
+    REQUIRE( detectCompression("datasets/popu1009.json") ==
+             Compression::None );
+
+    WHEN( "it is opened as an InputFile" ) {
+
+      InputFile input(path);
+      std::istream& stream = input.open();
+
+      THEN( "it is read decompressed" ) {
+
+        std::stringstream contents;
+        contents << stream.rdbuf();
+        REQUIRE( contents.str() == popu1009 );
+
+      } // THEN
+
+      THEN( "it can be seeked within, as the parsers do" ) {
+
+        stream.seekg(1, stream.beg);
+        REQUIRE( stream.get() == popu1009[1] );
+        stream.seekg(popu1009.size() - 1, stream.beg);
+        REQUIRE( stream.get() == popu1009.back() );
+        stream.seekg(0, stream.beg);
+        REQUIRE( stream.get() == popu1009[0] );
+
+      } // THEN
+
+      THEN( "it is parsed as if it were not compressed" ) {
+
+        auto cols = BethYw::InputFiles::POPDEN.COLS;
+
+        Areas expected = Areas();
+        InputFile plain("datasets/popu1009.json");
+        expected.populateFromWelshStatsJSON(plain.open(), cols);
+
+        Areas areas = Areas();
+        areas.populateFromWelshStatsJSON(stream, cols);
+        REQUIRE( areas.toJSON() == expected.toJSON() );
+
+      } // THEN
+
+    } // WHEN
+
+  } // GIVEN
+
+  GIVEN( "a gzip file of several members" ) {
+
+    const std::string path = (dir / "members.gz").string();
+    writeGzip(path, popu1009.substr(0, 1000));
+    writeGzip(path, popu1009.substr(1000), true);
+
+    THEN( "the members are read as one" ) {
+
+      InputFile input(path);
+      std::stringstream contents;
+      contents << input.open().rdbuf();
+      REQUIRE( contents.str() == popu1009 );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a ring of blocks much smaller than the file" ) {
+
+    const std::string path = (dir / "small.gz").string();
+    writeGzip(path, popu1009);
+
+    ReadAheadBuffer buffer(std::make_unique<GzipReader>(path), 100, 2);
+    std::istream stream(&buffer);
+
+    THEN( "every block is read in order" ) {
+
+      std::string contents;
+      std::string line;
+      while (std::getline(stream, line)) {
+        contents += line + "\n";
+      }
+      contents.pop_back();
+      REQUIRE( contents == popu1009 );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a truncated gzip file" ) {
+
+    const std::string path = (dir / "truncated.gz").string();
+    writeGzip(path, popu1009);
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) / 2);
+
+    THEN( "an exception is thrown once the data before the error is read" ) {
+
+      InputFile input(path);
+      std::istream& stream = input.open();
+      std::string line;
+      REQUIRE_THROWS_AS( [&]() { while (std::getline(stream, line)) {} }(),
+                         std::runtime_error );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a truncated or corrupt gzip JSON file" ) {
+
+    const std::string truncated = (dir / "truncated.json.gz").string();
+    writeGzip(truncated, popu1009);
+    std::filesystem::resize_file(truncated,
+                                 std::filesystem::file_size(truncated) - 4);
+
+    // The CRC of the data is in the 4 bytes before the size at the end
+    const std::string corrupt = (dir / "corrupt.json.gz").string();
+    writeGzip(corrupt, popu1009);
+    {
+      std::fstream file(corrupt,
+                        std::ios::in | std::ios::out | std::ios::binary);
+      file.seekp(-8, std::ios::end);
+      file.put('\0').put('\0').put('\0').put('\0');
+    }
+
+    for (const auto& file : {std::make_pair(truncated, "Truncated file"),
+                             std::make_pair(corrupt, "Corrupt file")}) {
+
+      THEN( std::string("parsing it reports the ") + file.second +
+            " error, not that the JSON is invalid" ) {
+
+        InputFile input(file.first);
+        Areas areas = Areas();
+        try {
+          areas.populateFromWelshStatsJSON(input.open(),
+                                           BethYw::InputFiles::POPDEN.COLS);
+          FAIL( "Expected an exception" );
+        } catch (const std::runtime_error& ex) {
+          REQUIRE( std::string(ex.what()).find(
+                       std::string("GzipReader: ") + file.second) !=
+                   std::string::npos );
+        }
+
+      } // THEN
+
+    }
+
+  } // GIVEN
+
+  GIVEN( "a zstd file" ) {
+
+    const std::string path = (dir / "popu1009.json.zst").string();
+    {
+      std::ofstream file(path, std::ios::binary);
+      file << std::string("\x28\xb5\x2f\xfd", 4) << "...";
+    }
+
+    THEN( "it is detected, and reported as unsupported" ) {
+
+      REQUIRE( detectCompression(path) == Compression::Zstd );
+
+      InputFile input(path);
+      REQUIRE_THROWS_AS( input.open(), std::runtime_error );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a data directory of gzip files named .gz" ) {
+
+    const std::string gzDir = (dir / "datasets").string() + DIR_SEP;
+    std::filesystem::create_directories(gzDir);
+    writeGzip(gzDir + "areas.csv.gz", readTestFile("datasets/areas.csv"));
+    writeGzip(gzDir + "popu1009.json.gz", popu1009);
+
+    auto datasets = std::vector<BethYw::InputFileSource>{
+        BethYw::InputFiles::POPDEN};
+    auto measuresFilter = std::unordered_set<std::string>();
+    auto yearsFilter = std::make_tuple(0u, 0u);
+
+    for (const auto& filter : {std::unordered_set<std::string>(),
+                               std::unordered_set<std::string>{"W06000011"}}) {
+
+      auto areasFilter = filter;
+
+      WHEN( std::string("the datasets are loaded ") +
+            (filter.empty() ? "in full" : "with an areas filter") ) {
+
+        Areas expected = Areas();
+        BethYw::loadAreas(expected, "datasets/", areasFilter);
+        BethYw::loadDatasets(expected,
+                             "datasets/",
+                             datasets,
+                             areasFilter,
+                             measuresFilter,
+                             yearsFilter);
+
+        Areas areas = Areas();
+        BethYw::loadAreas(areas, gzDir, areasFilter);
+        BethYw::loadDatasets(areas,
+                             gzDir,
+                             datasets,
+                             areasFilter,
+                             measuresFilter,
+                             yearsFilter);
+
+        THEN( "the data is the same as from the uncompressed files" ) {
+
+          REQUIRE( BethYw::findDataFile(gzDir + "popu1009.json") ==
+                   gzDir + "popu1009.json.gz" );
+          REQUIRE( areas.size() == expected.size() );
+          REQUIRE( areas.toJSON() == expected.toJSON() );
+
+        } // THEN
+
+      } // WHEN
+
+    }
+
+  } // GIVEN
+
+  std::filesystem::remove_all(dir);
+
+} // SCENARIO
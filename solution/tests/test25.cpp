@@ -0,0 +1,173 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+
+#include "../areas.h"
+#include "../bethyw.h"
+#include "../datasets.h"
+#include "../input.h"
+#include "../readahead.h"
+
+/*
+  A BlockReader of a string, which fails after a given number of blocks.
+*/
+class FailingBlockReader : public BlockReader {
+protected:
+  const std::string mContents;
+  size_t mPos;
+  unsigned int mBlocksLeft;
+
+public:
+  FailingBlockReader(const std::string& contents, unsigned int blocks)
+      : mContents(contents), mPos(0), mBlocksLeft(blocks) {}
+
+  virtual size_t read(char* data, size_t size) {
+    if (mBlocksLeft == 0) {
+      throw std::runtime_error("FailingBlockReader: Failed");
+    }
+    mBlocksLeft--;
+
+    const size_t length = std::min(size, mContents.size() - mPos);
+    mContents.copy(data, length, mPos);
+    mPos += length;
+    return length;
+  }
+
+  virtual void rewind() {
+    mPos = 0;
+  }
+};
+
+SCENARIO( "files are read ahead of the parser on a thread of their own", "[ReadAheadBuffer][InputFile]" ) {
+
+  std::string popu1009;
+  {
+    std::ifstream file("datasets/popu1009.json");
+    std::stringstream contents;
+    contents << file.rdbuf();
+    popu1009 = contents.str();
+  }
+
+  GIVEN( "a file double buffered in blocks much smaller than it" ) {
+
+    ReadAheadBuffer buffer(
+        std::make_unique<FileBlockReader>("datasets/popu1009.json"),
+        4096,
+        2);
+    std::istream stream(&buffer);
+
+    THEN( "it is read in full" ) {
+
+      std::stringstream contents;
+      contents << stream.rdbuf();
+      REQUIRE( contents.str() == popu1009 );
+
+    } // THEN
+
+    THEN( "it can be seeked forwards and backwards across blocks" ) {
+
+      stream.seekg(10000, stream.beg);
+      REQUIRE( stream.get() == popu1009[10000] );
+      REQUIRE( stream.tellg() == 10001 );
+      stream.seekg(5000, stream.cur);
+      REQUIRE( stream.get() == popu1009[15001] );
+      stream.seekg(100, stream.beg);
+      REQUIRE( stream.get() == popu1009[100] );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a source that fails part way through" ) {
+
+    ReadAheadBuffer buffer(
+        std::make_unique<FailingBlockReader>(popu1009, 3),
+        100,
+        2);
+    std::istream stream(&buffer);
+    stream.exceptions(std::ios::badbit);
+
+    THEN( "the blocks before the error are read, and then it is thrown" ) {
+
+      char block[300];
+      REQUIRE( stream.read(block, sizeof(block)) );
+      REQUIRE( std::string(block, sizeof(block)) == popu1009.substr(0, 300) );
+      REQUIRE_THROWS_AS( stream.get(), std::runtime_error );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "read-ahead mode" ) {
+
+    InputOptions options;
+    options.readAhead = true;
+    const ReadAheadStats before = getReadAheadStats();
+
+    auto datasets = std::vector<BethYw::InputFileSource>{
+        BethYw::InputFiles::POPDEN};
+    auto areasFilter = std::unordered_set<std::string>();
+    auto measuresFilter = std::unordered_set<std::string>();
+    auto yearsFilter = std::make_tuple(0u, 0u);
+
+    Areas areas = Areas();
+    BethYw::loadAreas(areas, "datasets/", areasFilter, options);
+    InputFile input("datasets/popu1009.json", options);
+    areas.populate(input.open(),
+                   BethYw::InputFiles::POPDEN.PARSER,
+                   BethYw::InputFiles::POPDEN.COLS,
+                   &areasFilter,
+                   &measuresFilter,
+                   &yearsFilter);
+
+    THEN( "the data is the same as when read directly" ) {
+
+      Areas expected = Areas();
+      BethYw::loadAreas(expected, "datasets/", areasFilter);
+      InputFile direct("datasets/popu1009.json");
+      expected.populate(direct.open(),
+                        BethYw::InputFiles::POPDEN.PARSER,
+                        BethYw::InputFiles::POPDEN.COLS,
+                        &areasFilter,
+                        &measuresFilter,
+                        &yearsFilter);
+
+      REQUIRE( areas.toJSON() == expected.toJSON() );
+
+    } // THEN
+
+    THEN( "the blocks read and the time waiting for them are counted" ) {
+
+      const ReadAheadStats after = getReadAheadStats();
+      REQUIRE( after.blocks >= before.blocks + 2 );
+      REQUIRE( after.waits <= after.blocks );
+      REQUIRE( after.waitTime >= before.waitTime );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
@@ -0,0 +1,237 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+
+#include "../areas.h"
+#include "../batch.h"
+#include "../bethyw.h"
+#include "../datasets.h"
+#include "../input.h"
+
+#include "testfile.h"
+
+SCENARIO( "the dataset files are read all at once in a batch", "[FileBatch][InputFile]" ) {
+
+  const std::vector<std::string> paths = {"datasets/popu1009.json",
+                                          "datasets/econ0080.json",
+                                          "datasets/tran0152.json",
+                                          "datasets/missing.json"};
+
+  GIVEN( "a batch of files" ) {
+
+    FileBatch batch(paths);
+
+    THEN( "each file's contents are as read with the blocking path" ) {
+
+      for (size_t i = 0; i < 3; i++) {
+        std::string contents;
+        if (batch.take(paths[i], contents)) {
+          REQUIRE( batch.isUsingUring() );
+          REQUIRE( contents == readTestFile(paths[i]) );
+        } else {
+          REQUIRE_FALSE( batch.isUsingUring() );
+        }
+      }
+
+    } // THEN
+
+    THEN( "the files out of order are the same" ) {
+
+      for (size_t i = 3; i-- > 0;) {
+        std::string contents;
+        if (batch.take(paths[i], contents)) {
+          REQUIRE( contents == readTestFile(paths[i]) );
+        }
+      }
+
+    } // THEN
+
+    THEN( "a file can be taken only once" ) {
+
+      std::string contents;
+      batch.take(paths[0], contents);
+      REQUIRE_FALSE( batch.take(paths[0], contents) );
+
+    } // THEN
+
+    THEN( "a missing file, or one not in the batch, is left to the blocking "
+          "path" ) {
+
+      std::string contents;
+      REQUIRE_FALSE( batch.take(paths[3], contents) );
+      REQUIRE_FALSE( batch.take("datasets/areas.csv", contents) );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a batch of more files than reads can be in flight at once" ) {
+
+    const std::filesystem::path dir =
+        std::filesystem::temp_directory_path() / "bethyw-test26-many";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    std::vector<std::string> many;
+    for (unsigned int i = 0; i < 2000; i++) {
+      many.push_back((dir / ("page" + std::to_string(i) + ".json")).string());
+      std::ofstream file(many.back());
+      file << "{\"page\":" << i << "}";
+    }
+
+    FileBatch batch(many);
+
+    THEN( "every file is read" ) {
+
+      size_t mismatches = 0;
+      for (size_t i = 0; i < many.size(); i++) {
+        std::string contents;
+        if (batch.take(many[i], contents) &&
+            contents != "{\"page\":" + std::to_string(i) + "}") {
+          mismatches++;
+        }
+      }
+      REQUIRE( mismatches == 0 );
+
+    } // THEN
+
+    std::filesystem::remove_all(dir);
+
+  } // GIVEN
+
+  GIVEN( "a batch of an empty file" ) {
+
+    const std::filesystem::path path =
+        std::filesystem::temp_directory_path() / "bethyw-test26-empty.json";
+    { std::ofstream file(path); }
+
+    FileBatch batch({path.string()});
+
+    THEN( "it is read as empty" ) {
+
+      std::string contents = "x";
+      if (batch.take(path.string(), contents)) {
+        REQUIRE( contents.empty() );
+      }
+
+    } // THEN
+
+    std::filesystem::remove(path);
+
+  } // GIVEN
+
+  GIVEN( "a batch that does not use io_uring" ) {
+
+    FileBatch batch(paths, false);
+
+    THEN( "every file is left to the blocking path" ) {
+
+      REQUIRE_FALSE( batch.isUsingUring() );
+      std::string contents;
+      REQUIRE_FALSE( batch.take(paths[0], contents) );
+
+      InputOptions options;
+      options.batch = std::make_shared<FileBatch>(paths, false);
+      InputFile input(paths[0], options);
+      std::stringstream read;
+      read << input.open().rdbuf();
+      REQUIRE( read.str() == readTestFile(paths[0]) );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "batch mode" ) {
+
+    auto datasets = std::vector<BethYw::InputFileSource>{
+        BethYw::InputFiles::POPDEN,
+        BethYw::InputFiles::BIZ,
+        BethYw::InputFiles::AQI,
+        BethYw::InputFiles::COMPLETE_POP};
+
+    for (const auto& filter : {std::unordered_set<std::string>(),
+                               std::unordered_set<std::string>{"W06000011"}}) {
+
+      auto areasFilter = filter;
+      auto measuresFilter = std::unordered_set<std::string>();
+      auto yearsFilter = std::make_tuple(0u, 0u);
+
+      WHEN( std::string("the datasets are loaded ") +
+            (filter.empty() ? "in full" : "with an areas filter") ) {
+
+        // The files are copied, so that they are parsed rather than restored
+        // from the snapshots kept alongside them
+        const std::filesystem::path dir =
+            std::filesystem::temp_directory_path() / "bethyw-test26";
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+        for (const auto& dataset : datasets) {
+          std::filesystem::copy_file("datasets/" + dataset.FILE,
+                                     dir / dataset.FILE);
+        }
+        const std::string batchDir = dir.string() + DIR_SEP;
+
+        InputOptions options;
+        options.batchReads = true;
+        Areas areas = Areas();
+        BethYw::loadAreas(areas, "datasets/", areasFilter);
+        BethYw::loadDatasets(areas,
+                             batchDir,
+                             datasets,
+                             areasFilter,
+                             measuresFilter,
+                             yearsFilter,
+                             nullptr,
+                             options);
+
+        Areas expected = Areas();
+        BethYw::loadAreas(expected, "datasets/", areasFilter);
+        BethYw::loadDatasets(expected,
+                             "datasets/",
+                             datasets,
+                             areasFilter,
+                             measuresFilter,
+                             yearsFilter);
+
+        std::filesystem::remove_all(dir);
+
+        THEN( "the data is the same as when read one at a time" ) {
+
+          REQUIRE( areas.toJSON() == expected.toJSON() );
+
+        } // THEN
+
+        THEN( "the batch is only kept for the import" ) {
+
+          REQUIRE( options.batch == nullptr );
+
+        } // THEN
+
+      } // WHEN
+
+    }
+
+  } // GIVEN
+
+} // SCENARIO
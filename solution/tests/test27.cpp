@@ -0,0 +1,251 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <cstdio>
+#include <istream>
+#include <memory>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "../lib_cxxopts.hpp"
+#include "../lib_cxxopts_argv.hpp"
+
+#include "../areas.h"
+#include "../bethyw.h"
+#include "../datasets.h"
+#include "../input.h"
+#include "../readahead.h"
+
+#include "testfile.h"
+
+/*
+  A stream buffer of a string that, like a pipe, can only be read forwards.
+*/
+class ForwardOnlyBuffer : public std::streambuf {
+protected:
+  std::string mContents;
+
+  virtual pos_type seekoff(off_type off,
+                           std::ios_base::seekdir dir,
+                           std::ios_base::openmode which) {
+    return pos_type(off_type(-1));
+  }
+
+  virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which) {
+    return pos_type(off_type(-1));
+  }
+
+public:
+  explicit ForwardOnlyBuffer(const std::string& contents)
+      : mContents(contents) {
+    setg(&mContents[0], &mContents[0], &mContents[0] + mContents.size());
+  }
+};
+
+SCENARIO( "datasets can be parsed from streams that cannot be seeked within", "[Areas][InputStdin]" ) {
+
+  for (const auto& dataset : {BethYw::InputFiles::POPDEN,
+                              BethYw::InputFiles::COMPLETE_POP}) {
+
+    GIVEN( "the " + dataset.CODE + " dataset in a stream that can only be "
+           "read forwards" ) {
+
+      const std::string contents =
+          readTestFile("datasets/" + dataset.FILE);
+      ForwardOnlyBuffer buffer(contents);
+      std::istream stream(&buffer);
+
+      THEN( "it is parsed the same as from its file" ) {
+
+        Areas expected = Areas();
+        InputFile input("datasets/" + dataset.FILE);
+        expected.populate(input.open(),
+                          dataset.PARSER,
+                          dataset.COLS,
+                          nullptr,
+                          nullptr,
+                          nullptr);
+
+        Areas areas = Areas();
+        REQUIRE_NOTHROW( areas.populate(stream,
+                                        dataset.PARSER,
+                                        dataset.COLS,
+                                        nullptr,
+                                        nullptr,
+                                        nullptr) );
+        REQUIRE( areas.toJSON() == expected.toJSON() );
+
+      } // THEN
+
+    } // GIVEN
+
+  }
+
+  GIVEN( "an empty stream that can only be read forwards" ) {
+
+    ForwardOnlyBuffer buffer("");
+    std::istream stream(&buffer);
+
+    THEN( "it is reported as not open" ) {
+
+      Areas areas = Areas();
+      REQUIRE_THROWS_AS( areas.populate(stream,
+                                        BethYw::WelshStatsJSON,
+                                        BethYw::InputFiles::POPDEN.COLS,
+                                        nullptr,
+                                        nullptr,
+                                        nullptr),
+                         std::runtime_error );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a dataset read from a pipe" ) {
+
+    std::FILE* pipe = popen("cat datasets/popu1009.json", "r");
+    REQUIRE( pipe != nullptr );
+
+    {
+      ReadAheadBuffer buffer(std::make_unique<PipeBlockReader>(pipe, "cat"),
+                             4096,
+                             4);
+      std::istream stream(&buffer);
+      stream.exceptions(std::ios::badbit);
+
+      THEN( "it is parsed the same as from its file" ) {
+
+        auto& cols = BethYw::InputFiles::POPDEN.COLS;
+
+        Areas expected = Areas();
+        InputFile input("datasets/popu1009.json");
+        expected.populateFromWelshStatsJSON(input.open(), cols);
+
+        Areas areas = Areas();
+        areas.populate(stream,
+                       BethYw::WelshStatsJSON,
+                       cols,
+                       nullptr,
+                       nullptr,
+                       nullptr);
+        REQUIRE( areas.toJSON() == expected.toJSON() );
+
+      } // THEN
+    }
+
+    pclose(pipe);
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "the standard input can be given as a dataset", "[BethYw][InputStdin]" ) {
+
+  GIVEN( "the dataset '-' and a format" ) {
+
+    Argv argv({"test", "--datasets", "-,biz", "--format", "POPDEN"});
+    auto** actual_argv = argv.argv();
+    auto argc = argv.argc();
+
+    auto cxxopts = BethYw::cxxoptsSetup();
+    auto args = cxxopts.parse(argc, actual_argv);
+
+    THEN( "the standard input is imported in that format" ) {
+
+      auto datasets = BethYw::parseDatasetsArg(args);
+      REQUIRE( datasets.size() == 2 );
+      REQUIRE( datasets[0].FILE == STDIN_PATH );
+      REQUIRE( datasets[0].CODE == BethYw::InputFiles::POPDEN.CODE );
+      REQUIRE( datasets[0].PARSER == BethYw::InputFiles::POPDEN.PARSER );
+      REQUIRE( datasets[0].COLS == BethYw::InputFiles::POPDEN.COLS );
+      REQUIRE( datasets[1].FILE == BethYw::InputFiles::BIZ.FILE );
+
+      auto source = BethYw::openDataFile(datasets[0].FILE);
+      REQUIRE( dynamic_cast<InputStdin*>(source.get()) != nullptr );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "the dataset '-' without a format" ) {
+
+    Argv argv({"test", "--datasets", "-"});
+    auto** actual_argv = argv.argv();
+    auto argc = argv.argc();
+
+    auto cxxopts = BethYw::cxxoptsSetup();
+    auto args = cxxopts.parse(argc, actual_argv);
+
+    THEN( "an exception is thrown" ) {
+
+      REQUIRE_THROWS_AS( BethYw::parseDatasetsArg(args),
+                         std::invalid_argument );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "the dataset '-' with an unknown format" ) {
+
+    Argv argv({"test", "--datasets", "-", "--format", "csv"});
+    auto** actual_argv = argv.argv();
+    auto argc = argv.argc();
+
+    auto cxxopts = BethYw::cxxoptsSetup();
+    auto args = cxxopts.parse(argc, actual_argv);
+
+    THEN( "an exception is thrown" ) {
+
+      REQUIRE_THROWS_WITH( BethYw::parseDatasetsArg(args),
+                           "No dataset matches key: csv" );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a format without the dataset '-'" ) {
+
+    THEN( "an exception is thrown, as the format would be ignored" ) {
+
+      for (const auto& datasets : {"popden", "all"}) {
+        Argv argv({"test", "--datasets", datasets, "--format", "popden"});
+        auto** actual_argv = argv.argv();
+        auto argc = argv.argc();
+
+        auto cxxopts = BethYw::cxxoptsSetup();
+        auto args = cxxopts.parse(argc, actual_argv);
+
+        REQUIRE_THROWS_WITH( BethYw::parseDatasetsArg(args),
+                             "--format can only be given with the dataset - (the standard input)" );
+      }
+
+      Argv argv({"test", "--format", "popden"});
+      auto** actual_argv = argv.argv();
+      auto argc = argv.argc();
+
+      auto cxxopts = BethYw::cxxoptsSetup();
+      auto args = cxxopts.parse(argc, actual_argv);
+
+      REQUIRE_THROWS_AS( BethYw::parseDatasetsArg(args),
+                         std::invalid_argument );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
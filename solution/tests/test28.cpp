@@ -0,0 +1,416 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <atomic>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "../lib_cxxopts.hpp"
+#include "../lib_cxxopts_argv.hpp"
+
+#include "../areas.h"
+#include "../bethyw.h"
+#include "../datasets.h"
+#include "../pipeline.h"
+
+#include "testfile.h"
+
+/*
+  Parse a dataset from a string with the given number of threads, and return
+  the data as JSON.
+*/
+static std::string populatePipelined(
+    const std::string& contents,
+    const BethYw::InputFileSource& dataset,
+    unsigned int threads,
+    const std::unordered_set<std::string>* areasFilter,
+    const std::unordered_set<std::string>* measuresFilter,
+    const std::tuple<unsigned int, unsigned int>* yearsFilter) {
+  Areas areas = Areas();
+  areas.setIngestThreads(threads);
+
+  if (dataset.PARSER != BethYw::AuthorityCodeCSV) {
+    std::istringstream areasStream(readTestFile("datasets/areas.csv"));
+    areas.populate(areasStream,
+                   BethYw::AuthorityCodeCSV,
+                   BethYw::InputFiles::AREAS.COLS,
+                   nullptr,
+                   nullptr,
+                   nullptr);
+  }
+
+  std::istringstream stream(contents);
+  areas.populate(stream,
+                 dataset.PARSER,
+                 dataset.COLS,
+                 areasFilter,
+                 measuresFilter,
+                 yearsFilter);
+
+  return areas.toJSON();
+}
+
+SCENARIO( "a lock-free queue passes every value on once", "[RingQueue]" ) {
+
+  GIVEN( "a queue of 8 values" ) {
+
+    RingQueue<int> queue(5);
+    REQUIRE( queue.capacity() == 8 );
+
+    THEN( "it is first in first out, and bounded" ) {
+
+      for (int i = 0; i < 8; i++) {
+        REQUIRE( queue.tryPush(int(i)) );
+      }
+      REQUIRE_FALSE( queue.tryPush(8) );
+
+      int value = -1;
+      for (int i = 0; i < 8; i++) {
+        REQUIRE( queue.tryPop(value) );
+        REQUIRE( value == i );
+      }
+      REQUIRE_FALSE( queue.tryPop(value) );
+
+    } // THEN
+
+    THEN( "values pushed by several threads are popped by several threads "
+          "exactly once" ) {
+
+      const int producers = 3;
+      const int consumers = 3;
+      const int perProducer = 20000;
+
+      std::atomic<long long> sum(0);
+      std::atomic<int> popped(0);
+      std::vector<std::thread> threads;
+
+      for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&queue, p]() {
+          for (int i = 0; i < perProducer; i++) {
+            int value = p * perProducer + i;
+            while (!queue.tryPush(std::move(value))) {
+              std::this_thread::yield();
+            }
+          }
+        });
+      }
+
+      for (int c = 0; c < consumers; c++) {
+        threads.emplace_back([&queue, &sum, &popped]() {
+          int value;
+          while (popped < producers * perProducer) {
+            if (queue.tryPop(value)) {
+              sum += value;
+              popped++;
+            } else {
+              std::this_thread::yield();
+            }
+          }
+        });
+      }
+
+      for (auto& thread : threads) {
+        thread.join();
+      }
+
+      const long long n = producers * perProducer;
+      REQUIRE( popped == n );
+      REQUIRE( sum == n * (n - 1) / 2 );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "a data file parsed by a pipeline of threads gives the same data as "
+          "on one thread", "[IngestPipeline][Areas]" ) {
+
+  const std::unordered_set<std::string> noFilter;
+  const std::unordered_set<std::string> areasFilter = {"W06000011", "CARDIFF"};
+  const std::unordered_set<std::string> measuresFilter = {"pop", "rb"};
+  const std::tuple<unsigned int, unsigned int> noYears(0, 0);
+  const std::tuple<unsigned int, unsigned int> years(2005, 2012);
+
+  for (const auto& dataset : {BethYw::InputFiles::AREAS,
+                              BethYw::InputFiles::POPDEN,
+                              BethYw::InputFiles::BIZ,
+                              BethYw::InputFiles::COMPLETE_POP}) {
+
+    GIVEN( "the " + dataset.CODE + " dataset" ) {
+
+      const std::string contents =
+          readTestFile("datasets/" + dataset.FILE);
+
+      THEN( "every row is parsed the same" ) {
+
+        REQUIRE( populatePipelined(contents,
+                                   dataset,
+                                   4,
+                                   &noFilter,
+                                   &noFilter,
+                                   &noYears) ==
+                 populatePipelined(contents,
+                                   dataset,
+                                   1,
+                                   &noFilter,
+                                   &noFilter,
+                                   &noYears) );
+
+      } // THEN
+
+      THEN( "the rows are filtered the same" ) {
+
+        REQUIRE( populatePipelined(contents,
+                                   dataset,
+                                   3,
+                                   &areasFilter,
+                                   &measuresFilter,
+                                   &years) ==
+                 populatePipelined(contents,
+                                   dataset,
+                                   1,
+                                   &areasFilter,
+                                   &measuresFilter,
+                                   &years) );
+
+      } // THEN
+
+    } // GIVEN
+
+  }
+
+  GIVEN( "an AuthorityByYearCSV file of many blocks" ) {
+
+    std::string contents = "AuthorityCode";
+    for (unsigned int year = 1991; year <= 2019; year++) {
+      contents += "," + std::to_string(year);
+    }
+    contents += "\n";
+    for (unsigned int row = 0; row < 6000; row++) {
+      contents += "W060000" + std::to_string(10 + row % 12);
+      for (unsigned int year = 1991; year <= 2019; year++) {
+        contents += (year + row) % 7 == 0
+                        ? ","
+                        : "," + std::to_string(row * 0.25 + year);
+      }
+      contents += "\n";
+    }
+    REQUIRE( contents.size() > 2 * 256 * 1024 );
+
+    THEN( "the rows are added in the same order" ) {
+
+      const auto& dataset = BethYw::InputFiles::COMPLETE_POP;
+      REQUIRE( populatePipelined(contents,
+                                 dataset,
+                                 4,
+                                 nullptr,
+                                 nullptr,
+                                 nullptr) ==
+               populatePipelined(contents,
+                                 dataset,
+                                 1,
+                                 nullptr,
+                                 nullptr,
+                                 nullptr) );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "errors parsing a data file with a pipeline of threads are thrown "
+          "to the caller", "[IngestPipeline][Areas]" ) {
+
+  GIVEN( "a malformed line in an AuthorityByYearCSV file" ) {
+
+    const std::string contents = "AuthorityCode,2001,2002\n"
+                                 "W06000011,1.5,2\n"
+                                 "W06000012,x,2\n";
+
+    THEN( "the line is reported" ) {
+
+      REQUIRE_THROWS_WITH( populatePipelined(contents,
+                                             BethYw::InputFiles::COMPLETE_POP,
+                                             2,
+                                             nullptr,
+                                             nullptr,
+                                             nullptr),
+                           "Areas::populateFromAuthorityByYearCSV: "
+                           "Error on or near line 3" );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "an incomplete WelshStatsJSON file" ) {
+
+    std::string contents = readTestFile("datasets/popu1009.json");
+    contents.resize(contents.size() / 2);
+
+    THEN( "a std::runtime_error exception is thrown" ) {
+
+      REQUIRE_THROWS_AS( populatePipelined(contents,
+                                           BethYw::InputFiles::POPDEN,
+                                           2,
+                                           nullptr,
+                                           nullptr,
+                                           nullptr),
+                         std::runtime_error );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a WelshStatsJSON file whose rows do not match the columns" ) {
+
+    const std::string contents =
+        "{\"value\": [{\"Localauthority_Code\": 1}]}";
+
+    THEN( "a std::out_of_range exception is thrown" ) {
+
+      REQUIRE_THROWS_AS( populatePipelined(contents,
+                                           BethYw::InputFiles::POPDEN,
+                                           2,
+                                           nullptr,
+                                           nullptr,
+                                           nullptr),
+                         std::out_of_range );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "the number of threads to parse with is a setting of each Areas instance", "[Areas][IngestPipeline]" ) {
+
+  GIVEN( "an Areas instance set to parse with several threads" ) {
+
+    Areas threaded = Areas();
+    threaded.setIngestThreads(4);
+
+    THEN( "other Areas instances still parse on one thread" ) {
+
+      REQUIRE( threaded.getIngestThreads() == 4 );
+      REQUIRE( Areas().getIngestThreads() == 1 );
+
+    } // THEN
+
+    THEN( "the setting moves with the data" ) {
+
+      Areas moved = Areas();
+      moved = std::move(threaded);
+      REQUIRE( moved.getIngestThreads() == 4 );
+
+    } // THEN
+
+    THEN( "0 threads is taken as 1" ) {
+
+      threaded.setIngestThreads(0);
+      REQUIRE( threaded.getIngestThreads() == 1 );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "the threads argument must be a number of at least 1", "[BethYw][IngestPipeline]" ) {
+
+  GIVEN( "a number of threads" ) {
+
+    Argv argv({"test", "--threads", "3"});
+    auto** actual_argv = argv.argv();
+    auto argc = argv.argc();
+
+    auto cxxopts = BethYw::cxxoptsSetup();
+    auto args = cxxopts.parse(argc, actual_argv);
+
+    THEN( "it is parsed" ) {
+
+      REQUIRE( BethYw::parseThreadsArg(args) == 3 );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "no threads argument" ) {
+
+    Argv argv({"test"});
+    auto** actual_argv = argv.argv();
+    auto argc = argv.argc();
+
+    auto cxxopts = BethYw::cxxoptsSetup();
+    auto args = cxxopts.parse(argc, actual_argv);
+
+    THEN( "one thread is used" ) {
+
+      REQUIRE( BethYw::parseThreadsArg(args) == 1 );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "0 threads" ) {
+
+    Argv argv({"test", "--threads", "0"});
+    auto** actual_argv = argv.argv();
+    auto argc = argv.argc();
+
+    auto cxxopts = BethYw::cxxoptsSetup();
+    auto args = cxxopts.parse(argc, actual_argv);
+
+    THEN( "an exception is thrown" ) {
+
+      REQUIRE_THROWS_WITH( BethYw::parseThreadsArg(args),
+                           "Invalid input for threads argument" );
+
+    } // THEN
+
+  } // GIVEN
+
+  for (const auto& value : {"abc", "-1", "0"}) {
+
+    GIVEN( std::string("the threads argument ") + value ) {
+
+      Argv argv({"test", "--datasets", "popden", "--threads", value});
+
+      THEN( "the program prints an error and exits with code 1" ) {
+
+        std::ostringstream errors;
+        std::streambuf* original = std::cerr.rdbuf(errors.rdbuf());
+        const int code = BethYw::run(argv.argc(), argv.argv());
+        std::cerr.rdbuf(original);
+
+        REQUIRE( code == 1 );
+        REQUIRE_FALSE( errors.str().empty() );
+
+      } // THEN
+
+    } // GIVEN
+
+  }
+
+} // SCENARIO
@@ -0,0 +1,267 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+
+#include "../areas.h"
+#include "../bethyw.h"
+#include "../datasets.h"
+#include "../scheduler.h"
+
+/*
+  Capture what printAreas() writes to the standard output.
+*/
+static std::string printSchedulerAreas(TaskScheduler& scheduler,
+                                       const Areas& areas,
+                                       bool json) {
+  std::ostringstream output;
+  std::streambuf* original = std::cout.rdbuf(output.rdbuf());
+  BethYw::printAreas(scheduler, areas, json);
+  std::cout.rdbuf(original);
+  return output.str();
+}
+
+SCENARIO( "a work-stealing scheduler runs every task once", "[TaskScheduler]" ) {
+
+  GIVEN( "a scheduler of 4 threads" ) {
+
+    TaskScheduler scheduler(4);
+    REQUIRE( scheduler.getThreads() == 4 );
+
+    THEN( "many tiny tasks are each run once" ) {
+
+      const size_t tasks = 200000;
+      std::vector<unsigned char> runs(tasks, 0);
+      std::atomic<size_t> total(0);
+
+      for (size_t i = 0; i < tasks; i++) {
+        scheduler.submit([&runs, &total, i]() {
+          runs[i]++;
+          total++;
+        });
+      }
+      scheduler.wait();
+
+      REQUIRE( total == tasks );
+      REQUIRE( scheduler.getExecuted() == tasks );
+      REQUIRE( std::count(runs.cbegin(), runs.cend(), 1) == long(tasks) );
+
+    } // THEN
+
+    THEN( "tasks added by tasks are run before wait() returns" ) {
+
+      std::atomic<size_t> total(0);
+      for (size_t i = 0; i < 100; i++) {
+        scheduler.submit([&scheduler, &total]() {
+          for (size_t j = 0; j < 100; j++) {
+            scheduler.submit([&total]() { total++; });
+          }
+        });
+      }
+      scheduler.wait();
+
+      REQUIRE( total == 100 * 100 );
+
+    } // THEN
+
+    THEN( "a task runs after the tasks it depends on" ) {
+
+      std::vector<size_t> order;
+      TaskScheduler::TaskId previous = scheduler.submit([&order]() {
+        order.push_back(0);
+      });
+      for (size_t i = 1; i < 1000; i++) {
+        previous = scheduler.submit([&order, i]() { order.push_back(i); },
+                                    {previous});
+      }
+
+      // A task that fans in many others runs after all of them
+      std::atomic<size_t> done(0);
+      std::vector<TaskScheduler::TaskId> fanIn;
+      for (size_t i = 0; i < 1000; i++) {
+        fanIn.push_back(scheduler.submit([&done]() { done++; }));
+      }
+      size_t doneWhenLast = 0;
+      scheduler.submit([&done, &doneWhenLast]() { doneWhenLast = done; },
+                       fanIn);
+
+      scheduler.wait();
+
+      REQUIRE( order.size() == 1000 );
+      REQUIRE( std::is_sorted(order.cbegin(), order.cend()) );
+      REQUIRE( doneWhenLast == 1000 );
+
+    } // THEN
+
+    THEN( "the error of the first task to fail is thrown, and the tasks that "
+          "depend on it are not run" ) {
+
+      std::atomic<size_t> dependentsRun(0);
+      scheduler.submit([]() {});
+      const auto first = scheduler.submit([]() {
+        throw std::runtime_error("first");
+      });
+      scheduler.submit([]() { throw std::runtime_error("second"); });
+      scheduler.submit([&dependentsRun]() { dependentsRun++; }, {first});
+
+      REQUIRE_THROWS_WITH( scheduler.wait(), "first" );
+      REQUIRE( dependentsRun == 0 );
+
+      // The scheduler can be used again
+      std::atomic<size_t> total(0);
+      scheduler.submit([&total]() { total++; });
+      REQUIRE_NOTHROW( scheduler.wait() );
+      REQUIRE( total == 1 );
+
+    } // THEN
+
+    THEN( "a task cannot depend on a task that does not exist" ) {
+
+      REQUIRE_THROWS_AS( scheduler.submit([]() {}, {42}), std::out_of_range );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a scheduler of 1 thread" ) {
+
+    TaskScheduler scheduler(0);
+    REQUIRE( scheduler.getThreads() == 1 );
+
+    THEN( "the tasks are run on the thread that waits" ) {
+
+      const std::thread::id caller = std::this_thread::get_id();
+      bool sameThread = false;
+      scheduler.submit([&sameThread, caller]() {
+        sameThread = std::this_thread::get_id() == caller;
+      });
+      scheduler.wait();
+
+      REQUIRE( sameThread );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "the datasets are loaded and the areas printed as tasks", "[TaskScheduler][BethYw]" ) {
+
+  auto datasets = std::vector<BethYw::InputFileSource>{
+      BethYw::InputFiles::POPDEN,
+      BethYw::InputFiles::BIZ,
+      BethYw::InputFiles::AQI,
+      BethYw::InputFiles::TRAINS,
+      BethYw::InputFiles::COMPLETE_POPDEN,
+      BethYw::InputFiles::COMPLETE_POP,
+      BethYw::InputFiles::COMPLETE_AREA};
+
+  for (const auto& filter : {std::unordered_set<std::string>(),
+                             std::unordered_set<std::string>{"W06000011",
+                                                             "CAERDYDD"}}) {
+    for (const auto memory : {AreasMemory::Arena, AreasMemory::Default}) {
+
+      auto areasFilter = filter;
+      auto measuresFilter = std::unordered_set<std::string>();
+      auto yearsFilter = std::make_tuple(0u, 0u);
+
+      GIVEN( std::string("the datasets ") +
+             (filter.empty() ? "in full" : "with an areas filter") +
+             (memory == AreasMemory::Arena ? ", imported into arenas"
+                                           : ", imported onto the heap") ) {
+
+        // The files are copied, so that they are parsed rather than restored
+        // from the snapshots kept alongside them
+        const std::filesystem::path dir =
+            std::filesystem::temp_directory_path() / "bethyw-test29";
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+        std::filesystem::copy_file("datasets/areas.csv", dir / "areas.csv");
+        for (const auto& dataset : datasets) {
+          std::filesystem::copy_file("datasets/" + dataset.FILE,
+                                     dir / dataset.FILE);
+        }
+        const std::string tasksDir = dir.string() + DIR_SEP;
+
+        TaskScheduler scheduler(4);
+        Areas areas = Areas(memory);
+        BethYw::loadAreasAndDatasets(scheduler,
+                                     areas,
+                                     tasksDir,
+                                     datasets,
+                                     areasFilter,
+                                     measuresFilter,
+                                     yearsFilter,
+                                     memory);
+
+        TaskScheduler serial(1);
+        Areas expected = Areas();
+        BethYw::loadAreasAndDatasets(serial,
+                                     expected,
+                                     "datasets/",
+                                     datasets,
+                                     areasFilter,
+                                     measuresFilter,
+                                     yearsFilter);
+
+        std::filesystem::remove_all(dir);
+
+        THEN( "the data is the same as when loaded one at a time" ) {
+
+          REQUIRE( areas.size() == expected.size() );
+          REQUIRE( areas.toJSON() == expected.toJSON() );
+
+        } // THEN
+
+        THEN( "the areas are printed the same" ) {
+
+          REQUIRE( printSchedulerAreas(scheduler, areas, true) ==
+                   printSchedulerAreas(serial, expected, true) );
+          REQUIRE( printSchedulerAreas(scheduler, areas, false) ==
+                   printSchedulerAreas(serial, expected, false) );
+
+        } // THEN
+
+      } // GIVEN
+
+    }
+
+  }
+
+  GIVEN( "no areas" ) {
+
+    TaskScheduler scheduler(4);
+    Areas areas = Areas();
+
+    THEN( "an empty JSON object is printed" ) {
+
+      REQUIRE( printSchedulerAreas(scheduler, areas, true) == "{}\n" );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
@@ -0,0 +1,218 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "../lib_json.hpp"
+
+#include "../areas.h"
+#include "../cell.h"
+#include "../datasets.h"
+
+/*
+  Parse a WelshStatsJSON file with the columns of the POPDEN dataset, with
+  the given number of threads, and return the data as JSON.
+*/
+static std::string populateCellsJSON(const std::string& contents,
+                                     unsigned int threads) {
+  Areas areas = Areas();
+  areas.setIngestThreads(threads);
+
+  std::istringstream stream(contents);
+  areas.populate(stream,
+                 BethYw::WelshStatsJSON,
+                 BethYw::InputFiles::POPDEN.COLS,
+                 nullptr,
+                 nullptr,
+                 nullptr);
+
+  return areas.toJSON();
+}
+
+/*
+  A row of a POPDEN-like WelshStatsJSON file, with the given year and value
+  (as they would appear in the file).
+*/
+static std::string cellsJSONRow(const std::string& year,
+                                const std::string& measure,
+                                const std::string& value) {
+  return "{\"Localauthority_Code\": \"W06000011\", "
+         "\"Localauthority_ItemName_ENG\": \"Swansea\", "
+         "\"Measure_Code\": \"" + measure + "\", "
+         "\"Measure_ItemName_ENG\": \"" + measure + "\", "
+         "\"Year_Code\": " + year + ", "
+         "\"Data\": " + value + "}";
+}
+
+SCENARIO( "the cells of a data file are decoded as numbers", "[Cell]" ) {
+
+  GIVEN( "the text of cells" ) {
+
+    double value = -1;
+    unsigned int year = 0;
+
+    THEN( "numbers are decoded, other than spaces around them" ) {
+
+      REQUIRE( decodeValueCell("12.5", value) == CellState::Value );
+      REQUIRE( value == 12.5 );
+      REQUIRE( decodeValueCell(" -3e2 ", value) == CellState::Value );
+      REQUIRE( value == -300 );
+      REQUIRE( decodeValueCell("+7", value) == CellState::Value );
+      REQUIRE( value == 7 );
+      REQUIRE( decodeValueCell("99.9999999999999999", value) ==
+               CellState::Value );
+      REQUIRE( value == std::stod("99.9999999999999999") );
+
+      REQUIRE( decodeYearCell("1991", year) == CellState::Value );
+      REQUIRE( year == 1991 );
+
+    } // THEN
+
+    THEN( "empty cells and placeholders are missing" ) {
+
+      REQUIRE( decodeValueCell("", value) == CellState::Missing );
+      REQUIRE( decodeValueCell(" ", value) == CellState::Missing );
+      REQUIRE( decodeValueCell(".", value) == CellState::Missing );
+      REQUIRE( decodeValueCell("..", value) == CellState::Missing );
+      REQUIRE( decodeYearCell("..", year) == CellState::Missing );
+      REQUIRE( value == -1 );
+
+    } // THEN
+
+    THEN( "anything else is invalid" ) {
+
+      REQUIRE( decodeValueCell("x", value) == CellState::Invalid );
+      REQUIRE( decodeValueCell("1.5x", value) == CellState::Invalid );
+      REQUIRE( decodeValueCell("...", value) == CellState::Invalid );
+      REQUIRE( decodeValueCell("+-1", value) == CellState::Invalid );
+      REQUIRE( decodeValueCell("1e999", value) == CellState::Invalid );
+      REQUIRE( decodeYearCell("2011-12", year) == CellState::Invalid );
+      REQUIRE( decodeYearCell("-1", year) == CellState::Invalid );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "JSON cells" ) {
+
+    double value = -1;
+    unsigned int year = 0;
+
+    THEN( "numbers and numbers quoted as strings are decoded" ) {
+
+      REQUIRE( decodeJSONValueCell(nlohmann::json(2.5), value) ==
+               CellState::Value );
+      REQUIRE( value == 2.5 );
+      REQUIRE( decodeJSONValueCell(nlohmann::json(-4), value) ==
+               CellState::Value );
+      REQUIRE( value == -4 );
+      REQUIRE( decodeJSONValueCell(nlohmann::json(4u), value) ==
+               CellState::Value );
+      REQUIRE( value == 4 );
+      REQUIRE( decodeJSONValueCell(nlohmann::json("8.25"), value) ==
+               CellState::Value );
+      REQUIRE( value == 8.25 );
+
+      REQUIRE( decodeJSONYearCell(nlohmann::json("2001"), year) ==
+               CellState::Value );
+      REQUIRE( year == 2001 );
+      REQUIRE( decodeJSONYearCell(nlohmann::json(2002), year) ==
+               CellState::Value );
+      REQUIRE( year == 2002 );
+
+    } // THEN
+
+    THEN( "null values and placeholders are missing" ) {
+
+      REQUIRE( decodeJSONValueCell(nlohmann::json(), value) ==
+               CellState::Missing );
+      REQUIRE( decodeJSONValueCell(nlohmann::json(".."), value) ==
+               CellState::Missing );
+      REQUIRE( decodeJSONYearCell(nlohmann::json("."), year) ==
+               CellState::Missing );
+
+    } // THEN
+
+    THEN( "a null year, and cells of other types, are invalid" ) {
+
+      REQUIRE( decodeJSONYearCell(nlohmann::json(), year) ==
+               CellState::Invalid );
+      REQUIRE( decodeJSONYearCell(nlohmann::json(-1), year) ==
+               CellState::Invalid );
+      REQUIRE( decodeJSONValueCell(nlohmann::json(true), value) ==
+               CellState::Invalid );
+      REQUIRE( decodeJSONValueCell(nlohmann::json::array(), value) ==
+               CellState::Invalid );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "a WelshStatsJSON file with missing values is imported without "
+          "them", "[Cell][Areas]" ) {
+
+  GIVEN( "a file of numbers, quoted numbers, and placeholders" ) {
+
+    const std::string contents =
+        "{\"value\": [" +
+        cellsJSONRow("\"2001\"", "Hectare", "1.5") + ", " +
+        cellsJSONRow("\"2002\"", "Hectare", "\"2.5\"") + ", " +
+        cellsJSONRow("\"2003\"", "Hectare", "\"..\"") + ", " +
+        cellsJSONRow("\"..\"", "Hectare", "4") + ", " +
+        cellsJSONRow("2004", "Hectare", "null") + ", " +
+        cellsJSONRow("\"2005\"", "Density", "\".\"") +
+        "]}";
+
+    for (unsigned int threads : {1u, 2u}) {
+
+      WHEN( "it is parsed with " + std::to_string(threads) + " thread(s)" ) {
+
+        const std::string json = populateCellsJSON(contents, threads);
+
+        THEN( "only the values that are present are imported" ) {
+
+          REQUIRE( json == "{\"W06000011\":{"
+                           "\"measures\":{"
+                           "\"hectare\":{\"2001\":1.5,\"2002\":2.5}},"
+                           "\"names\":{\"eng\":\"Swansea\"}}}" );
+
+        } // THEN
+
+      } // WHEN
+
+    }
+
+  } // GIVEN
+
+  GIVEN( "a file with a value that is not a number" ) {
+
+    const std::string contents =
+        "{\"value\": [" + cellsJSONRow("\"2001\"", "Hectare", "\"x\"") + "]}";
+
+    THEN( "a std::out_of_range exception is thrown" ) {
+
+      REQUIRE_THROWS_AS( populateCellsJSON(contents, 1), std::out_of_range );
+      REQUIRE_THROWS_AS( populateCellsJSON(contents, 2), std::out_of_range );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
@@ -0,0 +1,257 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../lib_json.hpp"
+
+#include "../projection.h"
+
+/*
+  Read a row from a string with a projection of the given columns.
+*/
+static std::vector<nlohmann::json> readProjectedRow(
+    const std::vector<std::string>& columns,
+    const std::string& text) {
+  JSONProjection projection(columns);
+  std::vector<nlohmann::json> row;
+  size_t pos = 0;
+  projection.readRow(text, pos, row);
+  return row;
+}
+
+SCENARIO( "a JSONProjection finds its columns with a perfect hash",
+          "[JSONProjection]" ) {
+
+  GIVEN( "the columns of a dataset" ) {
+
+    const std::vector<std::string> columns = {"Localauthority_Code",
+                                              "Localauthority_ItemName_ENG",
+                                              "Year_Code",
+                                              "Data",
+                                              "Measure_Code",
+                                              "Measure_ItemName_ENG"};
+    JSONProjection projection(columns);
+
+    THEN( "each column is found at its index" ) {
+
+      REQUIRE( projection.size() == columns.size() );
+      for (size_t i = 0; i < columns.size(); i++) {
+        REQUIRE( projection.find(columns[i]) == i );
+      }
+
+    } // THEN
+
+    THEN( "other keys are not found" ) {
+
+      REQUIRE( projection.find("RowKey") == JSONProjection::NPOS );
+      REQUIRE( projection.find("Data ") == JSONProjection::NPOS );
+      REQUIRE( projection.find("") == JSONProjection::NPOS );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "a JSONProjection reads only its columns from a row",
+          "[JSONProjection]" ) {
+
+  GIVEN( "a row with columns that are not needed" ) {
+
+    const std::string text =
+        "{\"SortOrder\": 12, \"Hierarchy\": {\"a\": [1, \"]}\", {}]}, "
+        "\"Name\": \"Caerdydd \\\"\\u00e2\\ud83d\\ude00\\\\\", "
+        "\"ItemNotes\": \"\\q not decoded\", \"Data\": -2.5e1, "
+        "\"Count\": 18446744073709551615, \"Flag\": true, "
+        "\"Nothing\": null, \"List\": [1, 2]} ";
+
+    THEN( "the values of the columns are decoded, and the rest skipped" ) {
+
+      const auto row = readProjectedRow(
+          {"Name", "Data", "Count", "Flag", "Nothing", "List", "Missing"},
+          text);
+
+      REQUIRE( row.size() == 7 );
+      REQUIRE( row[0] == "Caerdydd \"\u00e2\U0001F600\\" );
+      REQUIRE( row[1] == -25.0 );
+      REQUIRE( row[1].is_number_float() );
+      REQUIRE( row[2] == 18446744073709551615ULL );
+      REQUIRE( row[2].is_number_unsigned() );
+      REQUIRE( row[3] == true );
+      REQUIRE( row[4].is_null() );
+      REQUIRE( row[5] == nlohmann::json::array({1, 2}) );
+      REQUIRE( row[6].is_null() );
+
+    } // THEN
+
+    THEN( "a column given twice is read into both" ) {
+
+      const auto row = readProjectedRow({"Data", "Data"}, text);
+
+      REQUIRE( row[0] == -25.0 );
+      REQUIRE( row[1] == -25.0 );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "rows read one after the other" ) {
+
+    JSONProjection projection({"a", "b"});
+    std::vector<nlohmann::json> row;
+    size_t pos = 0;
+
+    THEN( "a column missing from a row is null" ) {
+
+      const std::string text = "{\"a\": \"x\", \"b\": 1} {\"a\": \"y\"} [1]";
+
+      projection.readRow(text, pos, row);
+      REQUIRE( row[0] == "x" );
+      REQUIRE( row[1] == 1 );
+
+      projection.readRow(text, pos, row);
+      REQUIRE( row[0] == "y" );
+      REQUIRE( row[1].is_null() );
+
+      projection.readRow(text, pos, row);
+      REQUIRE( row[0].is_null() );
+      REQUIRE( row[1].is_null() );
+      REQUIRE( pos == text.size() );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "rows that are not valid JSON" ) {
+
+    THEN( "a std::invalid_argument exception is thrown" ) {
+
+      for (const std::string text : {"{\"a\": \"x}",
+                                     "{\"b\": [1, {]}",
+                                     "{\"b\": [1, 2}",
+                                     "{\"a\" 1}",
+                                     "{\"a\": 1 \"b\": 2}",
+                                     "{\"a\": 01}",
+                                     "{\"a\": tru}",
+                                     "{\"a\": \"\\ud800\"}",
+                                     "{\"a\": \"\\x\"}",
+                                     "{\"a\": 1"}) {
+        REQUIRE_THROWS_AS( readProjectedRow({"a"}, text),
+                           std::invalid_argument );
+      }
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "a JSONRowReader reads the rows of a WelshStatsJSON document",
+          "[JSONRowReader]" ) {
+
+  GIVEN( "a page of a dataset with a link to the next page" ) {
+
+    const std::string text =
+        "{\"odata.metadata\": {\"x\": [\"value\"]}, "
+        "\"value\": [{\"a\": 1}, {\"a\": 2}, {}], "
+        "\"odata.nextLink\": \"https://example.com/?\\u0026page=2\"}\n";
+
+    JSONProjection projection({"a"});
+    JSONRowReader reader(projection, text);
+    std::vector<nlohmann::json> row;
+
+    THEN( "each row is read, and then the link" ) {
+
+      REQUIRE( reader.next(row) );
+      REQUIRE( row[0] == 1 );
+      REQUIRE( reader.next(row) );
+      REQUIRE( row[0] == 2 );
+      REQUIRE( reader.next(row) );
+      REQUIRE( row[0].is_null() );
+      REQUIRE_FALSE( reader.next(row) );
+      REQUIRE_FALSE( reader.next(row) );
+      REQUIRE( reader.getNextLink() == "https://example.com/?&page=2" );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "popu1009.json" ) {
+
+    std::ifstream file("datasets/popu1009.json");
+    std::stringstream contents;
+    contents << file.rdbuf();
+    const std::string text = contents.str();
+
+    const std::vector<std::string> columns = {"Localauthority_Code",
+                                              "Localauthority_ItemName_ENG",
+                                              "Measure_Code",
+                                              "Measure_ItemName_ENG",
+                                              "Year_Code",
+                                              "Data"};
+
+    THEN( "the columns of every row are the same as when parsed in full" ) {
+
+      const nlohmann::json j = nlohmann::json::parse(text);
+      JSONProjection projection(columns);
+      JSONRowReader reader(projection, text);
+      std::vector<nlohmann::json> row;
+
+      size_t rows = 0;
+      size_t mismatches = 0;
+      for (const auto& expected : j["value"]) {
+        if (!reader.next(row)) {
+          break;
+        }
+        for (size_t i = 0; i < columns.size(); i++) {
+          if (row[i] != expected[columns[i]]) {
+            mismatches++;
+          }
+        }
+        rows++;
+      }
+
+      REQUIRE_FALSE( reader.next(row) );
+      REQUIRE( rows == j["value"].size() );
+      REQUIRE( mismatches == 0 );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a document that ends part way through" ) {
+
+    const std::string text = "{\"value\": [{\"a\": 1}, {\"a\": ";
+
+    THEN( "a std::invalid_argument exception is thrown" ) {
+
+      JSONProjection projection({"a"});
+      JSONRowReader reader(projection, text);
+      std::vector<nlohmann::json> row;
+
+      REQUIRE( reader.next(row) );
+      REQUIRE_THROWS_AS( reader.next(row), std::invalid_argument );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
@@ -0,0 +1,295 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../areas.h"
+#include "../datasets.h"
+#include "../structural.h"
+
+#include "testfile.h"
+
+/*
+  Find the structural characters of text one byte at a time, as the parsers
+  did before the StructuralScanner. As with the scanner, a backslash escapes
+  a quote after it even outside a string (which is not valid JSON).
+*/
+static std::vector<size_t> scanBytes(const std::string& text,
+                                     ScanFormat format) {
+  std::vector<size_t> positions;
+  bool inString = false;
+  bool escaped = false;
+
+  for (size_t i = 0; i < text.size(); i++) {
+    const char c = text[i];
+    if (format == ScanFormat::CSV) {
+      if (c == ',' || c == '\n') {
+        positions.push_back(i);
+      }
+      continue;
+    }
+
+    if (c == '"' && !escaped) {
+      positions.push_back(i);
+      inString = !inString;
+    } else if (!inString && (c == '{' || c == '}' || c == '[' || c == ']' ||
+                             c == ':' || c == ',')) {
+      positions.push_back(i);
+    }
+    escaped = c == '\\' && !escaped;
+  }
+
+  return positions;
+}
+
+/*
+  Find the structural characters of text with a kernel, giving it to the
+  scanner in parts of the given size (or all at once, if 0).
+*/
+static std::vector<size_t> scanKernel(const std::string& text,
+                                      ScanFormat format,
+                                      ScanKernel kernel,
+                                      size_t part) {
+  StructuralScanner scanner(format, kernel);
+  std::vector<size_t> positions;
+  if (part == 0) {
+    part = text.size();
+  }
+  for (size_t begin = 0; begin < text.size(); begin += part) {
+    scanner.scan(text.data() + begin,
+                 std::min(part, text.size() - begin),
+                 begin,
+                 positions);
+  }
+  return positions;
+}
+
+/*
+  The kernels this CPU supports.
+*/
+static std::vector<ScanKernel> supportedKernels() {
+  std::vector<ScanKernel> kernels;
+  for (auto kernel : {ScanKernel::Scalar, ScanKernel::SSE2, ScanKernel::AVX2}) {
+    if (StructuralScanner::isSupported(kernel)) {
+      kernels.push_back(kernel);
+    }
+  }
+  return kernels;
+}
+
+/*
+  Generate text of random characters, mostly the structural ones (and
+  backslashes, in runs of different lengths).
+*/
+static std::string generateScannerFuzz(std::mt19937& rng, size_t length) {
+  const std::string alphabet = "\"\"\\\\{}[]:,\n abc019.-";
+  std::uniform_int_distribution<size_t> pick(0, alphabet.size() - 1);
+
+  std::string text;
+  for (size_t i = 0; i < length; i++) {
+    text.push_back(alphabet[pick(rng)]);
+  }
+  return text;
+}
+
+SCENARIO( "a StructuralScanner finds the same characters with every kernel",
+          "[StructuralScanner]" ) {
+
+  const auto kernels = supportedKernels();
+  REQUIRE( StructuralScanner::isSupported(StructuralScanner::bestKernel()) );
+
+  GIVEN( "the datasets" ) {
+
+    for (const auto& dataset : {BethYw::InputFiles::AREAS,
+                                BethYw::InputFiles::POPDEN,
+                                BethYw::InputFiles::BIZ,
+                                BethYw::InputFiles::AQI,
+                                BethYw::InputFiles::TRAINS,
+                                BethYw::InputFiles::COMPLETE_POPDEN}) {
+
+      const std::string text =
+          readTestFile("datasets/" + dataset.FILE);
+      const ScanFormat format = dataset.PARSER == BethYw::WelshStatsJSON
+                                    ? ScanFormat::JSON
+                                    : ScanFormat::CSV;
+      const auto expected = scanBytes(text, format);
+
+      THEN( "the positions in " + dataset.FILE + " are the same as when "
+            "scanned a byte at a time" ) {
+
+        REQUIRE_FALSE( expected.empty() );
+        for (auto kernel : kernels) {
+          REQUIRE( scanKernel(text, format, kernel, 0) == expected );
+          REQUIRE( scanKernel(text, format, kernel, 1000) == expected );
+        }
+
+      } // THEN
+
+    }
+
+  } // GIVEN
+
+  GIVEN( "random text" ) {
+
+    std::mt19937 rng(462);
+    std::uniform_int_distribution<size_t> lengths(0, 700);
+    std::uniform_int_distribution<size_t> parts(1, 130);
+
+    THEN( "the positions are the same as when scanned a byte at a time, "
+          "however the text is split" ) {
+
+      size_t mismatches = 0;
+      for (unsigned int i = 0; i < 2000; i++) {
+        const std::string text = generateScannerFuzz(rng, lengths(rng));
+        const size_t part = parts(rng);
+
+        for (auto format : {ScanFormat::JSON, ScanFormat::CSV}) {
+          const auto expected = scanBytes(text, format);
+          for (auto kernel : kernels) {
+            if (scanKernel(text, format, kernel, 0) != expected ||
+                scanKernel(text, format, kernel, part) != expected) {
+              mismatches++;
+            }
+          }
+        }
+      }
+
+      REQUIRE( mismatches == 0 );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a string that ends part way through" ) {
+
+    StructuralScanner scanner(ScanFormat::JSON);
+    std::vector<size_t> positions;
+
+    THEN( "the scanner knows it is in the string, until it ends" ) {
+
+      scanner.scan("{\"a\\", 4, 0, positions);
+      REQUIRE( scanner.isInString() );
+      scanner.scan("\"\"}", 3, 4, positions);
+      REQUIRE_FALSE( scanner.isInString() );
+      REQUIRE( positions == std::vector<size_t>{0, 1, 5, 6} );
+
+      scanner.scan("\"", 1, 7, positions);
+      REQUIRE( scanner.isInString() );
+      scanner.reset();
+      REQUIRE_FALSE( scanner.isInString() );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "data files split with a StructuralScanner are parsed the same as "
+          "on one thread", "[StructuralScanner][IngestPipeline]" ) {
+
+  GIVEN( "random AuthorityByYearCSV files" ) {
+
+    std::mt19937 rng(46);
+    std::uniform_int_distribution<int> cellKind(0, 5);
+
+    THEN( "the data is the same" ) {
+
+      size_t mismatches = 0;
+      for (unsigned int file = 0; file < 20; file++) {
+        std::string contents = "AuthorityCode,2001,2002,2003\n";
+        for (unsigned int row = 0; row < 500 + file * 37; row++) {
+          contents += "W060000" + std::to_string(10 + row % 13);
+          for (unsigned int col = 0; col < 3; col++) {
+            switch (cellKind(rng)) {
+              case 0:
+                contents += ",";
+                break;
+
+              case 1:
+                contents += ",..";
+                break;
+
+              default:
+                contents += "," + std::to_string(row * 1.5 + col);
+                break;
+            }
+          }
+          contents += "\n";
+        }
+
+        std::string json[2];
+        for (unsigned int threads : {1u, 3u}) {
+          Areas areas = Areas();
+          areas.setIngestThreads(threads);
+          std::istringstream stream(contents);
+          areas.populate(stream,
+                         BethYw::AuthorityByYearCSV,
+                         BethYw::InputFiles::COMPLETE_POP.COLS,
+                         nullptr,
+                         nullptr,
+                         nullptr);
+          json[threads == 1 ? 0 : 1] = areas.toJSON();
+        }
+
+        if (json[0] != json[1] ||
+            json[0].find("W06000010") == std::string::npos) {
+          mismatches++;
+        }
+      }
+
+      REQUIRE( mismatches == 0 );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "the WelshStatsJSON datasets" ) {
+
+    for (const auto& dataset : {BethYw::InputFiles::AQI,
+                                BethYw::InputFiles::TRAINS,
+                                BethYw::InputFiles::COMPLETE_POPDEN}) {
+
+      const std::string contents =
+          readTestFile("datasets/" + dataset.FILE);
+
+      THEN( "the rows of " + dataset.FILE + " are the same" ) {
+
+        std::string json[2];
+        for (unsigned int threads : {1u, 2u}) {
+          Areas areas = Areas();
+          areas.setIngestThreads(threads);
+          std::istringstream stream(contents);
+          areas.populate(stream,
+                         dataset.PARSER,
+                         dataset.COLS,
+                         nullptr,
+                         nullptr,
+                         nullptr);
+          json[threads - 1] = areas.toJSON();
+        }
+
+        REQUIRE( json[0] == json[1] );
+
+      } // THEN
+
+    }
+
+  } // GIVEN
+
+} // SCENARIO
@@ -0,0 +1,301 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "../areas.h"
+#include "../datasets.h"
+#include "../valuefilter.h"
+
+/*
+  Import a dataset with a value filter, on the given number of threads.
+*/
+static std::string importWhere(const BethYw::InputFileSource& dataset,
+                               const std::string& contents,
+                               const ValueFilter* filter,
+                               unsigned int threads) {
+  Areas areas = Areas();
+  areas.setIngestThreads(threads);
+  std::istringstream stream(contents);
+  areas.populate(stream,
+                 dataset.PARSER,
+                 dataset.COLS,
+                 nullptr,
+                 nullptr,
+                 nullptr,
+                 filter);
+  return areas.toJSON();
+}
+
+SCENARIO( "a ValueFilter can be compiled from a --where expression",
+          "[ValueFilter]" ) {
+
+  GIVEN( "valid expressions" ) {
+
+    THEN( "the comparisons of values and of aggregates are split" ) {
+
+      ValueFilter filter("POP > 100000 and (dens >= 5e2 || value < 0)");
+      REQUIRE_FALSE( filter.empty() );
+      REQUIRE( filter.hasRowPredicate() );
+      REQUIRE_FALSE( filter.hasSeriesPredicate() );
+      REQUIRE( filter.describeRows() ==
+               "(pop > 100000 and (dens >= 500 or value < 0))" );
+
+      ValueFilter split("pop > 1 && max(dens) > 500 and value != 0");
+      REQUIRE( split.describeRows() == "(pop > 1 and value != 0)" );
+      REQUIRE( split.describeSeries() == "max(dens) > 500" );
+
+    } // THEN
+
+    THEN( "the examples in the documentation are valid" ) {
+
+      for (const auto& expression :
+               {"(pop > 100000 or dens >= 500) and max(dens) > 500",
+                "pop > 100000 and max(dens) >= 500",
+                "pop > 100000 and max(dens) > 500",
+                "avg(pop, 2011, 2015) > 100000"}) {
+        REQUIRE_NOTHROW( ValueFilter(expression) );
+      }
+
+    } // THEN
+
+    THEN( "equivalent expressions are described the same" ) {
+
+      REQUIRE( ValueFilter("pop>100000").describeRows() ==
+               ValueFilter("  Pop  >  1e5 ").describeRows() );
+
+    } // THEN
+
+    THEN( "an empty filter keeps everything" ) {
+
+      ValueFilter filter;
+      REQUIRE( filter.empty() );
+      REQUIRE( ValueFilter("  ").empty() );
+      REQUIRE( filter.keepRow("pop", -1) );
+      REQUIRE( filter.getRowMeasures().empty() );
+      REQUIRE( filter.getRowsPruned() == 0 );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "invalid expressions" ) {
+
+    THEN( "a std::invalid_argument exception is thrown" ) {
+
+      for (const auto& expression : {"pop >",
+                                     "pop 5",
+                                     "(pop > 5",
+                                     "median(pop) > 5",
+                                     "pop > 5 pop",
+                                     "pop ! 5",
+                                     "pop > 5 or max(pop) > 5"}) {
+        REQUIRE_THROWS_AS( ValueFilter(expression), std::invalid_argument );
+      }
+
+      std::string deep;
+      for (unsigned int i = 0; i < ValueFilter::MAX_DEPTH + 1; i++) {
+        deep += "(pop > 1 or ";
+      }
+      deep += "pop > 1" + std::string(ValueFilter::MAX_DEPTH + 1, ')');
+      REQUIRE_THROWS_AS( ValueFilter(deep), std::invalid_argument );
+
+    } // THEN
+
+    THEN( "the message gives the character at which it is not valid" ) {
+
+      try {
+        ValueFilter filter("pop > x");
+        FAIL( "Expected an exception" );
+      } catch (const std::invalid_argument& ex) {
+        REQUIRE( std::string(ex.what()).find("at character 7") !=
+                 std::string::npos );
+      }
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "a ValueFilter keeps the rows and series that match",
+          "[ValueFilter]" ) {
+
+  GIVEN( "a comparison of one measure's values" ) {
+
+    ValueFilter filter("pop > 100");
+
+    THEN( "only the rows of that measure that compare are kept" ) {
+
+      REQUIRE( filter.keepRow("pop", 101) );
+      REQUIRE_FALSE( filter.keepRow("pop", 100) );
+      REQUIRE_FALSE( filter.keepRow("dens", 1000) );
+      REQUIRE( filter.getRowsPruned() == 2 );
+      REQUIRE( filter.getRowMeasures() ==
+               std::unordered_set<std::string>{"pop"} );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a comparison of every measure's values" ) {
+
+    ValueFilter filter("value < 0 or pop = 5");
+
+    THEN( "the rows of any measure may be kept" ) {
+
+      REQUIRE( filter.keepRow("dens", -1) );
+      REQUIRE( filter.keepRow("pop", 5) );
+      REQUIRE_FALSE( filter.keepRow("dens", 5) );
+      REQUIRE( filter.getRowMeasures().empty() );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "comparisons of aggregates" ) {
+
+    Measure dens("dens", "Density");
+    dens.setValue(2000, 100);
+    dens.setValue(2001, 600);
+    Measure pop("pop", "Population");
+    pop.setValue(2000, 10);
+
+    THEN( "the series are kept by their aggregates" ) {
+
+      REQUIRE( ValueFilter("max(dens) > 500").keepSeries(dens) );
+      REQUIRE_FALSE( ValueFilter("min(dens) > 500").keepSeries(dens) );
+      REQUIRE( ValueFilter("avg(dens) = 350").keepSeries(dens) );
+      REQUIRE( ValueFilter("sum(value) = 700").keepSeries(dens) );
+      REQUIRE( ValueFilter("count(dens) = 2").keepSeries(dens) );
+      REQUIRE_FALSE( ValueFilter("max(dens) > 500").keepSeries(pop) );
+
+      ValueFilter filter("max(dens) > 500 or count(pop) = 1");
+      REQUIRE( filter.keepSeries(dens) );
+      REQUIRE( filter.keepSeries(pop) );
+      REQUIRE( filter.getSeriesPruned() == 0 );
+
+    } // THEN
+
+    THEN( "Areas::pruneSeries() removes the series that are not kept" ) {
+
+      Areas areas = Areas();
+      Area area("W06000011");
+      area.setMeasure("dens", dens);
+      area.setMeasure("pop", pop);
+      std::string code = "W06000011";
+      areas.setArea(code, std::move(area));
+
+      ValueFilter filter("max(dens) > 500");
+      REQUIRE( areas.pruneSeries(filter) == 1 );
+      REQUIRE( filter.getSeriesPruned() == 1 );
+      REQUIRE( areas.size() == 1 );
+      REQUIRE( areas.getArea(code).size() == 1 );
+      REQUIRE( areas.getArea(code).getMeasure("dens").size() == 2 );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "data files are filtered by value as they are parsed, on one thread "
+          "or more", "[ValueFilter][IngestPipeline]" ) {
+
+  GIVEN( "an AuthorityByYearCSV file" ) {
+
+    const std::string contents = "AuthorityCode,2001,2002,2003\n"
+                                 "W06000010,50,150,..\n"
+                                 "W06000011,10,20,30\n"
+                                 "W06000012,200,,300\n";
+
+    THEN( "only the rows kept are imported, and areas with none are not "
+          "added" ) {
+
+      ValueFilter filter("pop > 100");
+      const std::string json = importWhere(BethYw::InputFiles::COMPLETE_POP,
+                                           contents,
+                                           &filter,
+                                           1);
+      REQUIRE( json == "{\"W06000010\":{\"measures\":{\"pop\":"
+                       "{\"2002\":150.0}}},"
+                       "\"W06000012\":{\"measures\":{\"pop\":"
+                       "{\"2001\":200.0,\"2003\":300.0}}}}" );
+      REQUIRE( filter.getRowsPruned() == 4 );
+
+      ValueFilter threaded("pop > 100");
+      REQUIRE( importWhere(BethYw::InputFiles::COMPLETE_POP,
+                           contents,
+                           &threaded,
+                           3) == json );
+      REQUIRE( threaded.getRowsPruned() == 4 );
+
+    } // THEN
+
+    THEN( "a filter of another measure's values imports nothing" ) {
+
+      ValueFilter filter("dens > 0");
+      REQUIRE( importWhere(BethYw::InputFiles::COMPLETE_POP,
+                           contents,
+                           &filter,
+                           1) == "{}" );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "the WelshStatsJSON datasets" ) {
+
+    for (const auto& dataset : {BethYw::InputFiles::POPDEN,
+                                BethYw::InputFiles::AQI,
+                                BethYw::InputFiles::TRAINS}) {
+
+      std::ifstream file("datasets/" + dataset.FILE);
+      std::stringstream contents;
+      contents << file.rdbuf();
+
+      THEN( "the rows of " + dataset.FILE + " kept are the same on one "
+            "thread or more, and fewer than without the filter" ) {
+
+        const std::string all = importWhere(dataset,
+                                            contents.str(),
+                                            nullptr,
+                                            1);
+
+        ValueFilter serial("value > 50 and value < 5000");
+        ValueFilter threaded("value > 50 and value < 5000");
+        const std::string json = importWhere(dataset,
+                                             contents.str(),
+                                             &serial,
+                                             1);
+        REQUIRE( importWhere(dataset,
+                             contents.str(),
+                             &threaded,
+                             2) == json );
+        REQUIRE( serial.getRowsPruned() == threaded.getRowsPruned() );
+        REQUIRE( serial.getRowsPruned() > 0 );
+        REQUIRE( json.size() < all.size() );
+
+      } // THEN
+
+    }
+
+  } // GIVEN
+
+} // SCENARIO
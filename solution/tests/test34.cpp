@@ -0,0 +1,208 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../areas.h"
+#include "../measure.h"
+
+/*
+  Check whether any value of a Measure is in a range by looking at each.
+*/
+static bool scanValueBetween(const Measure& measure,
+                             double low,
+                             double high) {
+  return std::any_of(measure.cbegin(),
+                     measure.cend(),
+                     [=](const std::pair<const int, double>& value) {
+                       return value.second >= low && value.second <= high;
+                     });
+}
+
+SCENARIO( "a Measure keeps the bounds of its values", "[Measure][zonemap]" ) {
+
+  GIVEN( "a Measure without values" ) {
+
+    Measure measure("dens", "Population density");
+
+    THEN( "it has no value in any range" ) {
+
+      REQUIRE( measure.getMin() == 0 );
+      REQUIRE( measure.getMax() == 0 );
+      REQUIRE_FALSE( measure.mayHaveValueBetween(
+          -std::numeric_limits<double>::infinity(),
+          std::numeric_limits<double>::infinity()) );
+      REQUIRE_FALSE( measure.hasValueBetween(0, 0) );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a Measure whose smallest and largest values are replaced" ) {
+
+    Measure measure("dens", "Population density");
+    measure.setValue(2000, 5);
+    measure.setValue(2001, 1);
+    measure.setValue(2002, 9);
+
+    THEN( "its values can only be changed with setValue()" ) {
+
+      static_assert(
+          std::is_same<decltype(std::declval<Measure&>().getValue(2000)),
+                       const Measure_t&>::value,
+          "getValue() must not return a mutable value");
+      static_assert(
+          std::is_same<decltype(std::declval<Measure&>().begin()),
+                       Measure_c::const_iterator>::value,
+          "begin() must not return a mutable iterator");
+
+      const Measure& constMeasure = measure;
+      REQUIRE( constMeasure.getValue(2002) == 9 );
+      measure.setValue(2002, 4);
+      REQUIRE( measure.getValue(2002) == 4 );
+      REQUIRE( measure.getMax() == 5 );
+
+    } // THEN
+
+    THEN( "the bounds narrow" ) {
+
+      REQUIRE( measure.getMin() == 1 );
+      REQUIRE( measure.getMax() == 9 );
+
+      measure.setValue(2002, 6);
+      measure.setValue(2001, 3);
+      REQUIRE( measure.getMin() == 3 );
+      REQUIRE( measure.getMax() == 6 );
+
+      REQUIRE_FALSE( measure.hasValueBetween(7, 100) );
+      REQUIRE( measure.hasValueBetween(4, 5) );
+      REQUIRE_FALSE( measure.hasValueBetween(4, 4.5) );
+      REQUIRE_FALSE( measure.hasValueBetween(5, 4) );
+
+    } // THEN
+
+    THEN( "merging another Measure into it keeps the bounds" ) {
+
+      Measure update("dens", "Population density");
+      update.setValue(2002, 2);
+      update.setValue(2003, 4);
+      measure.merge(std::move(update));
+
+      REQUIRE( measure.getMin() == 1 );
+      REQUIRE( measure.getMax() == 5 );
+      REQUIRE( update.size() == 0 );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "random values, some replacing others" ) {
+
+    std::mt19937 rng(48);
+    std::uniform_int_distribution<int> years(1990, 2020);
+    std::uniform_real_distribution<double> values(-1000, 1000);
+
+    THEN( "the bounds and queries are the same as when found from every "
+          "value" ) {
+
+      size_t mismatches = 0;
+      for (unsigned int series = 0; series < 200; series++) {
+        Measure measure("pop", "Population");
+        Measure other("pop", "Population");
+        for (unsigned int i = 0; i < 40; i++) {
+          measure.setValue(years(rng), std::round(values(rng)));
+          if (i % 3 == 0) {
+            other.setValue(years(rng), std::round(values(rng)));
+          }
+        }
+        measure.merge(std::move(other));
+
+        double min = std::numeric_limits<double>::infinity();
+        double max = -std::numeric_limits<double>::infinity();
+        for (auto it = measure.cbegin(); it != measure.cend(); it++) {
+          min = std::min(min, it->second);
+          max = std::max(max, it->second);
+        }
+        if (measure.getMin() != min || measure.getMax() != max) {
+          mismatches++;
+        }
+
+        for (unsigned int query = 0; query < 20; query++) {
+          double low = std::round(values(rng));
+          double high = low + std::round(values(rng) / 10 + 100);
+          if (measure.hasValueBetween(low, high) !=
+              scanValueBetween(measure, low, high)) {
+            mismatches++;
+          }
+        }
+      }
+
+      REQUIRE( mismatches == 0 );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "the areas with a value of a measure in a range can be found",
+          "[Areas][zonemap]" ) {
+
+  GIVEN( "an Areas instance with two measures" ) {
+
+    Areas areas = Areas();
+    for (unsigned int i = 0; i < 5; i++) {
+      std::string code = "W0600001" + std::to_string(i);
+      Area area(code);
+
+      Measure dens("dens", "Population density");
+      Measure pop("pop", "Population");
+      for (int year = 2000; year < 2005; year++) {
+        dens.setValue(year, 100.0 * i + year - 2000);
+        pop.setValue(year, 1000.0 * (5 - i));
+      }
+      area.setMeasure("dens", dens);
+      area.setMeasure("pop", pop);
+      areas.setArea(code, std::move(area));
+    }
+
+    THEN( "the areas whose density has ever exceeded a value are found" ) {
+
+      const double inf = std::numeric_limits<double>::infinity();
+      REQUIRE( areas.findAreasWithValuesBetween(
+                   "dens", std::nextafter(300.0, inf), inf) ==
+               std::vector<std::string>{"W06000013", "W06000014"} );
+      REQUIRE( areas.findAreasWithValuesBetween("dens", 202.5, 203.5) ==
+               std::vector<std::string>{"W06000012"} );
+      REQUIRE( areas.findAreasWithValuesBetween("dens", 202.5, 202.6)
+                   .empty() );
+      REQUIRE( areas.findAreasWithValuesBetween("pop", 0, 1000) ==
+               std::vector<std::string>{"W06000014"} );
+      REQUIRE( areas.findAreasWithValuesBetween("", 0, 1000).size() == 5 );
+      REQUIRE( areas.findAreasWithValuesBetween("rail", -inf, inf).empty() );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
@@ -0,0 +1,159 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+
+#include "../measure.h"
+
+/*
+  The statistics of a Measure's values, found from every value.
+*/
+struct RecomputedStatistics {
+  double sum;
+  double mean;
+  double variance;
+  double min;
+  double max;
+  double first;
+  double last;
+};
+
+static RecomputedStatistics recomputeStatistics(const Measure& measure) {
+  RecomputedStatistics stats{0, 0, 0, 0, 0, 0, 0};
+  if (measure.size() == 0) {
+    return stats;
+  }
+
+  stats.min = std::numeric_limits<double>::infinity();
+  stats.max = -std::numeric_limits<double>::infinity();
+  for (auto it = measure.cbegin(); it != measure.cend(); it++) {
+    stats.sum += it->second;
+    stats.min = std::min(stats.min, it->second);
+    stats.max = std::max(stats.max, it->second);
+  }
+  stats.mean = stats.sum / measure.size();
+
+  for (auto it = measure.cbegin(); it != measure.cend(); it++) {
+    stats.variance += (it->second - stats.mean) * (it->second - stats.mean);
+  }
+  stats.variance /= measure.size();
+
+  stats.first = measure.cbegin()->second;
+  stats.last = measure.crbegin()->second;
+  return stats;
+}
+
+/*
+  Check whether the statistics a Measure keeps agree with those found from
+  every value, to a relative tolerance.
+*/
+static bool statisticsAgree(const Measure& measure) {
+  const RecomputedStatistics stats = recomputeStatistics(measure);
+  const auto close = [](double kept, double recomputed, double scale) {
+    return std::abs(kept - recomputed) <= 1e-9 * std::max(1.0, scale);
+  };
+  const double scale = std::max(std::abs(stats.min), std::abs(stats.max));
+
+  return close(measure.getSum(), stats.sum, scale * measure.size()) &&
+         close(measure.getAverage(), stats.mean, scale) &&
+         close(measure.getVariance(), stats.variance, scale * scale) &&
+         close(measure.getStandardDeviation(),
+               std::sqrt(stats.variance),
+               scale) &&
+         measure.getMin() == stats.min &&
+         measure.getMax() == stats.max &&
+         measure.getFirst() == stats.first &&
+         measure.getLast() == stats.last;
+}
+
+SCENARIO( "a Measure keeps the statistics of its values as they are set",
+          "[Measure][statistics]" ) {
+
+  GIVEN( "a Measure with a few values" ) {
+
+    Measure measure("pop", "Population");
+
+    THEN( "the statistics are those of the values" ) {
+
+      REQUIRE( measure.getVariance() == 0 );
+      REQUIRE( measure.getFirst() == 0 );
+      REQUIRE( measure.getLast() == 0 );
+
+      measure.setValue(2001, 4);
+      REQUIRE( measure.getVariance() == 0 );
+
+      measure.setValue(2000, 2);
+      REQUIRE( measure.getVariance() == Approx(1) );
+      REQUIRE( measure.getStandardDeviation() == Approx(1) );
+      REQUIRE( measure.getFirst() == 2 );
+      REQUIRE( measure.getLast() == 4 );
+
+      measure.setValue(2001, 8);
+      REQUIRE( measure.getVariance() == Approx(9) );
+      REQUIRE( measure.getDifference() == 6 );
+
+      measure.setValue(2001, 2);
+      REQUIRE( measure.getVariance() == Approx(0).margin(1e-12) );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "random values, some replacing others and some merged in" ) {
+
+    std::mt19937 rng(49);
+    std::uniform_int_distribution<int> years(1980, 2020);
+    std::uniform_real_distribution<double> scales(0, 7);
+    std::normal_distribution<double> values(0, 1);
+
+    THEN( "the statistics agree with those found from every value" ) {
+
+      size_t mismatches = 0;
+      for (unsigned int series = 0; series < 300; series++) {
+        // The values are offset from 0 as populations are, which is where a
+        // naive sum of squares loses its precision
+        const double scale = std::pow(10.0, scales(rng));
+        const double offset = scale * 20;
+
+        Measure measure("pop", "Population");
+        for (unsigned int i = 0; i < 60; i++) {
+          measure.setValue(years(rng), offset + scale * values(rng));
+          if (!statisticsAgree(measure)) {
+            mismatches++;
+          }
+        }
+
+        Measure update("pop", "Population");
+        for (unsigned int i = 0; i < 20; i++) {
+          update.setValue(years(rng) + 20, offset + scale * values(rng));
+        }
+        measure.merge(std::move(update));
+        if (!statisticsAgree(measure) || !statisticsAgree(update)) {
+          mismatches++;
+        }
+      }
+
+      REQUIRE( mismatches == 0 );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
@@ -0,0 +1,197 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license.
+ */
+
+#include "../lib_catch.hpp"
+
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include "../measure.h"
+#include "../valuefilter.h"
+
+/*
+  Check whether the sum and count of a Measure's values in a range of years
+  agree with those found by looking at each value.
+*/
+static bool rangeAgrees(const Measure& measure, int from, int to) {
+  double sum = 0;
+  size_t count = 0;
+  for (auto it = measure.cbegin(); it != measure.cend(); it++) {
+    if (it->first >= from && it->first <= to) {
+      sum += it->second;
+      count++;
+    }
+  }
+
+  const double average = count > 0 ? sum / count : 0;
+  return measure.getCount(from, to) == count &&
+         std::abs(measure.getSum(from, to) - sum) <= 1e-6 &&
+         std::abs(measure.getAverage(from, to) - average) <= 1e-6;
+}
+
+SCENARIO( "a Measure finds the sums of ranges of years", "[Measure][prefix]" ) {
+
+  GIVEN( "a Measure with gaps between its years" ) {
+
+    Measure measure("pop", "Population");
+    measure.setValue(2010, 1);
+    measure.setValue(2012, 2);
+    measure.setValue(2013, 3);
+
+    THEN( "the ranges are clamped to the years with values" ) {
+
+      REQUIRE( measure.getCount(2011, 2015) == 2 );
+      REQUIRE( measure.getSum(2011, 2015) == 5 );
+      REQUIRE( measure.getAverage(2011, 2015) == 2.5 );
+      REQUIRE( measure.getSum(1900, 3000) == 6 );
+      REQUIRE( measure.getCount(2011, 2011) == 0 );
+      REQUIRE( measure.getAverage(2011, 2011) == 0 );
+      REQUIRE( measure.getSum(2014, 2020) == 0 );
+      REQUIRE( measure.getSum(2013, 2010) == 0 );
+
+    } // THEN
+
+    THEN( "setting a value is seen by the next query" ) {
+
+      REQUIRE( measure.getSum(2010, 2013) == 6 );
+      measure.setValue(2011, 4);
+      REQUIRE( measure.getSum(2010, 2013) == 10 );
+      measure.setValue(2013, 1);
+      REQUIRE( measure.getSum(2012, 2013) == 3 );
+      measure.setValue(2020, 10);
+      REQUIRE( measure.getCount(2000, 2100) == 5 );
+
+    } // THEN
+
+    THEN( "merging another Measure into it is seen by the next query" ) {
+
+      Measure update("pop", "Population");
+      update.setValue(2011, 4);
+      REQUIRE( update.getSum(2000, 2100) == 4 );
+      REQUIRE( measure.getSum(2000, 2100) == 6 );
+
+      measure.merge(std::move(update));
+      REQUIRE( measure.getSum(2000, 2100) == 10 );
+      REQUIRE( update.getSum(2000, 2100) == 0 );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "a Measure whose years are too far apart to keep running totals "
+         "for" ) {
+
+    Measure measure("pop", "Population");
+    measure.setValue(0, 1);
+    measure.setValue(MEASURE_PREFIX_MAX_SPAN + 5, 2);
+
+    THEN( "the ranges are still summed" ) {
+
+      REQUIRE( measure.getSum(0, MEASURE_PREFIX_MAX_SPAN + 5) == 3 );
+      REQUIRE( measure.getCount(1, MEASURE_PREFIX_MAX_SPAN + 5) == 1 );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "random values, set and merged between queries" ) {
+
+    std::mt19937 rng(50);
+    std::uniform_int_distribution<int> years(1980, 2020);
+    std::uniform_real_distribution<double> values(-1000, 1000);
+
+    THEN( "the ranges agree with those found from every value" ) {
+
+      size_t mismatches = 0;
+      for (unsigned int series = 0; series < 100; series++) {
+        Measure measure("pop", "Population");
+        for (unsigned int i = 0; i < 40; i++) {
+          measure.setValue(years(rng), std::round(values(rng)));
+
+          const int from = years(rng) - 5;
+          if (!rangeAgrees(measure, from, from + years(rng) % 20)) {
+            mismatches++;
+          }
+        }
+
+        Measure update("pop", "Population");
+        update.setValue(years(rng), std::round(values(rng)));
+        measure.merge(std::move(update));
+        if (!rangeAgrees(measure, 1980, 2000) ||
+            !rangeAgrees(measure, 1970, 2030)) {
+          mismatches++;
+        }
+      }
+
+      REQUIRE( mismatches == 0 );
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
+
+SCENARIO( "a ValueFilter compares aggregates of ranges of years",
+          "[ValueFilter][prefix]" ) {
+
+  GIVEN( "aggregates of ranges of years" ) {
+
+    Measure pop("pop", "Population");
+    pop.setValue(2010, 50000);
+    pop.setValue(2011, 120000);
+    pop.setValue(2015, 140000);
+    pop.setValue(2016, 10);
+
+    THEN( "the series are kept by the aggregates of those years" ) {
+
+      REQUIRE( ValueFilter("avg(pop, 2011, 2015) > 100000").keepSeries(pop) );
+      REQUIRE_FALSE( ValueFilter("avg(pop) > 100000").keepSeries(pop) );
+      REQUIRE( ValueFilter("sum(pop, 2015, 2016) = 140010").keepSeries(pop) );
+      REQUIRE( ValueFilter("count(value, 2012, 2020) = 2").keepSeries(pop) );
+      REQUIRE( ValueFilter("sum(pop, 2010) = 50000").keepSeries(pop) );
+      REQUIRE_FALSE( ValueFilter("avg(pop, 2012, 2014) >= 0")
+                         .keepSeries(pop) );
+
+    } // THEN
+
+    THEN( "they are described with their years" ) {
+
+      REQUIRE( ValueFilter("AVG(Pop,2011,2015)>1e5").describeSeries() ==
+               "avg(pop, 2011, 2015) > 100000" );
+      REQUIRE( ValueFilter("sum(pop, 2011) > 0").describeSeries() ==
+               "sum(pop, 2011, 2011) > 0" );
+
+    } // THEN
+
+  } // GIVEN
+
+  GIVEN( "invalid ranges of years" ) {
+
+    THEN( "a std::invalid_argument exception is thrown" ) {
+
+      for (const auto& expression : {"max(pop, 2011, 2015) > 1",
+                                     "avg(pop, 2015, 2011) > 1",
+                                     "avg(pop, 2011.5) > 1",
+                                     "avg(pop, ) > 1",
+                                     "avg(pop, 2011, 2012, 2013) > 1"}) {
+        REQUIRE_THROWS_AS( ValueFilter(expression), std::invalid_argument );
+      }
+
+    } // THEN
+
+  } // GIVEN
+
+} // SCENARIO
@@ -0,0 +1,25 @@
+#ifndef TESTFILE_H_
+#define TESTFILE_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  A helper for the tests to read a whole file (e.g. a dataset, to compare
+  with what a reader returns), which is empty if the file cannot be read.
+ */
+
+#include <string>
+
+#include "../fingerprint.h"
+
+inline std::string readTestFile(const std::string& path) {
+  std::string contents;
+  readFileContents(path, contents);
+  return contents;
+}
+
+#endif // TESTFILE_H_
@@ -0,0 +1,759 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the implementation of the ValueFilter class. See the
+  header file for additional comments.
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "cell.h"
+#include "measure.h"
+#include "valuefilter.h"
+
+/*
+  A token of a --where expression, with its position for error messages.
+*/
+struct WhereToken {
+  enum Kind { Name, Number, Operator, And, Or, Open, Close, Comma, End } kind;
+  std::string text;
+  double number;
+  size_t pos;
+};
+
+/*
+  A node of the parsed expression: a comparison, or an and/or of two nodes.
+*/
+struct WhereNode {
+  enum Kind { Compare, And, Or } kind;
+  ValueComparison comparison;
+  size_t left;
+  size_t right;
+};
+
+/*
+  What the comparisons within a node compare: values, aggregates, or both.
+*/
+const unsigned int WHERE_ROWS = 1;
+const unsigned int WHERE_SERIES = 2;
+
+/*
+  Throw the error for a --where expression that cannot be compiled.
+*/
+[[noreturn]] static void throwWhereError(const std::string& reason,
+                                         size_t pos) {
+  throw std::invalid_argument("Invalid --where expression: " + reason +
+                              " at character " + std::to_string(pos + 1));
+}
+
+/*
+  Split a --where expression into its tokens.
+*/
+static std::vector<WhereToken> tokenizeWhere(const std::string& expression) {
+  std::vector<WhereToken> tokens;
+  size_t pos = 0;
+
+  while (pos < expression.size()) {
+    const char c = expression[pos];
+    const size_t start = pos;
+
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      pos++;
+      continue;
+    }
+
+    if (c == '(' || c == ')') {
+      tokens.push_back(WhereToken{c == '(' ? WhereToken::Open
+                                           : WhereToken::Close,
+                                  std::string(1, c), 0.0, start});
+      pos++;
+      continue;
+    }
+
+    if (c == ',') {
+      tokens.push_back(WhereToken{WhereToken::Comma, ",", 0.0, start});
+      pos++;
+      continue;
+    }
+
+    if (c == '<' || c == '>' || c == '=' || c == '!') {
+      pos++;
+      if (pos < expression.size() &&
+          (expression[pos] == '=' || (c == '<' && expression[pos] == '>'))) {
+        pos++;
+      }
+      std::string op = expression.substr(start, pos - start);
+      if (op == "!") {
+        throwWhereError("unknown operator !", start);
+      }
+      tokens.push_back(WhereToken{WhereToken::Operator, op, 0.0, start});
+      continue;
+    }
+
+    if ((c == '&' || c == '|') && pos + 1 < expression.size() &&
+        expression[pos + 1] == c) {
+      tokens.push_back(WhereToken{c == '&' ? WhereToken::And : WhereToken::Or,
+                                  expression.substr(start, 2), 0.0, start});
+      pos += 2;
+      continue;
+    }
+
+    if (std::isdigit(static_cast<unsigned char>(c)) || c == '.' || c == '-' ||
+        c == '+') {
+      pos++;
+      while (pos < expression.size() &&
+             (std::isalnum(static_cast<unsigned char>(expression[pos])) ||
+              expression[pos] == '.' ||
+              ((expression[pos] == '-' || expression[pos] == '+') &&
+               (expression[pos - 1] == 'e' || expression[pos - 1] == 'E')))) {
+        pos++;
+      }
+
+      WhereToken token{WhereToken::Number,
+                       expression.substr(start, pos - start), 0.0, start};
+      if (decodeValueCell(token.text, token.number) != CellState::Value ||
+          !std::isfinite(token.number)) {
+        throwWhereError("invalid number " + token.text, start);
+      }
+      tokens.push_back(token);
+      continue;
+    }
+
+    if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+      pos++;
+      while (pos < expression.size() &&
+             (std::isalnum(static_cast<unsigned char>(expression[pos])) ||
+              expression[pos] == '_' ||
+              expression[pos] == '-' ||
+              expression[pos] == '.')) {
+        pos++;
+      }
+
+      std::string name = expression.substr(start, pos - start);
+      std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+      const WhereToken::Kind kind = name == "and" ? WhereToken::And
+                                    : name == "or" ? WhereToken::Or
+                                                   : WhereToken::Name;
+      tokens.push_back(WhereToken{kind, name, 0.0, start});
+      continue;
+    }
+
+    throwWhereError(std::string("unexpected ") + c, start);
+  }
+
+  tokens.push_back(WhereToken{WhereToken::End, "", 0.0, expression.size()});
+  return tokens;
+}
+
+/*
+  A recursive descent parser of a --where expression:
+
+    expression := term ( or term )*
+    term       := factor ( and factor )*
+    factor     := ( expression ) | operand operator number
+    operand    := measure | value | aggregate ( measure | value years? )
+    aggregate  := min | max | avg | sum | count
+    years      := , year ( , year )?
+    operator   := < | <= | > | >= | = | == | != | <>
+*/
+class WhereParser {
+protected:
+  const std::vector<WhereToken>& mTokens;
+  size_t mNext;
+  std::vector<WhereNode>& mNodes;
+
+  const WhereToken& peek() const { return mTokens[mNext]; }
+  const WhereToken& take() { return mTokens[mNext++]; }
+
+  size_t add(WhereNode::Kind kind, size_t left, size_t right) {
+    mNodes.push_back(WhereNode{kind, ValueComparison{}, left, right});
+    return mNodes.size() - 1;
+  }
+
+  size_t parseTerm() {
+    size_t node = parseFactor();
+    while (peek().kind == WhereToken::And) {
+      take();
+      node = add(WhereNode::And, node, parseFactor());
+    }
+    return node;
+  }
+
+  size_t parseFactor() {
+    if (peek().kind == WhereToken::Open) {
+      take();
+      const size_t node = parseExpression();
+      if (peek().kind != WhereToken::Close) {
+        throwWhereError("expected )", peek().pos);
+      }
+      take();
+      return node;
+    }
+
+    return parseComparison();
+  }
+
+  int parseYear() {
+    const WhereToken& year = take();
+    if (year.kind != WhereToken::Number || year.number < 1 ||
+        year.number > 9999 || year.number != std::floor(year.number)) {
+      throwWhereError("expected a year", year.pos);
+    }
+    return static_cast<int>(year.number);
+  }
+
+  /*
+    Parse the years of an aggregate over a range of years, e.g. the ", 2011,
+    2015" of avg(pop, 2011, 2015), or a single year.
+  */
+  void parseYears(ValueComparison& comparison) {
+    const WhereToken& comma = take();
+    if (comparison.aggregate != ValueAggregate::Avg &&
+        comparison.aggregate != ValueAggregate::Sum &&
+        comparison.aggregate != ValueAggregate::Count) {
+      throwWhereError("a range of years is only for avg, sum, and count",
+                      comma.pos);
+    }
+
+    comparison.from = parseYear();
+    comparison.to = comparison.from;
+    if (peek().kind == WhereToken::Comma) {
+      take();
+      const size_t pos = peek().pos;
+      comparison.to = parseYear();
+      if (comparison.to < comparison.from) {
+        throwWhereError("the range of years ends before it begins", pos);
+      }
+    }
+  }
+
+  size_t parseComparison() {
+    const WhereToken& name = take();
+    if (name.kind != WhereToken::Name) {
+      throwWhereError("expected a measure, value, or aggregate", name.pos);
+    }
+
+    ValueComparison comparison{name.text, ValueAggregate::None,
+                               ValueOperator::Equal, 0.0, 0, 0};
+    if (peek().kind == WhereToken::Open) {
+      if (name.text == "min") {
+        comparison.aggregate = ValueAggregate::Min;
+      } else if (name.text == "max") {
+        comparison.aggregate = ValueAggregate::Max;
+      } else if (name.text == "avg") {
+        comparison.aggregate = ValueAggregate::Avg;
+      } else if (name.text == "sum") {
+        comparison.aggregate = ValueAggregate::Sum;
+      } else if (name.text == "count") {
+        comparison.aggregate = ValueAggregate::Count;
+      } else {
+        throwWhereError("unknown aggregate " + name.text, name.pos);
+      }
+
+      take();
+      const WhereToken& measure = take();
+      if (measure.kind != WhereToken::Name) {
+        throwWhereError("expected a measure or value", measure.pos);
+      }
+      if (peek().kind == WhereToken::Comma) {
+        parseYears(comparison);
+      }
+      if (peek().kind != WhereToken::Close) {
+        throwWhereError("expected )", peek().pos);
+      }
+      take();
+      comparison.measure = measure.text;
+    }
+
+    if (comparison.measure == "value") {
+      comparison.measure.clear();
+    }
+
+    const WhereToken& op = take();
+    if (op.kind != WhereToken::Operator) {
+      throwWhereError("expected a comparison operator", op.pos);
+    }
+    if (op.text == "<") {
+      comparison.op = ValueOperator::Less;
+    } else if (op.text == "<=") {
+      comparison.op = ValueOperator::LessEqual;
+    } else if (op.text == ">") {
+      comparison.op = ValueOperator::Greater;
+    } else if (op.text == ">=") {
+      comparison.op = ValueOperator::GreaterEqual;
+    } else if (op.text == "=" || op.text == "==") {
+      comparison.op = ValueOperator::Equal;
+    } else {
+      comparison.op = ValueOperator::NotEqual;
+    }
+
+    const WhereToken& number = take();
+    if (number.kind != WhereToken::Number) {
+      throwWhereError("expected a number", number.pos);
+    }
+    comparison.operand = number.number;
+
+    mNodes.push_back(WhereNode{WhereNode::Compare, comparison, 0, 0});
+    return mNodes.size() - 1;
+  }
+
+public:
+  WhereParser(const std::vector<WhereToken>& tokens,
+              std::vector<WhereNode>& nodes)
+      : mTokens(tokens), mNext(0), mNodes(nodes) {}
+
+  size_t parseExpression() {
+    size_t node = parseTerm();
+    while (peek().kind == WhereToken::Or) {
+      take();
+      node = add(WhereNode::Or, node, parseTerm());
+    }
+    return node;
+  }
+
+  void expectEnd() const {
+    if (peek().kind != WhereToken::End) {
+      throwWhereError("unexpected " + peek().text, peek().pos);
+    }
+  }
+};
+
+/*
+  @return
+    WHERE_ROWS and/or WHERE_SERIES, for what the comparisons within a node
+    compare
+*/
+static unsigned int classifyWhereNode(const std::vector<WhereNode>& nodes,
+                                      size_t node) {
+  if (nodes[node].kind == WhereNode::Compare) {
+    return nodes[node].comparison.aggregate == ValueAggregate::None
+               ? WHERE_ROWS
+               : WHERE_SERIES;
+  }
+
+  return classifyWhereNode(nodes, nodes[node].left) |
+         classifyWhereNode(nodes, nodes[node].right);
+}
+
+/*
+  Find the nodes joined by and at the top of the expression.
+*/
+static void splitWhereConjuncts(const std::vector<WhereNode>& nodes,
+                                size_t node,
+                                std::vector<size_t>& conjuncts) {
+  if (nodes[node].kind == WhereNode::And) {
+    splitWhereConjuncts(nodes, nodes[node].left, conjuncts);
+    splitWhereConjuncts(nodes, nodes[node].right, conjuncts);
+  } else {
+    conjuncts.push_back(node);
+  }
+}
+
+/*
+  Construct a ValueFilter that keeps everything.
+*/
+ValueFilter::ValueFilter() noexcept
+    : mExpression(), mRows(), mSeries(), mRowsPruned(0), mSeriesPruned(0) {}
+
+/*
+  Compile a --where expression (see the header file) into a ValueFilter.
+
+  @param expression
+    The expression, which if empty (or only spaces) keeps everything
+
+  @throws
+    std::invalid_argument if the expression is not valid, with the message:
+    Invalid --where expression: <reason> at character <position>
+
+  @example
+    ValueFilter filter("pop > 100000 and max(dens) >= 500");
+*/
+ValueFilter::ValueFilter(const std::string& expression)
+    : mExpression(expression),
+      mRows(),
+      mSeries(),
+      mRowsPruned(0),
+      mSeriesPruned(0) {
+  const std::vector<WhereToken> tokens = tokenizeWhere(expression);
+  if (tokens.size() == 1) {
+    return;
+  }
+
+  std::vector<WhereNode> nodes;
+  WhereParser parser(tokens, nodes);
+  const size_t root = parser.parseExpression();
+  parser.expectEnd();
+
+  std::vector<size_t> conjuncts;
+  splitWhereConjuncts(nodes, root, conjuncts);
+
+  // Each node is emitted in postfix order, with a stack of nodes to visit
+  // and whether their children have been emitted yet
+  auto emit = [&nodes](size_t node, std::vector<Instruction>& program) {
+    std::vector<std::pair<size_t, bool>> visit = {{node, false}};
+    size_t depth = 0;
+    size_t maxDepth = 0;
+    while (!visit.empty()) {
+      const auto current = visit.back();
+      visit.pop_back();
+      const WhereNode& n = nodes[current.first];
+
+      if (n.kind == WhereNode::Compare) {
+        program.push_back(Instruction{Instruction::Compare, n.comparison});
+        maxDepth = std::max(maxDepth, ++depth);
+      } else if (current.second) {
+        program.push_back(Instruction{n.kind == WhereNode::And
+                                          ? Instruction::And
+                                          : Instruction::Or,
+                                      ValueComparison{}});
+        depth--;
+      } else {
+        visit.push_back({current.first, true});
+        visit.push_back({n.right, false});
+        visit.push_back({n.left, false});
+      }
+    }
+    return maxDepth;
+  };
+
+  for (auto it = conjuncts.cbegin(); it != conjuncts.cend(); it++) {
+    const unsigned int kind = classifyWhereNode(nodes, *it);
+    if (kind == (WHERE_ROWS | WHERE_SERIES)) {
+      throw std::invalid_argument("Invalid --where expression: values and "
+                                  "aggregates cannot be compared within "
+                                  "the same or");
+    }
+
+    std::vector<Instruction>& program =
+        kind == WHERE_ROWS ? mRows : mSeries;
+    const bool joined = !program.empty();
+    if (emit(*it, program) + (joined ? 1 : 0) > MAX_DEPTH) {
+      throw std::invalid_argument("Invalid --where expression: too deeply "
+                                  "nested");
+    }
+    if (joined) {
+      program.push_back(Instruction{Instruction::And, ValueComparison{}});
+    }
+  }
+}
+
+/*
+  Compare two numbers, where a number that is not a number (e.g. the minimum
+  of a series without values) never compares as true.
+*/
+bool ValueFilter::compare(double lhs, ValueOperator op, double rhs) noexcept {
+  if (std::isnan(lhs)) {
+    return false;
+  }
+
+  switch (op) {
+    case ValueOperator::Less:
+      return lhs < rhs;
+
+    case ValueOperator::LessEqual:
+      return lhs <= rhs;
+
+    case ValueOperator::Greater:
+      return lhs > rhs;
+
+    case ValueOperator::GreaterEqual:
+      return lhs >= rhs;
+
+    case ValueOperator::Equal:
+      return lhs == rhs;
+
+    default:
+      return lhs != rhs;
+  }
+}
+
+/*
+  Run a program, with the results on a stack of bits (the top being the
+  lowest), as a program is never nested more than MAX_DEPTH deep.
+
+  @param program
+    The program
+
+  @param comparison
+    Gives the result of a comparison
+
+  @return
+    The result of the program, which is true for an empty program
+*/
+template <typename Compare>
+bool ValueFilter::run(const std::vector<Instruction>& program,
+                      Compare comparison) noexcept {
+  uint64_t stack = 1;
+  for (auto it = program.cbegin(); it != program.cend(); it++) {
+    if (it->kind == Instruction::Compare) {
+      stack = (stack << 1) | (comparison(it->comparison) ? 1 : 0);
+    } else {
+      const uint64_t top = stack & 1;
+      stack >>= 1;
+      stack = it->kind == Instruction::And ? stack & (~uint64_t(1) | top)
+                                           : stack | top;
+    }
+  }
+  return (stack & 1) != 0;
+}
+
+/*
+  @return
+    true if the filter keeps everything
+*/
+bool ValueFilter::empty() const noexcept {
+  return mRows.empty() && mSeries.empty();
+}
+
+/*
+  @return
+    true if the filter has comparisons of values, applied to each row while
+    parsing
+*/
+bool ValueFilter::hasRowPredicate() const noexcept {
+  return !mRows.empty();
+}
+
+/*
+  @return
+    true if the filter has comparisons of aggregates, applied to each series
+    once loaded
+*/
+bool ValueFilter::hasSeriesPredicate() const noexcept {
+  return !mSeries.empty();
+}
+
+/*
+  @return
+    The expression the filter was compiled from
+*/
+const std::string& ValueFilter::getExpression() const noexcept {
+  return mExpression;
+}
+
+/*
+  Write a program back out as an expression, in a canonical form (lowercase,
+  bracketed, and with each number written in full), e.g. for a
+  DatasetSnapshot to tell whether it was imported with the same filter.
+*/
+std::string ValueFilter::describe(const std::vector<Instruction>& program) {
+  static const char* const aggregates[] = {"", "min", "max", "avg", "sum",
+                                           "count"};
+  static const char* const operators[] = {"<", "<=", ">", ">=", "=", "!="};
+
+  std::vector<std::string> stack;
+  for (auto it = program.cbegin(); it != program.cend(); it++) {
+    if (it->kind == Instruction::Compare) {
+      const ValueComparison& c = it->comparison;
+      const std::string measure = c.measure.empty() ? "value" : c.measure;
+
+      std::ostringstream text;
+      text << std::setprecision(std::numeric_limits<double>::max_digits10);
+      if (c.aggregate == ValueAggregate::None) {
+        text << measure;
+      } else {
+        text << aggregates[static_cast<int>(c.aggregate)] << "(" << measure;
+        if (c.from != 0) {
+          text << ", " << c.from << ", " << c.to;
+        }
+        text << ")";
+      }
+      text << " " << operators[static_cast<int>(c.op)] << " " << c.operand;
+      stack.push_back(text.str());
+    } else {
+      const std::string right = std::move(stack.back());
+      stack.pop_back();
+      stack.back() = "(" + stack.back() +
+                     (it->kind == Instruction::And ? " and " : " or ") +
+                     right + ")";
+    }
+  }
+
+  return stack.empty() ? "" : stack.back();
+}
+
+/*
+  @return
+    The comparisons of values, in a canonical form, or an empty string if
+    there are none
+*/
+std::string ValueFilter::describeRows() const {
+  return describe(mRows);
+}
+
+/*
+  @return
+    The comparisons of aggregates, in a canonical form, or an empty string if
+    there are none
+*/
+std::string ValueFilter::describeSeries() const {
+  return describe(mSeries);
+}
+
+/*
+  Check whether any row of a measure could be kept, i.e. whether the row
+  program is true when every comparison of this measure (or of every
+  measure) is, as no other comparison can be true for its rows. As a program
+  has only and/or, it cannot be true for any value if it is not for this.
+*/
+bool ValueFilter::mayMatchMeasure(const std::string& measureCode) const
+    noexcept {
+  return run(mRows, [&](const ValueComparison& comparison) {
+    return comparison.measure.empty() || comparison.measure == measureCode;
+  });
+}
+
+/*
+  Find the measures whose rows may be kept, to skip datasets (and the rows
+  of a RowIndex) that have none of them.
+
+  @return
+    The lowercase codes of the measures, or an empty set if the rows of any
+    measure may be kept (as with a measures filter)
+*/
+std::unordered_set<std::string> ValueFilter::getRowMeasures() const {
+  std::unordered_set<std::string> measures;
+  if (mRows.empty() || mayMatchMeasure("")) {
+    return measures;
+  }
+
+  for (auto it = mRows.cbegin(); it != mRows.cend(); it++) {
+    if (it->kind == Instruction::Compare &&
+        !it->comparison.measure.empty() &&
+        mayMatchMeasure(it->comparison.measure)) {
+      measures.insert(it->comparison.measure);
+    }
+  }
+
+  return measures;
+}
+
+/*
+  Check whether a row is kept, counting it as pruned if it is not.
+
+  @param measureCode
+    The lowercase code of the row's measure
+
+  @param value
+    The row's value
+
+  @return
+    true if the row is kept
+
+  @example
+    if (filter.keepRow("pop", 123456.0)) {
+      measure.setValue(2020, 123456.0);
+    }
+*/
+bool ValueFilter::keepRow(const std::string& measureCode, double value) const
+    noexcept {
+  const bool keep =
+      run(mRows, [&](const ValueComparison& comparison) {
+        return (comparison.measure.empty() ||
+                comparison.measure == measureCode) &&
+               compare(value, comparison.op, comparison.operand);
+      });
+
+  if (!keep) {
+    mRowsPruned.fetch_add(1, std::memory_order_relaxed);
+  }
+  return keep;
+}
+
+/*
+  Check whether a whole series is kept, counting it as pruned if it is not.
+
+  @param measure
+    The Measure
+
+  @return
+    true if the series is kept
+*/
+bool ValueFilter::keepSeries(const Measure& measure) const noexcept {
+  const std::string& measureCode = measure.getCodename();
+  const bool keep =
+      run(mSeries, [&](const ValueComparison& comparison) {
+        if (!comparison.measure.empty() &&
+            comparison.measure != measureCode) {
+          return false;
+        }
+
+        double aggregate = std::numeric_limits<double>::quiet_NaN();
+        switch (comparison.aggregate) {
+          case ValueAggregate::Min:
+            if (measure.size() > 0) {
+              aggregate = measure.getMin();
+            }
+            break;
+
+          case ValueAggregate::Max:
+            if (measure.size() > 0) {
+              aggregate = measure.getMax();
+            }
+            break;
+
+          case ValueAggregate::Avg:
+            if (comparison.from != 0) {
+              if (measure.getCount(comparison.from, comparison.to) > 0) {
+                aggregate = measure.getAverage(comparison.from, comparison.to);
+              }
+            } else if (measure.size() > 0) {
+              aggregate = measure.getAverage();
+            }
+            break;
+
+          case ValueAggregate::Sum:
+            aggregate = comparison.from != 0
+                            ? measure.getSum(comparison.from, comparison.to)
+                            : measure.getSum();
+            break;
+
+          default:
+            aggregate = static_cast<double>(
+                comparison.from != 0
+                    ? measure.getCount(comparison.from, comparison.to)
+                    : measure.size());
+            break;
+        }
+
+        return compare(aggregate, comparison.op, comparison.operand);
+      });
+
+  if (!keep) {
+    mSeriesPruned.fetch_add(1, std::memory_order_relaxed);
+  }
+  return keep;
+}
+
+/*
+  @return
+    The number of rows the filter has not kept
+*/
+uint64_t ValueFilter::getRowsPruned() const noexcept {
+  return mRowsPruned.load(std::memory_order_relaxed);
+}
+
+/*
+  @return
+    The number of series the filter has not kept
+*/
+uint64_t ValueFilter::getSeriesPruned() const noexcept {
+  return mSeriesPruned.load(std::memory_order_relaxed);
+}
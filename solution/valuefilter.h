@@ -0,0 +1,152 @@
+#ifndef VALUEFILTER_H_
+#define VALUEFILTER_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the ValueFilter class, which filters the data by its
+  values with an expression given as --where, e.g.
+
+    --where "(pop > 100000 or dens >= 500) and max(dens) > 500"
+
+  An expression is made of comparisons of a number with either the values
+  of a measure (or of every measure, as value), or an aggregate of a whole
+  series (min, max, avg, sum, or count of a measure, or of value), joined by
+  and and or (or && and ||), with brackets. Measure codes are matched
+  without regard to case. An avg, sum, or count may be of a range of years
+  of the series, e.g. "avg(pop, 2011, 2015) > 100000", or of a single year.
+
+  The expression is compiled once, into two programs in postfix order, one
+  for each row (a year's value of a measure of an area) and one for each
+  series (a Measure, once loaded):
+
+    — A comparison of values is true for the rows of that measure whose value
+      compares as given, so "pop > 100000" keeps only the rows of the pop
+      measure above 100000, as "WHERE measure = 'pop' AND value > 100000"
+      would in SQL. The row program is pushed down into the parsers, which
+      skip the rows it does not keep before they are added to an Area, so
+      they take neither memory nor time to print.
+
+    — A comparison of an aggregate is likewise true for the series of that
+      measure whose aggregate compares as given, e.g. "max(dens) > 500" for
+      the areas whose density has ever exceeded 500. As a series is only
+      whole once every dataset is loaded, the series program is run after
+      the load (see Areas::pruneSeries()), removing the Measures it does
+      not keep.
+
+  The comparisons joined by and at the top of the expression are split
+  between the two programs. An or cannot mix values and aggregates: the
+  comparisons within it must all be of values or all be of aggregates, so
+  "pop > 100000 or max(dens) > 500" is not a valid expression.
+
+  A row whose value is missing (e.g. .. in a StatsWales file) has nothing to
+  compare, and is always skipped when filtering by value. Rows and series
+  that do not match are counted, for --where to report, although a dataset
+  restored from its snapshot (see snapshot.h) is not parsed, so its rows are
+  not counted again.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "measure.h"
+
+/*
+  What a comparison compares with its number.
+*/
+enum class ValueAggregate {
+  // The value of each row
+  None,
+
+  // The smallest, largest, mean, or sum of the values of a series, or how
+  // many values it has
+  Min,
+  Max,
+  Avg,
+  Sum,
+  Count
+};
+
+enum class ValueOperator {
+  Less,
+  LessEqual,
+  Greater,
+  GreaterEqual,
+  Equal,
+  NotEqual
+};
+
+/*
+  A comparison of the values (or an aggregate) of a measure, or of every
+  measure if measure is empty, with a number. An aggregate of a range of
+  years has its first and last year (inclusive) in from and to, which are
+  otherwise 0 for the whole series.
+*/
+struct ValueComparison {
+  std::string measure;
+  ValueAggregate aggregate;
+  ValueOperator op;
+  double operand;
+  int from;
+  int to;
+};
+
+class ValueFilter {
+protected:
+  /*
+    An instruction of a program: a comparison, which pushes its result on to
+    the stack, or an and/or of the top two results.
+  */
+  struct Instruction {
+    enum Kind { Compare, And, Or } kind;
+    ValueComparison comparison;
+  };
+
+  std::string mExpression;
+  std::vector<Instruction> mRows;
+  std::vector<Instruction> mSeries;
+
+  mutable std::atomic<uint64_t> mRowsPruned;
+  mutable std::atomic<uint64_t> mSeriesPruned;
+
+  template <typename Compare>
+  static bool run(const std::vector<Instruction>& program,
+                  Compare comparison) noexcept;
+  static bool compare(double lhs, ValueOperator op, double rhs) noexcept;
+  static std::string describe(const std::vector<Instruction>& program);
+  bool mayMatchMeasure(const std::string& measureCode) const noexcept;
+
+public:
+  ValueFilter() noexcept;
+  explicit ValueFilter(const std::string& expression);
+  ~ValueFilter() = default;
+
+  ValueFilter(const ValueFilter& other) = delete;
+  ValueFilter& operator=(const ValueFilter& other) = delete;
+
+  bool empty() const noexcept;
+  bool hasRowPredicate() const noexcept;
+  bool hasSeriesPredicate() const noexcept;
+  const std::string& getExpression() const noexcept;
+  std::string describeRows() const;
+  std::string describeSeries() const;
+  std::unordered_set<std::string> getRowMeasures() const;
+
+  bool keepRow(const std::string& measureCode, double value) const noexcept;
+  bool keepSeries(const Measure& measure) const noexcept;
+
+  uint64_t getRowsPruned() const noexcept;
+  uint64_t getSeriesPruned() const noexcept;
+
+  // The deepest nesting of comparisons a program may have
+  static constexpr size_t MAX_DEPTH = 64;
+};
+
+#endif // VALUEFILTER_H_
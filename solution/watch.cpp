@@ -0,0 +1,203 @@
+
+
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the implementation of the DirectoryWatcher class. See
+  the header file for additional comments.
+*/
+
+#include <cerrno>
+#include <chrono>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "watch.h"
+
+/*
+  Start watching a directory. Changes made from now on will be reported by
+  wait(), even if they happen before it is called.
+
+  @param dir
+    The directory to watch
+
+  @throws
+    std::runtime_error if the directory cannot be watched, or watching a
+    directory is not supported on this platform
+
+  @example
+    DirectoryWatcher watcher("datasets");
+*/
+DirectoryWatcher::DirectoryWatcher(const std::string& dir)
+    : mDir(dir), mFd(-1), mWd(-1) {
+#ifdef __linux__
+  mFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (mFd < 0) {
+    throw std::runtime_error("DirectoryWatcher: Failed to initialise inotify");
+  }
+
+  mWd = inotify_add_watch(mFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+  if (mWd < 0) {
+    close(mFd);
+    throw std::runtime_error("DirectoryWatcher: Failed to watch directory " +
+                             dir);
+  }
+#else
+  throw std::runtime_error("DirectoryWatcher: Watching a directory is not "
+                           "supported on this platform");
+#endif
+}
+
+DirectoryWatcher::~DirectoryWatcher() {
+#ifdef __linux__
+  if (mFd >= 0) {
+    close(mFd);
+  }
+#endif
+}
+
+/*
+  Retrieve the directory being watched.
+
+  @return
+    The directory
+*/
+const std::string& DirectoryWatcher::getDir() const noexcept {
+  return mDir;
+}
+
+/*
+  Read the pending events, adding the names of the files we are interested
+  in that have changed to changed.
+
+  @param files
+    The names of the files we are interested in
+
+  @param changed
+    The names of the changed files
+
+  @return
+    true if any of the files we are interested in changed
+*/
+bool DirectoryWatcher::readEvents(const std::set<std::string>& files,
+                                  std::set<std::string>& changed) {
+  bool any = false;
+
+#ifdef __linux__
+  alignas(struct inotify_event) char buffer[4096];
+  while (true) {
+    const ssize_t length = read(mFd, buffer, sizeof(buffer));
+    if (length < 0) {
+      if (errno == EINTR) {
+        continue;
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+      throw std::runtime_error("DirectoryWatcher::wait: Failed to read "
+                               "events for " + mDir);
+    } else if (length == 0) {
+      break;
+    }
+
+    for (char* ptr = buffer; ptr < buffer + length; ) {
+      const auto* event = reinterpret_cast<const struct inotify_event*>(ptr);
+      ptr += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        // Events were lost, so any of the files may have changed
+        changed.insert(files.cbegin(), files.cend());
+        any = true;
+      } else if (event->len > 0 && files.count(event->name) > 0) {
+        changed.insert(event->name);
+        any = true;
+      }
+    }
+  }
+#endif
+
+  return any;
+}
+
+/*
+  Wait for any of a set of files in the directory to change, and then for
+  the files to be left unchanged for the debounce period, so that a series
+  of writes is reported as one change.
+
+  @param files
+    The names of the files (within the directory) we are interested in
+
+  @param debounceMs
+    How long, in milliseconds, the files must be left unchanged
+
+  @param timeoutMs
+    How long, in milliseconds, to wait for the first change, or a negative
+    number to wait indefinitely
+
+  @return
+    The names of the files that changed, which is empty if none changed
+    before the timeout
+
+  @throws
+    std::runtime_error if the events cannot be read
+
+  @example
+    DirectoryWatcher watcher("datasets");
+    auto changed = watcher.wait({"popu1009.json", "areas.csv"}, 250);
+*/
+std::set<std::string> DirectoryWatcher::wait(
+    const std::set<std::string>& files,
+    unsigned int debounceMs,
+    int timeoutMs) {
+  std::set<std::string> changed;
+
+#ifdef __linux__
+  using Clock = std::chrono::steady_clock;
+  using Milliseconds = std::chrono::milliseconds;
+
+  const auto deadline = Clock::now() + Milliseconds(timeoutMs);
+  auto quietUntil = deadline;
+
+  while (true) {
+    // Until something changes we wait for the timeout, and after that for
+    // the rest of the debounce period since the last change
+    int pollMs = -1;
+    if (!changed.empty() || timeoutMs >= 0) {
+      const auto until = changed.empty() ? deadline : quietUntil;
+      const auto remaining =
+          std::chrono::duration_cast<Milliseconds>(until - Clock::now());
+      pollMs = remaining.count() > 0 ? static_cast<int>(remaining.count()) : 0;
+    }
+
+    struct pollfd pfd = {mFd, POLLIN, 0};
+    const int ready = poll(&pfd, 1, pollMs);
+    if (ready < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error("DirectoryWatcher::wait: Failed to wait for "
+                               "events for " + mDir);
+    } else if (ready == 0) {
+      // Either we timed out, or the files have been quiet long enough
+      return changed;
+    }
+
+    if (readEvents(files, changed)) {
+      quietUntil = Clock::now() + Milliseconds(debounceMs);
+    }
+  }
+#endif
+
+  return changed;
+}
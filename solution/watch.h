@@ -0,0 +1,51 @@
+#ifndef WATCH_H_
+#define WATCH_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: Dr Martin Porcheron
+
+  This file contains the DirectoryWatcher class, which waits for files in a
+  directory to be written to, for BethYw::watchDatasets() to reload the
+  datasets that change.
+
+  On Linux, the directory is watched with inotify, so waiting uses no CPU
+  time. A file counts as changed when a writer closes it, or when a file is
+  moved into its place (e.g. when it is replaced atomically). A series of
+  writes to the same files, e.g. a download arriving in several chunks, is
+  reported once, after the directory has been quiet for the debounce period.
+
+  Watching a directory is not supported on other platforms, where
+  constructing a DirectoryWatcher throws an exception.
+ */
+
+#include <set>
+#include <string>
+
+class DirectoryWatcher {
+protected:
+  std::string mDir;
+  int mFd;
+  int mWd;
+
+  bool readEvents(const std::set<std::string>& files,
+                  std::set<std::string>& changed);
+
+public:
+  explicit DirectoryWatcher(const std::string& dir);
+  ~DirectoryWatcher();
+
+  DirectoryWatcher(const DirectoryWatcher& other) = delete;
+  DirectoryWatcher& operator=(const DirectoryWatcher& other) = delete;
+
+  const std::string& getDir() const noexcept;
+
+  std::set<std::string> wait(const std::set<std::string>& files,
+                             unsigned int debounceMs,
+                             int timeoutMs = -1);
+};
+
+#endif // WATCH_H_